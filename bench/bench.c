@@ -0,0 +1,313 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - THROUGHPUT BENCHMARK
+ *
+ * Runs lexer_analyze (comments, tokenize, checks) over each input file,
+ * in process and from memory, so that disk and terminal output don't add
+ * noise. After one warm-up run, each case repeats until --min-time seconds
+ * have passed (at least 5 runs). The report gives median and p95 MB/s and
+ * tokens/s, plus the heap peak of one cold analysis. p95 is the slow tail:
+ * 95% of runs were at least that fast. MB is 10^6 bytes.
+ *
+ * --json writes the results; --baseline compares against an earlier JSON.
+ * A case regresses if its median MB/s drops, or its heap peak grows, by
+ * more than --threshold percent; the exit status is then 2.
+ *
+ * Usage: bench [--threads N] [--min-time 1.0] [--json out.json]
+ *              [--baseline base.json] [--threshold 5] file...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "lexer.h"
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+#define MIN_RUNS    5
+#define MAX_RUNS    10000
+
+/* BenchCase: the measurements of one input file */
+typedef struct {
+    const char *path;
+    const char *name;           // Base name, used as the key in JSON
+    long long bytes;
+    long long tokens;
+    int runs;
+    double median_seconds;
+    double p95_seconds;
+    long long peak_bytes;       // Heap peak of the warm-up run, buffers included
+    double baseline_mb_s;       // 0 if not in the baseline
+    long long baseline_peak;
+    int regressed;
+} BenchCase;
+
+/*===========================================================================
+ * SECTION 2: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted values */
+static double percentile(const double *sorted, int count, double percent) {
+    int rank = (int)(percent / 100.0 * count + 0.999999);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static char *read_file(const char *path, long long *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = lexer_malloc(*length + 1);
+    if (text && fread(text, 1, *length, file) != (size_t)*length) {
+        lexer_free(text);
+        text = NULL;
+    }
+    if (text) text[*length] = '\0';
+    fclose(file);
+    return text;
+}
+
+static Language language_of(const char *path) {
+    const char *extension = strrchr(path, '.');
+    return extension && strcmp(extension, ".py") == 0 ? LANG_PYTHON : LANG_TYPESCRIPT;
+}
+
+/*===========================================================================
+ * SECTION 3: MEASUREMENT
+ *===========================================================================*/
+
+/* Measure one case; returns 0 if the file cannot be read or memory runs out */
+static int run_case(BenchCase *bench, int thread_count, double min_time) {
+    long long length;
+    lexer_memory_begin();
+    char *source_code = read_file(bench->path, &length);
+    if (!source_code || length > 0x7fffffff) {
+        lexer_memory_end(&(LexerMemory){ 0 });
+        lexer_free(source_code);
+        return 0;
+    }
+    Language lang = language_of(bench->path);
+
+    // Size the token buffer from a cheap first pass instead of MAX_TOKENS
+    LexerIterator iter;
+    TokenView view;
+    int token_estimate = 0;
+    lexer_iter_init(&iter, lang, source_code, (int)length);
+    while (lexer_iter_next(&iter, &view)) token_estimate++;
+    token_estimate += token_estimate / 8 + 1024;
+
+    LexerResult result = { lexer_malloc(sizeof(Token) * token_estimate), token_estimate, 0,
+                           lexer_malloc(sizeof(Comment) * MAX_COMMENTS), MAX_COMMENTS, 0,
+                           lexer_malloc(sizeof(Error) * MAX_ERRORS), MAX_ERRORS, 0 };
+    double *seconds = malloc(sizeof(double) * MAX_RUNS);
+    LexerContext *context = lexer_create();
+    int ok = result.tokens && result.comments && result.errors && seconds && context;
+    if (ok) {
+        lexer_set_threads(context, thread_count);
+        ok = lexer_analyze(context, lang, source_code, (int)length, &result);   // Warm-up
+    }
+    LexerMemory memory;
+    lexer_memory_end(&memory);
+    bench->peak_bytes = memory.peak_bytes;
+    bench->bytes = length;
+    bench->tokens = result.token_count;
+
+    double started = now_seconds();
+    bench->runs = 0;
+    while (ok && bench->runs < MAX_RUNS && (bench->runs < MIN_RUNS || now_seconds() - started < min_time)) {
+        double start = now_seconds();
+        ok = lexer_analyze(context, lang, source_code, (int)length, &result);
+        seconds[bench->runs++] = now_seconds() - start;
+    }
+    if (ok) {
+        qsort(seconds, bench->runs, sizeof(double), compare_doubles);
+        bench->median_seconds = percentile(seconds, bench->runs, 50);
+        bench->p95_seconds = percentile(seconds, bench->runs, 95);
+    }
+
+    lexer_destroy(context);
+    free(seconds);
+    lexer_free(result.tokens);
+    lexer_free(result.comments);
+    lexer_free(result.errors);
+    lexer_free(source_code);
+    return ok;
+}
+
+/*===========================================================================
+ * SECTION 4: BASELINE
+ * Reads back the JSON that write_json produces: each case object starts with
+ * its "case" key and has one key per line.
+ *===========================================================================*/
+
+static double json_number_after(const char *object, const char *object_end, const char *key) {
+    const char *found = strstr(object, key);
+    return found && (!object_end || found < object_end) ? strtod(found + strlen(key), NULL) : 0;
+}
+
+static void compare_baseline(BenchCase *cases, int case_count, const char *baseline, double threshold) {
+    char key[512];
+    for (int c = 0; c < case_count; c++) {
+        BenchCase *bench = &cases[c];
+        snprintf(key, sizeof(key), "\"case\": \"%s\"", bench->name);
+        const char *object = strstr(baseline, key);
+        if (!object) continue;
+        const char *object_end = strstr(object, "}");
+        bench->baseline_mb_s = json_number_after(object, object_end, "\"median_mb_s\": ");
+        bench->baseline_peak = (long long)json_number_after(object, object_end, "\"peak_bytes\": ");
+
+        double mb_s = bench->bytes / 1e6 / bench->median_seconds;
+        bench->regressed = (bench->baseline_mb_s > 0 && mb_s < bench->baseline_mb_s * (1 - threshold / 100)) ||
+                           (bench->baseline_peak > 0 && bench->peak_bytes > bench->baseline_peak * (1 + threshold / 100));
+    }
+}
+
+/*===========================================================================
+ * SECTION 5: OUTPUT
+ *===========================================================================*/
+
+static void print_table(FILE *out, const BenchCase *cases, int case_count, int thread_count, int has_baseline,
+                        double threshold) {
+    fprintf(out, "Throughput, %d thread%s (median / p95 of the runs)\n", thread_count, thread_count == 1 ? "" : "s");
+    fprintf(out, "  %-20s %10s %6s %9s %9s %12s %12s %9s", "Case", "Bytes", "Runs", "MB/s", "p95 MB/s", "Mtok/s",
+            "p95 Mtok/s", "Peak MB");
+    if (has_baseline) fprintf(out, " %9s", "vs base");
+    fprintf(out, "\n");
+
+    int regressions = 0;
+    for (int c = 0; c < case_count; c++) {
+        const BenchCase *bench = &cases[c];
+        double mb_s = bench->bytes / 1e6 / bench->median_seconds;
+        fprintf(out, "  %-20s %10lld %6d %9.2f %9.2f %12.3f %12.3f %9.2f", bench->name, bench->bytes, bench->runs, mb_s,
+                bench->bytes / 1e6 / bench->p95_seconds, bench->tokens / 1e6 / bench->median_seconds,
+                bench->tokens / 1e6 / bench->p95_seconds, bench->peak_bytes / 1e6);
+        if (has_baseline && bench->baseline_mb_s > 0) {
+            fprintf(out, " %+8.1f%%%s", (mb_s / bench->baseline_mb_s - 1) * 100, bench->regressed ? "  REGRESSION" : "");
+        } else if (has_baseline) {
+            fprintf(out, " %9s", "new");
+        }
+        fprintf(out, "\n");
+        regressions += bench->regressed;
+    }
+    if (has_baseline) {
+        fprintf(out, "%d regression%s over %.1f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    }
+}
+
+static int write_json(const char *path, const BenchCase *cases, int case_count, int thread_count) {
+    FILE *out = fopen(path, "w");
+    if (!out) return 0;
+    struct rusage usage;
+    long max_rss_kb = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+
+    fprintf(out, "{\n  \"threads\": %d,\n  \"max_rss_bytes\": %lld,\n  \"cases\": [", thread_count, max_rss_kb * 1024LL);
+    for (int c = 0; c < case_count; c++) {
+        const BenchCase *bench = &cases[c];
+        fprintf(out, "%s\n    {\n", c ? "," : "");
+        fprintf(out, "      \"case\": \"%s\",\n", bench->name);
+        fprintf(out, "      \"bytes\": %lld,\n", bench->bytes);
+        fprintf(out, "      \"tokens\": %lld,\n", bench->tokens);
+        fprintf(out, "      \"runs\": %d,\n", bench->runs);
+        fprintf(out, "      \"median_mb_s\": %.3f,\n", bench->bytes / 1e6 / bench->median_seconds);
+        fprintf(out, "      \"p95_mb_s\": %.3f,\n", bench->bytes / 1e6 / bench->p95_seconds);
+        fprintf(out, "      \"median_tokens_s\": %.0f,\n", bench->tokens / bench->median_seconds);
+        fprintf(out, "      \"p95_tokens_s\": %.0f,\n", bench->tokens / bench->p95_seconds);
+        fprintf(out, "      \"peak_bytes\": %lld,\n", bench->peak_bytes);
+        fprintf(out, "      \"regressed\": %s\n", bench->regressed ? "true" : "false");
+        fprintf(out, "    }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    return fclose(out) == 0;
+}
+
+/*===========================================================================
+ * SECTION 6: MAIN
+ *===========================================================================*/
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--threads N] [--min-time 1.0] [--json out.json] [--baseline base.json]\n"
+                    "       [--threshold 5] file...\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    int thread_count = 1;
+    double min_time = 1.0, threshold = 5.0;
+    const char *json_path = NULL, *baseline_path = NULL;
+    BenchCase *cases = calloc(argc, sizeof(BenchCase));
+    int case_count = 0;
+    if (!cases) return 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (argv[i][0] != '-') {
+            const char *slash = strrchr(argv[i], '/');
+            cases[case_count].path = argv[i];
+            cases[case_count++].name = slash ? slash + 1 : argv[i];
+            continue;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--threads") == 0) thread_count = atoi(value);
+        else if (strcmp(argv[i], "--min-time") == 0) min_time = strtod(value, NULL);
+        else if (strcmp(argv[i], "--json") == 0) json_path = value;
+        else if (strcmp(argv[i], "--baseline") == 0) baseline_path = value;
+        else if (strcmp(argv[i], "--threshold") == 0) threshold = strtod(value, NULL);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (case_count == 0 || thread_count < 1 || thread_count > MAX_THREADS || min_time < 0 || threshold < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int c = 0; c < case_count; c++) {
+        fprintf(stderr, "  %s...\n", cases[c].name);
+        if (!run_case(&cases[c], thread_count, min_time)) {
+            fprintf(stderr, "Error: Cannot benchmark '%s'\n", cases[c].path);
+            return 1;
+        }
+    }
+
+    int has_baseline = 0, regressions = 0;
+    if (baseline_path) {
+        long long length;
+        char *baseline = read_file(baseline_path, &length);
+        if (baseline) {
+            compare_baseline(cases, case_count, baseline, threshold);
+            lexer_free(baseline);
+            has_baseline = 1;
+        } else {
+            fprintf(stderr, "No baseline at '%s'; nothing to compare against\n", baseline_path);
+        }
+    }
+    print_table(stdout, cases, case_count, thread_count, has_baseline, threshold);
+    if (json_path && !write_json(json_path, cases, case_count, thread_count)) {
+        fprintf(stderr, "Error: Cannot write '%s'\n", json_path);
+        return 1;
+    }
+    for (int c = 0; c < case_count; c++) regressions += cases[c].regressed;
+    free(cases);
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,599 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - CORPUS GENERATOR
+ *
+ * Writes deterministic Python or TypeScript source of a given size for
+ * benchmarks: functions with parameters, locals, loops, conditionals, calls,
+ * comments, docstrings, strings and numbers. The same seed always gives the
+ * same file. Names are only used after their declaration and inside their
+ * scope, and no builtins are called (the lexer would take print, range or log
+ * for misspelled keywords), so the output is clean unless errors are injected; with
+ * --error-rate, that fraction of statements is replaced by one of the four
+ * error kinds the lexer detects (in turn, chosen at random).
+ *
+ * Usage: gencorpus --lang py|ts [--size 64K] [--seed 1]
+ *                  [--profile typical|comments|strings] [--error-rate 0.01] [-o file]
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*===========================================================================
+ * SECTION 1: CONSTANTS
+ *===========================================================================*/
+
+#define NAME_LENGTH     48
+#define NAME_WINDOW     64      // Most recent globals/functions that code may refer to
+#define MAX_DEPTH       3       // Nesting of blocks inside a function
+#define MAX_LOCALS      256
+#define LINE_BUFFER     8192
+
+/* Words for identifiers; joined with '_' and a number they are never close to a keyword */
+static const char *const WORDS[] = {
+    "user", "count", "total", "value", "index", "buffer", "result", "config", "record", "item",
+    "name", "data", "offset", "length", "cache", "entry", "node", "parent", "child", "score",
+    "limit", "width", "height", "price", "amount", "delta", "ratio", "label", "token", "state",
+};
+#define WORD_COUNT (int)(sizeof(WORDS) / sizeof(WORDS[0]))
+
+/* Words for comments and strings */
+static const char *const PROSE[] = {
+    "compute", "the", "running", "total", "for", "each", "record", "before", "returning", "result",
+    "skip", "empty", "entries", "and", "keep", "order", "stable", "across", "calls", "update",
+    "cache", "when", "input", "changes", "values", "are", "clamped", "to", "limit", "note",
+};
+#define PROSE_COUNT (int)(sizeof(PROSE) / sizeof(PROSE[0]))
+
+/* Keyword misspellings (edit distance 1-2), for injected errors */
+static const char *const PYTHON_MISSPELLINGS[] = {
+    "retrun", "whiel", "contniue", "lamdba", "yeild", "improt", "Flase", "Ture", "asert", "globl", "finaly",
+};
+static const char *const TYPESCRIPT_MISSPELLINGS[] = {
+    "fucntion", "retrun", "cosnt", "whiel", "swtich", "defualt", "flase", "ture", "typoef", "interfcae",
+};
+#define MISSPELLING_COUNT(list) (int)(sizeof(list) / sizeof(list[0]))
+
+typedef enum { LANG_PY, LANG_TS } CorpusLanguage;
+
+enum { ERROR_MISSPELLED, ERROR_TYPE_MISMATCH, ERROR_UNDECLARED, ERROR_OPERATOR, ERROR_KINDS };
+static const char *const ERROR_NAMES[ERROR_KINDS] = {
+    "misspelled keyword", "type mismatch", "undeclared identifier", "invalid operator"
+};
+
+/* Profile: the mix of statements */
+typedef struct {
+    const char *name;
+    int comment_percent;        // Statements that are comments
+    int docstring_percent;      // Functions with a docstring / JSDoc block
+    int string_percent;         // Statements that assign a string
+    int string_min, string_max; // String literal length
+    int comment_lines_max;      // Lines in one comment block
+} Profile;
+
+static const Profile PROFILES[] = {
+    { "typical",  10,  50, 10,  8,  40, 2 },
+    { "comments", 45, 100,  8,  8,  40, 8 },
+    { "strings",   6,  30, 50, 60, 240, 2 },
+};
+#define PROFILE_COUNT (int)(sizeof(PROFILES) / sizeof(PROFILES[0]))
+
+/*===========================================================================
+ * SECTION 2: DATA STRUCTURES
+ *===========================================================================*/
+
+typedef struct {
+    char name[NAME_LENGTH];
+    int param_count;            // Functions only
+    int is_const;               // TypeScript const: never assigned again
+    int is_text;                // Holds a string: not used in arithmetic
+} Name;
+
+/* NameRing: the last NAME_WINDOW names of a kind (all still in scope) */
+typedef struct {
+    Name names[NAME_WINDOW];
+    int count;                  // Ever added
+} NameRing;
+
+typedef struct {
+    FILE *out;
+    uint64_t rng;
+    const Profile *profile;
+    CorpusLanguage lang;
+    double error_rate;
+    long long bytes;
+    long long lines;
+    long long injected[ERROR_KINDS];
+    int serial;                 // Makes every generated name unique
+    NameRing globals;
+    NameRing functions;
+    Name locals[MAX_LOCALS];    // Parameters and locals in scope, innermost last
+    int local_count;
+} Generator;
+
+/*===========================================================================
+ * SECTION 3: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+/* splitmix64: small, fast and identical on every platform */
+static uint64_t rng_next(Generator *gen) {
+    uint64_t z = (gen->rng += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static int rng_below(Generator *gen, int bound) {
+    return (int)(rng_next(gen) % (uint64_t)bound);
+}
+
+static int rng_percent(Generator *gen, int percent) {
+    return rng_below(gen, 100) < percent;
+}
+
+static int rng_chance(Generator *gen, double probability) {
+    return (rng_next(gen) >> 11) * (1.0 / 9007199254740992.0) < probability;
+}
+
+static void emit(Generator *gen, const char *format, ...) {
+    char line[LINE_BUFFER];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length >= (int)sizeof(line)) length = sizeof(line) - 1;
+    fwrite(line, 1, length, gen->out);
+    gen->bytes += length;
+    for (int i = 0; i < length; i++) gen->lines += line[i] == '\n';
+}
+
+static void indent(Generator *gen, int depth) {
+    emit(gen, "%*s", depth * (gen->lang == LANG_PY ? 4 : 2), "");
+}
+
+static void new_name(Generator *gen, char *name) {
+    snprintf(name, NAME_LENGTH, "%s_%s_%d", WORDS[rng_below(gen, WORD_COUNT)], WORDS[rng_below(gen, WORD_COUNT)],
+             ++gen->serial);
+}
+
+static Name *ring_add(NameRing *ring) {
+    return &ring->names[ring->count++ % NAME_WINDOW];
+}
+
+static const Name *ring_pick(Generator *gen, const NameRing *ring) {
+    int available = ring->count < NAME_WINDOW ? ring->count : NAME_WINDOW;
+    return available ? &ring->names[rng_below(gen, available)] : NULL;
+}
+
+/* A numeric name in scope: a local (most of the time) or a global; NULL if there is none */
+static const char *pick_variable(Generator *gen) {
+    for (int attempt = 0; attempt < 8 && gen->local_count > 0; attempt++) {
+        if (gen->globals.count > 0 && rng_percent(gen, 20)) break;
+        const Name *local = &gen->locals[rng_below(gen, gen->local_count)];
+        if (!local->is_text) return local->name;
+    }
+    const Name *global = ring_pick(gen, &gen->globals);
+    return global ? global->name : NULL;
+}
+
+/* A local that may be assigned again; NULL if there is none */
+static const char *pick_assignable(Generator *gen) {
+    for (int attempt = 0; attempt < 8 && gen->local_count > 0; attempt++) {
+        const Name *local = &gen->locals[rng_below(gen, gen->local_count)];
+        if (!local->is_const && !local->is_text) return local->name;
+    }
+    return NULL;
+}
+
+/* Declare a local; the name is in scope for the statements that follow */
+static const char *declare_local(Generator *gen, const char *name, int is_const, int is_text) {
+    if (gen->local_count == MAX_LOCALS) gen->local_count--;   // Reuse the slot of the innermost one
+    Name *local = &gen->locals[gen->local_count++];
+    snprintf(local->name, NAME_LENGTH, "%s", name);
+    local->is_const = is_const;
+    local->is_text = is_text;
+    return local->name;
+}
+
+static const char *add_local(Generator *gen, int is_const, int is_text) {
+    char name[NAME_LENGTH];
+    new_name(gen, name);
+    return declare_local(gen, name, is_const, is_text);
+}
+
+static void prose(Generator *gen, int words) {
+    for (int i = 0; i < words; i++) emit(gen, "%s%s", i ? " " : "", PROSE[rng_below(gen, PROSE_COUNT)]);
+}
+
+/*===========================================================================
+ * SECTION 4: EXPRESSIONS
+ *===========================================================================*/
+
+static void number(Generator *gen) {
+    if (rng_percent(gen, 70)) emit(gen, "%d", rng_below(gen, 1000));
+    else emit(gen, "%d.%02d", rng_below(gen, 100), rng_below(gen, 100));
+}
+
+static void string_literal(Generator *gen, int min_length, int max_length) {
+    static const char ALPHABET[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .,:;-+";
+    int length = min_length + rng_below(gen, max_length - min_length + 1);
+    char quote = gen->lang == LANG_TS && rng_percent(gen, 50) ? '\'' : '"';
+    char text[LINE_BUFFER / 2];
+    int used = 0;
+    for (int i = 0; i < length && used < (int)sizeof(text) - 3; i++) {
+        if (rng_percent(gen, 3)) {
+            text[used++] = '\\';
+            text[used++] = "nt\\"[rng_below(gen, 3)];
+        } else {
+            text[used++] = ALPHABET[rng_below(gen, sizeof(ALPHABET) - 1)];
+        }
+    }
+    text[used] = '\0';
+    emit(gen, "%c%s%c", quote, text, quote);
+}
+
+static void term_call(Generator *gen, const Name *function) {
+    emit(gen, "%s(", function->name);
+    for (int p = 0; p < function->param_count; p++) {
+        const char *argument = pick_variable(gen);
+        if (p) emit(gen, ", ");
+        if (argument) emit(gen, "%s", argument);
+        else number(gen);
+    }
+    emit(gen, ")");
+}
+
+static void term(Generator *gen) {
+    const char *variable = pick_variable(gen);
+    const Name *function = ring_pick(gen, &gen->functions);
+    int choice = rng_below(gen, 10);
+    if (choice < 5 && variable) {
+        emit(gen, "%s", variable);
+    } else if (choice < 7 && function) {
+        term_call(gen, function);
+    } else {
+        number(gen);
+    }
+}
+
+static void expression(Generator *gen) {
+    static const char *const OPERATORS[] = { "+", "-", "*", "/", "%" };
+    int terms = 1 + rng_below(gen, 3);
+    for (int t = 0; t < terms; t++) {
+        if (t) emit(gen, " %s ", OPERATORS[rng_below(gen, 5)]);
+        term(gen);
+    }
+}
+
+static void comparison(Generator *gen) {
+    static const char *const COMPARISONS[] = { "<", ">", "<=", ">=", "==", "!=" };
+    term(gen);
+    emit(gen, " %s ", COMPARISONS[rng_below(gen, 6)]);
+    term(gen);
+}
+
+/*===========================================================================
+ * SECTION 5: STATEMENTS
+ *===========================================================================*/
+
+static void comment_block(Generator *gen, int depth) {
+    int lines = 1 + rng_below(gen, gen->profile->comment_lines_max);
+    if (gen->lang == LANG_TS && lines > 2) {
+        indent(gen, depth);
+        emit(gen, "/*\n");
+        for (int l = 0; l < lines; l++) {
+            indent(gen, depth);
+            emit(gen, " * ");
+            prose(gen, 4 + rng_below(gen, 8));
+            emit(gen, "\n");
+        }
+        indent(gen, depth);
+        emit(gen, " */\n");
+        return;
+    }
+    for (int l = 0; l < lines; l++) {
+        indent(gen, depth);
+        emit(gen, gen->lang == LANG_PY ? "# " : "// ");
+        prose(gen, 4 + rng_below(gen, 8));
+        emit(gen, "\n");
+    }
+}
+
+static void line_end(Generator *gen) {
+    if (gen->lang == LANG_TS) emit(gen, ";");
+    if (rng_percent(gen, gen->profile->comment_percent / 3)) {
+        emit(gen, gen->lang == LANG_PY ? "  # " : " // ");
+        prose(gen, 2 + rng_below(gen, 4));
+    }
+    emit(gen, "\n");
+}
+
+/* One statement replaced by an error of the given kind */
+static void error_statement(Generator *gen, int depth, int kind) {
+    int python = gen->lang == LANG_PY;
+    const char *variable = pick_variable(gen);
+    indent(gen, depth);
+    switch (kind) {
+        case ERROR_MISSPELLED:
+            if (python) {
+                emit(gen, "%s = ", PYTHON_MISSPELLINGS[rng_below(gen, MISSPELLING_COUNT(PYTHON_MISSPELLINGS))]);
+            } else {
+                emit(gen, "let %s = ", TYPESCRIPT_MISSPELLINGS[rng_below(gen, MISSPELLING_COUNT(TYPESCRIPT_MISSPELLINGS))]);
+            }
+            expression(gen);
+            break;
+        case ERROR_TYPE_MISMATCH:
+            if (python && variable) {
+                static const char *const MISMATCHES[] = { "int = 3.5", "int = \"text\"", "float = \"text\"", "str = 42" };
+                emit(gen, "%s: %s", variable, MISMATCHES[rng_below(gen, 4)]);
+            } else if (python) {
+                emit(gen, "%s = 0", add_local(gen, 0, 0));  // Nothing to annotate yet
+                kind = -1;
+            } else {
+                static const char *const MISMATCHES[] = { "number = \"text\"", "string = 42", "boolean = 1" };
+                emit(gen, "let %s: %s", add_local(gen, 0, 1), MISMATCHES[rng_below(gen, 3)]);
+            }
+            break;
+        case ERROR_UNDECLARED: {
+            char missing[NAME_LENGTH];
+            snprintf(missing, sizeof(missing), "missing_%s_%d", WORDS[rng_below(gen, WORD_COUNT)], ++gen->serial);
+            emit(gen, python ? "%s = %s + 1" : "let %s = %s + 1", add_local(gen, 0, 0), missing);
+            break;
+        }
+        default:
+            if (python) emit(gen, "if %s =< %d:\n", variable ? variable : "0", rng_below(gen, 100));
+            else emit(gen, "if (%s =< %d) {\n", variable ? variable : "0", rng_below(gen, 100));
+            indent(gen, depth + 1);
+            emit(gen, python ? "pass\n" : "return %d;\n", 0);
+            indent(gen, depth);
+            emit(gen, python ? "" : "}\n");
+            if (kind >= 0) gen->injected[kind]++;
+            return;
+    }
+    if (kind >= 0) gen->injected[kind]++;
+    line_end(gen);
+}
+
+static void block(Generator *gen, int depth, int statements);
+
+/* Declaration of a new numeric local; it is in scope only after its initializer */
+static void declaration(Generator *gen, int depth) {
+    char name[NAME_LENGTH];
+    new_name(gen, name);
+    int is_const = gen->lang == LANG_TS && rng_percent(gen, 30);
+    indent(gen, depth);
+    emit(gen, gen->lang == LANG_PY ? "%s = " : is_const ? "const %s = " : "let %s = ", name);
+    expression(gen);
+    line_end(gen);
+    declare_local(gen, name, is_const, 0);
+}
+
+/* One statement; the first of a block is code, since a Python block of only comments is invalid */
+static void statement(Generator *gen, int depth, int allow_comment) {
+    if (gen->error_rate > 0 && rng_chance(gen, gen->error_rate)) {
+        error_statement(gen, depth, rng_below(gen, ERROR_KINDS));
+        return;
+    }
+    int python = gen->lang == LANG_PY;
+    const Profile *profile = gen->profile;
+    const char *variable, *assigned;
+    int roll = allow_comment ? rng_below(gen, 100) : profile->comment_percent + rng_below(gen, 100 - profile->comment_percent);
+
+    if (roll < profile->comment_percent) {
+        comment_block(gen, depth);
+    } else if (roll < profile->comment_percent + profile->string_percent) {
+        indent(gen, depth);
+        emit(gen, python ? "%s = " : "const %s = ", add_local(gen, 1, 1));
+        string_literal(gen, profile->string_min, profile->string_max);
+        line_end(gen);
+    } else if (depth < MAX_DEPTH && roll < 70 && (variable = pick_variable(gen))) {
+        // Compound statement; names declared inside are only used inside
+        int saved_locals = gen->local_count;
+        int kind = rng_below(gen, 3);
+        indent(gen, depth);
+        if (kind == 0) {
+            const char *other = pick_variable(gen);     // May fail where the first pick did not
+            const char *counter = add_local(gen, python, 0);   // A Python loop variable is not assigned
+            if (python) emit(gen, "for %s in [%s, %d, %s]:\n", counter, variable, rng_below(gen, 100), other ? other : variable);
+            else emit(gen, "for (let %s = 0; %s < %s; %s++) {\n", counter, counter, variable, counter);
+        } else if (kind == 1) {
+            emit(gen, python ? "if " : "if (");
+            comparison(gen);
+            emit(gen, python ? ":\n" : ") {\n");
+        } else {
+            emit(gen, python ? "while " : "while (");
+            comparison(gen);
+            emit(gen, python ? ":\n" : ") {\n");
+        }
+        block(gen, depth + 1, 1 + rng_below(gen, 4));
+        gen->local_count = saved_locals;
+        if (kind == 1 && rng_percent(gen, 40)) {
+            indent(gen, depth);
+            emit(gen, python ? "else:\n" : "} else {\n");
+            block(gen, depth + 1, 1 + rng_below(gen, 3));
+            gen->local_count = saved_locals;
+        }
+        if (!python) {
+            indent(gen, depth);
+            emit(gen, "}\n");
+        }
+    } else if (roll < 80 && (assigned = pick_assignable(gen))) {
+        indent(gen, depth);
+        emit(gen, "%s = ", assigned);
+        expression(gen);
+        line_end(gen);
+    } else if (roll < 88 && gen->functions.count > 0) {
+        indent(gen, depth);
+        term_call(gen, ring_pick(gen, &gen->functions));
+        line_end(gen);
+    } else {
+        declaration(gen, depth);
+    }
+}
+
+static void block(Generator *gen, int depth, int statements) {
+    for (int s = 0; s < statements; s++) statement(gen, depth, s > 0);
+}
+
+/*===========================================================================
+ * SECTION 6: FUNCTIONS AND FILES
+ *===========================================================================*/
+
+static void function(Generator *gen) {
+    int python = gen->lang == LANG_PY;
+    Name declared;
+    new_name(gen, declared.name);
+    declared.param_count = rng_below(gen, 4);
+    declared.is_const = declared.is_text = 0;
+    gen->local_count = 0;
+
+    if (!python && rng_percent(gen, gen->profile->docstring_percent)) {
+        emit(gen, "/**\n * ");
+        prose(gen, 6 + rng_below(gen, 10));
+        emit(gen, "\n");
+        for (int l = rng_below(gen, gen->profile->comment_lines_max); l > 0; l--) {
+            emit(gen, " * ");
+            prose(gen, 6 + rng_below(gen, 10));
+            emit(gen, "\n");
+        }
+        emit(gen, " */\n");
+    }
+    emit(gen, python ? "def %s(" : "function %s(", declared.name);
+    for (int p = 0; p < declared.param_count; p++) {
+        const char *param = add_local(gen, 0, 0);
+        emit(gen, python ? "%s%s" : "%s%s: number", p ? ", " : "", param);
+    }
+    emit(gen, python ? "):\n" : "): number {\n");
+
+    if (python && rng_percent(gen, gen->profile->docstring_percent)) {
+        emit(gen, "    \"\"\"");
+        prose(gen, 6 + rng_below(gen, 10));
+        for (int l = rng_below(gen, gen->profile->comment_lines_max); l > 0; l--) {
+            emit(gen, "\n    ");
+            prose(gen, 6 + rng_below(gen, 10));
+        }
+        emit(gen, "\"\"\"\n");
+    }
+    // Start with a numeric local so that loops and returns have something to use
+    indent(gen, 1);
+    emit(gen, python ? "%s = " : "let %s = ", add_local(gen, 0, 0));
+    number(gen);
+    line_end(gen);
+    block(gen, 1, 3 + rng_below(gen, 10));
+    indent(gen, 1);
+    emit(gen, "return ");
+    expression(gen);
+    emit(gen, python ? "\n\n" : ";\n}\n\n");
+
+    *ring_add(&gen->functions) = declared;
+    gen->local_count = 0;
+}
+
+static void global(Generator *gen) {
+    Name *declared = ring_add(&gen->globals);
+    new_name(gen, declared->name);
+    declared->param_count = declared->is_const = declared->is_text = 0;
+    emit(gen, gen->lang == LANG_PY ? "%s = " : "let %s = ", declared->name);
+    number(gen);
+    line_end(gen);
+}
+
+static void generate(Generator *gen, long long size) {
+    comment_block(gen, 0);
+    emit(gen, "\n");
+    while (gen->bytes < size) {
+        if (gen->globals.count < 8 || rng_percent(gen, 15)) {
+            global(gen);
+            if (rng_percent(gen, 50)) continue;
+            emit(gen, "\n");
+        }
+        function(gen);
+    }
+}
+
+/*===========================================================================
+ * SECTION 7: COMMAND LINE
+ *===========================================================================*/
+
+/* "64K", "10M", "1G" or a byte count; returns -1 if invalid */
+static long long parse_size(const char *text) {
+    char *end;
+    long long size = strtoll(text, &end, 10);
+    if (end == text || size < 0) return -1;
+    switch (*end) {
+        case '\0':              return size;
+        case 'k': case 'K':     size <<= 10; break;
+        case 'm': case 'M':     size <<= 20; break;
+        case 'g': case 'G':     size <<= 30; break;
+        default:                return -1;
+    }
+    return end[1] == '\0' ? size : -1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s --lang py|ts [--size 64K] [--seed 1] [--profile typical|comments|strings]\n"
+                    "       [--error-rate 0.01] [-o file]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    Generator *gen = calloc(1, sizeof(Generator));
+    if (!gen) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    long long size = 64 << 10;
+    const char *output = NULL;
+    int has_lang = 0;
+    gen->rng = 1;
+    gen->profile = &PROFILES[0];
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--lang") == 0 && value) {
+            has_lang = strcmp(value, "py") == 0 || strcmp(value, "ts") == 0;
+            gen->lang = strcmp(value, "ts") == 0 ? LANG_TS : LANG_PY;
+        } else if (strcmp(argv[i], "--size") == 0 && value) {
+            size = parse_size(value);
+        } else if (strcmp(argv[i], "--seed") == 0 && value) {
+            gen->rng = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--profile") == 0 && value) {
+            gen->profile = NULL;
+            for (int p = 0; p < PROFILE_COUNT; p++) {
+                if (strcmp(value, PROFILES[p].name) == 0) gen->profile = &PROFILES[p];
+            }
+        } else if (strcmp(argv[i], "--error-rate") == 0 && value) {
+            gen->error_rate = strtod(value, NULL);
+        } else if (strcmp(argv[i], "-o") == 0 && value) {
+            output = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (!has_lang || size < 0 || !gen->profile || gen->error_rate < 0 || gen->error_rate > 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    gen->out = output ? fopen(output, "w") : stdout;
+    if (!gen->out) {
+        fprintf(stderr, "Error: Cannot write '%s'\n", output);
+        return 1;
+    }
+    generate(gen, size);
+    if (output && fclose(gen->out) != 0) {
+        fprintf(stderr, "Error: Cannot write '%s'\n", output);
+        return 1;
+    }
+
+    fprintf(stderr, "%s: %lld bytes, %lld lines, %s profile", output ? output : "stdout", gen->bytes, gen->lines,
+            gen->profile->name);
+    for (int k = 0; k < ERROR_KINDS; k++) {
+        if (gen->injected[k]) fprintf(stderr, ", %lld %s", gen->injected[k], ERROR_NAMES[k]);
+    }
+    fprintf(stderr, "\n");
+    free(gen);
+    return 0;
+}
@@ -0,0 +1,345 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - KERNEL MICROBENCHMARKS
+ *
+ * Times the building blocks of lexer_analyze on their own, on seeded inputs
+ * shaped like real code: keyword-like and ordinary identifiers, code bytes,
+ * comment-heavy source, and token streams with many declared names (also
+ * parsed into a syntax tree). Each
+ * kernel warms up first, then runs in batches; the table gives the median
+ * and minimum cost per unit over the batches.
+ *
+ * On x86 cycles come from the TSC (reference cycles at a constant rate, not
+ * core clock cycles); elsewhere they are nanoseconds. Every result feeds a
+ * volatile sink, so the compiler cannot drop the calls being timed.
+ *
+ * Usage: microbench [--filter text] [--batches 31]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_NAME "cycles"
+static inline unsigned long long cycles_now(void) {
+    _mm_lfence();   // Keep earlier work from drifting past the read
+    return __rdtsc();
+}
+#else
+#define CYCLE_NAME "ns"
+static inline unsigned long long cycles_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+/*===========================================================================
+ * SECTION 1: CONSTANTS AND INPUTS
+ *===========================================================================*/
+
+#define WORD_COUNT      4096
+#define BUFFER_SIZE     (64 * 1024)
+#define WARMUP_SECONDS  0.1
+#define BATCH_SECONDS   0.002
+
+static const char *const PYTHON_KEYWORDS[] = {
+    "def", "class", "if", "else", "elif", "for", "while", "return", "import", "from", "as", "try", "except",
+    "finally", "with", "lambda", "yield", "pass", "break", "continue", "and", "or", "not", "in", "is", "None",
+    "True", "False", "global", "int", "float", "str", "bool", "list", "dict",
+};
+#define PYTHON_KEYWORD_TOTAL (int)(sizeof(PYTHON_KEYWORDS) / sizeof(PYTHON_KEYWORDS[0]))
+
+static const char *const NAME_PARTS[] = {
+    "user", "count", "total", "value", "index", "buffer", "result", "config", "node", "item", "data", "size",
+};
+#define NAME_PART_COUNT (int)(sizeof(NAME_PARTS) / sizeof(NAME_PARTS[0]))
+
+static volatile long long sink;     // Every kernel result ends up here
+static unsigned long long rng = 42;
+
+/* Inputs, built once by setup_inputs */
+static char words[WORD_COUNT][40];          // 30% keywords, 50% long names, 20% short names
+static char code_text[BUFFER_SIZE + 1];     // Python-like code
+static char identifier_text[BUFFER_SIZE + 1];
+static char python_comment_text[BUFFER_SIZE + 1];
+static char typescript_comment_text[BUFFER_SIZE + 1];
+static char clean_code[BUFFER_SIZE + 1];    // Output of the comment scans
+static Token *scan_tokens;                  // Output of the identifier scan
+static Token *symbol_tokens[2];             // Token streams with 64 and 5000 declared names
+static const long long word_count = WORD_COUNT;
+static long long code_length, identifier_length, python_comment_length, typescript_comment_length;
+static long long symbol_token_counts[2];
+static Comment comments[MAX_COMMENTS];
+static Error errors[MAX_ERRORS];
+static SyntaxTree tree;                     // Reused by every parse
+
+/*===========================================================================
+ * SECTION 2: INPUT GENERATION
+ *===========================================================================*/
+
+static unsigned long long rng_next(void) {
+    unsigned long long z = (rng += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static int rng_below(int bound) {
+    return (int)(rng_next() % (unsigned long long)bound);
+}
+
+/* Fill buffer with generated lines until it is full (always NUL-terminated) */
+static void fill_text(char *buffer, void (*line)(char *out, int size)) {
+    int used = 0;
+    char text[256];
+    for (;;) {
+        line(text, sizeof(text));
+        int length = strlen(text);
+        if (used + length > BUFFER_SIZE) break;
+        memcpy(buffer + used, text, length);
+        used += length;
+    }
+    buffer[used] = '\0';
+}
+
+static const char *random_word(void) {
+    return words[rng_below(WORD_COUNT)];
+}
+
+static void code_line(char *out, int size) {
+    static const char *const OPERATORS[] = { "+", "-", "*", "==", "<=", "+=" };
+    snprintf(out, size, "    %s = %s(%s, %s[%d]) %s %d\n", random_word(), random_word(), random_word(), random_word(),
+             rng_below(100), OPERATORS[rng_below(6)], rng_below(1000));
+}
+
+static void identifier_line(char *out, int size) {
+    snprintf(out, size, "%s %s %s %s %s %s\n", random_word(), random_word(), random_word(), random_word(),
+             random_word(), random_word());
+}
+
+static void python_comment_line(char *out, int size) {
+    int kind = rng_below(4);
+    if (kind == 0) snprintf(out, size, "# %s %s %s %s\n", random_word(), random_word(), random_word(), random_word());
+    else if (kind == 1) snprintf(out, size, "    \"\"\"%s %s\n    %s %s\"\"\"\n", random_word(), random_word(), random_word(), random_word());
+    else snprintf(out, size, "    %s = %s + 1  # %s\n", random_word(), random_word(), random_word());
+}
+
+static void typescript_comment_line(char *out, int size) {
+    int kind = rng_below(4);
+    if (kind == 0) snprintf(out, size, "// %s %s %s %s\n", random_word(), random_word(), random_word(), random_word());
+    else if (kind == 1) snprintf(out, size, "  /* %s %s\n   * %s %s */\n", random_word(), random_word(), random_word(), random_word());
+    else snprintf(out, size, "  let %s = %s + 1; // %s\n", random_word(), random_word(), random_word());
+}
+
+/* Python source declaring name_count names, then using them; tokenized into *tokens */
+static long long symbol_stream(int name_count, Token **tokens) {
+    char *source = malloc(BUFFER_SIZE * 4);
+    int used = 0;
+    for (int n = 0; n < name_count; n++) used += sprintf(source + used, "%s_%d = %d\n", NAME_PARTS[n % NAME_PART_COUNT], n, n);
+    while (used < BUFFER_SIZE * 4 - 128) {
+        int uses[3] = { rng_below(name_count), rng_below(name_count), rng_below(name_count) };
+        used += sprintf(source + used, "%s_%d = %s_%d + %s_%d\n", NAME_PARTS[uses[0] % NAME_PART_COUNT], uses[0],
+                        NAME_PARTS[uses[1] % NAME_PART_COUNT], uses[1], NAME_PARTS[uses[2] % NAME_PART_COUNT], uses[2]);
+    }
+    *tokens = malloc(sizeof(Token) * (used / 2));   // Lines hold at most one token (NEWLINE included) per two bytes
+    LexCursor cursor = { source, used, 0, 1, 0, 0, { 0 } };
+    int count = tokenize_range(&cursor, used, LANG_PYTHON, *tokens, used / 2);
+    free(source);
+    return count;
+}
+
+static void setup_inputs(void) {
+    for (int w = 0; w < WORD_COUNT; w++) {
+        int kind = rng_below(10);
+        if (kind < 3) {
+            snprintf(words[w], sizeof(words[w]), "%s", PYTHON_KEYWORDS[rng_below(PYTHON_KEYWORD_TOTAL)]);
+        } else if (kind < 8) {
+            snprintf(words[w], sizeof(words[w]), "%s_%s_%d", NAME_PARTS[rng_below(NAME_PART_COUNT)],
+                     NAME_PARTS[rng_below(NAME_PART_COUNT)], rng_below(100));
+        } else {
+            snprintf(words[w], sizeof(words[w]), "%c%c", 'a' + rng_below(26), rng_below(2) ? 'a' + rng_below(26) : '\0');
+        }
+    }
+    fill_text(code_text, code_line);
+    fill_text(identifier_text, identifier_line);
+    fill_text(python_comment_text, python_comment_line);
+    fill_text(typescript_comment_text, typescript_comment_line);
+    code_length = strlen(code_text);
+    identifier_length = strlen(identifier_text);
+    python_comment_length = strlen(python_comment_text);
+    typescript_comment_length = strlen(typescript_comment_text);
+    scan_tokens = malloc(sizeof(Token) * BUFFER_SIZE);
+    symbol_token_counts[0] = symbol_stream(64, &symbol_tokens[0]);
+    symbol_token_counts[1] = symbol_stream(5000, &symbol_tokens[1]);
+}
+
+/*===========================================================================
+ * SECTION 3: KERNELS
+ * One pass over a kernel's input; the result depends on every call.
+ *===========================================================================*/
+
+static long long run_levenshtein(void) {
+    long long sum = 0;
+    for (int w = 0; w < WORD_COUNT; w++) sum += levenshtein_distance(words[w], PYTHON_KEYWORDS[w % PYTHON_KEYWORD_TOTAL]);
+    return sum;
+}
+
+static long long run_python_keyword(void) {
+    long long sum = 0;
+    for (int w = 0; w < WORD_COUNT; w++) sum += is_python_keyword(words[w]);
+    return sum;
+}
+
+static long long run_typescript_keyword(void) {
+    long long sum = 0;
+    for (int w = 0; w < WORD_COUNT; w++) sum += is_typescript_keyword(words[w]);
+    return sum;
+}
+
+static long long run_char_class(void) {
+    long long sum = 0;
+    for (const char *c = code_text; *c; c++) sum += is_operator_char(*c) + 2 * is_delimiter_char(*c);
+    return sum;
+}
+
+static long long run_identifier_scan(void) {
+    LexCursor cursor = { identifier_text, (int)identifier_length, 0, 1, 0, 0, { 0 } };
+    int count = tokenize_range(&cursor, (int)identifier_length, LANG_PYTHON, scan_tokens, BUFFER_SIZE);
+    return count + scan_tokens[count - 1].line;
+}
+
+static long long run_comment_scan(const char *text, int length, Language lang) {
+    CommentScanner scanner = { 0, 0, 1, 0, 0, MAX_COMMENTS };
+    if (lang == LANG_PYTHON) scan_comments_python(&scanner, text, length, 1, comments, clean_code);
+    else scan_comments_typescript(&scanner, text, length, 1, comments, clean_code);
+    return scanner.clean_index + scanner.comment_count;
+}
+
+static long long run_python_comment_scan(void) {
+    return run_comment_scan(python_comment_text, (int)python_comment_length, LANG_PYTHON);
+}
+
+static long long run_typescript_comment_scan(void) {
+    return run_comment_scan(typescript_comment_text, (int)typescript_comment_length, LANG_TYPESCRIPT);
+}
+
+static long long run_symbols(int table) {
+    int err_count = 0;
+    check_undeclared_identifier_python(symbol_tokens[table], (int)symbol_token_counts[table], errors, &err_count);
+    return err_count + symbol_tokens[table][0].line;
+}
+
+static long long run_symbols_64(void) {
+    return run_symbols(0);
+}
+
+static long long run_symbols_5000(void) {
+    return run_symbols(1);
+}
+
+static long long run_parse(void) {
+    lexer_parse(LANG_PYTHON, symbol_tokens[0], (int)symbol_token_counts[0], &tree);
+    return tree.node_count;
+}
+
+/* Kernel: a pass function and how many units one pass covers */
+typedef struct {
+    const char *name;
+    const char *unit;
+    long long (*run)(void);
+    const long long *units;     // Known once setup_inputs has run
+} Kernel;
+
+static const Kernel KERNELS[] = {
+    { "levenshtein_distance", "call", run_levenshtein, &word_count },
+    { "is_python_keyword", "call", run_python_keyword, &word_count },
+    { "is_typescript_keyword", "call", run_typescript_keyword, &word_count },
+    { "is_operator/delimiter_char", "byte", run_char_class, &code_length },
+    { "identifier scan", "byte", run_identifier_scan, &identifier_length },
+    { "comment scan (py)", "byte", run_python_comment_scan, &python_comment_length },
+    { "comment scan (ts)", "byte", run_typescript_comment_scan, &typescript_comment_length },
+    { "symbol lookup (64 names)", "token", run_symbols_64, &symbol_token_counts[0] },
+    { "symbol lookup (5000 names)", "token", run_symbols_5000, &symbol_token_counts[1] },
+    { "lexer_parse", "token", run_parse, &symbol_token_counts[0] },
+};
+#define KERNEL_COUNT (int)(sizeof(KERNELS) / sizeof(KERNELS[0]))
+
+/*===========================================================================
+ * SECTION 4: MEASUREMENT
+ *===========================================================================*/
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Warm up, size the batches, then time batch_count batches; fills cost per unit */
+static void measure(const Kernel *kernel, int batch_count, double *median, double *minimum,
+                    double *nanoseconds) {
+    double started = now_seconds();
+    int passes = 0;
+    while (now_seconds() - started < WARMUP_SECONDS) {
+        sink += kernel->run();
+        passes++;
+    }
+    int batch_passes = (int)(passes * BATCH_SECONDS / WARMUP_SECONDS) + 1;
+
+    long long units = *kernel->units;
+    double *costs = malloc(sizeof(double) * batch_count);
+    double total_seconds = 0;
+    for (int b = 0; b < batch_count; b++) {
+        double start_seconds = now_seconds();
+        unsigned long long start = cycles_now();
+        for (int p = 0; p < batch_passes; p++) sink += kernel->run();
+        unsigned long long end = cycles_now();
+        total_seconds += now_seconds() - start_seconds;
+        costs[b] = (double)(end - start) / ((double)batch_passes * units);
+    }
+    qsort(costs, batch_count, sizeof(double), compare_doubles);
+    *median = costs[batch_count / 2];
+    *minimum = costs[0];
+    *nanoseconds = total_seconds * 1e9 / ((double)batch_count * batch_passes * units);
+    free(costs);
+}
+
+/*===========================================================================
+ * SECTION 5: MAIN
+ *===========================================================================*/
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL;
+    int batch_count = 31;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--batches") == 0 && i + 1 < argc) {
+            batch_count = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--filter text] [--batches 31]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (batch_count < 1) batch_count = 1;
+
+    setup_inputs();
+    printf("Kernels (%d batches after %.0f ms warm-up; cost per unit)\n", batch_count, WARMUP_SECONDS * 1000);
+    printf("  %-28s %-6s %12s %12s %10s\n", "Kernel", "Unit", "median " CYCLE_NAME, "min " CYCLE_NAME, "ns");
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        if (filter && !strstr(KERNELS[k].name, filter)) continue;
+        double median, minimum, nanoseconds;
+        measure(&KERNELS[k], batch_count, &median, &minimum, &nanoseconds);
+        printf("  %-28s %-6s %12.2f %12.2f %10.2f\n", KERNELS[k].name, KERNELS[k].unit, median, minimum, nanoseconds);
+    }
+    return 0;
+}
@@ -0,0 +1,333 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - THREAD SCALING BENCHMARK
+ *
+ * Runs the same work at 1, 2, 4 ... --max-threads threads and reports wall
+ * time, speedup over one thread, parallel efficiency (speedup / threads) and
+ * idle time per thread, for two cases:
+ *
+ *   many files  Workers take files from a shared counter, one LexerContext
+ *               each (as --report does). A worker's idle time is wall time
+ *               minus its own CPU time, so waiting on locks (the allocator,
+ *               the counters) and running out of work both show up.
+ *   one file    One context with lexer_set_threads: the tokenizer splits the
+ *               file into chunks and the checks run side by side. Those
+ *               threads are internal, so idle is the average per thread:
+ *               wall - process CPU time / threads.
+ *
+ * Inputs are read into memory first; output is not printed.
+ *
+ * Usage: scaling [--max-threads N] [--min-time 1.0] [--giant file] file...
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lexer.h"
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+#define MIN_RUNS 3
+
+/* SourceFile: an input held in memory */
+typedef struct {
+    char *text;
+    int length;
+    Language lang;
+    int token_estimate;
+} SourceFile;
+
+/* ScalingJobs: the files of one run, shared by its workers */
+typedef struct {
+    const SourceFile *files;
+    int file_count;
+    atomic_int next_file;
+} ScalingJobs;
+
+/* ScalingWorker: one thread of a many-files run */
+typedef struct {
+    ScalingJobs *jobs;
+    LexerContext *context;
+    LexerResult result;
+    double cpu_seconds;         // This thread's CPU time in the run
+    long long tokens;
+} ScalingWorker;
+
+/* ScalingRow: one thread count */
+typedef struct {
+    int threads;
+    int runs;
+    double median_seconds;
+    double mean_idle;           // Fraction of wall time, averaged over threads
+    double max_idle;            // Many files: the idlest thread
+} ScalingRow;
+
+/*===========================================================================
+ * SECTION 2: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+static double clock_seconds(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double process_cpu_seconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int load_file(const char *path, SourceFile *file) {
+    FILE *in = fopen(path, "rb");
+    if (!in) return 0;
+    fseek(in, 0, SEEK_END);
+    long length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    file->text = length >= 0 && length < 0x7fffffff ? malloc(length + 1) : NULL;
+    int ok = file->text && fread(file->text, 1, length, in) == (size_t)length;
+    fclose(in);
+    if (!ok) return 0;
+    file->text[length] = '\0';
+    file->length = (int)length;
+    const char *extension = strrchr(path, '.');
+    file->lang = extension && strcmp(extension, ".py") == 0 ? LANG_PYTHON : LANG_TYPESCRIPT;
+
+    // Token buffers are sized from a cheap first pass instead of MAX_TOKENS
+    LexerIterator iter;
+    TokenView token;
+    file->token_estimate = 1024;
+    lexer_iter_init(&iter, file->lang, file->text, file->length);
+    while (lexer_iter_next(&iter, &token)) file->token_estimate++;
+    file->token_estimate += file->token_estimate / 8;
+    return 1;
+}
+
+static int init_result(LexerResult *result, int token_capacity) {
+    *result = (LexerResult){ malloc(sizeof(Token) * token_capacity), token_capacity, 0,
+                             malloc(sizeof(Comment) * MAX_COMMENTS), MAX_COMMENTS, 0,
+                             malloc(sizeof(Error) * MAX_ERRORS), MAX_ERRORS, 0 };
+    return result->tokens && result->comments && result->errors;
+}
+
+static void free_result(LexerResult *result) {
+    free(result->tokens);
+    free(result->comments);
+    free(result->errors);
+}
+
+/*===========================================================================
+ * SECTION 3: MANY FILES
+ *===========================================================================*/
+
+static void *scaling_worker(void *arg) {
+    ScalingWorker *worker = arg;
+    ScalingJobs *jobs = worker->jobs;
+    double cpu_start = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+    for (int index = atomic_fetch_add(&jobs->next_file, 1); index < jobs->file_count;
+         index = atomic_fetch_add(&jobs->next_file, 1)) {
+        const SourceFile *file = &jobs->files[index];
+        lexer_analyze(worker->context, file->lang, file->text, file->length, &worker->result);
+        worker->tokens += worker->result.token_count;
+    }
+    worker->cpu_seconds = clock_seconds(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+    return NULL;
+}
+
+/* One run over all files with thread_count workers (worker 0 on this thread); returns wall seconds */
+static double run_files(ScalingWorker *workers, int thread_count, const SourceFile *files, int file_count) {
+    ScalingJobs jobs = { files, file_count, 0 };
+    pthread_t threads[MAX_THREADS];
+    atomic_init(&jobs.next_file, 0);
+    for (int i = 0; i < thread_count; i++) {
+        workers[i].jobs = &jobs;
+        workers[i].cpu_seconds = 0;
+        workers[i].tokens = 0;
+    }
+
+    double start = clock_seconds(CLOCK_MONOTONIC);
+    for (int i = 1; i < thread_count; i++) pthread_create(&threads[i], NULL, scaling_worker, &workers[i]);
+    scaling_worker(&workers[0]);
+    for (int i = 1; i < thread_count; i++) pthread_join(threads[i], NULL);
+    return clock_seconds(CLOCK_MONOTONIC) - start;
+}
+
+static int measure_files(ScalingRow *row, const SourceFile *files, int file_count, double min_time) {
+    static ScalingWorker workers[MAX_THREADS];
+    int token_capacity = 0;
+    for (int f = 0; f < file_count; f++) {
+        if (files[f].token_estimate > token_capacity) token_capacity = files[f].token_estimate;
+    }
+    for (int i = 0; i < row->threads; i++) {
+        workers[i].context = lexer_create();
+        if (!workers[i].context || !init_result(&workers[i].result, token_capacity)) return 0;
+    }
+
+    double *seconds = malloc(sizeof(double) * 100000);
+    double wall_total = 0, idle_total[MAX_THREADS] = { 0 };
+    run_files(workers, row->threads, files, file_count);   // Warm-up: contexts grow their buffers
+    double started = clock_seconds(CLOCK_MONOTONIC);
+    for (row->runs = 0; seconds && row->runs < 100000 &&
+                        (row->runs < MIN_RUNS || clock_seconds(CLOCK_MONOTONIC) - started < min_time); row->runs++) {
+        double wall = run_files(workers, row->threads, files, file_count);
+        seconds[row->runs] = wall;
+        wall_total += wall;
+        for (int i = 0; i < row->threads; i++) idle_total[i] += wall - workers[i].cpu_seconds;
+    }
+
+    row->mean_idle = row->max_idle = 0;
+    for (int i = 0; i < row->threads; i++) {
+        double idle = idle_total[i] > 0 ? idle_total[i] / wall_total : 0;
+        row->mean_idle += idle / row->threads;
+        if (idle > row->max_idle) row->max_idle = idle;
+    }
+    if (seconds) {
+        qsort(seconds, row->runs, sizeof(double), compare_doubles);
+        row->median_seconds = seconds[row->runs / 2];
+    }
+    free(seconds);
+    for (int i = 0; i < row->threads; i++) {
+        lexer_destroy(workers[i].context);
+        free_result(&workers[i].result);
+    }
+    return row->runs > 0;
+}
+
+/*===========================================================================
+ * SECTION 4: ONE FILE
+ *===========================================================================*/
+
+static int measure_giant(ScalingRow *row, const SourceFile *file, double min_time) {
+    LexerContext *context = lexer_create();
+    LexerResult result;
+    if (!context || !init_result(&result, file->token_estimate)) return 0;
+    lexer_set_threads(context, row->threads);
+    lexer_analyze(context, file->lang, file->text, file->length, &result);   // Warm-up
+
+    double seconds[1000], wall_total = 0, cpu_total = 0;
+    double started = clock_seconds(CLOCK_MONOTONIC);
+    for (row->runs = 0; row->runs < 1000 && (row->runs < MIN_RUNS || clock_seconds(CLOCK_MONOTONIC) - started < min_time);
+         row->runs++) {
+        double cpu_start = process_cpu_seconds(), start = clock_seconds(CLOCK_MONOTONIC);
+        lexer_analyze(context, file->lang, file->text, file->length, &result);
+        seconds[row->runs] = clock_seconds(CLOCK_MONOTONIC) - start;
+        cpu_total += process_cpu_seconds() - cpu_start;
+        wall_total += seconds[row->runs];
+    }
+    qsort(seconds, row->runs, sizeof(double), compare_doubles);
+    row->median_seconds = seconds[row->runs / 2];
+    row->mean_idle = 1 - cpu_total / row->threads / wall_total;
+    if (row->mean_idle < 0) row->mean_idle = 0;
+    row->max_idle = -1;     // Not known per thread
+    lexer_destroy(context);
+    free_result(&result);
+    return 1;
+}
+
+/*===========================================================================
+ * SECTION 5: OUTPUT AND MAIN
+ *===========================================================================*/
+
+static void print_rows(const char *title, const ScalingRow *rows, int row_count) {
+    printf("%s\n", title);
+    printf("  %7s %5s %12s %8s %10s %10s %10s\n", "Threads", "Runs", "Median ms", "Speedup", "Efficiency", "Idle avg",
+           "Idle max");
+    for (int r = 0; r < row_count; r++) {
+        double speedup = rows[0].median_seconds / rows[r].median_seconds;
+        printf("  %7d %5d %12.2f %7.2fx %9.0f%% %9.0f%%", rows[r].threads, rows[r].runs, rows[r].median_seconds * 1000,
+               speedup, speedup / rows[r].threads * 100, rows[r].mean_idle * 100);
+        if (rows[r].max_idle >= 0) printf(" %9.0f%%\n", rows[r].max_idle * 100);
+        else printf(" %10s\n", "-");
+    }
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--max-threads N] [--min-time 1.0] [--giant file] file...\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = cpus < 1 ? 1 : cpus > MAX_THREADS ? MAX_THREADS : (int)cpus;
+    double min_time = 1.0;
+    const char *giant_path = NULL;
+    SourceFile *files = calloc(argc, sizeof(SourceFile));
+    SourceFile giant = { 0 };
+    int file_count = 0;
+    if (!files) return 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            if (!load_file(argv[i], &files[file_count++])) {
+                fprintf(stderr, "Error: Cannot read '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "--max-threads") == 0) {
+            max_threads = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--min-time") == 0) {
+            min_time = strtod(argv[++i], NULL);
+        } else if (i + 1 < argc && strcmp(argv[i], "--giant") == 0) {
+            giant_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((file_count == 0 && !giant_path) || max_threads < 1 || max_threads > MAX_THREADS) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (giant_path && !load_file(giant_path, &giant)) {
+        fprintf(stderr, "Error: Cannot read '%s'\n", giant_path);
+        return 1;
+    }
+
+    // 1, 2, 4 ... and max_threads itself
+    int counts[MAX_THREADS], count_total = 0;
+    for (int threads = 1; threads < max_threads; threads *= 2) counts[count_total++] = threads;
+    counts[count_total++] = max_threads;
+
+    ScalingRow rows[MAX_THREADS];
+    char title[256];
+    if (file_count > 0) {
+        long long bytes = 0;
+        for (int f = 0; f < file_count; f++) bytes += files[f].length;
+        for (int c = 0; c < count_total; c++) {
+            rows[c] = (ScalingRow){ .threads = counts[c] };
+            if (!measure_files(&rows[c], files, file_count, min_time)) {
+                fprintf(stderr, "Error: Out of memory\n");
+                return 1;
+            }
+        }
+        snprintf(title, sizeof(title), "Many files: %d files, %lld bytes (%ld CPUs online)", file_count, bytes, cpus);
+        print_rows(title, rows, count_total);
+    }
+    if (giant_path) {
+        for (int c = 0; c < count_total; c++) {
+            rows[c] = (ScalingRow){ .threads = counts[c] };
+            if (!measure_giant(&rows[c], &giant, min_time)) {
+                fprintf(stderr, "Error: Out of memory\n");
+                return 1;
+            }
+        }
+        snprintf(title, sizeof(title), "%sOne file: %s, %d bytes (idle is the average of the library's threads)",
+                 file_count > 0 ? "\n" : "", giant_path, giant.length);
+        print_rows(title, rows, count_total);
+    }
+
+    for (int f = 0; f < file_count; f++) free(files[f].text);
+    free(files);
+    free(giant.text);
+    return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - DAEMON CLIENT
+ *
+ * Sends one file (or stdin) to a running ./lexer --daemon and prints the report.
+ * Kept deliberately tiny: it does not link liblexer, so starting it costs
+ * next to nothing. The protocol is described in daemon.h.
+ *
+ * Usage: ./lexer-client <socket> [--binary] <source_file>
+ *        ./lexer-client <socket> [--binary] --lang py|ts -     (source on stdin)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CLIENT_BLOCK 65536
+
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return 0;
+        data += written;
+        length -= written;
+    }
+    return 1;
+}
+
+/* Read all of stdin into new memory */
+static char *read_stdin(size_t *length) {
+    size_t capacity = CLIENT_BLOCK;
+    char *content = malloc(capacity);
+    *length = 0;
+    while (content) {
+        ssize_t bytes = read(STDIN_FILENO, content + *length, capacity - *length);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        *length += bytes;
+        if (*length == capacity) {
+            char *grown = realloc(content, capacity *= 2);
+            if (!grown) free(content);
+            content = grown;
+        }
+    }
+    return content;
+}
+
+static int usage(const char *program) {
+    printf("Usage: %s <socket> [--binary] <source_file>\n", program);
+    printf("       %s <socket> [--binary] --lang py|ts -\n", program);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) return usage(argv[0]);
+    const char *socket_path = argv[1];
+    const char *format = "text", *lang = "-";
+    int arg_index = 2;
+    while (arg_index < argc - 1) {
+        if (strcmp(argv[arg_index], "--binary") == 0) {
+            format = "binary";
+            arg_index++;
+        } else if (strcmp(argv[arg_index], "--lang") == 0 && arg_index + 2 < argc) {
+            lang = argv[arg_index + 1];
+            arg_index += 2;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (arg_index != argc - 1) return usage(argv[0]);
+    const char *source = argv[arg_index];
+
+    // Request payload: the source itself for stdin, otherwise a path the daemon can open
+    char path[PATH_MAX];
+    const char *payload = path;
+    size_t payload_length;
+    char *buffer = NULL;
+    int from_stdin = strcmp(source, "-") == 0;
+    if (from_stdin) {
+        if (strcmp(lang, "py") != 0 && strcmp(lang, "ts") != 0) return usage(argv[0]);
+        buffer = read_stdin(&payload_length);
+        if (!buffer) {
+            printf("Error: Out of memory\n");
+            return 1;
+        }
+        payload = buffer;
+    } else if (source[0] == '/') {
+        snprintf(path, sizeof(path), "%s", source);
+        payload_length = strlen(path);
+    } else {
+        if (!getcwd(path, sizeof(path))) {
+            printf("Error: Cannot resolve '%s'\n", source);
+            return 1;
+        }
+        size_t cwd_length = strlen(path);
+        snprintf(path + cwd_length, sizeof(path) - cwd_length, "/%s", source);
+        payload_length = strlen(path);
+    }
+
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        printf("Error: No daemon listening on '%s' (start one with ./lexer --daemon %s)\n", socket_path, socket_path);
+        return 1;
+    }
+
+    char header[64];
+    int header_length = snprintf(header, sizeof(header), "%s %s %s %zu\n",
+                                 from_stdin ? "BUFFER" : "PATH", format, lang, payload_length);
+    if (!write_all(fd, header, header_length) || !write_all(fd, payload, payload_length)) {
+        printf("Error: Lost connection to the daemon\n");
+        return 1;
+    }
+    free(buffer);
+
+    // Response: "<status> <length>\n" then the report, copied straight to stdout
+    char block[CLIENT_BLOCK];
+    size_t filled = 0;
+    char *newline = NULL;
+    while (!newline && filled < sizeof(block)) {
+        ssize_t bytes = read(fd, block + filled, sizeof(block) - filled);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        filled += bytes;
+        newline = memchr(block, '\n', filled);
+    }
+    int status;
+    if (!newline || sscanf(block, "%d", &status) != 1) {
+        printf("Error: Lost connection to the daemon\n");
+        return 1;
+    }
+
+    write_all(STDOUT_FILENO, newline + 1, filled - (newline + 1 - block));
+    for (;;) {
+        ssize_t bytes = read(fd, block, sizeof(block));
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        write_all(STDOUT_FILENO, block, bytes);
+    }
+    close(fd);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,444 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - ANALYSIS DAEMON
+ *
+ * Workers share the listening socket and each keeps a warm LexerContext and
+ * result buffers for its whole life. Reports for files are cached by path,
+ * modification time and size, so an unchanged file is answered without being
+ * read again. See daemon.h for the protocol.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "lexer.h"
+#include "daemon.h"
+#include "probes.h"
+
+/*===========================================================================
+ * CONSTANTS
+ *===========================================================================*/
+#define DAEMON_CACHE_SLOTS    256             // Cached reports (by path hash)
+#define DAEMON_MAX_REQUEST    (64 << 20)      // Largest accepted request payload
+#define DAEMON_BACKLOG        64
+#define DAEMON_HEADER_MAX     128
+#define DAEMON_IO_TIMEOUT_S   10              // A client stalling a read or write longer is dropped
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+/* CacheEntry: the response payload for one file as it was when analyzed */
+typedef struct {
+    char *path;
+    struct timespec mtime;
+    off_t size;
+    char lang;              // Language requested: 'p', 't' or '-'
+    int binary;
+    char *report;
+    size_t length;
+} CacheEntry;
+
+typedef struct {
+    int listen_fd;
+    ReportPrinter print_report;
+    CacheEntry cache[DAEMON_CACHE_SLOTS];
+    pthread_mutex_t cache_lock;
+} Daemon;
+
+/* DaemonWorker: per-thread analysis state, reused across requests */
+typedef struct {
+    Daemon *daemon;
+    LexerContext *context;
+    Token *tokens;          // Grown to the largest source so far by lexer_analyze_all
+    int token_capacity;
+    Comment *comments;
+    Error *errors;
+} DaemonWorker;
+
+/* Socket path, for removal when the daemon is stopped */
+static const char *daemon_socket_path;
+
+/*===========================================================================
+ * SECTION 2: I/O HELPERS
+ *===========================================================================*/
+
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return 0;
+        data += written;
+        length -= written;
+    }
+    return 1;
+}
+
+static int read_all(int fd, char *data, size_t length) {
+    while (length > 0) {
+        ssize_t bytes = read(fd, data, length);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) return 0;
+        data += bytes;
+        length -= bytes;
+    }
+    return 1;
+}
+
+static void send_response(int fd, int status, const char *payload, size_t length) {
+    char header[32];
+    int header_length = snprintf(header, sizeof(header), "%d %zu\n", status, length);
+    if (write_all(fd, header, header_length)) write_all(fd, payload, length);
+}
+
+static void send_failure(int fd, const char *message) {
+    send_response(fd, 1, message, strlen(message));
+}
+
+static void stop_daemon(int signal_number) {
+    (void)signal_number;
+    unlink(daemon_socket_path);
+    _exit(0);
+}
+
+/*===========================================================================
+ * SECTION 3: RESULT CACHE
+ *===========================================================================*/
+
+static unsigned int hash_path(const char *path) {
+    unsigned int hash = 2166136261u;    // FNV-1a
+    for (; *path; path++) hash = (hash ^ (unsigned char)*path) * 16777619u;
+    return hash;
+}
+
+/* Copy of the cached report for this file version, or NULL */
+static char *cache_lookup(Daemon *daemon, const char *path, const struct stat *info, char lang, int binary,
+                          size_t *length) {
+    char *report = NULL;
+    CacheEntry *entry = &daemon->cache[hash_path(path) % DAEMON_CACHE_SLOTS];
+    pthread_mutex_lock(&daemon->cache_lock);
+    if (entry->path && strcmp(entry->path, path) == 0 && entry->lang == lang && entry->binary == binary &&
+        entry->size == info->st_size && entry->mtime.tv_sec == info->st_mtim.tv_sec &&
+        entry->mtime.tv_nsec == info->st_mtim.tv_nsec) {
+        report = lexer_malloc(entry->length);
+        if (report) {
+            memcpy(report, entry->report, entry->length);
+            *length = entry->length;
+        }
+    }
+    pthread_mutex_unlock(&daemon->cache_lock);
+    return report;
+}
+
+static void cache_store(Daemon *daemon, const char *path, const struct stat *info, char lang, int binary,
+                        const char *report, size_t length) {
+    char *path_copy = strdup(path);
+    char *report_copy = lexer_malloc(length);
+    if (!path_copy || !report_copy) {
+        free(path_copy);
+        lexer_free(report_copy);
+        return;
+    }
+    memcpy(report_copy, report, length);
+
+    CacheEntry *entry = &daemon->cache[hash_path(path) % DAEMON_CACHE_SLOTS];
+    pthread_mutex_lock(&daemon->cache_lock);
+    free(entry->path);
+    lexer_free(entry->report);
+    *entry = (CacheEntry){ path_copy, info->st_mtim, info->st_size, lang, binary, report_copy, length };
+    pthread_mutex_unlock(&daemon->cache_lock);
+}
+
+/*===========================================================================
+ * SECTION 4: REQUEST HANDLING
+ *===========================================================================*/
+
+/* Write the binary report for one analysis (format in daemon.h) */
+static void write_binary_report(FILE *out, const LexerResult *result) {
+    int32_t header[5] = { 0, DAEMON_BINARY_VERSION, result->token_count, result->comment_count, result->error_count };
+    memcpy(header, "LEXB", 4);
+    fwrite(header, sizeof(header), 1, out);
+
+    for (int i = 0; i < result->token_count; i++) {
+        const Token *token = &result->tokens[i];
+        int32_t line = token->line;
+        uint16_t lengths[2] = { (uint16_t)strlen(token->type), (uint16_t)strlen(token->value) };
+        fwrite(&line, sizeof(line), 1, out);
+        fwrite(lengths, sizeof(lengths), 1, out);
+        fwrite(token->type, 1, lengths[0], out);
+        fwrite(token->value, 1, lengths[1], out);
+    }
+    for (int i = 0; i < result->comment_count; i++) {
+        const Comment *comment = &result->comments[i];
+        int32_t fields[3] = { comment->start_line, comment->end_line, comment->is_multiline };
+        uint16_t length = (uint16_t)strlen(comment->content);
+        fwrite(fields, sizeof(fields), 1, out);
+        fwrite(&length, sizeof(length), 1, out);
+        fwrite(comment->content, 1, length, out);
+    }
+    for (int i = 0; i < result->error_count; i++) {
+        const Error *error = &result->errors[i];
+        int32_t fields[2] = { error->line_number, (int32_t)error->type };
+        uint16_t length = (uint16_t)strlen(error->message);
+        fwrite(fields, sizeof(fields), 1, out);
+        fwrite(&length, sizeof(length), 1, out);
+        fwrite(error->message, 1, length, out);
+    }
+}
+
+/* Analyze source_code and render the report into memory from lexer_malloc; NULL if out of memory */
+static char *analyze_to_report(DaemonWorker *worker, const char *filename, Language lang, const char *source_code,
+                               int binary, size_t *length) {
+    LexerResult result = { worker->tokens, worker->token_capacity, 0, worker->comments, MAX_COMMENTS, 0,
+                           worker->errors, MAX_ERRORS, 0 };
+    lexer_set_source_name(worker->context, filename);
+    int analyzed = lexer_analyze_all(worker->context, lang, source_code, strlen(source_code), &result);
+    worker->tokens = result.tokens;
+    worker->token_capacity = result.token_capacity;
+    if (!analyzed) return NULL;
+
+    char *rendered = NULL;
+    FILE *out = open_memstream(&rendered, length);
+    if (!out) return NULL;
+    if (binary) {
+        write_binary_report(out, &result);
+    } else {
+        worker->daemon->print_report(out, filename, lang, &result);
+    }
+    fclose(out);
+
+    // Moved out of the stream's buffer so that the allocator counts it, like the rest of a request
+    char *report = lexer_malloc(*length + 1);
+    if (report) memcpy(report, rendered, *length + 1);
+    free(rendered);
+    return report;
+}
+
+/* Read a whole file opened as fd (size from fstat, but tolerate it changing) */
+static char *read_source(int fd, off_t size) {
+    size_t capacity = (size_t)size + 1, length = 0;
+    char *content = lexer_malloc(capacity + 1);
+    if (!content) return NULL;
+    for (;;) {
+        if (length == capacity) {
+            char *grown = lexer_realloc(content, capacity * 2 + 1);
+            if (!grown) {
+                lexer_free(content);
+                return NULL;
+            }
+            content = grown;
+            capacity *= 2;
+        }
+        ssize_t bytes = read(fd, content + length, capacity - length);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0) {
+            lexer_free(content);
+            return NULL;
+        }
+        if (bytes == 0) break;
+        length += bytes;
+    }
+    content[length] = '\0';
+    return content;
+}
+
+static void serve_path(DaemonWorker *worker, int client, const char *path, char lang_code, int binary) {
+    Language lang;
+    if (lang_code == '-') {
+        const char *ext = strrchr(path, '.');
+        if (ext && strcmp(ext, ".py") == 0) {
+            lang = LANG_PYTHON;
+        } else if (ext && (strcmp(ext, ".ts") == 0 || strcmp(ext, ".js") == 0)) {
+            lang = LANG_TYPESCRIPT;
+        } else {
+            send_failure(client, "Error: Unsupported file extension. Please provide a Python (.py) or TypeScript (.ts, .js) file.\n");
+            return;
+        }
+    } else {
+        lang = lang_code == 'p' ? LANG_PYTHON : LANG_TYPESCRIPT;
+    }
+
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        char message[MAX_LENGTH];
+        snprintf(message, sizeof(message), "Error: Cannot open file '%s'\n", path);
+        send_failure(client, message);
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    size_t length;
+    char *report = cache_lookup(worker->daemon, path, &info, lang_code, binary, &length);
+    if (report) {
+        LEXER_PROBE(cache_hit, path, (long long)info.st_size);
+    } else {
+        LEXER_PROBE(cache_miss, path, (long long)info.st_size);
+        char *source_code = read_source(fd, info.st_size);
+        report = source_code ? analyze_to_report(worker, path, lang, source_code, binary, &length) : NULL;
+        lexer_free(source_code);
+        if (report) cache_store(worker->daemon, path, &info, lang_code, binary, report, length);
+    }
+    close(fd);
+
+    if (report) send_response(client, 0, report, length);
+    else send_failure(client, "Error: Out of memory\n");
+    lexer_free(report);
+}
+
+static void serve_request(DaemonWorker *worker, int client) {
+    // Header line; bytes read past it are the start of the payload
+    char header[DAEMON_HEADER_MAX + 1];
+    size_t header_length = 0;
+    char *newline = NULL;
+    while (!newline && header_length < DAEMON_HEADER_MAX) {
+        ssize_t bytes = read(client, header + header_length, DAEMON_HEADER_MAX - header_length);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) return;
+        header_length += bytes;
+        header[header_length] = '\0';
+        newline = memchr(header, '\n', header_length);
+    }
+
+    char kind[8], format[8], lang_code[4];
+    size_t payload_length;
+    if (!newline || sscanf(header, "%7s %7s %3s %zu", kind, format, lang_code, &payload_length) != 4 ||
+        (strcmp(kind, "PATH") != 0 && strcmp(kind, "BUFFER") != 0) ||
+        (strcmp(format, "text") != 0 && strcmp(format, "binary") != 0) ||
+        (strcmp(lang_code, "py") != 0 && strcmp(lang_code, "ts") != 0 && strcmp(lang_code, "-") != 0) ||
+        (kind[0] == 'B' && lang_code[0] == '-')) {
+        send_failure(client, "Error: Malformed request\n");
+        return;
+    }
+    if (payload_length > DAEMON_MAX_REQUEST) {
+        send_failure(client, "Error: Request too large\n");
+        return;
+    }
+
+    char *payload = lexer_malloc(payload_length + 1);
+    if (!payload) {
+        send_failure(client, "Error: Out of memory\n");
+        return;
+    }
+    size_t buffered = header_length - (newline + 1 - header);
+    if (buffered > payload_length) buffered = payload_length;
+    memcpy(payload, newline + 1, buffered);
+    if (!read_all(client, payload + buffered, payload_length - buffered)) {
+        lexer_free(payload);
+        return;
+    }
+    payload[payload_length] = '\0';
+
+    int binary = format[0] == 'b';
+    if (kind[0] == 'P') {
+        serve_path(worker, client, payload, lang_code[0], binary);
+    } else {
+        Language lang = lang_code[0] == 'p' ? LANG_PYTHON : LANG_TYPESCRIPT;
+        size_t length;
+        char *report = analyze_to_report(worker, "<stdin>", lang, payload, binary, &length);
+        if (report) send_response(client, 0, report, length);
+        else send_failure(client, "Error: Out of memory\n");
+        lexer_free(report);
+    }
+    lexer_free(payload);
+}
+
+static void *daemon_worker(void *arg) {
+    DaemonWorker *worker = arg;
+    struct timeval timeout = { DAEMON_IO_TIMEOUT_S, 0 };
+    for (;;) {
+        int client = accept(worker->daemon->listen_fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            return NULL;
+        }
+        // A client that stops sending (or reading) must not hold the worker forever
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve_request(worker, client);
+        close(client);
+    }
+}
+
+/*===========================================================================
+ * SECTION 5: STARTUP
+ *===========================================================================*/
+
+int run_daemon(const char *socket_path, int worker_count, ReportPrinter print_report) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        printf("Error: Socket path '%s' is too long\n", socket_path);
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    // Refuse to take over the socket of a running daemon; replace a stale one
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        printf("Error: A daemon is already listening on '%s'\n", socket_path);
+        close(probe);
+        return 1;
+    }
+    if (probe >= 0) close(probe);
+    unlink(socket_path);
+
+    static Daemon daemon;
+    daemon.print_report = print_report;
+    pthread_mutex_init(&daemon.cache_lock, NULL);
+    daemon.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (daemon.listen_fd < 0 || bind(daemon.listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(daemon.listen_fd, DAEMON_BACKLOG) != 0) {
+        printf("Error: Cannot listen on '%s': %s\n", socket_path, strerror(errno));
+        return 1;
+    }
+
+    daemon_socket_path = socket_path;
+    signal(SIGPIPE, SIG_IGN);   // Clients may hang up before reading the response
+    signal(SIGINT, stop_daemon);
+    signal(SIGTERM, stop_daemon);
+
+    // Workers are set up once; each request then only lexes
+    DaemonWorker *workers = calloc(worker_count, sizeof(DaemonWorker));
+    if (!workers) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < worker_count; i++) {
+        workers[i].daemon = &daemon;
+        workers[i].context = lexer_create();
+        workers[i].comments = lexer_malloc(sizeof(Comment) * MAX_COMMENTS);
+        workers[i].errors = lexer_malloc(sizeof(Error) * MAX_ERRORS);
+        if (!workers[i].context || !workers[i].comments || !workers[i].errors) {
+            printf("Error: Out of memory\n");
+            return 1;
+        }
+    }
+
+    // The calling thread is worker 0; serve with fewer workers if threads cannot be started
+    pthread_t threads[MAX_THREADS];
+    int started = 1;
+    for (; started < worker_count; started++) {
+        if (pthread_create(&threads[started], NULL, daemon_worker, &workers[started]) != 0) {
+            fprintf(stderr, "Warning: Could only start %d of %d workers\n", started, worker_count);
+            break;
+        }
+    }
+
+    printf("Listening on %s with %d worker%s\n", socket_path, started, started == 1 ? "" : "s");
+    fflush(stdout);
+    daemon_worker(&workers[0]);
+
+    unlink(socket_path);
+    return 1;
+}
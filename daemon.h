@@ -0,0 +1,38 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - ANALYSIS DAEMON
+ *
+ * ./lexer --daemon <socket> serves analyses over a Unix domain socket, so a
+ * request costs the lexing only, not exec, dynamic loading and allocator
+ * warm-up. lexer-client is the matching command line client.
+ *
+ * Protocol (one request per connection):
+ *   request:  "<PATH|BUFFER> <text|binary> <py|ts|-> <length>\n" + length bytes
+ *             PATH: the bytes are a file path (language "-": from the extension)
+ *             BUFFER: the bytes are source code
+ *   response: "<status> <length>\n" + length bytes
+ *             status 0: the report; status 1: an error message
+ *   A client that stalls for 10 seconds while sending or reading is disconnected.
+ *
+ * Binary report (native byte order):
+ *   char magic[4] = "LEXB"; int32 version; int32 token_count, comment_count, error_count;
+ *   token_count times   { int32 line; uint16 type_length, value_length; type; value }
+ *   comment_count times { int32 start_line, end_line, is_multiline; uint16 length; content }
+ *   error_count times   { int32 line, type; uint16 length; message }
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdio.h>
+
+#include "lexer.h"
+
+#define DAEMON_BINARY_VERSION 1
+
+/* Prints the human-readable report for one input (the CLI's output format) */
+typedef void (*ReportPrinter)(FILE *out, const char *filename, Language lang, const LexerResult *result);
+
+/* Serve requests on socket_path with worker_count workers until killed; returns the exit code */
+int run_daemon(const char *socket_path, int worker_count, ReportPrinter print_report);
+
+#endif
@@ -1,5 +1,5 @@
 /**
- * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - LIBRARY (liblexer)
  * 
  * Features:
  * 1. Comment Detection - Extracts single-line and multi-line comments
@@ -10,54 +10,40 @@
  *    - Undeclared identifiers
  *    - Invalid operators (=< instead of <=)
  * 
- * Output: Displays results in terminal
- * Usage: ./lexer <source_file.py|source_file.ts>
+ * Public interface: lexer.h. No global mutable state apart from the allocation
+ * counters; see LexerContext.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
 
-/*===========================================================================
- * ANSI COLOR CODES FOR TERMINAL OUTPUT
- *===========================================================================*/
-#define COLOR_RESET       "\033[0m"
-#define COLOR_BOLD        "\033[1m"
-
-// Comment colors
-#define COLOR_SINGLE_LINE_COMMENT   "\033[32m"  // Green
-#define COLOR_MULTI_LINE_COMMENT    "\033[36m"  // Cyan
-
-// Token attribute colors
-#define COLOR_KEYWORD         "\033[35m"  // Magenta
-#define COLOR_IDENTIFIER      "\033[33m"  // Yellow
-#define COLOR_LITERAL         "\033[34m"  // Blue
-#define COLOR_OPERATOR        "\033[31m"  // Red
-#define COLOR_DELIMITER       "\033[37m"  // White
-
-// Error type colors
-#define COLOR_ERROR_MISSPELL  "\033[93m"  // Bright Yellow
-#define COLOR_ERROR_TYPE      "\033[91m"  // Bright Red
-#define COLOR_ERROR_UNDECL    "\033[95m"  // Bright Magenta
-#define COLOR_ERROR_OPERATOR  "\033[96m"  // Bright Cyan
-
-// UI elements
-#define COLOR_HEADER          "\033[1;36m" // Bold Cyan
-#define COLOR_LINE_NUMBER     "\033[90m"   // Gray
+#include "lexer.h"
+#include "probes.h"
 
 /*===========================================================================
  * SECTION 1: CONSTANTS
  *===========================================================================*/
 
-#define MAX_TOKENS   1000
-#define MAX_COMMENTS 100
-#define MAX_ERRORS   100
-#define MAX_SYMBOLS  500
-#define MAX_LENGTH   1024
+#define LEVENSHTEIN_STACK_LENGTH 64     // Longer strings get their matrix rows from the heap
+
+/* Parallel tokenizer (inputs smaller than this are lexed on one thread) */
+#ifndef PARALLEL_LEX_MIN_BYTES
+#define PARALLEL_LEX_MIN_BYTES (1 << 20)
+#endif
+#ifndef PARALLEL_LEX_MIN_CHUNK
+#define PARALLEL_LEX_MIN_CHUNK (256 * 1024)
+#endif
+#define PARALLEL_CHECK_MIN_TOKENS 256
 
 /* Python Keywords */
-const char *PYTHON_KEYWORDS[] = {
+static const char *const PYTHON_KEYWORDS[] = {
     "False", "None", "True", "and", "as", "assert", "async", "await",
     "break", "class", "continue", "def", "del", "elif", "else", "except",
     "finally", "for", "from", "global", "if", "import", "in", "is",
@@ -67,7 +53,7 @@ const char *PYTHON_KEYWORDS[] = {
 #define PYTHON_KEYWORD_COUNT 41
 
 /* TypeScript Keywords */
-const char *TYPESCRIPT_KEYWORDS[] = {
+static const char *const TYPESCRIPT_KEYWORDS[] = {
     "break", "case", "catch", "class", "const", "continue", "debugger",
     "default", "delete", "do", "else", "enum", "export", "extends", "false",
     "finally", "for", "function", "if", "import", "in", "instanceof",
@@ -77,53 +63,205 @@ const char *TYPESCRIPT_KEYWORDS[] = {
 };
 #define TYPESCRIPT_KEYWORD_COUNT 46
 
-typedef enum { LANG_PYTHON, LANG_TYPESCRIPT } Language;
-
 /*===========================================================================
  * SECTION 2: DATA STRUCTURES
+ * (public types are in lexer.h)
  *===========================================================================*/
 
-/* Token: smallest meaningful unit (e.g., "print", "123", "+") */
+/* Scope: the module, a function or class body, or a block (see the undeclared-identifier check) */
 typedef struct {
-    char value[256];    // The text of the token
-    char type[32];      // KEYWORD, IDENTIFIER, OPERATOR, etc.
-    int line;           // Line number
-} Token;
+    int parent;             // Enclosing scope, -1 for the module
+    int depth;              // 0 for the module
+    int function_depth;     // Depth of the innermost function body at or around it, 0 if none
+    int indent;             // Python: block level of the line that opened it; its body is one level in
+    int end_depth;          // TypeScript: bracket depth that ends an arrow body without braces, else -1
+    int first_declaration;  // Its declarations are by_scope[first_declaration ..
+    int declaration_count;  //   .. first_declaration + declaration_count)
+} Scope;
+
+/* Declaration: a name declared in a scope */
+typedef struct {
+    int scope;
+    int name;               // Interned name
+    int hoisted;            // Visible from the start of its scope (parameters, TypeScript functions)
+    int token;              // The declaring token
+} Declaration;
+
+/* NameRole: what an identifier token does */
+typedef enum {
+    NAME_NONE,              // Not an identifier
+    NAME_USE,               // Must refer to a visible declaration
+    NAME_DECLARE,           // Declares the name from here to the end of its scope
+    NAME_SKIP               // Attribute, keyword argument, or declared at the start of its scope
+} NameRole;
 
-/* Comment: stores extracted comment information */
+/* NameTable: identifier spellings interned to dense numbers */
 typedef struct {
-    char content[MAX_LENGTH];
-    int start_line;
-    int end_line;
-    int is_multiline;
-} Comment;
+    int *name_slots;        // Hash table of interned names, -1 if empty
+    int slot_mask;
+    int *name_tokens;       // Interned name -> a token spelling it
+    int name_count;
+} NameTable;
 
-/* Error: stores detected error information */
+/* ValueType: type of a literal, or of a variable whose last assignment was one */
 typedef enum {
-    ERROR_TYPE_MISSPELLED_KEYWORD,
-    ERROR_TYPE_TYPE_MISMATCH,
-    ERROR_TYPE_UNDECLARED_IDENTIFIER,
-    ERROR_TYPE_INVALID_OPERATOR
-} ErrorType;
+    VALUE_UNKNOWN,
+    VALUE_INT,
+    VALUE_FLOAT,            // Also a TypeScript number annotation
+    VALUE_STRING,
+    VALUE_BOOL
+} ValueType;
+
+/* ValueTypes: per interned name, the types the type-mismatch check has recorded */
+typedef struct {
+    NameTable names;
+    unsigned char *held;    // ValueType of the last simple assignment
+    unsigned char *declared;    // ValueType of the annotation
+    int *region;            // Region each name was recorded in; entries from older regions are stale
+    int current_region;
+} ValueTypes;
+
+/* ScopeOutline: scopes and declarations of a token array, with its names interned */
+typedef struct {
+    int *name_of;           // Interned name of each token, -1 if not an identifier
+    int *scope_of;          // Innermost scope around each token
+    unsigned char *role;    // NameRole of each token
+    Scope *scopes;
+    int scope_count;
+    Declaration *declarations;  // In token order
+    Declaration *by_scope;      // The same, grouped by scope
+    int declaration_count;
+    NameTable names;
+    int *stack;             // Scopes open while outlining, innermost last
+    int *group_open;        // TypeScript: token opening each bracket still open
+} ScopeOutline;
+
+/* Binding: a visible declaration; the bindings of a ScopedNames are also its undo log */
+typedef struct {
+    int name;
+    int depth;              // Depth of the declaring scope
+    int shadowed;           // Binding of the same name that this one hides, or -1
+} Binding;
 
+/* ScopedNames: name -> innermost binding; leaving a scope pops the bindings made since entering it */
 typedef struct {
-    char message[MAX_LENGTH];
-    int line_number;
-    ErrorType type;
-} Error;
+    int *innermost;         // Interned name -> binding, or -1
+    Binding *bindings;
+    int binding_count;
+} ScopedNames;
 
-/* Symbol: for tracking declared variables */
+/* MemoryAccount: allocation counters, updated from several threads */
 typedef struct {
-    char name[256];
-    int line;
-} Symbol;
+    long long id;                       // Stored in each allocation it is charged for
+    atomic_llong allocated_bytes;
+    atomic_llong allocation_count;
+    atomic_llong current_bytes;
+    atomic_llong peak_bytes;
+} MemoryAccount;
+
+/* AllocationHeader: placed before every block from lexer_malloc */
+typedef union {
+    struct {
+        size_t size;
+        long long account_id;           // File account charged, or 0
+    } info;
+    max_align_t align;
+} AllocationHeader;
 
 /*===========================================================================
  * SECTION 3: UTILITY FUNCTIONS
  *===========================================================================*/
 
+/* Monotonic clock in seconds, for phase timings */
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*---------------------------------------------------------------------------
+ * Counting allocator
+ *---------------------------------------------------------------------------*/
+
+static MemoryAccount process_memory;
+static atomic_llong last_account_id;
+static _Thread_local MemoryAccount *file_memory;    // Current file of this thread, or NULL
+
+static void account_charge(MemoryAccount *account, long long bytes) {
+    atomic_fetch_add(&account->allocated_bytes, bytes);
+    atomic_fetch_add(&account->allocation_count, 1);
+    long long current = atomic_fetch_add(&account->current_bytes, bytes) + bytes;
+    long long peak = atomic_load(&account->peak_bytes);
+    while (current > peak && !atomic_compare_exchange_weak(&account->peak_bytes, &peak, current)) {}
+}
+
+/* Uncount a block that is being freed or moved */
+static void account_release(const AllocationHeader *header) {
+    atomic_fetch_sub(&process_memory.current_bytes, header->info.size);
+    if (file_memory && header->info.account_id == file_memory->id) {
+        atomic_fetch_sub(&file_memory->current_bytes, header->info.size);
+    }
+}
+
+static void *account_block(AllocationHeader *header, size_t size) {
+    header->info.size = size;
+    header->info.account_id = file_memory ? file_memory->id : 0;
+    account_charge(&process_memory, size);
+    if (file_memory) account_charge(file_memory, size);
+    return header + 1;
+}
+
+void *lexer_malloc(size_t size) {
+    AllocationHeader *header = malloc(sizeof(AllocationHeader) + size);
+    return header ? account_block(header, size) : NULL;
+}
+
+void *lexer_realloc(void *pointer, size_t size) {
+    if (!pointer) return lexer_malloc(size);
+    AllocationHeader *header = (AllocationHeader *)pointer - 1;
+    AllocationHeader old = *header;
+    AllocationHeader *grown = realloc(header, sizeof(AllocationHeader) + size);
+    if (!grown) return NULL;
+    account_release(&old);
+    return account_block(grown, size);
+}
+
+void lexer_free(void *pointer) {
+    if (!pointer) return;
+    AllocationHeader *header = (AllocationHeader *)pointer - 1;
+    account_release(header);
+    free(header);
+}
+
+static void memory_snapshot(MemoryAccount *account, LexerMemory *usage) {
+    usage->allocated_bytes = atomic_load(&account->allocated_bytes);
+    usage->allocation_count = atomic_load(&account->allocation_count);
+    usage->current_bytes = atomic_load(&account->current_bytes);
+    usage->peak_bytes = atomic_load(&account->peak_bytes);
+}
+
+void lexer_memory_process(LexerMemory *usage) {
+    memory_snapshot(&process_memory, usage);
+}
+
+int lexer_memory_begin(void) {
+    MemoryAccount *account = calloc(1, sizeof(MemoryAccount));
+    if (!account) return 0;
+    account->id = atomic_fetch_add(&last_account_id, 1) + 1;
+    file_memory = account;
+    return 1;
+}
+
+void lexer_memory_end(LexerMemory *usage) {
+    LexerMemory none = {0};
+    if (file_memory) memory_snapshot(file_memory, usage);
+    else *usage = none;
+    free(file_memory);
+    file_memory = NULL;
+}
+
 /* Returns minimum of three integers */
-int min_of_three(int a, int b, int c) {
+static int min_of_three(int a, int b, int c) {
     int min = a;
     if (b < min) min = b;
     if (c < min) min = c;
@@ -134,28 +272,50 @@ int min_of_three(int a, int b, int c) {
  * Levenshtein Distance Algorithm
  * Calculates edit distance between two strings (insertions, deletions, substitutions)
  * Used to detect misspelled keywords (e.g., "pritn" vs "print" = distance 2)
+ * Keeps two rows of the matrix, sized by the shorter string; they live on the stack
+ * unless both strings are long.
  */
 int levenshtein_distance(const char *str1, const char *str2) {
     int len1 = strlen(str1);
     int len2 = strlen(str2);
-    int matrix[len1 + 1][len2 + 1];
+    if (len2 > len1) {
+        const char *swap = str1;
+        str1 = str2;
+        str2 = swap;
+        len2 = len1;
+        len1 = strlen(str1);
+    }
+    int stack_rows[2][LEVENSHTEIN_STACK_LENGTH + 1];
+    int *heap_rows = NULL;
+    int *previous = stack_rows[0], *current = stack_rows[1];
+    if (len2 > LEVENSHTEIN_STACK_LENGTH) {
+        heap_rows = lexer_malloc(sizeof(int) * 2 * (len2 + 1));
+        if (!heap_rows) return len1;    // An upper bound: len1 >= len2
+        previous = heap_rows;
+        current = heap_rows + len2 + 1;
+    }
 
-    // Initialize base cases
-    for (int i = 0; i <= len1; i++) matrix[i][0] = i;
-    for (int j = 0; j <= len2; j++) matrix[0][j] = j;
+    // Initialize base case: row 0
+    for (int j = 0; j <= len2; j++) previous[j] = j;
 
-    // Fill matrix using dynamic programming
+    // Fill matrix row by row using dynamic programming
     for (int i = 1; i <= len1; i++) {
+        current[0] = i;
         for (int j = 1; j <= len2; j++) {
-            int cost = (tolower(str1[i-1]) == tolower(str2[j-1])) ? 0 : 1;
-            matrix[i][j] = min_of_three(
-                matrix[i-1][j] + 1,      // deletion
-                matrix[i][j-1] + 1,      // insertion
-                matrix[i-1][j-1] + cost  // substitution
+            int cost = (tolower((unsigned char)str1[i-1]) == tolower((unsigned char)str2[j-1])) ? 0 : 1;
+            current[j] = min_of_three(
+                previous[j] + 1,        // deletion
+                current[j-1] + 1,       // insertion
+                previous[j-1] + cost    // substitution
             );
         }
+        int *swap = previous;
+        previous = current;
+        current = swap;
     }
-    return matrix[len1][len2];
+    int distance = previous[len2];
+    lexer_free(heap_rows);
+    return distance;
 }
 
 /* Check if word is a Python keyword */
@@ -184,78 +344,130 @@ int is_delimiter_char(char c) {
     return strchr("()[]{},:;.", c) != NULL;
 }
 
-/* Read entire file into a string */
-char *read_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        printf("Error: Cannot open file '%s'\n", filename);
-        return NULL;
-    }
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char *content = malloc(size + 1);
-    fread(content, 1, size, file);
-    content[size] = '\0';
-    fclose(file);
-    return content;
-}
-
 /*===========================================================================
  * SECTION 4: COMMENT EXTRACTION
  * Extracts comments and returns code without comments (clean_code)
+ * Newlines inside multi-line comments are kept, so token lines match the source
  *===========================================================================*/
 
+/* Record one comment character, truncating comments longer than the buffer */
+static inline void append_comment_char(Comment *comment, int *content_index, char c) {
+    if (*content_index < MAX_LENGTH - 1) comment->content[(*content_index)++] = c;
+}
+
+/* Index of the first close[0 .. close_length) at or after from, or -1 */
+static int find_closing(const char *source_code, int from, int source_length, const char *close, int close_length) {
+    while (from + close_length <= source_length) {
+        const char *found = memchr(source_code + from, close[0], source_length - close_length + 1 - from);
+        if (!found) return -1;
+        from = found - source_code;
+        if (memcmp(found, close, close_length) == 0) return from;
+        from++;
+    }
+    return -1;
+}
+
+/**
+ * Record an unterminated multi-line comment as a comment up to the end of its line, so
+ * it does not swallow the rest of the file. Returns the index of that line end.
+ */
+static int scan_unterminated_comment(const char *source_code, int source_index, int source_length, int current_line,
+                                     Comment *comment) {
+    int content_index = 0;
+    comment->start_line = current_line;
+    comment->end_line = current_line;
+    comment->is_multiline = 0;
+    while (source_index < source_length && source_code[source_index] != '\n') {
+        append_comment_char(comment, &content_index, source_code[source_index++]);
+    }
+    comment->content[content_index] = '\0';
+    return source_index;
+}
+
 /**
- * Extract Python comments
+ * Scan Python comments incrementally
  * - Single-line: # comment
  * - Multi-line: ''' or """ (docstrings)
+ * Scans source_code[scanner->source_index .. source_length). When more input may still
+ * arrive (is_final == 0), it stops before any comment or quote run that is not yet
+ * complete, so calling it again on a longer buffer continues seamlessly. In the final
+ * scan, a ''' or """ that is never closed only comments out the rest of its line.
+ * Comments beyond scanner->comment_capacity are still stripped from the code, but not recorded.
  */
-void extract_comments_python(const char *source_code, Comment *comments, int *comment_count, char *code_without_comments) {
-    *comment_count = 0;
-    int source_index = 0, clean_index = 0, current_line = 1;
-    int source_length = strlen(source_code);
+void scan_comments_python(CommentScanner *scanner, const char *source_code, int source_length, int is_final,
+                          Comment *comments, char *code_without_comments) {
+    int source_index = scanner->source_index, clean_index = scanner->clean_index;
+    int current_line = scanner->current_line;
+    int unclosed_from[2] = { INT_MAX, INT_MAX };    // No ''' (0) or """ (1) at or after these indexes
+    Comment discarded;
 
     while (source_index < source_length) {
+        Comment *comment = scanner->comment_count < scanner->comment_capacity ? &comments[scanner->comment_count] : &discarded;
+
         // Single-line comment: #
         if (source_code[source_index] == '#') {
-            comments[*comment_count].start_line = current_line;
-            comments[*comment_count].end_line = current_line;
-            comments[*comment_count].is_multiline = 0;
-            
+            if (!is_final) {
+                int search_index = scanner->pending_search > source_index ? scanner->pending_search : source_index;
+                if (!memchr(source_code + search_index, '\n', source_length - search_index)) {
+                    scanner->pending_search = source_length; // No newline read yet
+                    break;
+                }
+            }
+            scanner->pending_search = 0;
+            comment->start_line = current_line;
+            comment->end_line = current_line;
+            comment->is_multiline = 0;
+
             int content_index = 0;
             while (source_index < source_length && source_code[source_index] != '\n') {
-                comments[*comment_count].content[content_index++] = source_code[source_index++];
+                append_comment_char(comment, &content_index, source_code[source_index++]);
             }
-            comments[*comment_count].content[content_index] = '\0';
-            (*comment_count)++;
+            comment->content[content_index] = '\0';
+            scanner->comment_count++;
+        }
+        // Not enough input yet to tell a quote from a triple quote
+        else if (!is_final && source_index + 2 >= source_length &&
+                 (source_code[source_index] == '\'' || source_code[source_index] == '"')) {
+            break;
         }
         // Multi-line: ''' or """
         else if (source_index + 2 < source_length &&
                  ((source_code[source_index] == '\'' && source_code[source_index+1] == '\'' && source_code[source_index+2] == '\'') ||
                   (source_code[source_index] == '"' && source_code[source_index+1] == '"' && source_code[source_index+2] == '"'))) {
-            
+
             char quote_char = source_code[source_index];
-            comments[*comment_count].start_line = current_line;
-            comments[*comment_count].is_multiline = 1;
-            
+            const char *quotes = quote_char == '"' ? "\"\"\"" : "'''";
+            int kind = quote_char == '"';
+            int search_index = scanner->pending_search > source_index + 3 ? scanner->pending_search : source_index + 3;
+            int close_index = search_index >= unclosed_from[kind] ? -1 :
+                              find_closing(source_code, search_index, source_length, quotes, 3);
+            if (close_index < 0 && !is_final) {
+                scanner->pending_search = source_length > search_index + 2 ? source_length - 2 : search_index; // Closing quotes not read yet
+                break;
+            }
+            scanner->pending_search = 0;
+            if (close_index < 0) {
+                // Never closed: nothing after search_index closes the later ones either
+                if (search_index < unclosed_from[kind]) unclosed_from[kind] = search_index;
+                source_index = scan_unterminated_comment(source_code, source_index, source_length, current_line, comment);
+                scanner->comment_count++;
+                continue;
+            }
+            comment->start_line = current_line;
+            comment->is_multiline = 1;
+
+            // Copy from the opening through the closing quotes
             int content_index = 0;
-            // Copy opening quotes
-            for (int q = 0; q < 3; q++) comments[*comment_count].content[content_index++] = source_code[source_index++];
-            
-            // Copy until closing quotes
-            while (source_index + 2 < source_length) {
-                if (source_code[source_index] == '\n') current_line++;
-                if (source_code[source_index] == quote_char && source_code[source_index+1] == quote_char && source_code[source_index+2] == quote_char) {
-                    for (int q = 0; q < 3; q++) comments[*comment_count].content[content_index++] = source_code[source_index++];
-                    break;
+            for (; source_index < close_index + 3; source_index++) {
+                if (source_code[source_index] == '\n') {
+                    current_line++;
+                    code_without_comments[clean_index++] = '\n'; // Keep token line numbers in step
                 }
-                comments[*comment_count].content[content_index++] = source_code[source_index++];
+                append_comment_char(comment, &content_index, source_code[source_index]);
             }
-            comments[*comment_count].content[content_index] = '\0';
-            comments[*comment_count].end_line = current_line;
-            (*comment_count)++;
+            comment->content[content_index] = '\0';
+            comment->end_line = current_line;
+            scanner->comment_count++;
         }
         // Regular code
         else {
@@ -264,53 +476,83 @@ void extract_comments_python(const char *source_code, Comment *comments, int *co
         }
     }
     code_without_comments[clean_index] = '\0';
+
+    scanner->source_index = source_index;
+    scanner->clean_index = clean_index;
+    scanner->current_line = current_line;
 }
 
 /**
- * Extract TypeScript comments
+ * Scan TypeScript comments incrementally (same contract as scan_comments_python)
  * - Single-line: //
  * - Multi-line: starts with slash-star, ends with star-slash
  */
-void extract_comments_typescript(const char *source_code, Comment *comments, int *comment_count, char *code_without_comments) {
-    *comment_count = 0;
-    int source_index = 0, clean_index = 0, current_line = 1;
-    int source_length = strlen(source_code);
+void scan_comments_typescript(CommentScanner *scanner, const char *source_code, int source_length, int is_final,
+                              Comment *comments, char *code_without_comments) {
+    int source_index = scanner->source_index, clean_index = scanner->clean_index;
+    int current_line = scanner->current_line;
+    int unclosed_from = INT_MAX;    // No star-slash at or after this index
+    Comment discarded;
 
     while (source_index < source_length) {
+        Comment *comment = scanner->comment_count < scanner->comment_capacity ? &comments[scanner->comment_count] : &discarded;
+
+        // Not enough input yet to tell '/' from a comment start
+        if (!is_final && source_index + 1 >= source_length && source_code[source_index] == '/') {
+            break;
+        }
         // Single-line: //
-        if (source_index + 1 < source_length && source_code[source_index] == '/' && source_code[source_index+1] == '/') {
-            comments[*comment_count].start_line = current_line;
-            comments[*comment_count].end_line = current_line;
-            comments[*comment_count].is_multiline = 0;
-            
+        else if (source_index + 1 < source_length && source_code[source_index] == '/' && source_code[source_index+1] == '/') {
+            if (!is_final) {
+                int search_index = scanner->pending_search > source_index ? scanner->pending_search : source_index;
+                if (!memchr(source_code + search_index, '\n', source_length - search_index)) {
+                    scanner->pending_search = source_length; // No newline read yet
+                    break;
+                }
+            }
+            scanner->pending_search = 0;
+            comment->start_line = current_line;
+            comment->end_line = current_line;
+            comment->is_multiline = 0;
+
             int content_index = 0;
             while (source_index < source_length && source_code[source_index] != '\n') {
-                comments[*comment_count].content[content_index++] = source_code[source_index++];
+                append_comment_char(comment, &content_index, source_code[source_index++]);
             }
-            comments[*comment_count].content[content_index] = '\0';
-            (*comment_count)++;
+            comment->content[content_index] = '\0';
+            scanner->comment_count++;
         }
         // Multi-line: /* */
         else if (source_index + 1 < source_length && source_code[source_index] == '/' && source_code[source_index+1] == '*') {
-            comments[*comment_count].start_line = current_line;
-            comments[*comment_count].is_multiline = 1;
-            
+            int search_index = scanner->pending_search > source_index + 2 ? scanner->pending_search : source_index + 2;
+            int close_index = search_index >= unclosed_from ? -1 : find_closing(source_code, search_index, source_length, "*/", 2);
+            if (close_index < 0 && !is_final) {
+                scanner->pending_search = source_length > search_index + 1 ? source_length - 1 : search_index; // Closing star-slash not read yet
+                break;
+            }
+            scanner->pending_search = 0;
+            if (close_index < 0) {
+                // Never closed: nothing after search_index closes the later ones either
+                if (search_index < unclosed_from) unclosed_from = search_index;
+                source_index = scan_unterminated_comment(source_code, source_index, source_length, current_line, comment);
+                scanner->comment_count++;
+                continue;
+            }
+            comment->start_line = current_line;
+            comment->is_multiline = 1;
+
+            // Copy from the opening through the closing star-slash
             int content_index = 0;
-            comments[*comment_count].content[content_index++] = source_code[source_index++];
-            comments[*comment_count].content[content_index++] = source_code[source_index++];
-            
-            while (source_index + 1 < source_length) {
-                if (source_code[source_index] == '\n') current_line++;
-                if (source_code[source_index] == '*' && source_code[source_index+1] == '/') {
-                    comments[*comment_count].content[content_index++] = source_code[source_index++];
-                    comments[*comment_count].content[content_index++] = source_code[source_index++];
-                    break;
+            for (; source_index < close_index + 2; source_index++) {
+                if (source_code[source_index] == '\n') {
+                    current_line++;
+                    code_without_comments[clean_index++] = '\n'; // Keep token line numbers in step
                 }
-                comments[*comment_count].content[content_index++] = source_code[source_index++];
+                append_comment_char(comment, &content_index, source_code[source_index]);
             }
-            comments[*comment_count].content[content_index] = '\0';
-            comments[*comment_count].end_line = current_line;
-            (*comment_count)++;
+            comment->content[content_index] = '\0';
+            comment->end_line = current_line;
+            scanner->comment_count++;
         }
         // Regular code
         else {
@@ -319,6 +561,24 @@ void extract_comments_typescript(const char *source_code, Comment *comments, int
         }
     }
     code_without_comments[clean_index] = '\0';
+
+    scanner->source_index = source_index;
+    scanner->clean_index = clean_index;
+    scanner->current_line = current_line;
+}
+
+/* Extract Python comments; the remaining code is written to code_without_comments */
+void extract_comments_python(const char *source_code, Comment *comments, int *comment_count, char *code_without_comments) {
+    CommentScanner scanner = { 0, 0, 1, 0, 0, MAX_COMMENTS };
+    scan_comments_python(&scanner, source_code, strlen(source_code), 1, comments, code_without_comments);
+    *comment_count = scanner.comment_count < MAX_COMMENTS ? scanner.comment_count : MAX_COMMENTS;
+}
+
+/* Extract TypeScript comments; the remaining code is written to code_without_comments */
+void extract_comments_typescript(const char *source_code, Comment *comments, int *comment_count, char *code_without_comments) {
+    CommentScanner scanner = { 0, 0, 1, 0, 0, MAX_COMMENTS };
+    scan_comments_typescript(&scanner, source_code, strlen(source_code), 1, comments, code_without_comments);
+    *comment_count = scanner.comment_count < MAX_COMMENTS ? scanner.comment_count : MAX_COMMENTS;
 }
 
 /*===========================================================================
@@ -326,166 +586,542 @@ void extract_comments_typescript(const char *source_code, Comment *comments, int
  * Breaks source code into tokens
  * Token types: KEYWORD, IDENTIFIER, INT_LITERAL, FLOAT_LITERAL, 
  *              STRING_LITERAL, OPERATOR, DELIMITER
+ *              and for Python NEWLINE, INDENT, DEDENT
  *===========================================================================*/
 
-/* Tokenize Python source code */
-void tokenize_python(const char *source_code, Token *tokens, int *token_count) {
-    *token_count = 0;
-    int code_index = 0, current_line = 1;
-    int code_length = strlen(source_code);
+/* Append a character to a token value, truncating values that do not fit */
+static inline void append_value_char(char *value, int *value_index, char c) {
+    if (*value_index < MAX_VALUE - 1) value[(*value_index)++] = c;
+}
 
-    while (code_index < code_length && *token_count < MAX_TOKENS) {
-        // Skip whitespace
-        while (code_index < code_length && isspace(source_code[code_index])) {
-            if (source_code[code_index] == '\n') current_line++;
+/* Length of a line continuation (a backslash, then "\n" or "\r\n") at index, or 0 */
+static inline int line_join_length(const char *source_code, int index, int length) {
+    if (source_code[index] != '\\' || index + 1 >= length) return 0;
+    if (source_code[index + 1] == '\n') return 2;
+    return source_code[index + 1] == '\r' && index + 2 < length && source_code[index + 2] == '\n' ? 3 : 0;
+}
+
+/* Indentation width of the line holding index, up to index (tabs to multiples of 8) */
+static int indent_width(const char *source_code, int index) {
+    int line_start = index, width = 0;
+    while (line_start > 0 && source_code[line_start - 1] != '\n') line_start--;
+    for (int i = line_start; i < index; i++) {
+        if (source_code[i] == '\t') width = (width / 8 + 1) * 8;
+        else if (source_code[i] == '\f') width = 0;
+        else if (source_code[i] == ' ') width++;
+        else break;     // A character that is not a token (such as '@') starts the line
+    }
+    return width;
+}
+
+/* Layout token due before the first token of a logical line, indented by width: INDENT, DEDENT (one per call) or -1 */
+static int layout_before_line(PythonLayout *layout, int width) {
+    int top = layout->depth > 0 ? layout->widths[layout->depth - 1] : 0;
+    if (width < top) {
+        layout->depth--;
+        return TOKEN_DEDENT;
+    }
+    if (width > top && layout->depth < MAX_INDENT_LEVELS) {
+        layout->widths[layout->depth++] = width;
+        return TOKEN_INDENT;
+    }
+    return -1;
+}
+
+/* Layout token due at the end of input: NEWLINE for an unfinished line, then one DEDENT per open block, or -1 */
+static int layout_at_end(PythonLayout *layout) {
+    if (layout->line_tokens > 0) {
+        layout->line_tokens = 0;
+        layout->brackets = 0;
+        return TOKEN_NEWLINE;
+    }
+    if (layout->depth > 0) {
+        layout->depth--;
+        return TOKEN_DEDENT;
+    }
+    return -1;
+}
+
+/* Count a token of the logical line; c is its first character if it is a delimiter, else 0 */
+static inline void layout_count_token(PythonLayout *layout, char c) {
+    layout->line_tokens++;
+    if (c == '(' || c == '[' || c == '{') layout->brackets++;
+    else if ((c == ')' || c == ']' || c == '}') && layout->brackets > 0) layout->brackets--;
+}
+
+static void write_layout_token(Token *token, int kind, int line, int column) {
+    token->value[0] = '\0';
+    strcpy(token->type, token_kind_name(kind));
+    token->line = line;
+    token->column = column;
+}
+
+/**
+ * Lex the next Python token starting at cursor->code_index
+ * Only tokens that begin before end_index are produced, but a token may run past it
+ * (e.g. a string literal crossing the boundary). Returns 1 if a token was written,
+ * 0 once no further token starts before end_index. With cursor->more_input set, a
+ * token that reaches code_length is not emitted; the cursor stays in front of it.
+ */
+int next_token_python(LexCursor *cursor, int end_index, Token *token) {
+    const char *source_code = cursor->source_code;
+    int code_length = cursor->code_length;
+    int code_index = cursor->code_index, current_line = cursor->current_line;
+    int line_start = cursor->line_start;
+    PythonLayout *layout = &cursor->layout;
+    int produced = 0;
+
+    while (!produced) {
+        // Skip whitespace; a line break outside brackets ends the logical line
+        while (code_index < end_index) {
+            int join = line_join_length(source_code, code_index, code_length);
+            if (join) {
+                code_index += join;
+                current_line++;
+                line_start = code_index;
+                continue;
+            }
+            if (!isspace(source_code[code_index])) break;
+            if (source_code[code_index] == '\n') {
+                if (layout->brackets == 0 && layout->line_tokens > 0) {
+                    write_layout_token(token, TOKEN_NEWLINE, current_line, code_index - line_start + 1);
+                    layout->line_tokens = 0;
+                    produced = 1;
+                }
+                current_line++;
+                line_start = code_index + 1;
+            }
             code_index++;
+            if (produced) break;
+        }
+        if (produced) break;
+        if (code_index >= end_index) {
+            int kind = code_index >= code_length && !cursor->more_input ? layout_at_end(layout) : -1;
+            if (kind >= 0) {
+                write_layout_token(token, kind, current_line, code_index - line_start + 1);
+                produced = 1;
+            }
+            break;
+        }
+        if (source_code[code_index] == '\\' && code_index + 2 >= code_length && cursor->more_input) break; // May be a line join
+
+        // Indentation of a logical line's first token
+        if (layout->brackets == 0 && layout->line_tokens == 0) {
+            int kind = layout_before_line(layout, indent_width(source_code, code_index));
+            if (kind >= 0) {
+                write_layout_token(token, kind, current_line, code_index - line_start + 1);
+                produced = 1;
+                break;
+            }
         }
-        if (code_index >= code_length) break;
+        int token_start = code_index, token_line = current_line, token_line_start = line_start;
 
         // Identifier or Keyword
         if (isalpha(source_code[code_index]) || source_code[code_index] == '_') {
             int value_index = 0;
             while (code_index < code_length && (isalnum(source_code[code_index]) || source_code[code_index] == '_')) {
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
+                append_value_char(token->value, &value_index, source_code[code_index++]);
             }
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, is_python_keyword(tokens[*token_count].value) ? "KEYWORD" : "IDENTIFIER");
-            (*token_count)++;
+            token->value[value_index] = '\0';
+            token->line = current_line;
+            strcpy(token->type, is_python_keyword(token->value) ? "KEYWORD" : "IDENTIFIER");
+            produced = 1;
         }
         // Number (integer or float)
         else if (isdigit(source_code[code_index])) {
             int value_index = 0, has_decimal_point = 0;
             while (code_index < code_length && (isdigit(source_code[code_index]) || source_code[code_index] == '.')) {
                 if (source_code[code_index] == '.') has_decimal_point = 1;
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
+                append_value_char(token->value, &value_index, source_code[code_index++]);
             }
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, has_decimal_point ? "FLOAT_LITERAL" : "INT_LITERAL");
-            (*token_count)++;
+            token->value[value_index] = '\0';
+            token->line = current_line;
+            strcpy(token->type, has_decimal_point ? "FLOAT_LITERAL" : "INT_LITERAL");
+            produced = 1;
         }
         // String literal
         else if (source_code[code_index] == '"' || source_code[code_index] == '\'') {
             char quote_char = source_code[code_index];
             int value_index = 0;
-            tokens[*token_count].value[value_index++] = source_code[code_index++];
+            append_value_char(token->value, &value_index, source_code[code_index++]);
             while (code_index < code_length && source_code[code_index] != quote_char) {
-                if (source_code[code_index] == '\\' && code_index + 1 < code_length) tokens[*token_count].value[value_index++] = source_code[code_index++];
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
+                if (source_code[code_index] == '\\' && code_index + 1 < code_length) append_value_char(token->value, &value_index, source_code[code_index++]);
+                if (source_code[code_index] == '\n') {
+                    current_line++;
+                    line_start = code_index + 1;
+                }
+                append_value_char(token->value, &value_index, source_code[code_index++]);
             }
-            if (code_index < code_length) tokens[*token_count].value[value_index++] = source_code[code_index++];
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, "STRING_LITERAL");
-            (*token_count)++;
+            if (code_index < code_length) append_value_char(token->value, &value_index, source_code[code_index++]);
+            token->value[value_index] = '\0';
+            token->line = token_line;
+            strcpy(token->type, "STRING_LITERAL");
+            produced = 1;
         }
         // Operator
         else if (is_operator_char(source_code[code_index])) {
             int value_index = 0;
             while (code_index < code_length && is_operator_char(source_code[code_index]) && value_index < 3) {
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
+                append_value_char(token->value, &value_index, source_code[code_index++]);
             }
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, "OPERATOR");
-            (*token_count)++;
+            token->value[value_index] = '\0';
+            token->line = current_line;
+            strcpy(token->type, "OPERATOR");
+            produced = 1;
         }
         // Delimiter
         else if (is_delimiter_char(source_code[code_index])) {
-            tokens[*token_count].value[0] = source_code[code_index++];
-            tokens[*token_count].value[1] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, "DELIMITER");
-            (*token_count)++;
+            token->value[0] = source_code[code_index++];
+            token->value[1] = '\0';
+            token->line = current_line;
+            strcpy(token->type, "DELIMITER");
+            produced = 1;
         }
         else {
             code_index++; // Skip unknown characters
         }
+
+        // A token touching the end of the buffer may still grow: wait for more input
+        if (produced && cursor->more_input && code_index >= code_length) {
+            code_index = token_start;
+            current_line = token_line;
+            line_start = token_line_start;
+            produced = 0;
+            break;
+        }
+        if (produced) {
+            token->column = token_start - token_line_start + 1;
+            layout_count_token(layout, strcmp(token->type, "DELIMITER") == 0 ? token->value[0] : 0);
+        }
     }
+
+    cursor->code_index = code_index;
+    cursor->current_line = current_line;
+    cursor->line_start = line_start;
+    return produced;
 }
 
-/* Tokenize TypeScript source code */
-void tokenize_typescript(const char *source_code, Token *tokens, int *token_count) {
-    *token_count = 0;
-    int code_index = 0, current_line = 1;
-    int code_length = strlen(source_code);
+/* Lex the next TypeScript token (same contract as next_token_python) */
+int next_token_typescript(LexCursor *cursor, int end_index, Token *token) {
+    const char *source_code = cursor->source_code;
+    int code_length = cursor->code_length;
+    int code_index = cursor->code_index, current_line = cursor->current_line;
+    int line_start = cursor->line_start;
+    int produced = 0;
 
-    while (code_index < code_length && *token_count < MAX_TOKENS) {
+    while (!produced) {
         // Skip whitespace
-        while (code_index < code_length && isspace(source_code[code_index])) {
-            if (source_code[code_index] == '\n') current_line++;
+        while (code_index < end_index && isspace(source_code[code_index])) {
+            if (source_code[code_index] == '\n') {
+                current_line++;
+                line_start = code_index + 1;
+            }
             code_index++;
         }
-        if (code_index >= code_length) break;
+        if (code_index >= end_index) break;
+        int token_start = code_index, token_line = current_line, token_line_start = line_start;
 
         // Identifier or Keyword (TypeScript allows $)
         if (isalpha(source_code[code_index]) || source_code[code_index] == '_' || source_code[code_index] == '$') {
             int value_index = 0;
             while (code_index < code_length && (isalnum(source_code[code_index]) || source_code[code_index] == '_' || source_code[code_index] == '$')) {
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
+                append_value_char(token->value, &value_index, source_code[code_index++]);
             }
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, is_typescript_keyword(tokens[*token_count].value) ? "KEYWORD" : "IDENTIFIER");
-            (*token_count)++;
+            token->value[value_index] = '\0';
+            token->line = current_line;
+            strcpy(token->type, is_typescript_keyword(token->value) ? "KEYWORD" : "IDENTIFIER");
+            produced = 1;
         }
         // Number
         else if (isdigit(source_code[code_index])) {
             int value_index = 0, has_decimal_point = 0;
             while (code_index < code_length && (isdigit(source_code[code_index]) || source_code[code_index] == '.')) {
                 if (source_code[code_index] == '.') has_decimal_point = 1;
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
+                append_value_char(token->value, &value_index, source_code[code_index++]);
             }
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, has_decimal_point ? "FLOAT_LITERAL" : "INT_LITERAL");
-            (*token_count)++;
+            token->value[value_index] = '\0';
+            token->line = current_line;
+            strcpy(token->type, has_decimal_point ? "FLOAT_LITERAL" : "INT_LITERAL");
+            produced = 1;
         }
         // String literal (includes template strings with backtick)
         else if (source_code[code_index] == '"' || source_code[code_index] == '\'' || source_code[code_index] == '`') {
             char quote_char = source_code[code_index];
             int value_index = 0;
-            tokens[*token_count].value[value_index++] = source_code[code_index++];
+            append_value_char(token->value, &value_index, source_code[code_index++]);
             while (code_index < code_length && source_code[code_index] != quote_char) {
-                if (source_code[code_index] == '\\' && code_index + 1 < code_length) tokens[*token_count].value[value_index++] = source_code[code_index++];
-                if (source_code[code_index] == '\n') current_line++;
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
-            }
-            if (code_index < code_length) tokens[*token_count].value[value_index++] = source_code[code_index++];
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, "STRING_LITERAL");
-            (*token_count)++;
+                if (source_code[code_index] == '\\' && code_index + 1 < code_length) append_value_char(token->value, &value_index, source_code[code_index++]);
+                if (source_code[code_index] == '\n') {
+                    current_line++;
+                    line_start = code_index + 1;
+                }
+                append_value_char(token->value, &value_index, source_code[code_index++]);
+            }
+            if (code_index < code_length) append_value_char(token->value, &value_index, source_code[code_index++]);
+            token->value[value_index] = '\0';
+            token->line = token_line;
+            strcpy(token->type, "STRING_LITERAL");
+            produced = 1;
         }
         // Operator
         else if (is_operator_char(source_code[code_index])) {
             int value_index = 0;
             while (code_index < code_length && is_operator_char(source_code[code_index]) && value_index < 3) {
-                tokens[*token_count].value[value_index++] = source_code[code_index++];
+                append_value_char(token->value, &value_index, source_code[code_index++]);
             }
-            tokens[*token_count].value[value_index] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, "OPERATOR");
-            (*token_count)++;
+            token->value[value_index] = '\0';
+            token->line = current_line;
+            strcpy(token->type, "OPERATOR");
+            produced = 1;
         }
         // Delimiter
         else if (is_delimiter_char(source_code[code_index])) {
-            tokens[*token_count].value[0] = source_code[code_index++];
-            tokens[*token_count].value[1] = '\0';
-            tokens[*token_count].line = current_line;
-            strcpy(tokens[*token_count].type, "DELIMITER");
-            (*token_count)++;
+            token->value[0] = source_code[code_index++];
+            token->value[1] = '\0';
+            token->line = current_line;
+            strcpy(token->type, "DELIMITER");
+            produced = 1;
         }
         else {
             code_index++;
         }
+
+        // A token touching the end of the buffer may still grow: wait for more input
+        if (produced && cursor->more_input && code_index >= code_length) {
+            code_index = token_start;
+            current_line = token_line;
+            line_start = token_line_start;
+            produced = 0;
+            break;
+        }
+        if (produced) token->column = token_start - token_line_start + 1;
+    }
+
+    cursor->code_index = code_index;
+    cursor->current_line = current_line;
+    cursor->line_start = line_start;
+    return produced;
+}
+
+/* Lex tokens starting before end_index into tokens[], up to max_tokens; returns the count */
+int tokenize_range(LexCursor *cursor, int end_index, Language lang, Token *tokens, int max_tokens) {
+    int token_count = 0;
+    if (lang == LANG_PYTHON) {
+        while (token_count < max_tokens && next_token_python(cursor, end_index, &tokens[token_count])) token_count++;
+    } else {
+        while (token_count < max_tokens && next_token_typescript(cursor, end_index, &tokens[token_count])) token_count++;
+    }
+    return token_count;
+}
+
+/* Tokenize Python source code */
+void tokenize_python(const char *source_code, Token *tokens, int *token_count) {
+    int code_length = strlen(source_code);
+    LexCursor cursor = { source_code, code_length, 0, 1, 0, 0, { 0 } };
+    *token_count = tokenize_range(&cursor, code_length, LANG_PYTHON, tokens, MAX_TOKENS);
+}
+
+/* Tokenize TypeScript source code */
+void tokenize_typescript(const char *source_code, Token *tokens, int *token_count) {
+    int code_length = strlen(source_code);
+    LexCursor cursor = { source_code, code_length, 0, 1, 0, 0, { 0 } };
+    *token_count = tokenize_range(&cursor, code_length, LANG_TYPESCRIPT, tokens, MAX_TOKENS);
+}
+
+/**
+ * Parallel tokenizer for large inputs
+ * The code is cut into one chunk per thread at line starts, and every chunk is lexed
+ * speculatively as if no token crossed into it. A sequential fix-up then walks the
+ * chunks in order: a chunk's guess was right iff the previous chunk stopped exactly
+ * at its start. Chunks that guessed wrong (a string or other token spanned the cut)
+ * are re-lexed from the true position. Lines are lexed relative to the chunk start
+ * and shifted by the running newline count while stitching, so the result is
+ * identical to tokenize_python / tokenize_typescript.
+ * Python chunks also guess that no bracket or block is open at their start, so
+ * they are cut at unindented lines where possible. At such a line every block
+ * closes, and the fix-up adds the DEDENT tokens the guess left out; a chunk whose
+ * start is inside brackets or a block is re-lexed with the true layout state.
+ */
+typedef struct {
+    const char *source_code;
+    int code_length;
+    Language lang;
+    int start_index;    // Speculative (or, after fix-up, true) start of the chunk
+    int end_index;      // Tokens must start before this index
+    Token *tokens;      // Tokens with lines relative to start_index (first line = 0)
+    int token_count;
+    int token_capacity;
+    int max_tokens;     // No chunk needs more tokens than the whole result can hold
+    int stop_index;     // Where lexing stopped (>= end_index unless max_tokens was reached)
+    int line_delta;     // Newlines consumed between start_index and stop_index
+    PythonLayout layout;    // Layout state where lexing stopped
+    int failed;         // Out of memory
+    MemoryAccount *memory;  // File account of the thread that split the input
+} LexChunk;
+
+/* Lex a chunk from the layout state entry (NULL: nothing open) */
+static void lex_chunk(LexChunk *chunk, const PythonLayout *entry) {
+    LexCursor cursor = { chunk->source_code, chunk->code_length, chunk->start_index, 0, 0, chunk->start_index, { 0 } };
+    if (entry) cursor.layout = *entry;
+    while (cursor.line_start > 0 && chunk->source_code[cursor.line_start - 1] != '\n') cursor.line_start--; // A re-lexed chunk may start mid-line
+    chunk->token_count = 0;
+    chunk->failed = 0;
+
+    while (chunk->token_count < chunk->max_tokens) {
+        if (chunk->token_count == chunk->token_capacity) {
+            int new_capacity = chunk->token_capacity ? chunk->token_capacity * 2 : 256;
+            if (new_capacity > chunk->max_tokens) new_capacity = chunk->max_tokens;
+            Token *grown = lexer_realloc(chunk->tokens, sizeof(Token) * new_capacity);
+            if (!grown) { chunk->failed = 1; break; }
+            chunk->tokens = grown;
+            chunk->token_capacity = new_capacity;
+        }
+        int lexed = tokenize_range(&cursor, chunk->end_index, chunk->lang,
+                                   chunk->tokens + chunk->token_count,
+                                   chunk->token_capacity - chunk->token_count);
+        chunk->token_count += lexed;
+        if (chunk->token_count < chunk->token_capacity) break; // Reached end_index
+    }
+    chunk->stop_index = cursor.code_index;
+    chunk->line_delta = cursor.current_line;
+    chunk->layout = cursor.layout;
+}
+
+static void tokenize_serial(const char *source_code, int code_length, Language lang, Token *tokens, int max_tokens, int *token_count) {
+    LexCursor cursor = { source_code, code_length, 0, 1, 0, 0, { 0 } };
+    *token_count = tokenize_range(&cursor, code_length, lang, tokens, max_tokens);
+}
+
+/* First line start in [line_start, limit) that is not indented or blank, else line_start */
+static int unindented_line_start(const char *source_code, int code_length, int line_start, int limit) {
+    for (int index = line_start; index < limit; ) {
+        if (!isspace(source_code[index])) return index;
+        const char *newline = memchr(source_code + index, '\n', code_length - index);
+        if (!newline) break;
+        index = (int)(newline - source_code) + 1;
+    }
+    return line_start;
+}
+
+/* Lines from index to its first character that is not whitespace: where the lexer puts layout tokens */
+static int lines_before_code(const char *source_code, int code_length, int index) {
+    int lines = 0;
+    while (index < code_length) {
+        int join = line_join_length(source_code, index, code_length);
+        if (join) {
+            index += join;
+            lines++;
+            continue;
+        }
+        if (!isspace(source_code[index])) break;
+        if (source_code[index] == '\n') lines++;
+        index++;
+    }
+    return lines;
+}
+
+static void *lex_chunk_thread(void *arg) {
+    LexChunk *chunk = arg;
+    file_memory = chunk->memory;
+    lex_chunk(chunk, NULL);
+    return NULL;
+}
+
+void tokenize_parallel(const char *source_code, int code_length, Language lang, Token *tokens, int max_tokens,
+                       int *token_count, int thread_count) {
+    int chunk_count = thread_count;
+    if (chunk_count > code_length / PARALLEL_LEX_MIN_CHUNK) chunk_count = code_length / PARALLEL_LEX_MIN_CHUNK;
+    if (chunk_count > MAX_THREADS) chunk_count = MAX_THREADS;
+
+    if (chunk_count < 2 || code_length < PARALLEL_LEX_MIN_BYTES) {
+        tokenize_serial(source_code, code_length, lang, tokens, max_tokens, token_count);
+        return;
+    }
+
+    // Cut at line starts so that only multi-line tokens can straddle a boundary
+    LexChunk chunks[MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    int boundary = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        int next_boundary = code_length;
+        if (c + 1 < chunk_count) {
+            next_boundary = (int)((long long)code_length * (c + 1) / chunk_count);
+            if (next_boundary < boundary) next_boundary = boundary;
+            const char *newline = memchr(source_code + next_boundary, '\n', code_length - next_boundary);
+            next_boundary = newline ? (int)(newline - source_code) + 1 : code_length;
+            if (lang == LANG_PYTHON) {
+                int limit = (int)((long long)code_length * (c + 2) / chunk_count);
+                next_boundary = unindented_line_start(source_code, code_length, next_boundary, limit);
+            }
+        }
+        chunks[c].source_code = source_code;
+        chunks[c].code_length = code_length;
+        chunks[c].lang = lang;
+        chunks[c].max_tokens = max_tokens;
+        chunks[c].start_index = boundary;
+        chunks[c].end_index = next_boundary;
+        chunks[c].memory = file_memory;
+        boundary = next_boundary;
+    }
+
+    // Speculative pass: chunk 0 on this thread, the rest on workers
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+    for (int c = 1; c < chunk_count; c++) {
+        started[c] = pthread_create(&threads[c], NULL, lex_chunk_thread, &chunks[c]) == 0;
+        if (!started[c]) lex_chunk(&chunks[c], NULL);
+    }
+    lex_chunk(&chunks[0], NULL);
+    for (int c = 1; c < chunk_count; c++) {
+        if (started[c]) pthread_join(threads[c], NULL);
+    }
+
+    // Sequential fix-up and stitching
+    int expected_start = 0, line_base = 1;
+    PythonLayout layout = { 0 };    // True layout state at expected_start
+    *token_count = 0;
+    for (int c = 0; c < chunk_count && *token_count < max_tokens; c++) {
+        int guessed = chunks[c].start_index == expected_start, dedents = 0;
+        if (guessed && lang == LANG_PYTHON) {
+            // Open blocks are fine if the chunk starts unindented: they all close there
+            guessed = layout.brackets == 0 && layout.line_tokens == 0 &&
+                      (layout.depth == 0 || (chunks[c].token_count > 0 && chunks[c].tokens[0].column == 1));
+            dedents = layout.depth;
+        }
+        if (!guessed) {
+            chunks[c].start_index = expected_start;
+            lex_chunk(&chunks[c], &layout);
+            dedents = 0;
+        }
+        if (chunks[c].failed) {
+            // Fall back to the serial path rather than return a partial stream
+            for (int f = 0; f < chunk_count; f++) lexer_free(chunks[f].tokens);
+            tokenize_serial(source_code, code_length, lang, tokens, max_tokens, token_count);
+            return;
+        }
+        // The DEDENTs go on the chunk's first non-blank line, even if nothing there becomes a token (a stray '@')
+        int dedent_line = dedents ? line_base + lines_before_code(source_code, code_length, chunks[c].start_index) : 0;
+        for (int d = 0; d < dedents && *token_count < max_tokens; d++) {
+            write_layout_token(&tokens[*token_count], TOKEN_DEDENT, dedent_line, 1);
+            (*token_count)++;
+        }
+        for (int t = 0; t < chunks[c].token_count && *token_count < max_tokens; t++) {
+            tokens[*token_count] = chunks[c].tokens[t];
+            tokens[*token_count].line += line_base;
+            (*token_count)++;
+        }
+        line_base += chunks[c].line_delta;
+        expected_start = chunks[c].stop_index;
+        layout = chunks[c].layout;
     }
+
+    for (int c = 0; c < chunk_count; c++) lexer_free(chunks[c].tokens);
 }
 
 /*===========================================================================
  * SECTION 6: ERROR DETECTION
  * Detects 4 types of errors for each language
+ * Each check stops once MAX_ERRORS errors have been recorded
  *===========================================================================*/
 
 /**
@@ -494,9 +1130,13 @@ void tokenize_typescript(const char *source_code, Token *tokens, int *token_coun
  */
 void check_misspelled_keyword_python(Token *tokens, int count, Error *errors, int *err_count) {
     for (int i = 0; i < count; i++) {
-        if (strcmp(tokens[i].type, "IDENTIFIER") != 0 || strlen(tokens[i].value) <= 2) continue;
+        if (*err_count >= MAX_ERRORS) return;
+        int length = strlen(tokens[i].value);
+        if (strcmp(tokens[i].type, "IDENTIFIER") != 0 || length <= 2) continue;
         
         for (int j = 0; j < PYTHON_KEYWORD_COUNT; j++) {
+            int length_difference = length - (int)strlen(PYTHON_KEYWORDS[j]);
+            if (length_difference > 2 || length_difference < -2) continue;     // Distance is at least this
             int edit_distance = levenshtein_distance(tokens[i].value, PYTHON_KEYWORDS[j]);
             if (edit_distance > 0 && edit_distance <= 2) {
                 snprintf(errors[*err_count].message, MAX_LENGTH,
@@ -513,9 +1153,13 @@ void check_misspelled_keyword_python(Token *tokens, int count, Error *errors, in
 
 void check_misspelled_keyword_typescript(Token *tokens, int count, Error *errors, int *err_count) {
     for (int i = 0; i < count; i++) {
-        if (strcmp(tokens[i].type, "IDENTIFIER") != 0 || strlen(tokens[i].value) <= 2) continue;
+        if (*err_count >= MAX_ERRORS) return;
+        int length = strlen(tokens[i].value);
+        if (strcmp(tokens[i].type, "IDENTIFIER") != 0 || length <= 2) continue;
         
         for (int j = 0; j < TYPESCRIPT_KEYWORD_COUNT; j++) {
+            int length_difference = length - (int)strlen(TYPESCRIPT_KEYWORDS[j]);
+            if (length_difference > 2 || length_difference < -2) continue;     // Distance is at least this
             int edit_distance = levenshtein_distance(tokens[i].value, TYPESCRIPT_KEYWORDS[j]);
             if (edit_distance > 0 && edit_distance <= 2) {
                 snprintf(errors[*err_count].message, MAX_LENGTH,
@@ -530,217 +1174,849 @@ void check_misspelled_keyword_typescript(Token *tokens, int count, Error *errors
     }
 }
 
+/* A NameTable for up to count names */
+static int name_table_init(NameTable *table, int count) {
+    int slots = 16;
+    while (slots < 2 * count) slots *= 2;
+    table->name_slots = lexer_malloc(sizeof(int) * slots);
+    table->name_tokens = lexer_malloc(sizeof(int) * (count + 1));
+    table->slot_mask = slots - 1;
+    table->name_count = 0;
+    if (!table->name_slots || !table->name_tokens) return 0;
+    memset(table->name_slots, 0xff, sizeof(int) * slots);
+    return 1;
+}
+
+static void name_table_free(NameTable *table) {
+    lexer_free(table->name_slots);
+    lexer_free(table->name_tokens);
+}
+
+/* Interned name of tokens[index] (FNV-1a hash, linear probing; the table is never more than half full) */
+static int intern_name(NameTable *table, const Token *tokens, int index) {
+    unsigned int hash = 2166136261u;
+    for (const char *c = tokens[index].value; *c; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+    for (int slot = hash & table->slot_mask;; slot = (slot + 1) & table->slot_mask) {
+        int name = table->name_slots[slot];
+        if (name < 0) {
+            table->name_slots[slot] = table->name_count;
+            table->name_tokens[table->name_count] = index;
+            return table->name_count++;
+        }
+        if (strcmp(tokens[table->name_tokens[name]].value, tokens[index].value) == 0) return name;
+    }
+}
+
 /**
  * ERROR 2: Type Mismatch
  * Detects when declared type doesn't match assigned value
  * Python: x: int = 3.14 (int declared, float assigned)
  * TypeScript: let x: number = "hello"
+ *
+ * One forward pass also records, per interned name, the annotated type and the type
+ * of the last simple assignment (a single literal or variable), so it catches
+ *   y = 3.14; x: int = y      (the type flows through y)
+ *   x: int = 1; x = "s"       (a reassignment against the annotation)
+ * Nothing flows across a def, class, lambda, function or arrow: each starts a new
+ * region and the types recorded before it go stale, which costs O(1). Its body is
+ * read afresh, at bracket depth 0, so a region checks the same wherever it starts
+ * (lexer_check_range replays just the region).
  */
-void check_type_mismatch_python(Token *tokens, int count, Error *errors, int *err_count) {
-    // Pattern: identifier : type = value
-    for (int i = 0; i < count - 4; i++) {
-        if (strcmp(tokens[i].type, "IDENTIFIER") != 0) continue;
-        if (strcmp(tokens[i+1].value, ":") != 0) continue;
-        if (strcmp(tokens[i+2].type, "KEYWORD") != 0) continue;
-        if (strcmp(tokens[i+3].value, "=") != 0) continue;
+static int value_types_init(ValueTypes *types, int count) {
+    types->held = lexer_malloc(count + 1);
+    types->declared = lexer_malloc(count + 1);
+    types->region = lexer_malloc(sizeof(int) * (count + 1));
+    types->current_region = 0;
+    if (!name_table_init(&types->names, count) || !types->held || !types->declared || !types->region) return 0;
+    return 1;
+}
 
-        char *declared_type = tokens[i+2].value;
-        char *value_type = tokens[i+4].type;
+static void value_types_free(ValueTypes *types) {
+    name_table_free(&types->names);
+    lexer_free(types->held);
+    lexer_free(types->declared);
+    lexer_free(types->region);
+}
 
-        if (strcmp(declared_type, "int") == 0 && strcmp(value_type, "FLOAT_LITERAL") == 0) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Type mismatch - '%s' declared as int but assigned float value %s",
-                tokens[i].value, tokens[i+4].value);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
-            (*err_count)++;
-        }
-        else if ((strcmp(declared_type, "int") == 0 || strcmp(declared_type, "float") == 0) &&
-                  strcmp(value_type, "STRING_LITERAL") == 0) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Type mismatch - '%s' declared as %s but assigned string value",
-                tokens[i].value, declared_type);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
-            (*err_count)++;
-        }
-        else if (strcmp(declared_type, "str") == 0 &&
-                (strcmp(value_type, "INT_LITERAL") == 0 || strcmp(value_type, "FLOAT_LITERAL") == 0)) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Type mismatch - '%s' declared as str but assigned numeric value %s",
-                tokens[i].value, tokens[i+4].value);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
-            (*err_count)++;
-        }
+/* Interned name of tokens[index], with its recorded types cleared if they are stale */
+static int value_name(ValueTypes *types, const Token *tokens, int index) {
+    int known = types->names.name_count;
+    int name = intern_name(&types->names, tokens, index);
+    if (name >= known || types->region[name] != types->current_region) {
+        types->held[name] = VALUE_UNKNOWN;
+        types->declared[name] = VALUE_UNKNOWN;
+        types->region[name] = types->current_region;
     }
+    return name;
 }
 
-void check_type_mismatch_typescript(Token *tokens, int count, Error *errors, int *err_count) {
-    // Pattern: let/const/var identifier : type = value
-    for (int i = 0; i < count - 5; i++) {
-        int is_declaration = strcmp(tokens[i].value, "let") == 0 ||
-                            strcmp(tokens[i].value, "const") == 0 ||
-                            strcmp(tokens[i].value, "var") == 0;
-        if (!is_declaration) continue;
-        if (strcmp(tokens[i+1].type, "IDENTIFIER") != 0) continue;
-        if (strcmp(tokens[i+2].value, ":") != 0) continue;
-        if (strcmp(tokens[i+4].value, "=") != 0) continue;
-
-        char *declared_type = tokens[i+3].value;
-        char *value_type = tokens[i+5].type;
-
-        if (strcmp(declared_type, "number") == 0 && strcmp(value_type, "STRING_LITERAL") == 0) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Type mismatch - '%s' declared as number but assigned string value",
-                tokens[i+1].value);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
-            (*err_count)++;
-        }
-        else if (strcmp(declared_type, "string") == 0 &&
-                (strcmp(value_type, "INT_LITERAL") == 0 || strcmp(value_type, "FLOAT_LITERAL") == 0)) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Type mismatch - '%s' declared as string but assigned numeric value %s",
-                tokens[i+1].value, tokens[i+5].value);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
-            (*err_count)++;
-        }
-        else if (strcmp(declared_type, "boolean") == 0 &&
-                strcmp(tokens[i+5].value, "true") != 0 &&
-                strcmp(tokens[i+5].value, "false") != 0) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Type mismatch - '%s' declared as boolean but assigned non-boolean value",
-                tokens[i+1].value);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
-            (*err_count)++;
-        }
-    }
+/* Type of the value tokens[index]: a literal's, or what a variable last held */
+static ValueType value_type(ValueTypes *types, const Token *tokens, int index) {
+    const Token *token = &tokens[index];
+    if (strcmp(token->type, "INT_LITERAL") == 0) return VALUE_INT;
+    if (strcmp(token->type, "FLOAT_LITERAL") == 0) return VALUE_FLOAT;
+    if (strcmp(token->type, "STRING_LITERAL") == 0) return VALUE_STRING;
+    if (strcmp(token->type, "IDENTIFIER") == 0) return types->held[value_name(types, tokens, index)];
+    if (strcmp(token->value, "True") == 0 || strcmp(token->value, "False") == 0 ||
+        strcmp(token->value, "true") == 0 || strcmp(token->value, "false") == 0) return VALUE_BOOL;
+    return VALUE_UNKNOWN;
 }
 
-/**
- * ERROR 3: Undeclared Identifiers
- * Builds symbol table of declared variables, then checks for undeclared usage
- */
-void check_undeclared_identifier_python(Token *tokens, int count, Error *errors, int *err_count) {
-    Symbol symbol_table[MAX_SYMBOLS];
-    int symbol_count = 0;
-
-    // Pass 1: Collect declared variables (identifier = value)
-    for (int i = 0; i < count - 1; i++) {
-        if (strcmp(tokens[i].type, "IDENTIFIER") == 0 &&
-            strcmp(tokens[i+1].value, "=") == 0 &&
-            strcmp(tokens[i+1].value, "==") != 0) {
-            
-            int already_exists = 0;
-            for (int j = 0; j < symbol_count; j++) {
-                if (strcmp(symbol_table[j].name, tokens[i].value) == 0) { already_exists = 1; break; }
-            }
-            if (!already_exists && symbol_count < MAX_SYMBOLS) {
-                strcpy(symbol_table[symbol_count++].name, tokens[i].value);
-            }
-        }
-        // Add function params and for loop vars
-        if (strcmp(tokens[i].value, "def") == 0 || strcmp(tokens[i].value, "for") == 0) {
-            for (int j = i + 1; j < count && strcmp(tokens[j].value, ":") != 0; j++) {
-                if (strcmp(tokens[j].type, "IDENTIFIER") == 0) {
-                    int already_exists = 0;
-                    for (int k = 0; k < symbol_count; k++) {
-                        if (strcmp(symbol_table[k].name, tokens[j].value) == 0) { already_exists = 1; break; }
-                    }
-                    if (!already_exists && symbol_count < MAX_SYMBOLS) {
-                        strcpy(symbol_table[symbol_count++].name, tokens[j].value);
-                    }
-                }
-            }
-        }
+/* Whether a value of type value may not be stored where declared is annotated */
+static int value_conflicts(Language lang, ValueType declared, ValueType value) {
+    if (value == VALUE_UNKNOWN) return 0;
+    switch (declared) {
+        case VALUE_INT:    return value == VALUE_FLOAT || value == VALUE_STRING;
+        case VALUE_FLOAT:  return value == VALUE_STRING;
+        case VALUE_STRING: return value == VALUE_INT || value == VALUE_FLOAT;
+        case VALUE_BOOL:   return lang == LANG_TYPESCRIPT && value != VALUE_BOOL;
+        default:           return 0;
     }
+}
 
-    // Pass 2: Check for undeclared usage
-    for (int i = 0; i < count; i++) {
-        if (strcmp(tokens[i].type, "IDENTIFIER") != 0 || is_python_keyword(tokens[i].value)) continue;
-        if (i + 1 < count && strcmp(tokens[i+1].value, "=") == 0) continue; // Skip declarations
-        
-        // Skip built-in functions
-        if (strcmp(tokens[i].value, "print") == 0 || strcmp(tokens[i].value, "len") == 0 ||
-            strcmp(tokens[i].value, "range") == 0 || strcmp(tokens[i].value, "input") == 0 ||
-            strcmp(tokens[i].value, "open") == 0 || strcmp(tokens[i].value, "type") == 0) continue;
+/* How a type is spelled in a message: as an annotation, or as the kind of a value */
+static const char *value_type_name(Language lang, ValueType type, int is_annotation) {
+    switch (type) {
+        case VALUE_INT:    return lang == LANG_PYTHON ? "int" : "number";
+        case VALUE_FLOAT:  return lang == LANG_PYTHON ? "float" : "number";
+        case VALUE_STRING: return lang == LANG_PYTHON && is_annotation ? "str" : "string";
+        case VALUE_BOOL:   return lang == LANG_PYTHON ? "bool" : "boolean";
+        default:           return "unknown";
+    }
+}
 
-        int is_declared = 0;
-        for (int j = 0; j < symbol_count; j++) {
-            if (strcmp(symbol_table[j].name, tokens[i].value) == 0) { is_declared = 1; break; }
-        }
-        if (!is_declared) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Undeclared identifier - '%s' used but never declared", tokens[i].value);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_UNDECLARED_IDENTIFIER;
-            (*err_count)++;
-        }
+/* Whether tokens[index] starts a statement (bracket depth is checked by the caller) */
+static int starts_statement(Language lang, const Token *tokens, int index) {
+    if (index == 0 || tokens[index-1].line != tokens[index].line) return 1;
+    const Token *previous = &tokens[index-1];
+    if (strcmp(previous->value, ";") == 0) return 1;
+    if (lang == LANG_PYTHON) {
+        return strcmp(previous->type, "NEWLINE") == 0 || strcmp(previous->type, "INDENT") == 0 ||
+               strcmp(previous->type, "DEDENT") == 0;
     }
+    return strcmp(previous->value, "{") == 0 || strcmp(previous->value, "}") == 0;
 }
 
-void check_undeclared_identifier_typescript(Token *tokens, int count, Error *errors, int *err_count) {
-    Symbol symbol_table[MAX_SYMBOLS];
-    int symbol_count = 0;
-
-    // Pass 1: Collect declarations (let/const/var identifier)
-    for (int i = 0; i < count - 1; i++) {
-        if ((strcmp(tokens[i].value, "let") == 0 || strcmp(tokens[i].value, "const") == 0 ||
-             strcmp(tokens[i].value, "var") == 0) && strcmp(tokens[i+1].type, "IDENTIFIER") == 0) {
-            
-            int already_exists = 0;
-            for (int j = 0; j < symbol_count; j++) {
-                if (strcmp(symbol_table[j].name, tokens[i+1].value) == 0) { already_exists = 1; break; }
-            }
-            if (!already_exists && symbol_count < MAX_SYMBOLS) {
-                strcpy(symbol_table[symbol_count++].name, tokens[i+1].value);
-            }
-        }
-        // Add function parameters
-        if (strcmp(tokens[i].value, "function") == 0) {
-            for (int j = i + 1; j < count && strcmp(tokens[j].value, ")") != 0; j++) {
-                if (strcmp(tokens[j].type, "IDENTIFIER") == 0 &&
-                    (j == i + 1 || strcmp(tokens[j-1].value, "(") == 0 || strcmp(tokens[j-1].value, ",") == 0)) {
-                    int already_exists = 0;
-                    for (int k = 0; k < symbol_count; k++) {
-                        if (strcmp(symbol_table[k].name, tokens[j].value) == 0) { already_exists = 1; break; }
-                    }
-                    if (!already_exists && symbol_count < MAX_SYMBOLS) {
-                        strcpy(symbol_table[symbol_count++].name, tokens[j].value);
-                    }
-                }
+/* Whether the statement ends right after tokens[index] */
+static int ends_statement(Language lang, const Token *tokens, int count, int index) {
+    if (index + 1 >= count || tokens[index+1].line != tokens[index].line) return 1;
+    const Token *next = &tokens[index+1];
+    if (strcmp(next->value, ";") == 0) return 1;
+    return lang == LANG_PYTHON ? strcmp(next->type, "NEWLINE") == 0 : strcmp(next->value, "}") == 0;
+}
+
+/* Whether tokens[index] is an operator that rebinds the name before it (+=, ++, :=, ...) */
+static int is_update_operator(const Token *token) {
+    const char *op = token->value;
+    size_t length = strlen(op);
+    if (strcmp(token->type, "OPERATOR") != 0 && strcmp(op, ":=") != 0) return 0;
+    if (strcmp(op, "++") == 0 || strcmp(op, "--") == 0) return 1;
+    return length >= 2 && op[length-1] == '=' && strcmp(op, "==") != 0 && strcmp(op, "!=") != 0 &&
+           strcmp(op, "<=") != 0 && strcmp(op, ">=") != 0 && strcmp(op, "===") != 0 && strcmp(op, "!==") != 0;
+}
+
+/**
+ * Record the statement tokens[target] = tokens[value], where declared is the annotation
+ * on target (VALUE_UNKNOWN if none, or if it is not a declaration). Reports a variable
+ * whose recorded type conflicts with the annotation; what the direct pattern check
+ * already reports at a declaration (a literal, or any value for a TypeScript boolean)
+ * is left to it.
+ */
+static void record_assignment(Language lang, ValueTypes *types, const Token *tokens, int count, int target,
+                              int value, ValueType declared, Error *errors, int *err_count) {
+    int name = value_name(types, tokens, target);
+    int is_declaration = declared != VALUE_UNKNOWN;
+    if (is_declaration) types->declared[name] = declared;
+    declared = types->declared[name];
+
+    if (value >= count || !ends_statement(lang, tokens, count, value)) {
+        types->held[name] = declared;
+        return;
+    }
+    ValueType held = value_type(types, tokens, value);
+    int from_variable = strcmp(tokens[value].type, "IDENTIFIER") == 0;
+    int reported = is_declaration && (!from_variable || (lang == LANG_TYPESCRIPT && declared == VALUE_BOOL));
+    if (!reported && value_conflicts(lang, declared, held)) {
+        if (from_variable) {
+            snprintf(errors[*err_count].message, MAX_LENGTH,
+                "Type mismatch - '%s' declared as %s but %s '%s', which holds a %s value",
+                tokens[target].value, value_type_name(lang, declared, 1), is_declaration ? "assigned" : "reassigned",
+                tokens[value].value, value_type_name(lang, held, 0));
+        } else {
+            snprintf(errors[*err_count].message, MAX_LENGTH,
+                "Type mismatch - '%s' declared as %s but reassigned %s value %s",
+                tokens[target].value, value_type_name(lang, declared, 1), value_type_name(lang, held, 0),
+                tokens[value].value);
+        }
+        errors[*err_count].line_number = tokens[target].line;
+        errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
+        (*err_count)++;
+    }
+    types->held[name] = held != VALUE_UNKNOWN ? held : declared;
+}
+
+static ValueType python_annotation(const Token *token) {
+    if (strcmp(token->value, "int") == 0) return VALUE_INT;
+    if (strcmp(token->value, "float") == 0) return VALUE_FLOAT;
+    if (strcmp(token->value, "str") == 0) return VALUE_STRING;
+    if (strcmp(token->value, "bool") == 0) return VALUE_BOOL;
+    return VALUE_UNKNOWN;
+}
+
+static ValueType typescript_annotation(const Token *token) {
+    if (strcmp(token->value, "number") == 0) return VALUE_FLOAT;
+    if (strcmp(token->value, "string") == 0) return VALUE_STRING;
+    if (strcmp(token->value, "boolean") == 0) return VALUE_BOOL;
+    return VALUE_UNKNOWN;
+}
+
+/* Propagation for the Python statement starting at tokens[i], a name outside brackets */
+static void propagate_python(ValueTypes *types, Token *tokens, int count, int i, Error *errors, int *err_count) {
+    if (i + 1 >= count) return;
+    const char *next = tokens[i+1].value;
+    if (strcmp(next, ":") == 0 && i + 2 < count) {
+        ValueType declared = python_annotation(&tokens[i+2]);
+        int has_value = i + 3 < count && strcmp(tokens[i+3].value, "=") == 0;
+        if (declared == VALUE_UNKNOWN) {
+            int name = value_name(types, tokens, i);
+            types->held[name] = VALUE_UNKNOWN;
+            types->declared[name] = VALUE_UNKNOWN;
+        } else record_assignment(LANG_PYTHON, types, tokens, count, i, has_value ? i + 4 : count, declared, errors, err_count);
+    } else if (strcmp(next, "=") == 0) {
+        record_assignment(LANG_PYTHON, types, tokens, count, i, i + 2, VALUE_UNKNOWN, errors, err_count);
+    } else if (strcmp(next, ",") == 0) {
+        // Tuple target: x, y = ... forgets what each name held
+        for (int j = i; j < count && strcmp(tokens[j].type, "IDENTIFIER") == 0; j += 2) {
+            types->held[value_name(types, tokens, j)] = VALUE_UNKNOWN;
+            if (j + 1 >= count || strcmp(tokens[j+1].value, ",") != 0) break;
+        }
+    }
+}
+
+void check_type_mismatch_python(Token *tokens, int count, Error *errors, int *err_count) {
+    ValueTypes types;
+    int tracking = value_types_init(&types, count);
+    int depth = 0;      // Bracket depth; assignments inside brackets are keyword arguments
+
+    for (int i = 0; i < count; i++) {
+        if (*err_count >= MAX_ERRORS) break;
+        const char *value = tokens[i].value;
+        if (strcmp(value, "def") == 0 || strcmp(value, "class") == 0 || strcmp(value, "lambda") == 0) {
+            types.current_region++;
+            depth = 0;
+            continue;
+        }
+        if (strcmp(tokens[i].type, "DELIMITER") == 0) {
+            if (strchr("([{", value[0])) depth++;
+            else if (strchr(")]}", value[0]) && depth > 0) depth--;
+            continue;
+        }
+        if (strcmp(tokens[i].type, "IDENTIFIER") != 0) continue;
+
+        // Pattern: identifier : type = value
+        if (i < count - 4 && strcmp(tokens[i+1].value, ":") == 0 && strcmp(tokens[i+2].type, "KEYWORD") == 0 &&
+            strcmp(tokens[i+3].value, "=") == 0) {
+            char *declared_type = tokens[i+2].value;
+            char *value_type = tokens[i+4].type;
+
+            if (strcmp(declared_type, "int") == 0 && strcmp(value_type, "FLOAT_LITERAL") == 0) {
+                snprintf(errors[*err_count].message, MAX_LENGTH,
+                    "Type mismatch - '%s' declared as int but assigned float value %s",
+                    tokens[i].value, tokens[i+4].value);
+                errors[*err_count].line_number = tokens[i].line;
+                errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
+                (*err_count)++;
             }
+            else if ((strcmp(declared_type, "int") == 0 || strcmp(declared_type, "float") == 0) &&
+                      strcmp(value_type, "STRING_LITERAL") == 0) {
+                snprintf(errors[*err_count].message, MAX_LENGTH,
+                    "Type mismatch - '%s' declared as %s but assigned string value",
+                    tokens[i].value, declared_type);
+                errors[*err_count].line_number = tokens[i].line;
+                errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
+                (*err_count)++;
+            }
+            else if (strcmp(declared_type, "str") == 0 &&
+                    (strcmp(value_type, "INT_LITERAL") == 0 || strcmp(value_type, "FLOAT_LITERAL") == 0)) {
+                snprintf(errors[*err_count].message, MAX_LENGTH,
+                    "Type mismatch - '%s' declared as str but assigned numeric value %s",
+                    tokens[i].value, tokens[i+4].value);
+                errors[*err_count].line_number = tokens[i].line;
+                errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
+                (*err_count)++;
+            }
+            if (*err_count >= MAX_ERRORS) break;
         }
+
+        if (!tracking) continue;
+        int rebinds = (i > 0 && (strcmp(tokens[i-1].value, "for") == 0 || strcmp(tokens[i-1].value, "as") == 0)) ||
+                      (i + 1 < count && is_update_operator(&tokens[i+1]));
+        if (rebinds) types.held[value_name(&types, tokens, i)] = VALUE_UNKNOWN;
+        else if (depth == 0 && starts_statement(LANG_PYTHON, tokens, i)) propagate_python(&types, tokens, count, i, errors, err_count);
     }
+    value_types_free(&types);
+}
+
+void check_type_mismatch_typescript(Token *tokens, int count, Error *errors, int *err_count) {
+    ValueTypes types;
+    int tracking = value_types_init(&types, count);
+    int depth = 0;      // Parenthesis and bracket depth; braces are blocks
 
-    // Pass 2: Check usage
     for (int i = 0; i < count; i++) {
-        if (strcmp(tokens[i].type, "IDENTIFIER") != 0 || is_typescript_keyword(tokens[i].value)) continue;
-        
-        // Skip declarations
-        if (i > 0 && (strcmp(tokens[i-1].value, "let") == 0 || strcmp(tokens[i-1].value, "const") == 0 ||
-                      strcmp(tokens[i-1].value, "var") == 0 || strcmp(tokens[i-1].value, "function") == 0)) continue;
-        
-        // Skip common globals
-        if (strcmp(tokens[i].value, "console") == 0 || strcmp(tokens[i].value, "log") == 0 ||
-            strcmp(tokens[i].value, "document") == 0 || strcmp(tokens[i].value, "window") == 0 ||
-            strcmp(tokens[i].value, "Math") == 0 || strcmp(tokens[i].value, "Array") == 0) continue;
+        if (*err_count >= MAX_ERRORS) break;
+        const char *value = tokens[i].value;
+        if (strcmp(value, "function") == 0 || strcmp(value, "class") == 0 || strcmp(value, "=>") == 0) {
+            types.current_region++;
+            depth = 0;
+            continue;
+        }
+        if (strcmp(value, "(") == 0 || strcmp(value, "[") == 0) depth++;
+        else if ((strcmp(value, ")") == 0 || strcmp(value, "]") == 0) && depth > 0) depth--;
+
+        // Pattern: let/const/var identifier : type = value
+        int is_declaration = strcmp(value, "let") == 0 || strcmp(value, "const") == 0 || strcmp(value, "var") == 0;
+        if (is_declaration && i < count - 5 && strcmp(tokens[i+1].type, "IDENTIFIER") == 0 &&
+            strcmp(tokens[i+2].value, ":") == 0 && strcmp(tokens[i+4].value, "=") == 0) {
+            char *declared_type = tokens[i+3].value;
+            char *value_type = tokens[i+5].type;
 
-        int is_declared = 0;
-        for (int j = 0; j < symbol_count; j++) {
-            if (strcmp(symbol_table[j].name, tokens[i].value) == 0) { is_declared = 1; break; }
+            if (strcmp(declared_type, "number") == 0 && strcmp(value_type, "STRING_LITERAL") == 0) {
+                snprintf(errors[*err_count].message, MAX_LENGTH,
+                    "Type mismatch - '%s' declared as number but assigned string value",
+                    tokens[i+1].value);
+                errors[*err_count].line_number = tokens[i].line;
+                errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
+                (*err_count)++;
+            }
+            else if (strcmp(declared_type, "string") == 0 &&
+                    (strcmp(value_type, "INT_LITERAL") == 0 || strcmp(value_type, "FLOAT_LITERAL") == 0)) {
+                snprintf(errors[*err_count].message, MAX_LENGTH,
+                    "Type mismatch - '%s' declared as string but assigned numeric value %s",
+                    tokens[i+1].value, tokens[i+5].value);
+                errors[*err_count].line_number = tokens[i].line;
+                errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
+                (*err_count)++;
+            }
+            else if (strcmp(declared_type, "boolean") == 0 &&
+                    strcmp(tokens[i+5].value, "true") != 0 &&
+                    strcmp(tokens[i+5].value, "false") != 0) {
+                snprintf(errors[*err_count].message, MAX_LENGTH,
+                    "Type mismatch - '%s' declared as boolean but assigned non-boolean value",
+                    tokens[i+1].value);
+                errors[*err_count].line_number = tokens[i].line;
+                errors[*err_count].type = ERROR_TYPE_TYPE_MISMATCH;
+                (*err_count)++;
+            }
+            if (*err_count >= MAX_ERRORS) break;
         }
-        if (!is_declared) {
-            snprintf(errors[*err_count].message, MAX_LENGTH,
-                "Undeclared identifier - '%s' used but never declared", tokens[i].value);
-            errors[*err_count].line_number = tokens[i].line;
-            errors[*err_count].type = ERROR_TYPE_UNDECLARED_IDENTIFIER;
-            (*err_count)++;
+
+        if (!tracking) continue;
+        if (is_declaration && i + 1 < count && strcmp(tokens[i+1].type, "IDENTIFIER") == 0) {
+            int target = i + 1;
+            if (depth > 0) {
+                // for (let x of ...): bound by the loop
+                types.held[value_name(&types, tokens, target)] = VALUE_UNKNOWN;
+            } else {
+                types.declared[value_name(&types, tokens, target)] = VALUE_UNKNOWN;     // A new declaration of the name
+                int annotated = target + 2 < count && strcmp(tokens[target+1].value, ":") == 0;
+                int equals = annotated ? target + 3 : target + 1;
+                int has_value = equals < count && strcmp(tokens[equals].value, "=") == 0;
+                record_assignment(LANG_TYPESCRIPT, &types, tokens, count, target, has_value ? equals + 1 : count,
+                                  annotated ? typescript_annotation(&tokens[target+2]) : VALUE_UNKNOWN, errors, err_count);
+            }
+            i = target;
+            continue;
+        }
+        if (strcmp(tokens[i].type, "IDENTIFIER") != 0) continue;
+        if (i + 1 < count && is_update_operator(&tokens[i+1])) {
+            types.held[value_name(&types, tokens, i)] = VALUE_UNKNOWN;
+        } else if (depth == 0 && i + 1 < count && strcmp(tokens[i+1].value, "=") == 0 &&
+                   starts_statement(LANG_TYPESCRIPT, tokens, i)) {
+            record_assignment(LANG_TYPESCRIPT, &types, tokens, count, i, i + 2, VALUE_UNKNOWN, errors, err_count);
+        }
+    }
+    value_types_free(&types);
+}
+
+/**
+ * ERROR 3: Undeclared Identifiers
+ * Two linear passes over the tokens:
+ * 1. Outline: find the scopes (Python def/class bodies by indentation; TypeScript
+ *    braces and arrow bodies) and which tokens declare which names. Names are
+ *    interned, so the second pass works on small integers.
+ * 2. Resolve: walk the tokens again, entering and leaving the scopes, with two maps
+ *    from name to innermost binding. Leaving a scope pops the bindings it pushed, so
+ *    entering or leaving costs O(1) per declaration:
+ *    - declared: what the open scopes have declared so far, in order;
+ *    - complete: every declaration of the open scopes, wherever it is.
+ *    A use is fine if the name was declared before it in an open scope, or anywhere in
+ *    a scope outside the innermost function around it: that body only runs once the
+ *    outer scope has run.
+ */
+static int outline_init(ScopeOutline *outline, int count) {
+    memset(outline, 0, sizeof(ScopeOutline));
+    outline->name_of = lexer_malloc(sizeof(int) * (count + 1));
+    outline->scope_of = lexer_malloc(sizeof(int) * (count + 1));
+    outline->role = lexer_malloc(count + 1);
+    outline->scopes = lexer_malloc(sizeof(Scope) * (count + 1));   // At most one scope per token, plus the module
+    outline->declarations = lexer_malloc(sizeof(Declaration) * (count + 1));
+    outline->by_scope = lexer_malloc(sizeof(Declaration) * (count + 1));
+    outline->stack = lexer_malloc(sizeof(int) * (count + 2));
+    outline->group_open = lexer_malloc(sizeof(int) * (count + 1));
+    if (!outline->name_of || !outline->scope_of || !outline->role || !outline->scopes || !outline->declarations ||
+        !outline->by_scope || !outline->stack || !outline->group_open) {
+        return 0;
+    }
+    return name_table_init(&outline->names, count);
+}
+
+static void outline_free(ScopeOutline *outline) {
+    lexer_free(outline->name_of);
+    lexer_free(outline->scope_of);
+    lexer_free(outline->role);
+    lexer_free(outline->scopes);
+    lexer_free(outline->declarations);
+    lexer_free(outline->by_scope);
+    name_table_free(&outline->names);
+    lexer_free(outline->stack);
+    lexer_free(outline->group_open);
+}
+
+static int add_scope(ScopeOutline *outline, int parent, int is_function) {
+    Scope *scope = &outline->scopes[outline->scope_count];
+    scope->parent = parent;
+    scope->depth = parent < 0 ? 0 : outline->scopes[parent].depth + 1;
+    scope->function_depth = is_function ? scope->depth : parent < 0 ? 0 : outline->scopes[parent].function_depth;
+    scope->indent = 0;
+    scope->end_depth = -1;
+    scope->first_declaration = 0;
+    scope->declaration_count = 0;
+    return outline->scope_count++;
+}
+
+/* Record that tokens[token] declares its name in scope */
+static void add_declaration(ScopeOutline *outline, int scope, int token, int hoisted) {
+    outline->declarations[outline->declaration_count++] = (Declaration){ scope, outline->name_of[token], hoisted, token };
+    outline->scopes[scope].declaration_count++;
+    outline->role[token] = hoisted ? NAME_SKIP : NAME_DECLARE;
+}
+
+/* Counting sort of the declarations by scope */
+static void group_declarations(ScopeOutline *outline) {
+    int next = 0;
+    for (int s = 0; s < outline->scope_count; s++) {
+        outline->scopes[s].first_declaration = next;
+        next += outline->scopes[s].declaration_count;
+        outline->scopes[s].declaration_count = 0;
+    }
+    for (int d = 0; d < outline->declaration_count; d++) {
+        Scope *scope = &outline->scopes[outline->declarations[d].scope];
+        outline->by_scope[scope->first_declaration + scope->declaration_count++] = outline->declarations[d];
+    }
+}
+
+static int is_parameter_start(const Token *tokens, int index) {
+    return strcmp(tokens[index].value, "(") == 0 || strcmp(tokens[index].value, ",") == 0;
+}
+
+/* Python scopes: a def or class body is the block after its header, ended by the matching DEDENT */
+static void outline_python_scopes(ScopeOutline *outline, const Token *tokens, int count) {
+    int top = 0, brackets = 0, level = 0;
+    int header = -1, header_is_function = 0;    // Body scope of a def or class whose ':' is still to come
+    int for_depth = -1, lambda_depth = -1;      // Bracket depth of a 'for' before its 'in', a 'lambda' before its ':'
+    int import_part = 0;                        // 1 in the module of a 'from' statement, 2 after 'import'
+    int binding_part = 0;                       // 1 after 'global', 2 after 'nonlocal'
+    outline->stack[0] = add_scope(outline, -1, 0);
+
+    for (int i = 0; i < count; i++) {
+        const Token *token = &tokens[i];
+        const char *previous = i > 0 ? tokens[i-1].value : "";
+
+        outline->scope_of[i] = outline->stack[top];
+        outline->name_of[i] = -1;
+        outline->role[i] = NAME_NONE;
+
+        // Logical lines and blocks; a body on the header's own line ends with that line
+        if (strcmp(token->type, "NEWLINE") == 0 || strcmp(token->value, ";") == 0) import_part = binding_part = 0;
+        if (strcmp(token->type, "NEWLINE") == 0) {
+            header = for_depth = lambda_depth = -1;
+            brackets = 0;
+            if (i + 1 < count && strcmp(tokens[i+1].type, "INDENT") == 0) continue;
+        } else if (strcmp(token->type, "INDENT") == 0) {
+            level++;
+            continue;
+        } else if (strcmp(token->type, "DEDENT") == 0) {
+            if (level > 0) level--;
+        }
+        if (strcmp(token->type, "NEWLINE") == 0 || strcmp(token->type, "DEDENT") == 0) {
+            while (top > 0 && outline->scopes[outline->stack[top]].indent >= level) top--;
+            continue;
+        }
+
+        if (strcmp(token->type, "DELIMITER") == 0) {
+            char c = token->value[0];
+            if (c == '(' || c == '[' || c == '{') brackets++;
+            else if ((c == ')' || c == ']' || c == '}') && brackets > 0) brackets--;
+            else if (c == ':' && brackets == lambda_depth) lambda_depth = -1;
+            else if (c == ':' && brackets == 0 && header >= 0) {
+                outline->scopes[header].indent = level;
+                outline->stack[++top] = header;
+                header = -1;
+            }
+            continue;
+        }
+        if (strcmp(token->type, "KEYWORD") == 0) {
+            if ((strcmp(token->value, "def") == 0 || strcmp(token->value, "class") == 0) && brackets == 0) {
+                header_is_function = token->value[0] == 'd';
+                header = add_scope(outline, outline->stack[top], header_is_function);
+            }
+            else if (strcmp(token->value, "for") == 0) for_depth = brackets;
+            else if (strcmp(token->value, "in") == 0 && brackets == for_depth) for_depth = -1;
+            else if (strcmp(token->value, "lambda") == 0) lambda_depth = brackets;
+            else if (strcmp(token->value, "from") == 0 && brackets == 0 && starts_statement(LANG_PYTHON, tokens, i)) import_part = 1;
+            else if (strcmp(token->value, "import") == 0 && brackets == 0) import_part = 2;
+            else if (strcmp(token->value, "global") == 0 && starts_statement(LANG_PYTHON, tokens, i)) binding_part = 1;
+            else if (strcmp(token->value, "nonlocal") == 0 && starts_statement(LANG_PYTHON, tokens, i)) binding_part = 2;
+            continue;
+        }
+        if (strcmp(token->type, "IDENTIFIER") != 0) continue;
+
+        outline->name_of[i] = intern_name(&outline->names, tokens, i);
+        outline->role[i] = NAME_USE;
+        if (strcmp(previous, ".") == 0) {
+            outline->role[i] = NAME_SKIP;                                   // Attribute
+        } else if (import_part) {
+            // import a.b, from m import x as y: binds a and y; m and x name another module's contents
+            int renamed = i + 1 < count && strcmp(tokens[i+1].value, "as") == 0;
+            if (import_part == 2 && !renamed) add_declaration(outline, outline->stack[top], i, 0);
+            else outline->role[i] = NAME_SKIP;
+        } else if (binding_part) {
+            // global x binds x at module level, for every function; nonlocal x refers to an enclosing function's x
+            add_declaration(outline, binding_part == 1 ? outline->stack[0] : outline->stack[top], i, 1);
+        } else if (strcmp(previous, "def") == 0 || strcmp(previous, "class") == 0 || strcmp(previous, "as") == 0) {
+            add_declaration(outline, outline->stack[top], i, 0);            // Also with ... as f, except ... as e
+        } else if (header >= 0 && header_is_function && brackets == 1 &&
+                   (is_parameter_start(tokens, i - 1) ||
+                    (previous[0] == '*' && i > 1 && is_parameter_start(tokens, i - 2)))) {
+            add_declaration(outline, header, i, 1);                         // Parameter, *args, **kwargs
+        } else if (for_depth >= 0 || lambda_depth >= 0) {
+            add_declaration(outline, outline->stack[top], i, 0);            // Loop variable or lambda parameter
+        } else if (i + 1 < count && strcmp(tokens[i+1].value, "=") == 0) {
+            if (brackets == 0) add_declaration(outline, outline->stack[top], i, 0);
+            else outline->role[i] = NAME_SKIP;                              // Keyword argument
+        } else if (brackets == 0 && header < 0 && i + 1 < count && strcmp(tokens[i+1].value, ":") == 0 &&
+                   starts_statement(LANG_PYTHON, tokens, i)) {
+            add_declaration(outline, outline->stack[top], i, 0);            // Annotated: count: int = 3
+        }
+    }
+}
+
+/* Declare the identifiers that start the items of the bracket tokens[open .. close] as parameters of scope */
+static void declare_parameters(ScopeOutline *outline, const Token *tokens, int open, int close, int scope) {
+    int depth = 0;
+    for (int j = open + 1; j < close; j++) {
+        if (strcmp(tokens[j].type, "DELIMITER") == 0 && strchr("([{", tokens[j].value[0])) depth++;
+        else if (strcmp(tokens[j].type, "DELIMITER") == 0 && strchr(")]}", tokens[j].value[0])) depth--;
+        else if (depth == 0 && outline->role[j] == NAME_USE && is_parameter_start(tokens, j - 1)) {
+            add_declaration(outline, scope, j, 1);
+        }
+    }
+}
+
+/* Whether tokens[index] is a word of an import or export clause rather than a name */
+static int is_clause_word(const Token *tokens, int count, int index) {
+    const char *value = tokens[index].value;
+    const Token *next = index + 1 < count ? &tokens[index+1] : NULL;
+    if (strcmp(value, "as") == 0) return 1;
+    if (strcmp(value, "from") == 0) return next && strcmp(next->type, "STRING_LITERAL") == 0;
+    if (strcmp(value, "type") == 0) {
+        // import type { T }, { type T }; but import type from 'm' imports a default named type
+        return next && (next->value[0] == '{' || next->value[0] == '*' ||
+                        (strcmp(next->type, "IDENTIFIER") == 0 && strcmp(next->value, "from") != 0));
+    }
+    return 0;
+}
+
+/* TypeScript scopes: braces, and arrow function bodies with or without them */
+static void outline_typescript_scopes(ScopeOutline *outline, const Token *tokens, int count) {
+    int top = 0, brackets = 0;
+    int pending = -1, pending_depth = 0;        // Function scope whose '{' is still to come, and its bracket depth
+    int last_open = -1, last_close = -1;        // Most recent parenthesized group
+    int import_clause = 0;                      // In import ... from 'module', or an export list
+    int export_list = 0, reexport = 0;          // In export { .. }, and whether it is followed by from 'module'
+    outline->stack[0] = add_scope(outline, -1, 0);
+
+    for (int i = 0; i < count; i++) {
+        const Token *token = &tokens[i];
+        const char *previous = i > 0 ? tokens[i-1].value : "";
+        int is_delimiter = strcmp(token->type, "DELIMITER") == 0;
+
+        // import d, { a as b } from 'm' binds d and b for the whole module; export { a as c } uses a.
+        // Their braces are not blocks, and 'as', 'from' and 'type' are only words there. Any
+        // token that cannot be part of the clause ends it.
+        if (import_clause) {
+            const char *value = token->value;
+            int is_string = strcmp(token->type, "STRING_LITERAL") == 0;
+            int is_name = strcmp(token->type, "IDENTIFIER") == 0;
+            if (!is_name && !is_string && strcmp(value, "{") != 0 && strcmp(value, "}") != 0 &&
+                strcmp(value, ",") != 0 && strcmp(value, "*") != 0 && strcmp(value, "default") != 0) {
+                import_clause = export_list = 0;
+            } else {
+                outline->scope_of[i] = outline->stack[top];
+                outline->name_of[i] = -1;
+                outline->role[i] = NAME_NONE;
+                if (is_string) {
+                    import_clause = export_list = 0;
+                } else if (is_name) {
+                    const char *next = i + 1 < count ? tokens[i+1].value : "";
+                    outline->name_of[i] = intern_name(&outline->names, tokens, i);
+                    outline->role[i] = NAME_SKIP;
+                    if (is_clause_word(tokens, count, i) || strcmp(next, "as") == 0) continue;     // import { a as b }: a is not bound
+                    if (!export_list) add_declaration(outline, outline->stack[top], i, 1);
+                    else if (!reexport && strcmp(previous, "as") != 0) outline->role[i] = NAME_USE;
+                } else if (export_list && value[0] == '}') {
+                    export_list = 0;
+                    if (!reexport) import_clause = 0;
+                }
+                continue;
+            }
+        }
+        if (strcmp(token->value, "import") == 0 && strcmp(previous, ".") != 0 && i + 1 < count &&
+            strcmp(tokens[i+1].value, "(") != 0 && strcmp(tokens[i+1].value, ".") != 0) {
+            import_clause = 1;
+        } else if (strcmp(token->value, "export") == 0 && i + 1 < count &&
+                   (strcmp(tokens[i+1].value, "{") == 0 || strcmp(tokens[i+1].value, "*") == 0)) {
+            // Whether the list is a re-export: it holds no braces or ';', so the scans never overlap
+            import_clause = 1;
+            export_list = tokens[i+1].value[0] == '{';
+            reexport = !export_list;
+            for (int j = i + 2; export_list && j < count && !strchr("{;", tokens[j].value[0]); j++) {
+                if (tokens[j].value[0] == '}') {
+                    reexport = j + 1 < count && strcmp(tokens[j+1].value, "from") == 0;
+                    break;
+                }
+            }
+        }
+
+        // An arrow body without braces ends at a ',' or ';' or the bracket around it
+        if (is_delimiter && strchr(",;)]}", token->value[0])) {
+            while (top > 0 && outline->scopes[outline->stack[top]].end_depth == brackets) top--;
+        }
+        outline->scope_of[i] = outline->stack[top];
+        outline->name_of[i] = -1;
+        outline->role[i] = NAME_NONE;
+
+        if (is_delimiter) {
+            char c = token->value[0];
+            if (c == '{') {
+                int scope = pending;
+                if (scope < 0 && i - 1 == last_close) {
+                    // name(...) { is a method; catch (e) { a block with a parameter
+                    int is_method = last_open > 0 && strcmp(tokens[last_open-1].type, "IDENTIFIER") == 0;
+                    int is_catch = last_open > 0 && strcmp(tokens[last_open-1].value, "catch") == 0;
+                    if (is_method || is_catch) {
+                        scope = add_scope(outline, outline->stack[top], is_method);
+                        declare_parameters(outline, tokens, last_open, last_close, scope);
+                    }
+                    if (is_method && outline->role[last_open-1] == NAME_USE) outline->role[last_open-1] = NAME_SKIP;
+                }
+                if (scope < 0) scope = add_scope(outline, outline->stack[top], 0);
+                outline->group_open[brackets++] = i;
+                outline->stack[++top] = scope;
+                pending = -1;
+            } else if (c == '(' || c == '[') {
+                outline->group_open[brackets++] = i;
+            } else if (c == ')' || c == ']' || c == '}') {
+                if (brackets > 0 && c == ')') {
+                    last_open = outline->group_open[--brackets];
+                    last_close = i;
+                } else if (brackets > 0) {
+                    brackets--;
+                }
+                if (c == '}' && top > 0) top--;
+            } else if (c == ';' && brackets <= pending_depth) {
+                pending = -1;                                               // Declaration without a body
+            }
+            continue;
         }
+        if (strcmp(token->value, "=>") == 0) {
+            int scope = add_scope(outline, outline->stack[top], 1);
+            if (i - 1 == last_close) declare_parameters(outline, tokens, last_open, last_close, scope);
+            else if (i > 0 && outline->role[i-1] == NAME_USE) add_declaration(outline, scope, i - 1, 1);
+            if (i + 1 < count && strcmp(tokens[i+1].value, "{") == 0) {
+                pending = scope;
+                pending_depth = brackets;
+            } else {
+                outline->scopes[scope].end_depth = brackets;
+                outline->stack[++top] = scope;
+            }
+            continue;
+        }
+        if (strcmp(token->value, "function") == 0) {
+            pending = add_scope(outline, outline->stack[top], 1);
+            pending_depth = brackets;
+            continue;
+        }
+        if (strcmp(token->type, "IDENTIFIER") != 0) continue;
+
+        outline->name_of[i] = intern_name(&outline->names, tokens, i);
+        outline->role[i] = NAME_USE;
+        if (strcmp(previous, ".") == 0) {
+            outline->role[i] = NAME_SKIP;                                   // Property
+        } else if (strcmp(previous, "function") == 0) {
+            add_declaration(outline, outline->stack[top], i, 1);            // Function declarations are hoisted
+        } else if (pending >= 0 && brackets == pending_depth + 1 && is_parameter_start(tokens, i - 1)) {
+            add_declaration(outline, pending, i, 1);
+        } else if (strcmp(previous, "let") == 0 || strcmp(previous, "const") == 0 || strcmp(previous, "var") == 0 ||
+                   strcmp(previous, "class") == 0 || strcmp(previous, "interface") == 0 || strcmp(previous, "enum") == 0) {
+            add_declaration(outline, outline->stack[top], i, 0);
+        }
+    }
+}
+
+static void bind_name(ScopedNames *names, int name, int depth) {
+    names->bindings[names->binding_count] = (Binding){ name, depth, names->innermost[name] };
+    names->innermost[name] = names->binding_count++;
+}
+
+static void unbind_names(ScopedNames *names, int mark) {
+    while (names->binding_count > mark) {
+        const Binding *binding = &names->bindings[--names->binding_count];
+        names->innermost[binding->name] = binding->shadowed;
+    }
+}
+
+/* Enter scope: bind all its declarations in complete, and the hoisted ones in declared */
+static void enter_scope(const ScopeOutline *outline, int scope, ScopedNames *declared, ScopedNames *complete, int *marks) {
+    const Scope *entered = &outline->scopes[scope];
+    marks[2 * scope] = declared->binding_count;
+    marks[2 * scope + 1] = complete->binding_count;
+    for (int d = entered->first_declaration; d < entered->first_declaration + entered->declaration_count; d++) {
+        bind_name(complete, outline->by_scope[d].name, entered->depth);
+        if (outline->by_scope[d].hoisted) bind_name(declared, outline->by_scope[d].name, entered->depth);
+    }
+}
+
+/* Leave the open scopes that do not contain target and enter those down to it */
+static void move_to_scope(const ScopeOutline *outline, int *current, int target, ScopedNames *declared,
+                          ScopedNames *complete, int *marks, int *path) {
+    int path_length = 0;
+    while (target != *current) {
+        if (outline->scopes[*current].depth >= outline->scopes[target].depth) {
+            unbind_names(declared, marks[2 * *current]);
+            unbind_names(complete, marks[2 * *current + 1]);
+            *current = outline->scopes[*current].parent;
+        } else {
+            path[path_length++] = target;
+            target = outline->scopes[target].parent;
+        }
+    }
+    while (path_length > 0) {
+        *current = path[--path_length];
+        enter_scope(outline, *current, declared, complete, marks);
+    }
+}
+
+static int name_is_visible(const ScopeOutline *outline, const ScopedNames *declared, const ScopedNames *complete, int token) {
+    int name = outline->name_of[token];
+    if (declared->innermost[name] >= 0) return 1;
+    int binding = complete->innermost[name];
+    return binding >= 0 && complete->bindings[binding].depth < outline->scopes[outline->scope_of[token]].function_depth;
+}
+
+/* Built-in functions and common globals, never declared in the file */
+static int is_known_global(Language lang, const char *name) {
+    if (lang == LANG_PYTHON) {
+        return strcmp(name, "print") == 0 || strcmp(name, "len") == 0 || strcmp(name, "range") == 0 ||
+               strcmp(name, "input") == 0 || strcmp(name, "open") == 0 || strcmp(name, "type") == 0;
+    }
+    return strcmp(name, "console") == 0 || strcmp(name, "log") == 0 || strcmp(name, "document") == 0 ||
+           strcmp(name, "window") == 0 || strcmp(name, "Math") == 0 || strcmp(name, "Array") == 0;
+}
+
+static void report_undeclared(const Token *token, Error *errors, int *err_count) {
+    if (*err_count >= MAX_ERRORS) return;
+    snprintf(errors[*err_count].message, MAX_LENGTH,
+        "Undeclared identifier - '%s' used but never declared", token->value);
+    errors[*err_count].line_number = token->line;
+    errors[*err_count].type = ERROR_TYPE_UNDECLARED_IDENTIFIER;
+    (*err_count)++;
+}
+
+/**
+ * Second pass. In Python, a use inside brackets may come before its declaration
+ * ([x for x in items]), so uses that do not resolve there are tried again once
+ * the outermost bracket closes; a Python scope cannot change inside brackets.
+ */
+static void resolve_names(const ScopeOutline *outline, const Token *tokens, int count, Language lang,
+                          Error *errors, int *err_count) {
+    ScopedNames declared = { lexer_malloc(sizeof(int) * (outline->names.name_count + 1)),
+                             lexer_malloc(sizeof(Binding) * (outline->declaration_count + 1)), 0 };
+    ScopedNames complete = { lexer_malloc(sizeof(int) * (outline->names.name_count + 1)),
+                             lexer_malloc(sizeof(Binding) * (outline->declaration_count + 1)), 0 };
+    int *marks = lexer_malloc(sizeof(int) * 2 * outline->scope_count);
+    int *path = lexer_malloc(sizeof(int) * outline->scope_count);
+    int *deferred = lexer_malloc(sizeof(int) * (count + 1));
+
+    if (declared.innermost && declared.bindings && complete.innermost && complete.bindings && marks && path && deferred) {
+        memset(declared.innermost, 0xff, sizeof(int) * outline->names.name_count);
+        memset(complete.innermost, 0xff, sizeof(int) * outline->names.name_count);
+        int current = 0, brackets = 0, deferred_count = 0;
+        enter_scope(outline, 0, &declared, &complete, marks);
+
+        for (int i = 0; i < count && *err_count < MAX_ERRORS; i++) {
+            if (outline->scope_of[i] != current) {
+                move_to_scope(outline, &current, outline->scope_of[i], &declared, &complete, marks, path);
+            }
+            if (lang == LANG_PYTHON && strcmp(tokens[i].type, "DELIMITER") == 0) {
+                char c = tokens[i].value[0];
+                if (c == '(' || c == '[' || c == '{') brackets++;
+                else if ((c == ')' || c == ']' || c == '}') && brackets > 0 && --brackets == 0) {
+                    for (int d = 0; d < deferred_count; d++) {
+                        if (!name_is_visible(outline, &declared, &complete, deferred[d])) report_undeclared(&tokens[deferred[d]], errors, err_count);
+                    }
+                    deferred_count = 0;
+                }
+            }
+            if (outline->role[i] == NAME_DECLARE) {
+                bind_name(&declared, outline->name_of[i], outline->scopes[current].depth);
+            } else if (outline->role[i] == NAME_USE && !is_known_global(lang, tokens[i].value) &&
+                       !name_is_visible(outline, &declared, &complete, i)) {
+                if (brackets > 0) deferred[deferred_count++] = i;
+                else report_undeclared(&tokens[i], errors, err_count);
+            }
+        }
+        for (int d = 0; d < deferred_count; d++) {
+            if (!name_is_visible(outline, &declared, &complete, deferred[d])) report_undeclared(&tokens[deferred[d]], errors, err_count);
+        }
+    }
+    lexer_free(declared.innermost);
+    lexer_free(declared.bindings);
+    lexer_free(complete.innermost);
+    lexer_free(complete.bindings);
+    lexer_free(marks);
+    lexer_free(path);
+    lexer_free(deferred);
+}
+
+void check_undeclared_identifier_python(Token *tokens, int count, Error *errors, int *err_count) {
+    ScopeOutline outline;
+    if (outline_init(&outline, count)) {
+        outline_python_scopes(&outline, tokens, count);
+        group_declarations(&outline);
+        resolve_names(&outline, tokens, count, LANG_PYTHON, errors, err_count);
+    }
+    outline_free(&outline);
+}
+
+void check_undeclared_identifier_typescript(Token *tokens, int count, Error *errors, int *err_count) {
+    ScopeOutline outline;
+    if (outline_init(&outline, count)) {
+        outline_typescript_scopes(&outline, tokens, count);
+        group_declarations(&outline);
+        resolve_names(&outline, tokens, count, LANG_TYPESCRIPT, errors, err_count);
     }
+    outline_free(&outline);
 }
 
 /**
@@ -749,6 +2025,7 @@ void check_undeclared_identifier_typescript(Token *tokens, int count, Error *err
  */
 void check_invalid_operator_python(Token *tokens, int count, Error *errors, int *err_count) {
     for (int i = 0; i < count; i++) {
+        if (*err_count >= MAX_ERRORS) return;
         if (strcmp(tokens[i].type, "OPERATOR") != 0) continue;
 
         if (strcmp(tokens[i].value, "===") == 0) {
@@ -784,6 +2061,7 @@ void check_invalid_operator_python(Token *tokens, int count, Error *errors, int
 
 void check_invalid_operator_typescript(Token *tokens, int count, Error *errors, int *err_count) {
     for (int i = 0; i < count; i++) {
+        if (*err_count >= MAX_ERRORS) return;
         if (strcmp(tokens[i].type, "OPERATOR") != 0) continue;
 
         if (strcmp(tokens[i].value, "=<") == 0) {
@@ -796,258 +2074,1781 @@ void check_invalid_operator_typescript(Token *tokens, int count, Error *errors,
     }
 }
 
-/*===========================================================================
- * SECTION 7: OUTPUT FUNCTIONS
- *===========================================================================*/
+/**
+ * Running the checks
+ * The checks only read the token array, so on large inputs they run concurrently
+ * on a small pool of threads. Each check writes to a private buffer; the buffers
+ * are then concatenated in the fixed order below, which gives exactly the errors
+ * (and order) of running the checks one after another.
+ */
+static CheckFunction const PYTHON_CHECKS[CHECK_COUNT] = {
+    check_misspelled_keyword_python, check_type_mismatch_python,
+    check_undeclared_identifier_python, check_invalid_operator_python
+};
 
-/* Helper function to get color for token attribute type */
-const char* get_token_attribute_color(const char* attribute_type) {
-    if (strcmp(attribute_type, "KEYWORD") == 0) {
-        return COLOR_KEYWORD;
-    } else if (strcmp(attribute_type, "IDENTIFIER") == 0) {
-        return COLOR_IDENTIFIER;
-    } else if (strstr(attribute_type, "LITERAL") != NULL) {
-        return COLOR_LITERAL;
-    } else if (strcmp(attribute_type, "OPERATOR") == 0) {
-        return COLOR_OPERATOR;
-    } else if (strcmp(attribute_type, "DELIMITER") == 0) {
-        return COLOR_DELIMITER;
-    }
-    return COLOR_RESET;
-}
-
-/* Helper function to get color for error type */
-const char* get_error_type_color(ErrorType error_type) {
-    switch(error_type) {
-        case ERROR_TYPE_MISSPELLED_KEYWORD:
-            return COLOR_ERROR_MISSPELL;
-        case ERROR_TYPE_TYPE_MISMATCH:
-            return COLOR_ERROR_TYPE;
-        case ERROR_TYPE_UNDECLARED_IDENTIFIER:
-            return COLOR_ERROR_UNDECL;
-        case ERROR_TYPE_INVALID_OPERATOR:
-            return COLOR_ERROR_OPERATOR;
-        default:
-            return COLOR_RESET;
-    }
-}
-
-/* Helper function to get error type name */
-const char* get_error_type_name(ErrorType error_type) {
-    switch(error_type) {
-        case ERROR_TYPE_MISSPELLED_KEYWORD:
-            return "MISSPELLED KEYWORD";
-        case ERROR_TYPE_TYPE_MISMATCH:
-            return "TYPE MISMATCH";
-        case ERROR_TYPE_UNDECLARED_IDENTIFIER:
-            return "UNDECLARED IDENTIFIER";
-        case ERROR_TYPE_INVALID_OPERATOR:
-            return "INVALID OPERATOR";
-        default:
-            return "UNKNOWN ERROR";
-    }
-}
-
-/* Print all results to screen */
-void print_results(Token *tokens, int token_count, Comment *comments, int comment_count, Error *errors, int error_count) {
-    // Print tokens table with colors
-    printf("\n");
-    printf("%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s║                         TOKENIZATION TABLE                           ║%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s┌──────────────────────────────────┬───────────────────────────────────┐%s\n", COLOR_BOLD, COLOR_RESET);
-    printf("%s│%-34s│%-35s│%s\n", COLOR_BOLD, "            TOKEN", "           ATTRIBUTE", COLOR_RESET);
-    printf("%s├──────────────────────────────────┼───────────────────────────────────┤%s\n", COLOR_BOLD, COLOR_RESET);
-    
-    for (int i = 0; i < token_count; i++) {
-        const char* attribute_color = get_token_attribute_color(tokens[i].type);
-        printf("│ %-32s │ %s%-33s%s │\n", 
-               tokens[i].value, 
-               attribute_color, 
-               tokens[i].type, 
-               COLOR_RESET);
-    }
-    printf("%s└──────────────────────────────────┴───────────────────────────────────┘%s\n", COLOR_BOLD, COLOR_RESET);
-
-    // Print comments with colors
-    printf("\n");
-    printf("%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s║                         COMMENTS DETECTED                            ║%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("\n");
-    
-    if (comment_count == 0) {
-        printf("  %s✓ No comments found in the source code.%s\n", COLOR_LINE_NUMBER, COLOR_RESET);
-    } else {
-        for (int i = 0; i < comment_count; i++) {
-            if (comments[i].is_multiline) {
-                printf("%s[Lines %d-%d]%s %sMULTI-LINE%s\n%s%s%s\n", 
-                       COLOR_LINE_NUMBER,
-                       comments[i].start_line, 
-                       comments[i].end_line,
-                       COLOR_RESET,
-                       COLOR_BOLD,
-                       COLOR_RESET,
-                       COLOR_MULTI_LINE_COMMENT,
-                       comments[i].content,
-                       COLOR_RESET);
-            } else {
-                printf("%s[Line %d]%s %sSINGLE-LINE%s: %s%s%s\n", 
-                       COLOR_LINE_NUMBER,
-                       comments[i].start_line,
-                       COLOR_RESET,
-                       COLOR_BOLD,
-                       COLOR_RESET,
-                       COLOR_SINGLE_LINE_COMMENT,
-                       comments[i].content,
-                       COLOR_RESET);
-            }
-        }
-    }
-
-    // Print errors with colors and categorization
-    printf("\n");
-    printf("%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s║                         ERROR DETECTION                              ║%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("\n");
-    
-    if (error_count == 0) {
-        printf("  %s✓ No errors detected! Code is clean.%s\n", COLOR_SINGLE_LINE_COMMENT, COLOR_RESET);
-    } else {
-        for (int i = 0; i < error_count; i++) {
-            const char* error_color = get_error_type_color(errors[i].type);
-            const char* error_type_name = get_error_type_name(errors[i].type);
-            
-            printf("  %s[Line %d]%s %s[%s]%s\n", 
-                   COLOR_LINE_NUMBER,
-                   errors[i].line_number,
-                   COLOR_RESET,
-                   error_color,
-                   error_type_name,
-                   COLOR_RESET);
-            printf("    %s↳ %s%s\n\n", 
-                   COLOR_LINE_NUMBER,
-                   errors[i].message,
-                   COLOR_RESET);
+static CheckFunction const TYPESCRIPT_CHECKS[CHECK_COUNT] = {
+    check_misspelled_keyword_typescript, check_type_mismatch_typescript,
+    check_undeclared_identifier_typescript, check_invalid_operator_typescript
+};
+
+/* Concatenate per-check error buffers in check order, stopping at max_errors */
+void merge_check_errors(Error *check_errors[CHECK_COUNT], int check_error_counts[CHECK_COUNT],
+                        Error *errors, int *err_count, int max_errors) {
+    for (int c = 0; c < CHECK_COUNT; c++) {
+        for (int e = 0; e < check_error_counts[c] && *err_count < max_errors; e++) {
+            errors[(*err_count)++] = check_errors[c][e];
         }
     }
 }
 
-/*===========================================================================
- * SECTION 8: MAIN FUNCTION
- *===========================================================================*/
+typedef struct {
+    CheckFunction const *checks;
+    Token *tokens;
+    int token_count;
+    atomic_int next_check;              // Next check for an idle worker to pick up
+    Error **check_errors;
+    int *check_error_counts;
+    LexerContext *context;              // Whose times, hook and probes cover each check, or NULL
+    MemoryAccount *memory;              // File account of the thread running the checks
+} CheckJobs;
+
+static void phase_boundary(LexerContext *context, LexerPhase phase, int is_end, int tokens);
+
+static void *check_worker(void *arg) {
+    CheckJobs *jobs = arg;
+    file_memory = jobs->memory;
+    int c;
+    while ((c = atomic_fetch_add(&jobs->next_check, 1)) < CHECK_COUNT) {
+        if (jobs->context) phase_boundary(jobs->context, LEXER_PHASE_CHECK_FIRST + c, 0, jobs->token_count);
+        jobs->checks[c](jobs->tokens, jobs->token_count, jobs->check_errors[c], &jobs->check_error_counts[c]);
+        if (jobs->context) phase_boundary(jobs->context, LEXER_PHASE_CHECK_FIRST + c, 1, jobs->token_count);
+    }
+    return NULL;
+}
 
-/* Validate and detect language from file extension */
-int validate_and_detect_language(const char *filename, Language *lang) {
-    const char *ext = strrchr(filename, '.');
-    
-    if (!ext || ext == filename) {
-        printf("%sError:%s File has no extension.\n", COLOR_BOLD, COLOR_RESET);
-        printf("Please provide a Python (.py) or TypeScript (.ts, .js) file.\n");
-        return 0;
+/* run_checks, marking each check as a phase of context (if not NULL) */
+static void run_checks_for(LexerContext *context, Token *tokens, int token_count, Language lang,
+                           Error *check_errors[CHECK_COUNT], int check_error_counts[CHECK_COUNT], int thread_count) {
+    CheckJobs jobs = { lang == LANG_PYTHON ? PYTHON_CHECKS : TYPESCRIPT_CHECKS, tokens, token_count, 0,
+                       check_errors, check_error_counts, context, file_memory };
+    for (int c = 0; c < CHECK_COUNT; c++) check_error_counts[c] = 0;
+
+    if (thread_count < 2 || token_count < PARALLEL_CHECK_MIN_TOKENS) {
+        check_worker(&jobs);
+        return;
     }
-    
-    if (strcmp(ext, ".py") == 0) {
-        *lang = LANG_PYTHON;
-        return 1;
-    } else if (strcmp(ext, ".ts") == 0 || strcmp(ext, ".js") == 0) {
-        *lang = LANG_TYPESCRIPT;
-        return 1;
-    } else {
-        printf("%sError:%s Unsupported file extension '%s'.\n", COLOR_BOLD, COLOR_RESET, ext);
-        printf("Please provide a Python (.py) or TypeScript (.ts, .js) file.\n");
-        return 0;
+
+    // The calling thread is one of the workers
+    int worker_count = thread_count < CHECK_COUNT ? thread_count : CHECK_COUNT;
+    pthread_t workers[CHECK_COUNT];
+    int started[CHECK_COUNT] = {0};
+    for (int w = 1; w < worker_count; w++) {
+        started[w] = pthread_create(&workers[w], NULL, check_worker, &jobs) == 0;
+    }
+    check_worker(&jobs);
+    for (int w = 1; w < worker_count; w++) {
+        if (started[w]) pthread_join(workers[w], NULL);
     }
 }
 
-int main(int argc, char *argv[]) {
-    // Validate command line arguments
-    if (argc < 2) {
-        printf("\n%sError:%s No input file provided.\n", COLOR_BOLD, COLOR_RESET);
-        printf("%sUsage:%s %s <source_file.py|source_file.ts>\n\n", COLOR_BOLD, COLOR_RESET, argv[0]);
-        printf("Examples:\n");
-        printf("  %s script.py    %s# Analyze Python file\n", argv[0], COLOR_LINE_NUMBER);
-        printf("  %s script.ts    %s# Analyze TypeScript file\n", argv[0], COLOR_LINE_NUMBER);
-        printf("  %s script.js    %s# Analyze JavaScript file\n", argv[0], COLOR_LINE_NUMBER);
-        printf("%s\n", COLOR_RESET);
-        return 1;
-    }
+void run_checks(Token *tokens, int token_count, Language lang, Error *check_errors[CHECK_COUNT],
+                int check_error_counts[CHECK_COUNT], int thread_count) {
+    run_checks_for(NULL, tokens, token_count, lang, check_errors, check_error_counts, thread_count);
+}
 
-    if (argc > 2) {
-        printf("\n%sError:%s Too many arguments provided.\n", COLOR_BOLD, COLOR_RESET);
-        printf("Please provide only one source file at a time.\n");
-        printf("%sUsage:%s %s <source_file.py|source_file.ts>\n\n", COLOR_BOLD, COLOR_RESET, argv[0]);
-        return 1;
+/*===========================================================================
+ * SECTION 7: CONTEXT API
+ * Scratch memory is kept in the context and reused across calls
+ *===========================================================================*/
+
+struct LexerContext {
+    int thread_count;
+    char *code_without_comments;        // Grown as needed
+    int code_capacity;
+    Error *check_errors[CHECK_COUNT];   // MAX_ERRORS each, allocated on first use
+    LexerTimes times;                   // Of the last analysis
+    LexerPhaseHook hook;                // Called around each phase, or NULL
+    void *hook_data;
+    const char *source_name;            // For probes, or NULL
+    int source_length;                  // Of the analysis in progress
+    double phase_start[LEXER_PHASE_COUNT];
+};
+
+static const char *const PHASE_NAMES[LEXER_PHASE_COUNT] = {
+    [LEXER_PHASE_COMMENTS] = "comments",
+    [LEXER_PHASE_TOKENIZE] = "tokenize",
+    [LEXER_PHASE_CHECKS] = "checks",
+    [LEXER_PHASE_CHECK_FIRST + ERROR_TYPE_MISSPELLED_KEYWORD] = "misspelled keyword",
+    [LEXER_PHASE_CHECK_FIRST + ERROR_TYPE_TYPE_MISMATCH] = "type mismatch",
+    [LEXER_PHASE_CHECK_FIRST + ERROR_TYPE_UNDECLARED_IDENTIFIER] = "undeclared identifier",
+    [LEXER_PHASE_CHECK_FIRST + ERROR_TYPE_INVALID_OPERATOR] = "invalid operator",
+};
+
+const char *lexer_phase_name(LexerPhase phase) {
+    return phase >= 0 && phase < LEXER_PHASE_COUNT ? PHASE_NAMES[phase] : "unknown";
+}
+
+LexerContext *lexer_create(void) {
+    LexerContext *context = lexer_malloc(sizeof(LexerContext));
+    if (!context) return NULL;
+    memset(context, 0, sizeof(LexerContext));
+    context->thread_count = 1;
+    return context;
+}
+
+void lexer_set_threads(LexerContext *context, int thread_count) {
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > MAX_THREADS) thread_count = MAX_THREADS;
+    context->thread_count = thread_count;
+}
+
+void lexer_set_phase_hook(LexerContext *context, LexerPhaseHook hook, void *data) {
+    context->hook = hook;
+    context->hook_data = data;
+}
+
+void lexer_get_phase_hook(const LexerContext *context, LexerPhaseHook *hook, void **data) {
+    *hook = context->hook;
+    *data = context->hook_data;
+}
+
+void lexer_set_source_name(LexerContext *context, const char *name) {
+    context->source_name = name;
+}
+
+/* Start or end a phase: time it, call the hook and fire the probe. Checks may end concurrently,
+   but each only touches its own slots. */
+static void phase_boundary(LexerContext *context, LexerPhase phase, int is_end, int tokens) {
+    const char *name = context->source_name ? context->source_name : "";
+    if (!is_end) {
+        LEXER_PROBE(phase_start, name, lexer_phase_name(phase), context->source_length);
+        if (context->hook) context->hook(context->hook_data, phase, 0);
+        context->phase_start[phase] = monotonic_seconds();
+        return;
     }
 
-    // Validate file extension and detect language
-    Language detected_language;
-    if (!validate_and_detect_language(argv[1], &detected_language)) {
-        return 1;
+    double seconds = monotonic_seconds() - context->phase_start[phase];
+    LexerTimes *times = &context->times;
+    switch (phase) {
+        case LEXER_PHASE_COMMENTS:  times->comments = seconds; break;
+        case LEXER_PHASE_TOKENIZE:  times->tokenize = seconds; break;
+        case LEXER_PHASE_CHECKS:    times->checks = seconds; break;
+        default:                    times->check[phase - LEXER_PHASE_CHECK_FIRST] = seconds; break;
     }
+    if (context->hook) context->hook(context->hook_data, phase, 1);
+    LEXER_PROBE(phase_end, name, lexer_phase_name(phase), context->source_length, tokens);
+}
 
-    // Read source file
-    char *source_code = read_file(argv[1]);
-    if (!source_code) return 1;
-
-    const char* language_name = (detected_language == LANG_PYTHON) ? "Python" : "TypeScript";
-    
-    printf("\n%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("%s              LEXICAL ANALYZER - %s MODE                           %s\n", 
-           COLOR_HEADER, 
-           detected_language == LANG_PYTHON ? "PYTHON    " : "TYPESCRIPT", 
-           COLOR_RESET);
-    printf("%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
-    printf("\n%sAnalyzing file:%s %s\n", COLOR_BOLD, COLOR_RESET, argv[1]);
-    printf("%sLanguage detected:%s %s\n", COLOR_BOLD, COLOR_RESET, language_name);
-
-    // Allocate memory for analysis
-    Token *token_array = malloc(sizeof(Token) * MAX_TOKENS);
-    Comment *comment_array = malloc(sizeof(Comment) * MAX_COMMENTS);
-    Error *error_array = malloc(sizeof(Error) * MAX_ERRORS);
-    char *code_without_comments = malloc(strlen(source_code) + 1);
-    
-    int total_tokens = 0, total_comments = 0, total_errors = 0;
+int lexer_analyze(LexerContext *context, Language lang, const char *source_code, int source_length, LexerResult *result) {
+    result->token_count = result->comment_count = result->error_count = 0;
 
-    // Extract comments
-    if (detected_language == LANG_PYTHON) {
-        extract_comments_python(source_code, comment_array, &total_comments, code_without_comments);
-    } else {
-        extract_comments_typescript(source_code, comment_array, &total_comments, code_without_comments);
+    if (context->code_capacity < source_length + 1) {
+        char *grown = lexer_realloc(context->code_without_comments, source_length + 1);
+        if (!grown) return 0;
+        context->code_without_comments = grown;
+        context->code_capacity = source_length + 1;
+    }
+    if (!context->check_errors[0]) {
+        Error *buffer = lexer_malloc(sizeof(Error) * MAX_ERRORS * CHECK_COUNT);
+        if (!buffer) return 0;
+        for (int c = 0; c < CHECK_COUNT; c++) context->check_errors[c] = buffer + c * MAX_ERRORS;
     }
 
-    // Tokenize
-    if (detected_language == LANG_PYTHON) {
-        tokenize_python(code_without_comments, token_array, &total_tokens);
+    // Extract comments
+    context->source_length = source_length;
+    LEXER_PROBE(file_start, context->source_name ? context->source_name : "", source_length);
+    phase_boundary(context, LEXER_PHASE_COMMENTS, 0, 0);
+    CommentScanner scanner = { 0, 0, 1, 0, 0, result->comment_capacity };
+    if (lang == LANG_PYTHON) {
+        scan_comments_python(&scanner, source_code, source_length, 1, result->comments, context->code_without_comments);
     } else {
-        tokenize_typescript(code_without_comments, token_array, &total_tokens);
+        scan_comments_typescript(&scanner, source_code, source_length, 1, result->comments, context->code_without_comments);
+    }
+    result->comment_count = scanner.comment_count < result->comment_capacity ? scanner.comment_count : result->comment_capacity;
+    phase_boundary(context, LEXER_PHASE_COMMENTS, 1, 0);
+
+    // Tokenize (large inputs are split across threads)
+    phase_boundary(context, LEXER_PHASE_TOKENIZE, 0, 0);
+    tokenize_parallel(context->code_without_comments, scanner.clean_index, lang, result->tokens, result->token_capacity,
+                      &result->token_count, context->thread_count);
+    phase_boundary(context, LEXER_PHASE_TOKENIZE, 1, result->token_count);
+
+    // Perform error detection (the checks run concurrently on large inputs)
+    phase_boundary(context, LEXER_PHASE_CHECKS, 0, result->token_count);
+    int check_error_counts[CHECK_COUNT];
+    run_checks_for(context, result->tokens, result->token_count, lang, context->check_errors, check_error_counts,
+                   context->thread_count);
+    merge_check_errors(context->check_errors, check_error_counts, result->errors, &result->error_count, result->error_capacity);
+    phase_boundary(context, LEXER_PHASE_CHECKS, 1, result->token_count);
+
+    for (int e = 0; e < result->error_count; e++) {
+        LEXER_PROBE(diagnostic, context->source_name ? context->source_name : "", result->errors[e].line_number,
+                    (int)result->errors[e].type, result->errors[e].message);
     }
+    LEXER_PROBE(file_end, context->source_name ? context->source_name : "", source_length, result->token_count,
+                result->error_count);
+    return 1;
+}
 
-    // Perform error detection
-    if (detected_language == LANG_PYTHON) {
-        check_misspelled_keyword_python(token_array, total_tokens, error_array, &total_errors);
-        check_type_mismatch_python(token_array, total_tokens, error_array, &total_errors);
-        check_undeclared_identifier_python(token_array, total_tokens, error_array, &total_errors);
-        check_invalid_operator_python(token_array, total_tokens, error_array, &total_errors);
-    } else {
-        check_misspelled_keyword_typescript(token_array, total_tokens, error_array, &total_errors);
-        check_type_mismatch_typescript(token_array, total_tokens, error_array, &total_errors);
-        check_undeclared_identifier_typescript(token_array, total_tokens, error_array, &total_errors);
-        check_invalid_operator_typescript(token_array, total_tokens, error_array, &total_errors);
+/* Make room for capacity tokens in result->tokens; returns 0 if out of memory */
+static int reserve_tokens(LexerResult *result, int capacity) {
+    if (result->tokens && result->token_capacity >= capacity) return 1;
+    Token *grown = lexer_realloc(result->tokens, sizeof(Token) * capacity);
+    if (!grown) return 0;
+    result->tokens = grown;
+    result->token_capacity = capacity;
+    return 1;
+}
+
+int lexer_analyze_all(LexerContext *context, Language lang, const char *source_code, int source_length,
+                      LexerResult *result) {
+    // The iterator's count is exact unless a string literal holds a '#' or '//', hence the headroom
+    LexerIterator iter;
+    TokenView token;
+    int estimate = 1024;
+    lexer_iter_init(&iter, lang, source_code, source_length);
+    while (lexer_iter_next(&iter, &token)) estimate++;
+    if (!reserve_tokens(result, estimate + estimate / 8)) return 0;
+
+    if (!lexer_analyze(context, lang, source_code, source_length, result)) return 0;
+    while (result->token_count == result->token_capacity) {
+        if (!reserve_tokens(result, 2 * result->token_capacity)) return 0;
+        if (!lexer_analyze(context, lang, source_code, source_length, result)) return 0;
     }
+    return 1;
+}
+
+const LexerTimes *lexer_last_times(const LexerContext *context) {
+    return &context->times;
+}
 
-    // Display formatted results
-    print_results(token_array, total_tokens, comment_array, total_comments, error_array, total_errors);
+void lexer_reset(LexerContext *context) {
+    lexer_free(context->code_without_comments);
+    lexer_free(context->check_errors[0]);
+    memset(context, 0, sizeof(LexerContext));
+    context->thread_count = 1;
+}
 
-    // Cleanup memory
-    free(source_code);
-    free(token_array);
-    free(comment_array);
-    free(error_array);
-    free(code_without_comments);
+void lexer_destroy(LexerContext *context) {
+    if (!context) return;
+    lexer_reset(context);
+    lexer_free(context);
+}
 
-    return 0;
+/*===========================================================================
+ * SECTION 8: TOKEN ITERATOR
+ * Pull-style lexing straight from the source buffer: no token array, no copies,
+ * comments skipped on the fly. Callers that only need the first few tokens
+ * (shebang, imports, language sniffing) stop whenever they like.
+ *===========================================================================*/
+
+void lexer_iter_init(LexerIterator *iter, Language lang, const char *source_code, int source_length) {
+    iter->source_code = source_code;
+    iter->source_length = source_length;
+    iter->index = 0;
+    iter->line = 1;
+    iter->lang = lang;
+    iter->unclosed_from[0] = iter->unclosed_from[1] = INT_MAX;
+    iter->layout_tokens = lang == LANG_PYTHON;
+    memset(&iter->layout, 0, sizeof(iter->layout));
+}
+
+/* Emit a layout token (length 0) at iter->index */
+static int iter_layout_token(LexerIterator *iter, TokenView *token, int kind) {
+    token->kind = kind;
+    token->start = iter->index;
+    token->length = 0;
+    token->line = iter->line;
+    return 1;
 }
 
+/* Skip the comment starting at iter->index, if any; returns 1 if one was skipped */
+static int iter_skip_comment(LexerIterator *iter) {
+    const char *source_code = iter->source_code;
+    int length = iter->source_length, index = iter->index;
+
+    if (iter->lang == LANG_PYTHON) {
+        if (source_code[index] == '#') {
+            while (index < length && source_code[index] != '\n') index++;
+        } else if (index + 2 < length && (source_code[index] == '\'' || source_code[index] == '"') &&
+                   source_code[index+1] == source_code[index] && source_code[index+2] == source_code[index]) {
+            int kind = source_code[index] == '"';
+            int close_index = index + 3 >= iter->unclosed_from[kind] ? -1 :
+                              find_closing(source_code, index + 3, length, kind ? "\"\"\"" : "'''", 3);
+            if (close_index < 0) {
+                if (index + 3 < iter->unclosed_from[kind]) iter->unclosed_from[kind] = index + 3;
+                while (index < length && source_code[index] != '\n') index++;
+            } else {
+                for (; index < close_index + 3; index++) {
+                    if (source_code[index] == '\n') iter->line++;
+                }
+            }
+        } else {
+            return 0;
+        }
+    } else {
+        if (index + 1 < length && source_code[index] == '/' && source_code[index+1] == '/') {
+            while (index < length && source_code[index] != '\n') index++;
+        } else if (index + 1 < length && source_code[index] == '/' && source_code[index+1] == '*') {
+            int close_index = index + 2 >= iter->unclosed_from[0] ? -1 : find_closing(source_code, index + 2, length, "*/", 2);
+            if (close_index < 0) {
+                if (index + 2 < iter->unclosed_from[0]) iter->unclosed_from[0] = index + 2;
+                while (index < length && source_code[index] != '\n') index++;
+            } else {
+                for (; index < close_index + 2; index++) {
+                    if (source_code[index] == '\n') iter->line++;
+                }
+            }
+        } else {
+            return 0;
+        }
+    }
+    iter->index = index;
+    return 1;
+}
 
+int lexer_iter_next(LexerIterator *iter, TokenView *token) {
+    const char *source_code = iter->source_code;
+    int length = iter->source_length;
+    int is_python = iter->lang == LANG_PYTHON;
+    int layout_tokens = is_python && iter->layout_tokens;
+    PythonLayout *layout = &iter->layout;
+
+    for (;;) {
+        // Skip whitespace and comments; a line break outside brackets ends the logical line
+        while (iter->index < length) {
+            int join = is_python ? line_join_length(source_code, iter->index, length) : 0;
+            if (join) {
+                iter->index += join;
+                iter->line++;
+                continue;
+            }
+            if (!isspace((unsigned char)source_code[iter->index])) break;
+            if (source_code[iter->index] == '\n') {
+                if (layout_tokens && layout->brackets == 0 && layout->line_tokens > 0) {
+                    layout->line_tokens = 0;
+                    iter_layout_token(iter, token, TOKEN_NEWLINE);
+                    iter->index++;
+                    iter->line++;
+                    return 1;
+                }
+                iter->line++;
+            }
+            iter->index++;
+        }
+        if (iter->index >= length) {
+            int kind = layout_tokens ? layout_at_end(layout) : -1;
+            return kind >= 0 ? iter_layout_token(iter, token, kind) : 0;
+        }
+        if (iter_skip_comment(iter)) continue;
+
+        // Indentation of a logical line's first token
+        if (layout_tokens && layout->brackets == 0 && layout->line_tokens == 0) {
+            int kind = layout_before_line(layout, indent_width(source_code, iter->index));
+            if (kind >= 0) return iter_layout_token(iter, token, kind);
+        }
+
+        int start = iter->index, index = start;
+        char c = source_code[index];
+        token->line = iter->line;
+
+        // Identifier or Keyword (TypeScript allows $)
+        if (isalpha((unsigned char)c) || c == '_' || (!is_python && c == '$')) {
+            while (index < length && (isalnum((unsigned char)source_code[index]) || source_code[index] == '_' ||
+                                      (!is_python && source_code[index] == '$'))) index++;
+            char word[16];
+            int word_length = index - start;
+            token->kind = TOKEN_IDENTIFIER;
+            if (word_length < (int)sizeof(word)) {     // Longer words are never keywords
+                memcpy(word, source_code + start, word_length);
+                word[word_length] = '\0';
+                if (is_python ? is_python_keyword(word) : is_typescript_keyword(word)) token->kind = TOKEN_KEYWORD;
+            }
+        }
+        // Number (integer or float)
+        else if (isdigit((unsigned char)c)) {
+            token->kind = TOKEN_INT_LITERAL;
+            while (index < length && (isdigit((unsigned char)source_code[index]) || source_code[index] == '.')) {
+                if (source_code[index] == '.') token->kind = TOKEN_FLOAT_LITERAL;
+                index++;
+            }
+        }
+        // String literal (TypeScript template strings too)
+        else if (c == '"' || c == '\'' || (!is_python && c == '`')) {
+            index++;
+            while (index < length && source_code[index] != c) {
+                if (source_code[index] == '\\' && index + 1 < length) index++;
+                if (source_code[index] == '\n') iter->line++;
+                index++;
+            }
+            if (index < length) index++;
+            token->kind = TOKEN_STRING_LITERAL;
+        }
+        // Operator (up to three characters)
+        else if (is_operator_char(c)) {
+            while (index < length && is_operator_char(source_code[index]) && index - start < 3) index++;
+            token->kind = TOKEN_OPERATOR;
+        }
+        // Delimiter
+        else if (is_delimiter_char(c)) {
+            index++;
+            token->kind = TOKEN_DELIMITER;
+        }
+        else {
+            iter->index++; // Skip unknown characters
+            continue;
+        }
+
+        token->start = start;
+        token->length = index - start;
+        iter->index = index;
+        if (layout_tokens) layout_count_token(layout, token->kind == TOKEN_DELIMITER ? c : 0);
+        return 1;
+    }
+}
+
+/* Token type name as used in Token.type */
+const char *token_kind_name(TokenKind kind) {
+    switch (kind) {
+        case TOKEN_KEYWORD:         return "KEYWORD";
+        case TOKEN_IDENTIFIER:      return "IDENTIFIER";
+        case TOKEN_INT_LITERAL:     return "INT_LITERAL";
+        case TOKEN_FLOAT_LITERAL:   return "FLOAT_LITERAL";
+        case TOKEN_STRING_LITERAL:  return "STRING_LITERAL";
+        case TOKEN_OPERATOR:        return "OPERATOR";
+        case TOKEN_DELIMITER:       return "DELIMITER";
+        case TOKEN_NEWLINE:         return "NEWLINE";
+        case TOKEN_INDENT:          return "INDENT";
+        case TOKEN_DEDENT:          return "DEDENT";
+        default:                    return "UNKNOWN";
+    }
+}
+
+/*===========================================================================
+ * SECTION 9: INCREMENTAL RE-LEXING
+ * Updates a TokenStream after an edit without re-lexing the whole file.
+ * Lexing state between tokens is (position, line), plus one thing that depends
+ * on text further on: whether a multi-line comment opener has a closer anywhere
+ * after it (if not, it only comments out the rest of its line). An edit can only
+ * change that for an opener before it by forming a new closer, and openers before
+ * the last closer ahead of the edit are closed either way. So lexing resumes at
+ * the end of the last token before the edit, or before that closer if the edit
+ * forms one, and it can stop as soon as a new token starts where a shifted old
+ * token started: from there on both streams are the same, apart from the offset
+ * and line shift. The tokens after the gap
+ * count from the end of the source, so that shift is applied by updating
+ * source_length and end_line, and only the re-lexed tokens are written.
+ *===========================================================================*/
+
+int lexer_stream_init(TokenStream *stream, Language lang, const char *source_code, int source_length) {
+    LexerIterator iter;
+    TokenView token;
+    memset(stream, 0, sizeof(TokenStream));
+    lexer_iter_init(&iter, lang, source_code, source_length);
+    iter.layout_tokens = 0;     // Layout depends on more than (position, line)
+    while (lexer_iter_next(&iter, &token)) {
+        if (stream->count == stream->capacity) {
+            int capacity = stream->capacity ? stream->capacity * 2 : 1024;
+            TokenView *grown = lexer_realloc(stream->views, sizeof(TokenView) * capacity);
+            if (!grown) {
+                lexer_stream_free(stream);
+                return 0;
+            }
+            stream->views = grown;
+            stream->capacity = capacity;
+        }
+        stream->views[stream->count++] = token;
+    }
+    stream->gap_start = stream->count;
+    stream->gap_length = stream->capacity - stream->count;
+    stream->source_length = source_length;
+    stream->end_line = iter.line;
+    return 1;
+}
+
+void lexer_stream_get(const TokenStream *stream, int index, TokenView *token) {
+    if (index < stream->gap_start) {
+        *token = stream->views[index];
+        return;
+    }
+    *token = stream->views[index + stream->gap_length];
+    token->start += stream->source_length;
+    token->line += stream->end_line;
+}
+
+void lexer_stream_free(TokenStream *stream) {
+    lexer_free(stream->views);
+    memset(stream, 0, sizeof(TokenStream));
+}
+
+/* Move the gap to just before token index, converting only the tokens it passes */
+static void stream_move_gap(TokenStream *stream, int index) {
+    while (stream->gap_start > index) {
+        TokenView token = stream->views[--stream->gap_start];
+        token.start -= stream->source_length;
+        token.line -= stream->end_line;
+        stream->views[stream->gap_start + stream->gap_length] = token;
+    }
+    while (stream->gap_start < index) {
+        lexer_stream_get(stream, stream->gap_start, &stream->views[stream->gap_start]);
+        stream->gap_start++;
+    }
+}
+
+/* Make the gap at least length tokens long; returns 0 if out of memory */
+static int stream_reserve_gap(TokenStream *stream, int length) {
+    if (stream->gap_length >= length) return 1;
+    int capacity = stream->capacity * 2 > stream->count + length ? stream->capacity * 2 : stream->count + length;
+    TokenView *grown = lexer_realloc(stream->views, sizeof(TokenView) * capacity);
+    if (!grown) return 0;
+    int tail_count = stream->count - stream->gap_start;
+    memmove(grown + capacity - tail_count, grown + stream->gap_start + stream->gap_length, sizeof(TokenView) * tail_count);
+    stream->views = grown;
+    stream->gap_length += capacity - stream->capacity;
+    stream->capacity = capacity;
+    return 1;
+}
+
+/* How far back an opener that the edit may have closed can start: the edit's start if the edit
+   formed no closer, otherwise just before the last closer ahead of it (0 if there is none) */
+static int closer_resume_limit(Language lang, const char *source_code, int source_length, const TextEdit *edit) {
+    static const char *const closers[] = { "*/", "'''", "\"\"\"" };
+    int first_closer = lang == LANG_PYTHON ? 1 : 0, closer_count = lang == LANG_PYTHON ? 2 : 1;
+    int edit_end = edit->start + edit->new_length;
+    int limit = edit->start;
+
+    for (int c = first_closer; c < first_closer + closer_count; c++) {
+        int length = (int)strlen(closers[c]);
+        int formed = 0;
+        for (int p = edit->start - length + 1 > 0 ? edit->start - length + 1 : 0;
+             p < edit_end && p + length <= source_length && !formed; p++) {
+            formed = memcmp(source_code + p, closers[c], length) == 0;
+        }
+        if (!formed) continue;
+
+        int last = edit->start - length;
+        while (last >= 0 && memcmp(source_code + last, closers[c], length) != 0) last--;
+        int from = last - (length - 1) > 0 ? last - (length - 1) : 0;     // An opener overlapping it is not closed by it
+        if (from < limit) limit = from;
+    }
+    return limit;
+}
+
+int lexer_relex(Language lang, const char *source_code, int source_length, const TextEdit *edit,
+                TokenStream *stream, RelexResult *change) {
+    int old_count = stream->count;
+    int offset_delta = edit->new_length - edit->old_length;
+    int edit_end = edit->start + edit->new_length;     // End of the inserted text, new coordinates
+    TokenView token;
+
+    // Last token that ends strictly before the edit and before any opener the edit may have closed
+    int resume_limit = closer_resume_limit(lang, source_code, source_length, edit);
+    int low = 0, high = old_count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        lexer_stream_get(stream, mid, &token);
+        if (token.start + token.length < resume_limit) low = mid + 1;
+        else high = mid;
+    }
+    int first = low;
+
+    LexerIterator iter;
+    lexer_iter_init(&iter, lang, source_code, source_length);
+    iter.layout_tokens = 0;     // Layout depends on more than (position, line)
+    if (first > 0) {
+        TokenView kept;
+        lexer_stream_get(stream, first - 1, &kept);
+        iter.index = kept.start + kept.length;
+        iter.line = kept.line;
+        for (int i = kept.start; i < iter.index; i++) {
+            if (source_code[i] == '\n') iter.line++;
+        }
+    }
+
+    // Lex until a token lines up with an old one past the edit
+    TokenView *fresh = NULL;
+    int fresh_count = 0, fresh_capacity = 0;
+    int resync = old_count, line_delta = 0;
+    int old_index = first;
+    while (lexer_iter_next(&iter, &token)) {
+        if (token.start >= edit_end) {
+            TokenView old;
+            for (; old_index < old_count; old_index++) {
+                lexer_stream_get(stream, old_index, &old);
+                if (old.start + offset_delta >= token.start) break;
+            }
+            if (old_index < old_count && old.start + offset_delta == token.start) {
+                resync = old_index;
+                line_delta = token.line - old.line;
+                break;
+            }
+        }
+        if (fresh_count == fresh_capacity) {
+            fresh_capacity = fresh_capacity ? fresh_capacity * 2 : 64;
+            TokenView *grown = lexer_realloc(fresh, sizeof(TokenView) * fresh_capacity);
+            if (!grown) {
+                lexer_free(fresh);
+                return 0;
+            }
+            fresh = grown;
+        }
+        fresh[fresh_count++] = token;
+    }
+
+    // Splice at the gap: the removed tokens join it, the re-lexed ones fill it from the front
+    int removed_count = resync - first;
+    if (!stream_reserve_gap(stream, fresh_count - removed_count)) {
+        lexer_free(fresh);
+        return 0;
+    }
+    stream_move_gap(stream, first);
+    stream->gap_length += removed_count - fresh_count;
+    if (fresh_count > 0) memcpy(stream->views + first, fresh, sizeof(TokenView) * fresh_count);
+    stream->gap_start = first + fresh_count;
+    stream->count = old_count - removed_count + fresh_count;
+    stream->source_length += offset_delta;
+    stream->end_line = resync < old_count ? stream->end_line + line_delta : iter.line;
+    lexer_free(fresh);
+
+    change->first_changed = first;
+    change->removed_count = removed_count;
+    change->inserted_count = fresh_count;
+    change->line_delta = line_delta;
+    return 1;
+}
+
+/* Copy a TokenView into a Token (value truncated to MAX_VALUE - 1 bytes); line_start is where its line begins */
+static void token_from_view(const char *source_code, const TokenView *view, int line_start, Token *token) {
+    int length = view->length < MAX_VALUE - 1 ? view->length : MAX_VALUE - 1;
+    memcpy(token->value, source_code + view->start, length);
+    token->value[length] = '\0';
+    strcpy(token->type, token_kind_name(view->kind));
+    token->line = view->line;
+    token->column = view->start - line_start + 1;
+}
+
+/* Whether a token starts a region of check_type_mismatch_*: no recorded type flows past it */
+static int starts_type_region(Language lang, const char *source_code, const TokenView *view) {
+    static const char *const words[][3] = { { "def", "class", "lambda" }, { "function", "class", "=>" } };
+    for (int w = 0; w < 3; w++) {
+        const char *word = words[lang == LANG_TYPESCRIPT][w];
+        if ((int)strlen(word) == view->length && memcmp(source_code + view->start, word, view->length) == 0) return 1;
+    }
+    return 0;
+}
+
+int lexer_type_region_end(Language lang, const char *source_code, const TokenStream *stream, int index) {
+    TokenView view;
+    for (; index < stream->count; index++) {
+        lexer_stream_get(stream, index, &view);
+        if (starts_type_region(lang, source_code, &view)) break;
+    }
+    return index;
+}
+
+int lexer_check_range(Language lang, const char *source_code, const TokenStream *stream,
+                      int first, int count, Error *errors, int max_errors) {
+    int window = lang == LANG_PYTHON ? 4 : 5;     // Tokens a direct type pattern spans before the value
+    int window_start = first - window > 0 ? first - window : 0;
+    int window_end = first + count + window < stream->count ? first + count + window : stream->count;
+    if (window_end <= window_start) return 0;
+
+    // Types reach the range from anywhere in its region, so the type check replays the region from its start
+    int region_start = window_start;
+    TokenView view;
+    for (; region_start > 0; region_start--) {
+        lexer_stream_get(stream, region_start, &view);
+        if (starts_type_region(lang, source_code, &view)) break;
+    }
+    int window_count = window_end - region_start;
+
+    Token *window_tokens = lexer_malloc(sizeof(Token) * window_count);
+    if (!window_tokens) return 0;
+    lexer_stream_get(stream, region_start, &view);
+    int line_start = view.start, scanned = line_start;
+    while (line_start > 0 && source_code[line_start - 1] != '\n') line_start--;
+    for (int i = 0; i < window_count; i++) {
+        lexer_stream_get(stream, region_start + i, &view);
+        for (; scanned < view.start; scanned++) {
+            if (source_code[scanned] == '\n') line_start = scanned + 1;
+        }
+        token_from_view(source_code, &view, line_start, &window_tokens[i]);
+    }
+
+    // Per-token checks on the range itself, the type check on the region up to the end of the window
+    Token *range_tokens = window_tokens + (first - region_start);
+    int check_error_counts[CHECK_COUNT] = {0};
+    Error *check_errors[CHECK_COUNT];
+    Error *buffer = lexer_malloc(sizeof(Error) * MAX_ERRORS * CHECK_COUNT);
+    if (!buffer) {
+        lexer_free(window_tokens);
+        return 0;
+    }
+    for (int c = 0; c < CHECK_COUNT; c++) check_errors[c] = buffer + c * MAX_ERRORS;
+
+    if (lang == LANG_PYTHON) {
+        check_misspelled_keyword_python(range_tokens, count, check_errors[ERROR_TYPE_MISSPELLED_KEYWORD],
+                                        &check_error_counts[ERROR_TYPE_MISSPELLED_KEYWORD]);
+        check_type_mismatch_python(window_tokens, window_count, check_errors[ERROR_TYPE_TYPE_MISMATCH],
+                                   &check_error_counts[ERROR_TYPE_TYPE_MISMATCH]);
+        check_invalid_operator_python(range_tokens, count, check_errors[ERROR_TYPE_INVALID_OPERATOR],
+                                      &check_error_counts[ERROR_TYPE_INVALID_OPERATOR]);
+    } else {
+        check_misspelled_keyword_typescript(range_tokens, count, check_errors[ERROR_TYPE_MISSPELLED_KEYWORD],
+                                            &check_error_counts[ERROR_TYPE_MISSPELLED_KEYWORD]);
+        check_type_mismatch_typescript(window_tokens, window_count, check_errors[ERROR_TYPE_TYPE_MISMATCH],
+                                       &check_error_counts[ERROR_TYPE_TYPE_MISMATCH]);
+        check_invalid_operator_typescript(range_tokens, count, check_errors[ERROR_TYPE_INVALID_OPERATOR],
+                                          &check_error_counts[ERROR_TYPE_INVALID_OPERATOR]);
+    }
+
+    // Only the type mismatches of statements that can reach into the range
+    int first_line = window_tokens[window_start - region_start].line, kept = 0;
+    Error *type_errors = check_errors[ERROR_TYPE_TYPE_MISMATCH];
+    for (int e = 0; e < check_error_counts[ERROR_TYPE_TYPE_MISMATCH]; e++) {
+        if (type_errors[e].line_number >= first_line) type_errors[kept++] = type_errors[e];
+    }
+    check_error_counts[ERROR_TYPE_TYPE_MISMATCH] = kept;
+
+    int error_count = 0;
+    merge_check_errors(check_errors, check_error_counts, errors, &error_count, max_errors);
+    lexer_free(buffer);
+    lexer_free(window_tokens);
+    return error_count;
+}
+
+/*===========================================================================
+ * SECTION 10: SYNTAX TREE
+ * One pass over the tokens with an explicit stack of open nodes, so deep
+ * nesting costs no recursion. A node is appended when its first token is
+ * seen and its end is filled in when it closes, which gives preorder without
+ * moving anything. Constructs that only show later what they are (an arrow
+ * function's parameters, a method, a call) are decided at their first token:
+ * a table of matching brackets, built first, lets the parser look past a group,
+ * and a called name is made of leaf tokens only, so its node can still start there.
+ * Tokens are read once, into a 4-byte TokenInfo each; the parser itself
+ * works on those and never touches the much larger Token records again.
+ *===========================================================================*/
+
+/* TokenClass: what the parser needs to know of a token */
+typedef enum {
+    CLASS_OTHER, CLASS_NAME, CLASS_KEYWORD, CLASS_OPEN, CLASS_CLOSE, CLASS_COMMA, CLASS_SEMICOLON, CLASS_COLON,
+    CLASS_DOT, CLASS_ASSIGN, CLASS_FAT_ARROW, CLASS_THIN_ARROW, CLASS_LESS, CLASS_GREATER, CLASS_OPERATOR,
+    CLASS_NEWLINE, CLASS_INDENT, CLASS_DEDENT
+} TokenClass;
+
+/* Word: keywords and names the parser looks for (per language), and operators that matter at a line break */
+typedef enum {
+    WORD_NONE, WORD_DEF, WORD_CLASS, WORD_ENUM, WORD_LAMBDA, WORD_ASYNC, WORD_FUNCTION, WORD_DECLARE, WORD_CONST,
+    WORD_COMPOUND,          // Header, then body
+    WORD_COMPOUND_BODY,     // TypeScript else, try, finally: body right away
+    WORD_DO, WORD_WHILE, WORD_MODIFIER, WORD_ACCESSOR, WORD_THIS, WORD_SUPER, WORD_RETURN,
+    WORD_ENDING,            // TypeScript literal keywords, break and continue: may end a statement
+    WORD_INCREMENT,         // ++ and --
+    WORD_UNARY              // ! and ~
+} Word;
+
+#define BRACKET_PAREN   0
+#define BRACKET_SQUARE  1
+#define BRACKET_BRACE   2
+#define BRACKET_LAYOUT  3   // INDENT and DEDENT
+
+/* TokenInfo: a token as the parser sees it */
+typedef struct {
+    unsigned char token_class;  // TokenClass
+    unsigned char word;         // Word; for CLASS_LESS / CLASS_GREATER the number of angle brackets
+    unsigned char bracket;      // BRACKET_* of an opening or closing token
+    unsigned char line_break;   // First token on its line
+} TokenInfo;
+
+/* FrameState: where an open node is in its own syntax */
+typedef enum {
+    FRAME_OPEN,             // Taking tokens until a terminator or its closing bracket
+    FRAME_HEADER,           // Function, class or compound statement before its parameters or body
+    FRAME_AFTER_PARAMETERS, // Function: return annotation, ':', '=>' or body next
+    FRAME_BODY_PENDING,     // The body comes next
+    FRAME_BODY_BLOCK,       // The body is the child block; closes with it
+    FRAME_BODY_INLINE,      // Body statements on the header's line (Python) or one statement (TypeScript)
+    FRAME_EXPRESSION,       // Lambda or arrow function body without braces
+    FRAME_TRAILER           // TypeScript do statement: the while condition after the body
+} FrameState;
+
+/* ParseFrame: an open node */
+typedef struct {
+    int node;
+    int opener;                 // Bracket or INDENT token the node closes with, or -1
+    int angle;                  // TypeScript annotation: '<' still open
+    unsigned char state;        // FrameState
+    unsigned char item_next;    // PARAMETERS / CALL: the next token starts an item
+    unsigned char annotation_next;  // The next token starts an annotation
+    unsigned char assigned;     // '=' seen (TypeScript VARIABLE: in the current declarator)
+    unsigned char is_lambda;    // Python lambda
+    unsigned char statement_level;  // Not inside brackets, so a TypeScript line break may end it
+    unsigned char class_member; // TypeScript statement directly in a class body
+} ParseFrame;
+
+/* ParseScratch: a tree's working memory */
+typedef struct {
+    int *pairs;                 // Matching bracket or INDENT / DEDENT of each token, -1 if none
+    TokenInfo *info;
+    int token_capacity;
+    ParseFrame *frames;
+    int frame_capacity;
+} ParseScratch;
+
+typedef struct {
+    Language lang;
+    int token_count;
+    int *pairs;
+    const TokenInfo *info;
+    SyntaxTree *tree;
+    ParseScratch *scratch;
+    int top;                    // Innermost open frame
+    int covered;                // Tokens before this one belong to a closed node
+    int failed;                 // Out of memory
+} Parser;
+
+typedef struct {
+    const char *text;
+    unsigned char word;
+} WordEntry;
+
+static const WordEntry PYTHON_WORDS[] = {
+    { "def", WORD_DEF }, { "class", WORD_CLASS }, { "lambda", WORD_LAMBDA }, { "async", WORD_ASYNC },
+    { "if", WORD_COMPOUND }, { "elif", WORD_COMPOUND }, { "else", WORD_COMPOUND }, { "for", WORD_COMPOUND },
+    { "while", WORD_COMPOUND }, { "try", WORD_COMPOUND }, { "except", WORD_COMPOUND },
+    { "finally", WORD_COMPOUND }, { "with", WORD_COMPOUND }, { NULL, WORD_NONE }
+};
+
+static const WordEntry TYPESCRIPT_WORDS[] = {
+    { "function", WORD_FUNCTION }, { "class", WORD_CLASS }, { "interface", WORD_CLASS }, { "enum", WORD_ENUM },
+    { "let", WORD_DECLARE }, { "var", WORD_DECLARE }, { "const", WORD_CONST },
+    { "if", WORD_COMPOUND }, { "for", WORD_COMPOUND }, { "switch", WORD_COMPOUND }, { "catch", WORD_COMPOUND },
+    { "else", WORD_COMPOUND_BODY }, { "try", WORD_COMPOUND_BODY }, { "finally", WORD_COMPOUND_BODY },
+    { "do", WORD_DO }, { "while", WORD_WHILE }, { "async", WORD_ASYNC },
+    { "export", WORD_MODIFIER }, { "default", WORD_MODIFIER }, { "declare", WORD_MODIFIER },
+    { "public", WORD_MODIFIER }, { "private", WORD_MODIFIER }, { "protected", WORD_MODIFIER },
+    { "static", WORD_MODIFIER }, { "readonly", WORD_MODIFIER }, { "abstract", WORD_MODIFIER },
+    { "override", WORD_MODIFIER }, { "get", WORD_ACCESSOR }, { "set", WORD_ACCESSOR },
+    { "this", WORD_THIS }, { "super", WORD_SUPER }, { "return", WORD_RETURN },
+    { "true", WORD_ENDING }, { "false", WORD_ENDING }, { "null", WORD_ENDING }, { "undefined", WORD_ENDING },
+    { "break", WORD_ENDING }, { "continue", WORD_ENDING }, { NULL, WORD_NONE }
+};
+
+#define MAX_WORD_LENGTH 9       // "interface"
+
+static unsigned char lookup_word(const WordEntry *words, const char *value) {
+    if (memchr(value, '\0', MAX_WORD_LENGTH + 1) == NULL) return WORD_NONE;
+    for (; words->text; words++) {
+        if (words->text[0] == value[0] && strcmp(words->text, value) == 0) return words->word;
+    }
+    return WORD_NONE;
+}
+
+/* Read what the parser needs of a token; previous is the token before it, or NULL */
+static TokenInfo classify_token(Language lang, const Token *token, const Token *previous) {
+    const char *type = token->type, *value = token->value;
+    TokenInfo info = { CLASS_OTHER, WORD_NONE, 0, previous == NULL || token->line > previous->line };
+    switch (type[0]) {
+        case 'I':
+            if (type[1] == 'D') {
+                info.token_class = CLASS_NAME;
+                info.word = lookup_word(lang == LANG_PYTHON ? PYTHON_WORDS : TYPESCRIPT_WORDS, value);
+            } else if (type[2] == 'D') {       // INDENT, not INT_LITERAL
+                info.token_class = CLASS_INDENT;
+                info.bracket = BRACKET_LAYOUT;
+            }
+            break;
+        case 'K':
+            info.token_class = CLASS_KEYWORD;
+            info.word = lookup_word(lang == LANG_PYTHON ? PYTHON_WORDS : TYPESCRIPT_WORDS, value);
+            break;
+        case 'N':
+            info.token_class = CLASS_NEWLINE;
+            break;
+        case 'D':
+            if (type[2] == 'D') {
+                info.token_class = CLASS_DEDENT;
+                info.bracket = BRACKET_LAYOUT;
+                break;
+            }
+            switch (value[0]) {
+                case '(': info.token_class = CLASS_OPEN; info.bracket = BRACKET_PAREN; break;
+                case '[': info.token_class = CLASS_OPEN; info.bracket = BRACKET_SQUARE; break;
+                case '{': info.token_class = CLASS_OPEN; info.bracket = BRACKET_BRACE; break;
+                case ')': info.token_class = CLASS_CLOSE; info.bracket = BRACKET_PAREN; break;
+                case ']': info.token_class = CLASS_CLOSE; info.bracket = BRACKET_SQUARE; break;
+                case '}': info.token_class = CLASS_CLOSE; info.bracket = BRACKET_BRACE; break;
+                case ',': info.token_class = CLASS_COMMA; break;
+                case ';': info.token_class = CLASS_SEMICOLON; break;
+                case ':': info.token_class = CLASS_COLON; break;
+                case '.': info.token_class = CLASS_DOT; break;
+            }
+            break;
+        case 'O': {
+            size_t angles;
+            info.token_class = CLASS_OPERATOR;
+            if (value[0] == '=' && value[1] == '\0') {
+                info.token_class = CLASS_ASSIGN;
+            } else if (value[1] == '>' && value[2] == '\0' && (value[0] == '=' || value[0] == '-')) {
+                info.token_class = value[0] == '=' ? CLASS_FAT_ARROW : CLASS_THIN_ARROW;
+            } else if (value[angles = strspn(value, "<")] == '\0' || value[angles = strspn(value, ">")] == '\0') {
+                info.token_class = value[0] == '<' ? CLASS_LESS : CLASS_GREATER;
+                info.word = (unsigned char)angles;
+            } else if ((value[0] == '+' || value[0] == '-') && value[1] == value[0] && value[2] == '\0') {
+                info.word = WORD_INCREMENT;
+            } else if ((value[0] == '!' || value[0] == '~') && value[1] == '\0') {
+                info.word = WORD_UNARY;
+            }
+            break;
+        }
+    }
+    return info;
+}
+
+/**
+ * Pair every closing token with its opening one. Openers still waiting are kept
+ * as a stack linked through pairs[]. A closer that does not match the innermost
+ * opener closes the nearest opener of its kind, and the openers in between stay
+ * unpaired; without an opener of its kind it stays unpaired itself.
+ */
+static void match_brackets(const TokenInfo *info, int count, int *pairs) {
+    int top = -1, open_of_kind[4] = { 0 };
+    for (int i = 0; i < count; i++) {
+        pairs[i] = -1;
+        if (info[i].token_class == CLASS_OPEN || info[i].token_class == CLASS_INDENT) {
+            pairs[i] = top;
+            top = i;
+            open_of_kind[info[i].bracket]++;
+        } else if (info[i].token_class == CLASS_CLOSE || info[i].token_class == CLASS_DEDENT) {
+            int kind = info[i].bracket;
+            if (open_of_kind[kind] == 0) continue;
+            for (;;) {
+                int opener = top, opener_kind = info[opener].bracket;
+                top = pairs[opener];
+                open_of_kind[opener_kind]--;
+                pairs[opener] = -1;
+                if (opener_kind == kind) {
+                    pairs[opener] = i;
+                    pairs[i] = opener;
+                    break;
+                }
+            }
+        }
+    }
+    while (top >= 0) {
+        int below = pairs[top];
+        pairs[top] = -1;
+        top = below;
+    }
+}
+
+/* Token index exists and is the keyword or name word */
+static int has_word(const Parser *parser, int index, Word word) {
+    return index < parser->token_count && parser->info[index].word == word &&
+           (parser->info[index].token_class == CLASS_NAME || parser->info[index].token_class == CLASS_KEYWORD);
+}
+
+/* Token index exists and opens a bracket of the given BRACKET_* kind */
+static int is_opening(const Parser *parser, int index, int bracket) {
+    return index < parser->token_count && parser->info[index].token_class == CLASS_OPEN &&
+           parser->info[index].bracket == bracket;
+}
+
+static ParseFrame *top_frame(Parser *parser) {
+    return &parser->scratch->frames[parser->top];
+}
+
+static CstNode *frame_node(Parser *parser, const ParseFrame *frame) {
+    return &parser->tree->nodes[frame->node];
+}
+
+/* Open a node starting at first_token as a child of the innermost open node; returns its frame or NULL */
+static ParseFrame *open_node(Parser *parser, CstKind kind, int first_token, int opener, FrameState state) {
+    SyntaxTree *tree = parser->tree;
+    ParseScratch *scratch = parser->scratch;
+    if (tree->node_count == tree->node_capacity) {
+        int capacity = tree->node_capacity ? tree->node_capacity * 2 : 256;
+        CstNode *grown = lexer_realloc(tree->nodes, sizeof(CstNode) * capacity);
+        if (!grown) { parser->failed = 1; return NULL; }
+        tree->nodes = grown;
+        tree->node_capacity = capacity;
+    }
+    if (parser->top + 1 == scratch->frame_capacity) {
+        int capacity = scratch->frame_capacity * 2;
+        ParseFrame *grown = lexer_realloc(scratch->frames, sizeof(ParseFrame) * capacity);
+        if (!grown) { parser->failed = 1; return NULL; }
+        scratch->frames = grown;
+        scratch->frame_capacity = capacity;
+    }
+    const ParseFrame *parent = parser->top >= 0 ? top_frame(parser) : NULL;
+    tree->nodes[tree->node_count] = (CstNode){ kind, parent ? parent->node : -1, 0, first_token, 0 };
+    ParseFrame *frame = &scratch->frames[++parser->top];
+    memset(frame, 0, sizeof(*frame));
+    frame->node = tree->node_count++;
+    frame->opener = opener;
+    frame->state = state;
+    frame->statement_level = kind == CST_STATEMENT || kind == CST_VARIABLE ||
+                             ((kind == CST_FUNCTION || kind == CST_ANNOTATION) && parent && parent->statement_level);
+    return frame;
+}
+
+/**
+ * Close the innermost node after token last (an empty node if last is before its
+ * first token). Bodies end with their block, and a TypeScript statement body
+ * with its statement, so those parents are closed as well.
+ */
+static void close_node(Parser *parser, int last) {
+    while (parser->top >= 0) {
+        ParseFrame *frame = top_frame(parser);
+        CstNode *node = frame_node(parser, frame);
+        node->token_count = last >= node->first_token ? last + 1 - node->first_token : 0;
+        node->end = parser->tree->node_count;
+        if (frame->opener >= 0 && parser->pairs[frame->opener] > last) {
+            parser->pairs[parser->pairs[frame->opener]] = -1;   // Closed early: its closer no longer closes it
+        }
+        if (last + 1 > parser->covered) parser->covered = last + 1;
+        CstKind kind = node->kind;
+        if (--parser->top < 0) return;
+
+        ParseFrame *parent = top_frame(parser);
+        CstKind parent_kind = frame_node(parser, parent)->kind;
+        if (kind == CST_PARAMETERS && parent->state == FRAME_HEADER) {
+            parent->state = FRAME_AFTER_PARAMETERS;
+        } else if (kind == CST_GROUP && parent_kind == CST_COMPOUND && parent->state == FRAME_HEADER) {
+            parent->state = FRAME_BODY_PENDING;                 // TypeScript condition
+        } else if ((kind == CST_BLOCK && parent->state == FRAME_BODY_BLOCK) ||
+                   (parser->lang == LANG_TYPESCRIPT && parent->state == FRAME_BODY_INLINE)) {
+            if (parent_kind == CST_COMPOUND && has_word(parser, frame_node(parser, parent)->first_token, WORD_DO) &&
+                has_word(parser, last + 1, WORD_WHILE)) {
+                parent->state = FRAME_TRAILER;
+                parent->statement_level = 1;
+                return;
+            }
+            continue;
+        }
+        return;
+    }
+}
+
+/* Open the statement node that starts at token index, in the innermost open node */
+static void open_statement(Parser *parser, int index) {
+    const TokenInfo *info = parser->info;
+
+    if (parser->lang == LANG_PYTHON) {
+        int head = index;
+        if (has_word(parser, head, WORD_ASYNC) && head + 1 < parser->token_count) head++;
+        switch (info[head].token_class == CLASS_KEYWORD ? info[head].word : WORD_NONE) {
+            case WORD_DEF: open_node(parser, CST_FUNCTION, index, -1, FRAME_HEADER); break;
+            case WORD_CLASS: open_node(parser, CST_CLASS, index, -1, FRAME_HEADER); break;
+            case WORD_COMPOUND: open_node(parser, CST_COMPOUND, index, -1, FRAME_HEADER); break;
+            default: open_node(parser, CST_STATEMENT, index, -1, FRAME_OPEN); break;
+        }
+        return;
+    }
+
+    const CstNode *container = frame_node(parser, top_frame(parser));
+    int in_class = container->kind == CST_BLOCK && container->parent >= 0 &&
+                   parser->tree->nodes[container->parent].kind == CST_CLASS;
+    int head = index;
+    while (head + 1 < parser->token_count && (info[head + 1].token_class == CLASS_NAME || info[head + 1].token_class == CLASS_KEYWORD) &&
+           (has_word(parser, head, WORD_MODIFIER) || has_word(parser, head, WORD_ASYNC) ||
+            (in_class && has_word(parser, head, WORD_ACCESSOR)))) {
+        head++;
+    }
+    int word = info[head].token_class == CLASS_NAME || info[head].token_class == CLASS_KEYWORD ? info[head].word : WORD_NONE;
+    int close = is_opening(parser, head + 1, BRACKET_PAREN) ? parser->pairs[head + 1] : -1;
+    ParseFrame *frame = NULL;
+    if (word == WORD_FUNCTION) {
+        frame = open_node(parser, CST_FUNCTION, index, -1, FRAME_HEADER);
+    } else if (word == WORD_CLASS || word == WORD_ENUM || (word == WORD_CONST && has_word(parser, head + 1, WORD_ENUM))) {
+        open_node(parser, CST_CLASS, index, -1, FRAME_HEADER);
+    } else if (word == WORD_DECLARE || word == WORD_CONST) {
+        open_node(parser, CST_VARIABLE, index, -1, FRAME_OPEN);
+    } else if (word == WORD_COMPOUND || word == WORD_COMPOUND_BODY || word == WORD_DO || word == WORD_WHILE) {
+        open_node(parser, CST_COMPOUND, index, -1, FRAME_HEADER);
+    } else if (head == index && is_opening(parser, head, BRACKET_BRACE)) {
+        open_node(parser, CST_BLOCK, index, index, FRAME_OPEN);
+    } else if (in_class && info[head].token_class == CLASS_NAME && close >= 0 &&
+               (is_opening(parser, close + 1, BRACKET_BRACE) ||
+                (close + 1 < parser->token_count && info[close + 1].token_class == CLASS_COLON))) {
+        frame = open_node(parser, CST_FUNCTION, index, -1, FRAME_HEADER);   // Method
+    } else {
+        frame = open_node(parser, CST_STATEMENT, index, -1, FRAME_OPEN);
+        if (frame) frame->class_member = in_class;
+    }
+    if (frame && frame_node(parser, frame)->kind == CST_FUNCTION) frame->statement_level = 1;
+}
+
+/* First token of the called name that ends at token index (a.b.c), or -1 if it is not a name */
+static int callee_start(Parser *parser, int index) {
+    const TokenInfo *info = parser->info;
+    int floor = frame_node(parser, top_frame(parser))->first_token;
+    if (parser->covered > floor) floor = parser->covered;
+    if (index < floor) return -1;
+    if (info[index].token_class != CLASS_NAME && !has_word(parser, index, WORD_SUPER)) return -1;
+    while (index - 2 >= floor && info[index - 1].token_class == CLASS_DOT &&
+           (info[index - 2].token_class == CLASS_NAME || has_word(parser, index - 2, WORD_THIS) ||
+            has_word(parser, index - 2, WORD_SUPER))) {
+        index -= 2;
+    }
+    return index;
+}
+
+/* TypeScript: an expression may start at token index, so a '(' there is not a call or a parenthesized operand */
+static int expression_may_start(const Parser *parser, int index) {
+    if (index == 0) return 1;
+    switch (parser->info[index - 1].token_class) {
+        case CLASS_ASSIGN: case CLASS_COMMA: case CLASS_OPEN: case CLASS_OPERATOR: case CLASS_FAT_ARROW:
+        case CLASS_SEMICOLON:
+            return 1;
+    }
+    return has_word(parser, index - 1, WORD_RETURN) || has_word(parser, index - 1, WORD_ASYNC);
+}
+
+/* TypeScript: token index is the '(' of an arrow function's parameters, (..) => or (..): type => */
+static int is_arrow_parameters(const Parser *parser, int index) {
+    int close = parser->pairs[index];
+    if (parser->info[index].bracket != BRACKET_PAREN || close < 0 || close + 1 >= parser->token_count) return 0;
+    return parser->info[close + 1].token_class == CLASS_FAT_ARROW ||
+           (parser->info[close + 1].token_class == CLASS_COLON && expression_may_start(parser, index));
+}
+
+/* First token of an arrow function whose parameters start at token index: an 'async' before them belongs to it */
+static int arrow_start(const Parser *parser, int index) {
+    return index > parser->covered && has_word(parser, index - 1, WORD_ASYNC) ? index - 1 : index;
+}
+
+/* A token inside an expression: brackets, calls, lambdas and arrow functions open nodes, the rest are leaves */
+static void take_expression_token(Parser *parser, int index) {
+    const TokenInfo *info = parser->info;
+    int is_typescript = parser->lang == LANG_TYPESCRIPT;
+    int in_annotation = frame_node(parser, top_frame(parser))->kind == CST_ANNOTATION;
+    ParseFrame *frame;
+
+    switch (info[index].token_class) {
+        case CLASS_OPEN: {
+            if (is_typescript && !in_annotation && is_arrow_parameters(parser, index)) {
+                if (open_node(parser, CST_FUNCTION, arrow_start(parser, index), -1, FRAME_HEADER) &&
+                    (frame = open_node(parser, CST_PARAMETERS, index, index, FRAME_OPEN))) frame->item_next = 1;
+                return;
+            }
+            int callee = info[index].bracket == BRACKET_PAREN && !in_annotation && index > 0 ? callee_start(parser, index - 1) : -1;
+            if (callee >= 0) {
+                if ((frame = open_node(parser, CST_CALL, callee, index, FRAME_OPEN))) frame->item_next = 1;
+                return;
+            }
+            open_node(parser, CST_GROUP, index, index, FRAME_OPEN);
+            return;
+        }
+        case CLASS_INDENT:
+            open_node(parser, CST_BLOCK, index, index, FRAME_OPEN);
+            return;
+        case CLASS_KEYWORD:
+            if (info[index].word == WORD_LAMBDA) {
+                if ((frame = open_node(parser, CST_FUNCTION, index, -1, FRAME_HEADER))) frame->is_lambda = 1;
+            } else if (info[index].word == WORD_FUNCTION) {
+                open_node(parser, CST_FUNCTION, index, -1, FRAME_HEADER);
+            }
+            return;
+        case CLASS_NAME:
+            if (is_typescript && !in_annotation && index + 1 < parser->token_count &&
+                info[index + 1].token_class == CLASS_FAT_ARROW) {
+                // x => ...: a function with one parameter
+                if (open_node(parser, CST_FUNCTION, arrow_start(parser, index), -1, FRAME_HEADER) &&
+                    open_node(parser, CST_PARAMETERS, index, -1, FRAME_OPEN) &&
+                    open_node(parser, CST_PARAMETER, index, -1, FRAME_OPEN)) {
+                    close_node(parser, index);
+                    close_node(parser, index);
+                }
+            }
+            return;
+        case CLASS_LESS:
+        case CLASS_GREATER:
+            frame = top_frame(parser);
+            if (is_typescript && in_annotation) {
+                frame->angle += info[index].token_class == CLASS_LESS ? info[index].word : -info[index].word;
+                if (frame->angle < 0) frame->angle = 0;
+            }
+            return;
+    }
+}
+
+static int can_end_statement(const Parser *parser, int index) {
+    const TokenInfo *token = &parser->info[index];
+    switch (token->token_class) {
+        case CLASS_NAME: case CLASS_OTHER: case CLASS_CLOSE: case CLASS_GREATER: return 1;
+        case CLASS_KEYWORD:
+            return token->word == WORD_ENDING || token->word == WORD_THIS || token->word == WORD_SUPER ||
+                   token->word == WORD_RETURN;
+        case CLASS_OPERATOR: return token->word == WORD_INCREMENT;
+    }
+    return 0;
+}
+
+static int can_start_statement(const Parser *parser, int index) {
+    const TokenInfo *token = &parser->info[index];
+    switch (token->token_class) {
+        case CLASS_NAME: case CLASS_KEYWORD: case CLASS_OTHER: return 1;
+        case CLASS_OPEN: return token->bracket == BRACKET_BRACE;     // A line starting with ( or [ continues
+        case CLASS_OPERATOR: return token->word == WORD_INCREMENT || token->word == WORD_UNARY;
+    }
+    return 0;
+}
+
+/* TypeScript: a line break before token index ends the statement (automatic semicolon insertion) */
+static int line_break_ends(Parser *parser, const ParseFrame *frame, int index) {
+    if (!frame->statement_level || index == 0 || !parser->info[index].line_break) return 0;
+    if (frame_node(parser, frame)->kind == CST_FUNCTION) {
+        if (frame->state != FRAME_EXPRESSION && frame->state != FRAME_AFTER_PARAMETERS) return 0;
+        if (frame->state == FRAME_AFTER_PARAMETERS && is_opening(parser, index, BRACKET_BRACE)) return 0;
+    }
+    return can_end_statement(parser, index - 1) && can_start_statement(parser, index);
+}
+
+/* Close the nodes whose body was the rest of a Python line ending at token last */
+static void close_inline_bodies(Parser *parser, int last) {
+    while (parser->top > 0 && top_frame(parser)->state == FRAME_BODY_INLINE) close_node(parser, last);
+}
+
+/* Body of a function, class or compound statement starting at token index */
+static void open_body(Parser *parser, ParseFrame *frame, int index) {
+    if (parser->info[index].token_class == CLASS_INDENT ||
+        (parser->lang == LANG_TYPESCRIPT && is_opening(parser, index, BRACKET_BRACE))) {
+        frame->state = FRAME_BODY_BLOCK;
+        open_node(parser, CST_BLOCK, index, index, FRAME_OPEN);
+    } else {
+        frame->state = FRAME_BODY_INLINE;
+        open_statement(parser, index);
+    }
+}
+
+/**
+ * Give token index to the innermost open node. Returns 1 once the token is
+ * taken; 0 if the open nodes changed (a node was closed before the token, or a
+ * child was opened that starts with it) and the token must be offered again.
+ */
+static int take_token(Parser *parser, int index) {
+    ParseFrame *frame = top_frame(parser);
+    CstNode *node = frame_node(parser, frame);
+    unsigned char token_class = parser->info[index].token_class;
+    int is_python = parser->lang == LANG_PYTHON;
+    int fresh = node->first_token == index;     // A node always takes its first token
+
+    // Lazily opened children: annotations and list items start at the next suitable token
+    if (frame->annotation_next) {
+        frame->annotation_next = 0;
+        if (token_class != CLASS_NEWLINE && token_class != CLASS_COMMA && token_class != CLASS_SEMICOLON &&
+            token_class != CLASS_ASSIGN && token_class != CLASS_COLON) {
+            open_node(parser, CST_ANNOTATION, index, -1, FRAME_OPEN);
+            return 0;
+        }
+    }
+    if (frame->item_next && token_class != CLASS_COMMA && token_class != CLASS_NEWLINE && token_class != CLASS_COLON) {
+        frame->item_next = 0;
+        open_node(parser, node->kind == CST_CALL ? CST_ARGUMENT : CST_PARAMETER, index, -1, FRAME_OPEN);
+        return 0;
+    }
+
+    // Python: NEWLINE ends the logical line and everything on it
+    if (is_python && token_class == CLASS_NEWLINE) {
+        switch (node->kind) {
+            case CST_MODULE: case CST_BLOCK:
+                return 1;
+            case CST_STATEMENT: case CST_VARIABLE:
+                close_node(parser, index);
+                close_inline_bodies(parser, index);
+                return 1;
+            case CST_COMPOUND: case CST_FUNCTION: case CST_CLASS:
+                if (frame->is_lambda) break;
+                if (frame->state == FRAME_BODY_PENDING) return 1;
+                close_node(parser, index);
+                close_inline_bodies(parser, index);
+                return 1;
+            default:
+                break;
+        }
+        close_node(parser, index - 1);
+        return 0;
+    }
+    if (!is_python && !fresh && line_break_ends(parser, frame, index)) {
+        close_node(parser, index - 1);
+        return 0;
+    }
+
+    switch (node->kind) {
+        case CST_MODULE:
+        case CST_BLOCK:
+            if (frame->opener == index || token_class == CLASS_CLOSE || token_class == CLASS_DEDENT ||
+                token_class == CLASS_NEWLINE) return 1;
+            if (token_class == CLASS_INDENT) {
+                open_node(parser, CST_BLOCK, index, index, FRAME_OPEN);     // Unexpected indent
+                return 1;
+            }
+            open_statement(parser, index);
+            return 0;
+
+        case CST_STATEMENT:
+        case CST_VARIABLE:
+            if (token_class == CLASS_SEMICOLON) {
+                close_node(parser, index);
+                return 1;
+            }
+            if (fresh) break;
+            if (token_class == CLASS_ASSIGN) {
+                if (is_python || (frame->class_member && !frame->assigned)) node->kind = CST_VARIABLE;
+                frame->assigned = 1;
+                return 1;
+            }
+            if (token_class == CLASS_COMMA && node->kind == CST_VARIABLE && !is_python) {
+                frame->assigned = 0;
+                return 1;
+            }
+            if (token_class == CLASS_COLON && !frame->assigned &&
+                (is_python ? callee_start(parser, index - 1) == node->first_token
+                           : node->kind == CST_VARIABLE || frame->class_member)) {
+                node->kind = CST_VARIABLE;
+                frame->annotation_next = 1;
+                return 1;
+            }
+            break;
+
+        case CST_COMPOUND:
+        case CST_CLASS:
+        case CST_FUNCTION:
+            if (fresh) {
+                if (!is_python && (has_word(parser, index, WORD_COMPOUND_BODY) || has_word(parser, index, WORD_DO))) {
+                    frame->state = FRAME_BODY_PENDING;
+                }
+                return 1;
+            }
+            switch (frame->state) {
+                case FRAME_HEADER:
+                    if (frame->is_lambda) {
+                        if (token_class == CLASS_COLON) {
+                            frame->state = FRAME_EXPRESSION;
+                            return 1;
+                        }
+                        if ((frame = open_node(parser, CST_PARAMETERS, index, -1, FRAME_OPEN))) frame->item_next = 1;
+                        return 0;
+                    }
+                    if (node->kind == CST_FUNCTION && is_opening(parser, index, BRACKET_PAREN)) {
+                        open_node(parser, CST_PARAMETERS, index, index, FRAME_OPEN);
+                        return 0;
+                    }
+                    if (is_python && token_class == CLASS_COLON) {
+                        frame->state = FRAME_BODY_PENDING;
+                        return 1;
+                    }
+                    if (is_python && node->kind == CST_CLASS && token_class == CLASS_OPEN) {
+                        open_node(parser, CST_GROUP, index, index, FRAME_OPEN);    // Base classes
+                        return 1;
+                    }
+                    if (!is_python && node->kind != CST_COMPOUND && is_opening(parser, index, BRACKET_BRACE)) {
+                        open_body(parser, frame, index);
+                        return 1;
+                    }
+                    break;
+                case FRAME_AFTER_PARAMETERS:
+                    if (is_python ? token_class == CLASS_THIN_ARROW : token_class == CLASS_COLON) {
+                        frame->annotation_next = 1;
+                        return 1;
+                    }
+                    if (is_python && token_class == CLASS_COLON) {
+                        frame->state = frame->is_lambda ? FRAME_EXPRESSION : FRAME_BODY_PENDING;
+                        return 1;
+                    }
+                    if (!is_python && token_class == CLASS_FAT_ARROW) {
+                        frame->state = FRAME_BODY_PENDING;
+                        return 1;
+                    }
+                    if (!is_python && is_opening(parser, index, BRACKET_BRACE)) {
+                        open_body(parser, frame, index);
+                        return 1;
+                    }
+                    if (!is_python && token_class == CLASS_SEMICOLON) {
+                        close_node(parser, index);      // Declaration without a body
+                        return 1;
+                    }
+                    close_node(parser, index - 1);
+                    return 0;
+                case FRAME_BODY_PENDING:
+                    if (node->kind == CST_FUNCTION && !is_python && !is_opening(parser, index, BRACKET_BRACE)) {
+                        frame->state = FRAME_EXPRESSION;
+                        return 0;
+                    }
+                    if (is_python && parser->info[index - 1].token_class == CLASS_NEWLINE && token_class != CLASS_INDENT) {
+                        close_node(parser, index - 1);  // Empty body
+                        return 0;
+                    }
+                    open_body(parser, frame, index);
+                    return parser->top >= 0 && top_frame(parser)->opener == index;     // Opened a block with it
+                case FRAME_BODY_INLINE:
+                    if (is_python) {
+                        open_statement(parser, index);
+                        return 0;
+                    }
+                    close_node(parser, index - 1);
+                    return 0;
+                case FRAME_EXPRESSION:
+                    if (token_class == CLASS_COMMA || token_class == CLASS_SEMICOLON) {
+                        close_node(parser, index - 1);
+                        return 0;
+                    }
+                    break;
+                case FRAME_TRAILER:
+                    if (token_class == CLASS_SEMICOLON) {
+                        close_node(parser, index);
+                        return 1;
+                    }
+                    break;
+                default:
+                    close_node(parser, index - 1);
+                    return 0;
+            }
+            break;
+
+        case CST_PARAMETERS:
+        case CST_CALL:
+            if (frame->opener == index || token_class == CLASS_COMMA) {
+                frame->item_next = 1;
+                return 1;
+            }
+            if (node->kind == CST_CALL) break;
+            if (token_class == CLASS_COLON && frame->opener < 0 && !fresh) {
+                close_node(parser, index - 1);      // End of lambda parameters
+                return 0;
+            }
+            break;
+
+        case CST_PARAMETER:
+            if (fresh) break;
+            if (token_class == CLASS_COMMA || (token_class == CLASS_COLON && parser->scratch->frames[parser->top - 1].opener < 0)) {
+                close_node(parser, index - 1);      // Lambda parameters end at ':'
+                return 0;
+            }
+            if (token_class == CLASS_ASSIGN) {
+                frame->assigned = 1;
+                return 1;
+            }
+            if (token_class == CLASS_COLON && !frame->assigned) {
+                frame->annotation_next = 1;
+                return 1;
+            }
+            break;
+
+        case CST_ANNOTATION:
+            if (fresh) break;
+            if (is_python) {
+                if (token_class == CLASS_COMMA || token_class == CLASS_ASSIGN || token_class == CLASS_COLON ||
+                    token_class == CLASS_SEMICOLON) {
+                    close_node(parser, index - 1);
+                    return 0;
+                }
+            } else if (frame->angle == 0) {
+                int parent_kind = parser->tree->nodes[node->parent].kind;
+                if (token_class == CLASS_COMMA || token_class == CLASS_ASSIGN || token_class == CLASS_SEMICOLON ||
+                    (token_class == CLASS_FAT_ARROW && parser->info[index - 1].token_class != CLASS_CLOSE) ||
+                    (parent_kind == CST_FUNCTION && is_opening(parser, index, BRACKET_BRACE))) {
+                    close_node(parser, index - 1);
+                    return 0;
+                }
+            }
+            break;
+
+        case CST_ARGUMENT:
+            if (token_class == CLASS_COMMA && !fresh) {
+                close_node(parser, index - 1);
+                return 0;
+            }
+            break;
+
+        case CST_GROUP:
+            break;
+    }
+    take_expression_token(parser, index);
+    return 1;
+}
+
+int lexer_parse(Language lang, const Token *tokens, int token_count, SyntaxTree *tree) {
+    ParseScratch *scratch = tree->scratch;
+    if (!scratch) {
+        scratch = tree->scratch = lexer_malloc(sizeof(ParseScratch));
+        if (!scratch) return 0;
+        memset(scratch, 0, sizeof(*scratch));
+    }
+    if (scratch->token_capacity < token_count) {
+        int *pairs = lexer_realloc(scratch->pairs, sizeof(int) * token_count);
+        if (pairs) scratch->pairs = pairs;
+        TokenInfo *info = lexer_realloc(scratch->info, sizeof(TokenInfo) * token_count);
+        if (info) scratch->info = info;
+        if (!pairs || !info) return 0;
+        scratch->token_capacity = token_count;
+    }
+    if (scratch->frame_capacity == 0) {
+        scratch->frames = lexer_malloc(sizeof(ParseFrame) * 64);
+        if (!scratch->frames) return 0;
+        scratch->frame_capacity = 64;
+    }
+
+    for (int i = 0; i < token_count; i++) scratch->info[i] = classify_token(lang, &tokens[i], i > 0 ? &tokens[i - 1] : NULL);
+    match_brackets(scratch->info, token_count, scratch->pairs);
+
+    Parser parser = { lang, token_count, scratch->pairs, scratch->info, tree, scratch, -1, 0, 0 };
+    tree->node_count = 0;
+    open_node(&parser, CST_MODULE, 0, -1, FRAME_OPEN);
+    for (int i = 0; i < token_count && !parser.failed; i++) {
+        unsigned char token_class = scratch->info[i].token_class;
+        if ((token_class == CLASS_CLOSE || token_class == CLASS_DEDENT) && parser.pairs[i] >= 0) {
+            // A closing bracket ends everything opened since its opener
+            while (parser.top > 0 && top_frame(&parser)->opener != parser.pairs[i]) close_node(&parser, i - 1);
+            close_node(&parser, i);
+            continue;
+        }
+        while (!parser.failed && !take_token(&parser, i)) {}
+        if (parser.pairs[i] > i && top_frame(&parser)->opener != i) parser.pairs[parser.pairs[i]] = -1;   // Taken as a leaf
+    }
+    while (parser.top >= 0) close_node(&parser, token_count - 1);
+    if (parser.failed) {
+        tree->node_count = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void lexer_tree_free(SyntaxTree *tree) {
+    ParseScratch *scratch = tree->scratch;
+    if (scratch) {
+        lexer_free(scratch->pairs);
+        lexer_free(scratch->info);
+        lexer_free(scratch->frames);
+        lexer_free(scratch);
+    }
+    lexer_free(tree->nodes);
+    memset(tree, 0, sizeof(*tree));
+}
+
+const char *cst_kind_name(CstKind kind) {
+    switch (kind) {
+        case CST_MODULE:        return "MODULE";
+        case CST_BLOCK:         return "BLOCK";
+        case CST_STATEMENT:     return "STATEMENT";
+        case CST_COMPOUND:      return "COMPOUND";
+        case CST_FUNCTION:      return "FUNCTION";
+        case CST_CLASS:         return "CLASS";
+        case CST_VARIABLE:      return "VARIABLE";
+        case CST_PARAMETERS:    return "PARAMETERS";
+        case CST_PARAMETER:     return "PARAMETER";
+        case CST_ANNOTATION:    return "ANNOTATION";
+        case CST_CALL:          return "CALL";
+        case CST_ARGUMENT:      return "ARGUMENT";
+        case CST_GROUP:         return "GROUP";
+        default:                return "UNKNOWN";
+    }
+}
+
+/*===========================================================================
+ * SECTION 11: MODULE INTERFACE
+ *===========================================================================*/
+
+/* Append text[0 .. length) and a NUL to module->text; returns its offset, or -1 if out of memory */
+static int module_text(ModuleInterface *module, const char *text, int length) {
+    if (module->text_length + length + 1 > module->text_capacity) {
+        int capacity = module->text_capacity ? module->text_capacity : 256;
+        while (capacity < module->text_length + length + 1) capacity *= 2;
+        char *grown = lexer_realloc(module->text, capacity);
+        if (!grown) return -1;
+        module->text = grown;
+        module->text_capacity = capacity;
+    }
+    int offset = module->text_length;
+    memcpy(module->text + offset, text, length);
+    module->text[offset + length] = '\0';
+    module->text_length += length + 1;
+    return offset;
+}
+
+/* The module a string literal names, without its quotes */
+static int module_specifier(ModuleInterface *module, const Token *token) {
+    const char *value = token->value;
+    int length = strlen(value);
+    if (length >= 2 && strchr("'\"`", value[0])) return module_text(module, value + 1, length - 2);
+    return module_text(module, value, length);
+}
+
+/* Add name as a declaration (module_offset -1) or as imported from module_offset; returns 0 if out of memory */
+static int module_symbol(ModuleInterface *module, const char *name, int module_offset, int line) {
+    int is_import = module_offset >= 0;
+    ModuleSymbol **symbols = is_import ? &module->imports : &module->declarations;
+    int *count = is_import ? &module->import_count : &module->declaration_count;
+    int *capacity = is_import ? &module->import_capacity : &module->declaration_capacity;
+    if (*count == *capacity) {
+        int grown_capacity = *capacity ? *capacity * 2 : 64;
+        ModuleSymbol *grown = lexer_realloc(*symbols, sizeof(ModuleSymbol) * grown_capacity);
+        if (!grown) return 0;
+        *symbols = grown;
+        *capacity = grown_capacity;
+    }
+    int name_offset = module_text(module, name, strlen(name));
+    if (name_offset < 0) return 0;
+    (*symbols)[(*count)++] = (ModuleSymbol){ name_offset, module_offset, line };
+    return 1;
+}
+
+/* Python: the names bound in the module scope, then from m import a, b as c */
+static int python_module_interface(const Token *tokens, int count, ModuleInterface *module) {
+    ScopeOutline outline;
+    unsigned char *listed = lexer_malloc(count + 1);        // By interned name
+    int ok = outline_init(&outline, count) && listed;
+    if (ok) {
+        outline_python_scopes(&outline, tokens, count);
+        memset(listed, 0, count + 1);
+        for (int d = 0; ok && d < outline.declaration_count; d++) {
+            const Declaration *declaration = &outline.declarations[d];
+            if (declaration->scope != 0 || listed[declaration->name]) continue;
+            listed[declaration->name] = 1;
+            const Token *token = &tokens[declaration->token];
+            ok = module_symbol(module, token->value, -1, token->line);
+        }
+    }
+    outline_free(&outline);
+    lexer_free(listed);
+
+    for (int i = 0; ok && i < count; i++) {
+        if (strcmp(tokens[i].value, "from") != 0 || !starts_statement(LANG_PYTHON, tokens, i)) continue;
+        char path[MAX_VALUE];
+        int length = 0, j = i + 1;
+        for (; j < count && strcmp(tokens[j].value, "import") != 0 && strcmp(tokens[j].type, "NEWLINE") != 0; j++) {
+            int part = strlen(tokens[j].value);
+            if (length + part >= MAX_VALUE) part = MAX_VALUE - 1 - length;
+            memcpy(path + length, tokens[j].value, part);
+            length += part;
+        }
+        if (j >= count || strcmp(tokens[j].value, "import") != 0) continue;
+        int module_offset = module_text(module, path, length);
+        ok = module_offset >= 0;
+        for (j++; ok && j < count && strcmp(tokens[j].type, "NEWLINE") != 0 && strcmp(tokens[j].value, ";") != 0; j++) {
+            const char *previous = tokens[j-1].value;
+            if (strcmp(tokens[j].value, "*") == 0) {
+                module->exports_all = 1;
+            } else if (strcmp(tokens[j].type, "IDENTIFIER") == 0 && (strcmp(previous, "import") == 0 ||
+                       strcmp(previous, ",") == 0 || strcmp(previous, "(") == 0)) {
+                ok = module_symbol(module, tokens[j].value, module_offset, tokens[j].line);
+            }
+        }
+        i = j;
+    }
+    return ok;
+}
+
+/**
+ * TypeScript clause tokens[first .. last) of import ... from or export { .. }: the
+ * names it takes from the other module (imports: a name outside braces is the
+ * default export) and, for exports, the names it exports. module_offset is the
+ * module it comes from, or -1 for export { .. } of local names.
+ */
+static int typescript_clause(const Token *tokens, int count, int first, int last, int is_export, int module_offset,
+                             ModuleInterface *module) {
+    int braces = 0, ok = 1;
+    for (int j = first; ok && j < last; j++) {
+        const Token *token = &tokens[j];
+        if (token->value[0] == '{' || token->value[0] == '}') braces = token->value[0] == '{';
+        if (strcmp(token->type, "IDENTIFIER") != 0 && strcmp(token->value, "default") != 0) continue;
+        if (is_clause_word(tokens, count, j)) continue;
+        if (j > first && strcmp(tokens[j-1].value, "as") == 0) {
+            // * as ns: a namespace, exported under that name by export * as ns from 'm'
+            if (is_export && j - 2 >= first && tokens[j-2].value[0] == '*') ok = module_symbol(module, token->value, -1, token->line);
+            continue;
+        }
+
+        // a as b: a is taken, b is exported (or bound locally)
+        int alias = j + 2 < last && strcmp(tokens[j+1].value, "as") == 0 ? j + 2 : j;
+        if (module_offset >= 0) ok = module_symbol(module, braces ? token->value : "default", module_offset, token->line);
+        if (ok && is_export) ok = module_symbol(module, tokens[alias].value, -1, tokens[alias].line);
+    }
+    return ok;
+}
+
+/* TypeScript: exported declarations and names, and the names imported from other modules */
+static int typescript_module_interface(const Token *tokens, int count, ModuleInterface *module) {
+    static const char *const DECLARATION_WORDS[] = {
+        "function", "class", "let", "const", "var", "interface", "type", "enum", "namespace", "module"
+    };
+    int depth = 0, ok = 1;
+    for (int i = 0; ok && i < count; i++) {
+        const char *value = tokens[i].value;
+        if (strcmp(tokens[i].type, "DELIMITER") == 0 && value[0] == '{') depth++;
+        else if (strcmp(tokens[i].type, "DELIMITER") == 0 && value[0] == '}' && depth > 0) depth--;
+        int is_import = strcmp(value, "import") == 0, is_export = strcmp(value, "export") == 0;
+        if (depth > 0 || (!is_import && !is_export) || i + 1 >= count) continue;
+        if (i > 0 && strcmp(tokens[i-1].value, ".") == 0) continue;
+        const char *next = tokens[i+1].value;
+
+        if (is_import || next[0] == '{' || next[0] == '*') {
+            if (is_import && (next[0] == '(' || next[0] == '.')) continue;     // import(...), import.meta
+            // The clause runs to its module (or, for export { .. }, its closing brace)
+            int end = i + 1, module_offset = -1;
+            for (; end < count && strcmp(tokens[end].type, "STRING_LITERAL") != 0 && tokens[end].value[0] != ';'; end++) {
+                if (is_export && tokens[end].value[0] == '}' && (end + 1 >= count || strcmp(tokens[end+1].value, "from") != 0)) break;
+                if (strcmp(tokens[end].type, "IDENTIFIER") != 0 && strcmp(tokens[end].type, "STRING_LITERAL") != 0 &&
+                    !strchr("{},*", tokens[end].value[0]) && strcmp(tokens[end].value, "default") != 0) break;
+            }
+            if (end < count && strcmp(tokens[end].type, "STRING_LITERAL") == 0) {
+                module_offset = module_specifier(module, &tokens[end]);
+                if (module_offset < 0) return 0;
+            }
+            if (is_export && next[0] == '*' && (i + 2 >= count || strcmp(tokens[i+2].value, "as") != 0)) {
+                module->exports_all = 1;                                    // export * from 'm'
+            } else if (is_import && module_offset < 0) {
+                continue;                                                   // import x = require('m')
+            } else {
+                ok = typescript_clause(tokens, count, i + 1, end, is_export, module_offset, module);
+            }
+            i = end;
+            continue;
+        }
+
+        // export default ..., export = ..., export [declare] [async] function name ...
+        if (strcmp(next, "default") == 0) {
+            ok = module_symbol(module, "default", -1, tokens[i].line);
+            continue;
+        }
+        if (strcmp(next, "=") == 0) {
+            module->exports_all = 1;
+            continue;
+        }
+        for (int j = i + 1; j + 1 < count && j < i + 5; j++) {
+            int is_declaration = 0;
+            for (size_t w = 0; w < sizeof(DECLARATION_WORDS) / sizeof(DECLARATION_WORDS[0]); w++) {
+                if (strcmp(tokens[j].value, DECLARATION_WORDS[w]) == 0) is_declaration = 1;
+            }
+            if (!is_declaration) continue;
+            int name = strcmp(tokens[j+1].value, "*") == 0 ? j + 2 : j + 1;     // function* name
+            if (name < count && strcmp(tokens[name].type, "IDENTIFIER") == 0) {
+                ok = module_symbol(module, tokens[name].value, -1, tokens[name].line);
+            }
+            break;
+        }
+    }
+    return ok;
+}
+
+int lexer_module_interface(Language lang, const Token *tokens, int token_count, ModuleInterface *module) {
+    module->declaration_count = module->import_count = module->text_length = 0;
+    module->exports_all = 0;
+    return lang == LANG_PYTHON ? python_module_interface(tokens, token_count, module)
+                               : typescript_module_interface(tokens, token_count, module);
+}
+
+int lexer_module_add(ModuleInterface *module, const char *name, const char *from_module, int line) {
+    int module_offset = -1;
+    if (from_module && (module_offset = module_text(module, from_module, strlen(from_module))) < 0) return 0;
+    return module_symbol(module, name, module_offset, line);
+}
+
+void lexer_module_free(ModuleInterface *module) {
+    lexer_free(module->declarations);
+    lexer_free(module->imports);
+    lexer_free(module->text);
+    memset(module, 0, sizeof(*module));
+}
@@ -0,0 +1,500 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - LIBRARY INTERFACE
+ *
+ * liblexer extracts comments, tokenizes and checks Python and TypeScript source.
+ * Apart from the allocation counters (see MEMORY ACCOUNTING) it keeps no
+ * global mutable state: all working memory lives in a LexerContext or in
+ * buffers owned by the caller, so contexts may be used from different threads
+ * at the same time (one thread per context).
+ *
+ * Typical use:
+ *   LexerContext *context = lexer_create();
+ *   LexerResult result = { tokens, MAX_TOKENS, 0, comments, MAX_COMMENTS, 0, errors, MAX_ERRORS, 0 };
+ *   lexer_analyze(context, LANG_PYTHON, source, strlen(source), &result);
+ *   ...
+ *   lexer_destroy(context);
+ */
+
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stddef.h>
+
+/*===========================================================================
+ * CONSTANTS
+ *===========================================================================*/
+
+#ifndef MAX_TOKENS
+#define MAX_TOKENS   1000
+#endif
+#define MAX_COMMENTS 100
+#define MAX_ERRORS   100
+#define MAX_LENGTH   1024
+#define MAX_VALUE    256
+#define MAX_THREADS  64
+#define CHECK_COUNT  4      // Checks, one per ErrorType
+#define MAX_INDENT_LEVELS 100   // Python blocks tracked for INDENT/DEDENT; deeper ones get no INDENT
+
+typedef enum { LANG_PYTHON, LANG_TYPESCRIPT } Language;
+
+/*===========================================================================
+ * DATA STRUCTURES
+ *===========================================================================*/
+
+/* Token: smallest meaningful unit (e.g., "print", "123", "+") */
+typedef struct {
+    char value[MAX_VALUE];  // The text of the token (truncated if longer)
+    char type[32];      // KEYWORD, IDENTIFIER, OPERATOR, etc.
+    int line;           // Line number
+    int column;         // Byte column of the first character (1 = start of line)
+} Token;
+
+/* Comment: stores extracted comment information */
+typedef struct {
+    char content[MAX_LENGTH];
+    int start_line;
+    int end_line;
+    int is_multiline;
+} Comment;
+
+/* Error: stores detected error information */
+typedef enum {
+    ERROR_TYPE_MISSPELLED_KEYWORD,
+    ERROR_TYPE_TYPE_MISMATCH,
+    ERROR_TYPE_UNDECLARED_IDENTIFIER,
+    ERROR_TYPE_INVALID_OPERATOR
+} ErrorType;
+
+typedef struct {
+    char message[MAX_LENGTH];
+    int line_number;
+    ErrorType type;
+} Error;
+
+/* PythonLayout: Python logical-line state, for NEWLINE / INDENT / DEDENT tokens (all zero at the start) */
+typedef struct {
+    int brackets;       // Open ( [ { of the current logical line
+    int line_tokens;    // Tokens of the current logical line so far
+    int depth;          // Open indentation levels
+    int widths[MAX_INDENT_LEVELS];  // Indentation width of each open level
+} PythonLayout;
+
+/* LexCursor: tokenizer position, so a buffer can be lexed piece by piece */
+typedef struct {
+    const char *source_code;
+    int code_length;    // Bytes of source_code that may be read
+    int code_index;     // Next byte to lex
+    int current_line;   // Line number at code_index
+    int more_input;     // 1 if bytes past code_length may still arrive (streaming)
+    int line_start;     // Index of the first byte of current_line
+    PythonLayout layout;    // Python only
+} LexCursor;
+
+/* CommentScanner: comment extraction state, so input can be scanned as it arrives */
+typedef struct {
+    int source_index;   // Next byte of the source to scan
+    int clean_index;    // Bytes written to code_without_comments so far
+    int current_line;   // Line number at source_index
+    int comment_count;  // Comments seen (may exceed comment_capacity; extras are not stored)
+    int pending_search; // Where the search for an unfinished comment's end resumes (streaming)
+    int comment_capacity;   // Size of the comments array
+} CommentScanner;
+
+/* TokenKind: token category reported by the token iterator */
+typedef enum {
+    TOKEN_KEYWORD,
+    TOKEN_IDENTIFIER,
+    TOKEN_INT_LITERAL,
+    TOKEN_FLOAT_LITERAL,
+    TOKEN_STRING_LITERAL,
+    TOKEN_OPERATOR,
+    TOKEN_DELIMITER,
+    TOKEN_NEWLINE,      // Python: end of a logical line (empty text)
+    TOKEN_INDENT,       // Python: a block opens (empty text, at the block's first token)
+    TOKEN_DEDENT        // Python: a block closes (empty text, at the next line's first token)
+} TokenKind;
+
+/* TokenView: a token as a span of the source buffer */
+typedef struct {
+    TokenKind kind;
+    int start;          // Byte offset of the first character
+    int length;         // Length in bytes
+    int line;           // Source line the token starts on
+} TokenView;
+
+/* LexerIterator: pull-style lexer over a caller's buffer (no allocation) */
+typedef struct {
+    const char *source_code;
+    int source_length;
+    int index;          // Next byte to look at
+    int line;           // Line number at index
+    Language lang;
+    int unclosed_from[2];   // No closing ''' / star-slash (0) or """ (1) at or after these indexes
+    int layout_tokens;  // 1 to emit NEWLINE / INDENT / DEDENT (Python default; see lexer_iter_init)
+    PythonLayout layout;
+} LexerIterator;
+
+/* TextEdit: source[start .. start + old_length) was replaced by new_length bytes */
+typedef struct {
+    int start;
+    int old_length;
+    int new_length;
+} TextEdit;
+
+/**
+ * TokenStream: the TokenView stream of a document, kept up to date by lexer_relex.
+ * The array has a gap where the last edit was. Tokens before the gap hold their own
+ * start and line; tokens after it count back from source_length and end_line, so an
+ * edit never has to touch them. Read tokens with lexer_stream_get.
+ */
+typedef struct {
+    TokenView *views;   // Token i is views[i] before the gap, views[i + gap_length] after it
+    int count;          // Tokens in the stream
+    int capacity;       // Size of views
+    int gap_start;
+    int gap_length;
+    int source_length;  // Length of the source the stream was lexed from
+    int end_line;       // Line number at the end of that source
+} TokenStream;
+
+/* RelexResult: the part of a token stream that an edit changed */
+typedef struct {
+    int first_changed;  // Index of the first token that differs
+    int removed_count;  // Old tokens [first_changed, first_changed + removed_count) ...
+    int inserted_count; // ... became new tokens [first_changed, first_changed + inserted_count)
+    int line_delta;     // Line shift of the tokens after the changed range
+} RelexResult;
+
+/* LexerResult: caller-owned output buffers and how much of each was filled */
+typedef struct {
+    Token *tokens;
+    int token_capacity;
+    int token_count;
+    Comment *comments;
+    int comment_capacity;
+    int comment_count;
+    Error *errors;
+    int error_capacity;
+    int error_count;
+} LexerResult;
+
+/* LexerTimes: where the last lexer_analyze call spent its time, in seconds (monotonic clock) */
+typedef struct {
+    double comments;            // Comment extraction
+    double tokenize;
+    double checks;              // All checks (wall clock; they may run concurrently)
+    double check[CHECK_COUNT];  // Each check on its own, indexed by ErrorType
+} LexerTimes;
+
+/* LexerPhase: the stages of lexer_analyze, as reported to a phase hook */
+typedef enum {
+    LEXER_PHASE_COMMENTS,
+    LEXER_PHASE_TOKENIZE,
+    LEXER_PHASE_CHECKS,                             // All checks, including merging their errors
+    LEXER_PHASE_CHECK_FIRST,                        // Then one phase per check, indexed by ErrorType
+    LEXER_PHASE_COUNT = LEXER_PHASE_CHECK_FIRST + CHECK_COUNT
+} LexerPhase;
+
+/* Called at the start (is_end 0) and end (is_end 1) of each phase, on the thread running it.
+   Checks may run concurrently, so a hook can be called from several threads at once, but
+   never for the same phase. */
+typedef void (*LexerPhaseHook)(void *data, LexerPhase phase, int is_end);
+
+/* LexerContext: reusable analysis state (opaque) */
+typedef struct LexerContext LexerContext;
+
+/*===========================================================================
+ * CONTEXT API
+ *===========================================================================*/
+
+/* Create a context (single-threaded analysis); returns NULL if out of memory */
+LexerContext *lexer_create(void);
+
+/* Let one analysis use up to thread_count threads (1..MAX_THREADS) */
+void lexer_set_threads(LexerContext *context, int thread_count);
+
+/**
+ * Analyze source_code[0 .. source_length) and fill the caller's result buffers
+ * Output beyond a buffer's capacity is dropped; each check reports at most
+ * MAX_ERRORS errors. Returns 1 on success, 0 if out of memory.
+ */
+int lexer_analyze(LexerContext *context, Language lang, const char *source_code, int source_length, LexerResult *result);
+
+/**
+ * lexer_analyze, but first grow result->tokens (from lexer_malloc, or NULL) to hold
+ * every token of source_code, so no token is dropped; the comment and error buffers
+ * are used as given. Returns 1 on success, 0 if out of memory.
+ */
+int lexer_analyze_all(LexerContext *context, Language lang, const char *source_code, int source_length,
+                      LexerResult *result);
+
+/* Phase timings of the last lexer_analyze call on this context */
+const LexerTimes *lexer_last_times(const LexerContext *context);
+
+/* Install a hook called around every phase of lexer_analyze (NULL removes it) */
+void lexer_set_phase_hook(LexerContext *context, LexerPhaseHook hook, void *data);
+
+/* Name of the source being analyzed, passed to USDT probes (see probes.h); not copied, NULL for none */
+void lexer_set_source_name(LexerContext *context, const char *name);
+
+/* The installed hook and its data (NULL if none), for a new hook that calls it in turn */
+void lexer_get_phase_hook(const LexerContext *context, LexerPhaseHook *hook, void **data);
+
+/* Return the context to its freshly created state, releasing cached scratch memory */
+void lexer_reset(LexerContext *context);
+
+void lexer_destroy(LexerContext *context);
+
+/*===========================================================================
+ * TOKEN ITERATOR
+ * Lexes the raw source (comments are skipped as they are met) one token per
+ * call. Only comments that start where a token could start are recognized, so
+ * unlike lexer_analyze, a '#' or '//' inside a string literal stays in the string.
+ * As in lexer_analyze, a multi-line comment that is never closed ends at its line end.
+ *
+ *   LexerIterator iter;
+ *   TokenView token;
+ *   lexer_iter_init(&iter, LANG_PYTHON, source, length);
+ *   while (lexer_iter_next(&iter, &token)) { ... }
+ *
+ * For Python the stream includes NEWLINE, INDENT and DEDENT tokens of length 0
+ * unless layout_tokens is set to 0 after lexer_iter_init.
+ *===========================================================================*/
+
+void lexer_iter_init(LexerIterator *iter, Language lang, const char *source_code, int source_length);
+
+/* Fetch the next token; returns 0 at the end of the buffer */
+int lexer_iter_next(LexerIterator *iter, TokenView *token);
+
+/* Token type name as used in Token.type ("KEYWORD", "IDENTIFIER", ...) */
+const char *token_kind_name(TokenKind kind);
+
+/* Phase name ("comments", "tokenize", "checks", then one per check such as "misspelled keyword") */
+const char *lexer_phase_name(LexerPhase phase);
+
+/*===========================================================================
+ * INCREMENTAL RE-LEXING
+ * For editors: keep the TokenStream of a document and patch it per edit.
+ *===========================================================================*/
+
+/* Lex source_code[0 .. source_length) into a new stream without NEWLINE / INDENT / DEDENT tokens;
+   returns 0 if out of memory */
+int lexer_stream_init(TokenStream *stream, Language lang, const char *source_code, int source_length);
+
+/* Token index of the stream (0 <= index < stream->count) */
+void lexer_stream_get(const TokenStream *stream, int index, TokenView *token);
+
+void lexer_stream_free(TokenStream *stream);
+
+/**
+ * Update the stream (for the source before the edit) to match source_code, the
+ * source after the edit. Lexing resumes just before the edit and stops once the
+ * new tokens line up with the old ones again. An edit that forms a comment
+ * closer (star-slash, ''' or """) may close an opener left open earlier in the
+ * file, so lexing then resumes before the last such closer ahead of the edit
+ * instead. The gap moves to the edit, so the
+ * cost depends on the size of the edit and its distance from the previous one,
+ * not on the size of the file. Returns 1 and fills *change, or 0 if out of
+ * memory (stream untouched).
+ */
+int lexer_relex(Language lang, const char *source_code, int source_length, const TextEdit *edit,
+                TokenStream *stream, RelexResult *change);
+
+/**
+ * Diagnostics for tokens [first .. first + count) of the stream: misspelled
+ * keywords, invalid operators and type mismatches overlapping the range.
+ * Types carried in from earlier assignments are followed: the type check
+ * replays the range's region (since the last def, class, lambda, function or
+ * arrow) from its start. What the range changes for statements after it, such
+ * as a new annotation for a later reassignment, is not re-checked unless the
+ * range runs on to lexer_type_region_end. Undeclared identifiers depend on the
+ * whole file and are not covered. Returns the number of errors.
+ */
+int lexer_check_range(Language lang, const char *source_code, const TokenStream *stream,
+                      int first, int count, Error *errors, int max_errors);
+
+/* Index of the first token from index on that starts a new type region (def, class, lambda;
+   function, class, arrow), or stream->count: types recorded before it do not reach past it */
+int lexer_type_region_end(Language lang, const char *source_code, const TokenStream *stream, int index);
+
+/*===========================================================================
+ * SYNTAX TREE
+ * An optional parse of a token stream into a concrete syntax tree, for checks
+ * that need structure rather than a window of tokens. Every token stays in
+ * the tree: a node covers a span of tokens, and the tokens of a node that no
+ * child covers are its own (keywords, names, operators, separators). Nodes
+ * are stored in preorder in one array, so a subtree is an index span too:
+ *
+ *   for (int child = n + 1; child < tree.nodes[n].end; child = tree.nodes[child].end) { ... }
+ *
+ * Python streams need their NEWLINE / INDENT / DEDENT tokens. Parsing never
+ * fails on bad input: a bracket that is never closed ends at its line end
+ * (Python) or at the end of the stream (TypeScript).
+ *===========================================================================*/
+
+/* CstKind: what a syntax tree node stands for */
+typedef enum {
+    CST_MODULE,         // The whole stream
+    CST_BLOCK,          // Python: INDENT .. DEDENT; TypeScript: { .. } of a body, or a bare block
+    CST_STATEMENT,      // Simple statement, with its NEWLINE or ';' if it has one
+    CST_COMPOUND,       // if, elif, else, for, while, try, except, catch, finally, with, do, switch: header and body
+    CST_FUNCTION,       // def, lambda, function, method or arrow function
+    CST_CLASS,          // class, interface or enum
+    CST_VARIABLE,       // let / const / var declaration, class property, or Python assignment or annotated name
+    CST_PARAMETERS,     // Parameter list of a function
+    CST_PARAMETER,
+    CST_ANNOTATION,     // Type after ':' (parameters, variables, properties, return types) or '->'
+    CST_CALL,           // Called name (such as a.b.c) and its parenthesized arguments
+    CST_ARGUMENT,
+    CST_GROUP           // Any other ( .. ), [ .. ] or { .. }
+} CstKind;
+
+/* CstNode: covers tokens [first_token, first_token + token_count); its descendants are nodes [index + 1, end) */
+typedef struct {
+    CstKind kind;
+    int parent;         // Index of the parent node, -1 for the root
+    int end;            // Index just past the last descendant (the next sibling, if any)
+    int first_token;
+    int token_count;
+} CstNode;
+
+/* SyntaxTree: nodes in preorder, node 0 is the CST_MODULE; zero-initialize before the first parse */
+typedef struct {
+    CstNode *nodes;
+    int node_count;
+    int node_capacity;
+    void *scratch;      // Working memory kept between parses
+} SyntaxTree;
+
+/* Parse tokens[0 .. token_count) into tree, reusing its memory; returns 1, or 0 if out of memory */
+int lexer_parse(Language lang, const Token *tokens, int token_count, SyntaxTree *tree);
+
+/* Release the memory of a tree (it may be parsed into again afterwards) */
+void lexer_tree_free(SyntaxTree *tree);
+
+/* Node kind name ("MODULE", "BLOCK", "STATEMENT", ...) */
+const char *cst_kind_name(CstKind kind);
+
+/*===========================================================================
+ * MODULE INTERFACE
+ * What a file offers other files and what it takes from them, for checks
+ * across a project. Declarations are, for Python, every name bound at module
+ * level (assignments, def, class, imports) and, for TypeScript, the exported
+ * names ("default" for a default export). Imports are the names taken by name:
+ * from m import x (Python), import d, { x } from 'm' and export { x } from 'm'
+ * (TypeScript; d is "default"). Imports of a whole module are not listed.
+ *===========================================================================*/
+
+/* ModuleSymbol: a declared name, or a name imported from another module */
+typedef struct {
+    int name;           // Offset of the name in ModuleInterface.text
+    int module;         // Imports: offset of the module as written ("..pkg.utils", "./y"); -1 for declarations
+    int line;
+} ModuleSymbol;
+
+/* ModuleInterface: zero-initialize before the first call */
+typedef struct {
+    ModuleSymbol *declarations;
+    int declaration_count;
+    ModuleSymbol *imports;
+    int import_count;
+    int exports_all;    // from m import * or export * from 'm': names that cannot be listed
+    char *text;         // NUL-terminated names and modules
+    int text_length;
+    int declaration_capacity;
+    int import_capacity;
+    int text_capacity;
+} ModuleInterface;
+
+/* Fill module from tokens[0 .. token_count), reusing its memory; returns 1, or 0 if out of memory */
+int lexer_module_interface(Language lang, const Token *tokens, int token_count, ModuleInterface *module);
+
+/* Add a declaration (from_module NULL) or a name imported from from_module, as when loading a
+   saved interface; returns 1, or 0 if out of memory */
+int lexer_module_add(ModuleInterface *module, const char *name, const char *from_module, int line);
+
+/* Release the memory of a module interface (it may be filled again afterwards) */
+void lexer_module_free(ModuleInterface *module);
+
+/*===========================================================================
+ * MEMORY ACCOUNTING
+ * All library memory comes from lexer_malloc/lexer_realloc, which count it
+ * for the whole process and, between lexer_memory_begin and lexer_memory_end,
+ * for the calling thread's current file (threads that lexer_analyze starts
+ * count towards the file of the thread that started them). Callers may use
+ * them for their own buffers to have those counted too.
+ *===========================================================================*/
+
+/* LexerMemory: heap use counted by the allocator */
+typedef struct {
+    long long allocated_bytes;  // Requested in total (a realloc counts its new size)
+    long long allocation_count;
+    long long current_bytes;    // Live now
+    long long peak_bytes;       // Most live at once
+} LexerMemory;
+
+void *lexer_malloc(size_t size);
+void *lexer_realloc(void *pointer, size_t size);
+void lexer_free(void *pointer);
+
+/* Usage of the whole process so far */
+void lexer_memory_process(LexerMemory *usage);
+
+/**
+ * Count the calling thread's allocations per file: lexer_memory_end fills
+ * usage with what was allocated since lexer_memory_begin. Memory allocated
+ * before (such as context scratch buffers kept from an earlier file) is not
+ * counted again when reused or freed. Returns 0 if out of memory.
+ */
+int lexer_memory_begin(void);
+void lexer_memory_end(LexerMemory *usage);
+
+/*===========================================================================
+ * BUILDING BLOCKS
+ * Used by lexer_analyze; exposed for streaming and custom pipelines
+ *===========================================================================*/
+
+int levenshtein_distance(const char *str1, const char *str2);
+int is_python_keyword(const char *word);
+int is_typescript_keyword(const char *word);
+int is_operator_char(char c);
+int is_delimiter_char(char c);
+
+/* Comment extraction; code outside comments is appended to code_without_comments */
+void scan_comments_python(CommentScanner *scanner, const char *source_code, int source_length, int is_final,
+                          Comment *comments, char *code_without_comments);
+void scan_comments_typescript(CommentScanner *scanner, const char *source_code, int source_length, int is_final,
+                              Comment *comments, char *code_without_comments);
+void extract_comments_python(const char *source_code, Comment *comments, int *comment_count, char *code_without_comments);
+void extract_comments_typescript(const char *source_code, Comment *comments, int *comment_count, char *code_without_comments);
+
+/* Tokenization of code without comments. Python tokens include NEWLINE, INDENT and
+   DEDENT: brackets and a backslash before the line break join lines, and the
+   blocks still open are closed at the end of input (when more_input is 0) */
+int next_token_python(LexCursor *cursor, int end_index, Token *token);
+int next_token_typescript(LexCursor *cursor, int end_index, Token *token);
+int tokenize_range(LexCursor *cursor, int end_index, Language lang, Token *tokens, int max_tokens);
+void tokenize_python(const char *source_code, Token *tokens, int *token_count);
+void tokenize_typescript(const char *source_code, Token *tokens, int *token_count);
+void tokenize_parallel(const char *source_code, int code_length, Language lang, Token *tokens, int max_tokens,
+                       int *token_count, int thread_count);
+
+/* Checks; each appends to errors and stops once *err_count reaches MAX_ERRORS */
+typedef void (*CheckFunction)(Token *tokens, int count, Error *errors, int *err_count);
+
+void check_misspelled_keyword_python(Token *tokens, int count, Error *errors, int *err_count);
+void check_misspelled_keyword_typescript(Token *tokens, int count, Error *errors, int *err_count);
+void check_type_mismatch_python(Token *tokens, int count, Error *errors, int *err_count);
+void check_type_mismatch_typescript(Token *tokens, int count, Error *errors, int *err_count);
+void check_undeclared_identifier_python(Token *tokens, int count, Error *errors, int *err_count);
+void check_undeclared_identifier_typescript(Token *tokens, int count, Error *errors, int *err_count);
+void check_invalid_operator_python(Token *tokens, int count, Error *errors, int *err_count);
+void check_invalid_operator_typescript(Token *tokens, int count, Error *errors, int *err_count);
+
+/* Run all checks, check c into check_errors[c] (MAX_ERRORS entries each), indexed by ErrorType */
+void run_checks(Token *tokens, int token_count, Language lang, Error *check_errors[CHECK_COUNT],
+                int check_error_counts[CHECK_COUNT], int thread_count);
+void merge_check_errors(Error *check_errors[CHECK_COUNT], int check_error_counts[CHECK_COUNT],
+                        Error *errors, int *err_count, int max_errors);
+
+#endif
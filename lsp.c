@@ -0,0 +1,871 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - LANGUAGE SERVER
+ *
+ * Speaks the Language Server Protocol over stdin/stdout (./lexer --lsp).
+ * Open documents stay in memory with their token stream. Each didChange edit
+ * is applied in place and re-lexed incrementally (lexer_relex), so semantic
+ * tokens are always current. The changed lines are re-checked right away with
+ * lexer_check_range, on to the end of their type region so that later
+ * reassignments follow a changed annotation. Undeclared identifiers depend on
+ * every scope of the file, so they come from a whole-document pass that only
+ * runs once typing pauses for LSP_DEBOUNCE_MS; a pending pass is pushed back
+ * by every new edit. Due passes run one document at a time and stop between
+ * documents when a new message has arrived; a pass that has started is not
+ * interrupted. Diagnostics are published after that pass.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "lsp.h"
+
+/*===========================================================================
+ * CONSTANTS
+ *===========================================================================*/
+#define LSP_DEBOUNCE_MS       150     // Quiet time after an edit before diagnostics run
+#define LSP_READ_BLOCK        65536   // Bytes requested from stdin per read
+#define LSP_MAX_MESSAGE       (64 << 20)  // Largest Content-Length accepted
+#define LSP_MAX_HEADER        4096    // Longest message header accepted
+#define LSP_METHOD_NOT_FOUND  -32601  // JSON-RPC error code
+
+/* Semantic token legend; TokenKind -> legend index (-1: not reported) */
+static const char *const SEMANTIC_TOKEN_TYPES[] = { "keyword", "variable", "number", "string", "operator" };
+static const int SEMANTIC_TOKEN_TYPE_OF_KIND[] = {
+    [TOKEN_KEYWORD] = 0, [TOKEN_IDENTIFIER] = 1, [TOKEN_INT_LITERAL] = 2, [TOKEN_FLOAT_LITERAL] = 2,
+    [TOKEN_STRING_LITERAL] = 3, [TOKEN_OPERATOR] = 4, [TOKEN_DELIMITER] = -1,
+    [TOKEN_NEWLINE] = -1, [TOKEN_INDENT] = -1, [TOKEN_DEDENT] = -1
+};
+
+/* Diagnostic codes, indexed by ErrorType */
+static const char *const DIAGNOSTIC_CODES[] = {
+    "misspelled-keyword", "type-mismatch", "undeclared-identifier", "invalid-operator"
+};
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+/* TextBuffer: growable output text */
+typedef struct {
+    char *data;
+    int length;
+    int capacity;
+} TextBuffer;
+
+/* LspDocument: an open document and its token stream */
+typedef struct {
+    char *uri;
+    Language lang;
+    int version;
+    char *text;             // NUL-terminated
+    int length;
+    int capacity;
+    TokenStream tokens;     // Token stream of text, patched by lexer_relex
+    Error *diagnostics;     // Keyword, type and operator errors, patched per edit
+    int diagnostic_count;
+    int diagnostic_capacity;
+    Error *undeclared;      // Undeclared identifiers as of the last whole-document pass
+    int undeclared_count;
+    int undeclared_capacity;
+    int dirty;              // Undeclared identifiers are out of date
+    long long due_ms;       // When the debounced pass may run
+} LspDocument;
+
+typedef struct {
+    LspDocument *documents;
+    int document_count;
+    int document_capacity;
+    Token *analysis_tokens; // Scratch tokens for the whole-document pass
+    int analysis_capacity;
+    Error *errors;          // Scratch errors, MAX_ERRORS * CHECK_COUNT
+    char *input;            // Bytes read from stdin, not yet handled
+    int input_length;
+    int input_capacity;
+    int shutdown_requested;
+} LspServer;
+
+/*===========================================================================
+ * SECTION 2: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+static void *lsp_realloc(void *pointer, size_t size) {
+    void *grown = lexer_realloc(pointer, size);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    return grown;
+}
+
+static long long now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* UTF-16 code units of the UTF-8 sequence led by byte c (0 for continuation bytes) */
+static int utf16_units(char c) {
+    unsigned char byte = (unsigned char)c;
+    if ((byte & 0xC0) == 0x80) return 0;
+    return byte >= 0xF0 ? 2 : 1;
+}
+
+static void text_reserve(TextBuffer *buffer, int extra) {
+    if (buffer->length + extra + 1 <= buffer->capacity) return;
+    int capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < buffer->length + extra + 1) capacity *= 2;
+    buffer->data = lsp_realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+static void text_append(TextBuffer *buffer, const char *text, int length) {
+    text_reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void text_printf(TextBuffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    text_reserve(buffer, length);
+    va_start(args, format);
+    vsnprintf(buffer->data + buffer->length, length + 1, format, args);
+    va_end(args);
+    buffer->length += length;
+}
+
+/* Append text as a quoted JSON string */
+static void text_append_json_string(TextBuffer *buffer, const char *text) {
+    text_append(buffer, "\"", 1);
+    for (const char *p = text; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            char escaped[2] = { '\\', (char)c };
+            text_append(buffer, escaped, 2);
+        } else if (c == '\n') {
+            text_append(buffer, "\\n", 2);
+        } else if (c < 0x20) {
+            text_printf(buffer, "\\u%04x", c);
+        } else {
+            text_append(buffer, p, 1);
+        }
+    }
+    text_append(buffer, "\"", 1);
+}
+
+/*===========================================================================
+ * SECTION 3: JSON READING
+ * Messages are read in place: lookups walk the raw text, and only strings
+ * that are kept (URIs, document text) are decoded into new memory.
+ *===========================================================================*/
+
+static const char *json_skip_space(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+/* Return the first byte after the JSON value at p */
+static const char *json_skip_value(const char *p) {
+    p = json_skip_space(p);
+    if (*p == '"') {
+        p++;
+        while (*p && *p != '"') {
+            if (*p == '\\' && p[1]) p++;
+            p++;
+        }
+        return *p ? p + 1 : p;
+    }
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        do {
+            if (*p == '"') {
+                p = json_skip_value(p);
+                continue;
+            }
+            if (*p == '{' || *p == '[') depth++;
+            else if (*p == '}' || *p == ']') depth--;
+            p++;
+        } while (*p && depth > 0);
+        return p;
+    }
+    while (*p && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') p++;
+    return p;
+}
+
+/* Value of member key in the object at p, or NULL */
+static const char *json_member(const char *object, const char *key) {
+    if (!object) return NULL;
+    const char *p = json_skip_space(object);
+    if (*p != '{') return NULL;
+    p = json_skip_space(p + 1);
+    int key_length = strlen(key);
+
+    while (*p == '"') {
+        const char *name = p + 1;
+        const char *name_end = json_skip_value(p) - 1;
+        const char *value = json_skip_space(name_end + 1);
+        if (*value != ':') return NULL;
+        value = json_skip_space(value + 1);
+        if (name_end - name == key_length && strncmp(name, key, key_length) == 0) return value;
+
+        p = json_skip_space(json_skip_value(value));
+        if (*p == ',') p = json_skip_space(p + 1);
+    }
+    return NULL;
+}
+
+/* First element of the array at p, or NULL if empty */
+static const char *json_first(const char *array) {
+    if (!array || *array != '[') return NULL;
+    const char *p = json_skip_space(array + 1);
+    return *p == ']' ? NULL : p;
+}
+
+/* Element after item, or NULL at the end of the array */
+static const char *json_next(const char *item) {
+    const char *p = json_skip_space(json_skip_value(item));
+    return *p == ',' ? json_skip_space(p + 1) : NULL;
+}
+
+/* Does the JSON string at p equal text? */
+static int json_is(const char *p, const char *text) {
+    int length = strlen(text);
+    return p && *p == '"' && strncmp(p + 1, text, length) == 0 && p[length + 1] == '"';
+}
+
+static int json_int(const char *p, int fallback) {
+    if (!p || (*p != '-' && (*p < '0' || *p > '9'))) return fallback;
+    return (int)strtol(p, NULL, 10);
+}
+
+static int json_hex4(const char *p) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' :
+                    c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                    c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (digit < 0) return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+/* Decode the JSON string at p into new memory (UTF-8); NULL if p is not a string */
+static char *json_string(const char *p, int *length) {
+    if (!p || *p != '"') return NULL;
+    const char *end = json_skip_value(p);
+    char *out = lsp_realloc(NULL, end - p + 1);
+    int n = 0;
+
+    for (p++; p < end - 1; p++) {
+        if (*p != '\\') {
+            out[n++] = *p;
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case 'n': out[n++] = '\n'; break;
+            case 't': out[n++] = '\t'; break;
+            case 'r': out[n++] = '\r'; break;
+            case 'b': out[n++] = '\b'; break;
+            case 'f': out[n++] = '\f'; break;
+            case 'u': {
+                int code = json_hex4(p + 1);
+                if (code < 0) break;
+                p += 4;
+                if (code >= 0xD800 && code < 0xDC00 && p[1] == '\\' && p[2] == 'u') {
+                    int low = json_hex4(p + 3);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                if (code < 0x80) {
+                    out[n++] = (char)code;
+                } else if (code < 0x800) {
+                    out[n++] = (char)(0xC0 | (code >> 6));
+                    out[n++] = (char)(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    out[n++] = (char)(0xE0 | (code >> 12));
+                    out[n++] = (char)(0x80 | ((code >> 6) & 0x3F));
+                    out[n++] = (char)(0x80 | (code & 0x3F));
+                } else {
+                    out[n++] = (char)(0xF0 | (code >> 18));
+                    out[n++] = (char)(0x80 | ((code >> 12) & 0x3F));
+                    out[n++] = (char)(0x80 | ((code >> 6) & 0x3F));
+                    out[n++] = (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: out[n++] = *p; break;  // \" \\ \/
+        }
+    }
+    out[n] = '\0';
+    if (length) *length = n;
+    return out;
+}
+
+/*===========================================================================
+ * SECTION 4: DOCUMENTS
+ *===========================================================================*/
+
+static int document_find(LspServer *server, const char *uri) {
+    for (int i = 0; i < server->document_count; i++) {
+        if (strcmp(server->documents[i].uri, uri) == 0) return i;
+    }
+    return -1;
+}
+
+/* Lex the whole document into its token stream */
+static void document_lex(LspDocument *document) {
+    lexer_stream_free(&document->tokens);
+    if (!lexer_stream_init(&document->tokens, document->lang, document->text, document->length)) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+}
+
+static int token_line(const LspDocument *document, int index) {
+    TokenView token;
+    lexer_stream_get(&document->tokens, index, &token);
+    return token.line;
+}
+
+/* Drop the errors on old lines [first_line, last_line] and move the ones after them by line_delta */
+static void errors_patch(Error *errors, int *count, int first_line, int last_line, int line_delta) {
+    int kept = 0;
+    for (int i = 0; i < *count; i++) {
+        if (errors[i].line_number >= first_line && errors[i].line_number <= last_line) continue;
+        if (errors[i].line_number > last_line) errors[i].line_number += line_delta;
+        errors[kept++] = errors[i];
+    }
+    *count = kept;
+}
+
+/* Append the errors on lines from first_line on */
+static void errors_append(Error **errors, int *count, int *capacity, const Error *added, int added_count, int first_line) {
+    for (int i = 0; i < added_count; i++) {
+        if (added[i].line_number < first_line) continue;
+        if (*count == *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 16;
+            *errors = lsp_realloc(*errors, sizeof(Error) * *capacity);
+        }
+        (*errors)[(*count)++] = added[i];
+    }
+}
+
+/* Check tokens [first, end), whole lines from first_line on, into the document's diagnostics */
+static void document_check(LspServer *server, LspDocument *document, int first, int end, int first_line) {
+    int error_count = lexer_check_range(document->lang, document->text, &document->tokens, first, end - first,
+                                        server->errors, MAX_ERRORS * CHECK_COUNT);
+    // Statements that start before first_line keep their diagnostics
+    errors_append(&document->diagnostics, &document->diagnostic_count, &document->diagnostic_capacity,
+                  server->errors, error_count, first_line);
+}
+
+/* Byte offset of an LSP position (line, UTF-16 character), clamped to the text */
+static int position_to_offset(const LspDocument *document, int line, int character) {
+    int offset = 0;
+    for (; line > 0; line--) {
+        const char *newline = memchr(document->text + offset, '\n', document->length - offset);
+        if (!newline) return document->length;
+        offset = newline - document->text + 1;
+    }
+    for (int units = 0; units < character && offset < document->length && document->text[offset] != '\n';) {
+        units += utf16_units(document->text[offset++]);
+        while (offset < document->length && utf16_units(document->text[offset]) == 0) offset++;
+    }
+    return offset;
+}
+
+/* Replace text[start .. end), patch the token stream and re-check the changed lines */
+static void document_edit(LspServer *server, LspDocument *document, int start, int end, const char *text,
+                          int text_length) {
+    int new_length = document->length - (end - start) + text_length;
+    if (new_length + 1 > document->capacity) {
+        document->capacity = (new_length + 1) * 2;
+        document->text = lsp_realloc(document->text, document->capacity);
+    }
+    memmove(document->text + start + text_length, document->text + end, document->length - end + 1);
+    memcpy(document->text + start, text, text_length);
+    document->length = new_length;
+
+    TextEdit edit = { start, end - start, text_length };
+    RelexResult change;
+    if (!lexer_relex(document->lang, document->text, document->length, &edit, &document->tokens, &change)) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+
+    // Changed lines run from the last token kept before the edit to the first one kept after it,
+    // and the check goes on to the end of their type region, where types recorded in them expire
+    const TokenStream *tokens = &document->tokens;
+    int first = change.first_changed, resync = first + change.inserted_count;
+    int first_line = first > 0 ? token_line(document, first - 1) : 1;
+    int last_line = resync < tokens->count ? token_line(document, resync) : tokens->end_line;
+    int check_start = first, check_end = lexer_type_region_end(document->lang, document->text, tokens, resync);
+    while (check_start > 0 && token_line(document, check_start - 1) >= first_line) check_start--;
+    if (check_end > check_start && token_line(document, check_end - 1) > last_line) {
+        last_line = token_line(document, check_end - 1);
+    }
+    while (check_end < tokens->count && token_line(document, check_end) <= last_line) check_end++;
+
+    int old_last_line = last_line - change.line_delta;
+    errors_patch(document->diagnostics, &document->diagnostic_count, first_line, old_last_line, change.line_delta);
+    errors_patch(document->undeclared, &document->undeclared_count, first_line, old_last_line, change.line_delta);
+    document_check(server, document, check_start, check_end, first_line);
+}
+
+/* Re-check the whole document after it was (re)loaded */
+static void document_check_all(LspServer *server, LspDocument *document) {
+    document->diagnostic_count = 0;
+    document->undeclared_count = 0;
+    document_check(server, document, 0, document->tokens.count, 1);
+}
+
+/* Whole-document pass for undeclared identifiers, on a layout-aware lex of the text */
+static void document_check_names(LspServer *server, LspDocument *document) {
+    LexerIterator iter;
+    TokenView view;
+    int count = 0, line_start = 0, scanned = 0;
+    lexer_iter_init(&iter, document->lang, document->text, document->length);
+    while (lexer_iter_next(&iter, &view)) {
+        if (count == server->analysis_capacity) {
+            server->analysis_capacity = server->analysis_capacity ? server->analysis_capacity * 2 : 1024;
+            server->analysis_tokens = lsp_realloc(server->analysis_tokens, sizeof(Token) * server->analysis_capacity);
+        }
+        Token *token = &server->analysis_tokens[count++];
+        int length = view.length < MAX_VALUE - 1 ? view.length : MAX_VALUE - 1;
+        memcpy(token->value, document->text + view.start, length);
+        token->value[length] = '\0';
+        strcpy(token->type, token_kind_name(view.kind));
+        for (; scanned < view.start; scanned++) {
+            if (document->text[scanned] == '\n') line_start = scanned + 1;
+        }
+        token->line = view.line;
+        token->column = view.start - line_start + 1;
+    }
+
+    int error_count = 0;
+    if (document->lang == LANG_PYTHON) check_undeclared_identifier_python(server->analysis_tokens, count, server->errors, &error_count);
+    else check_undeclared_identifier_typescript(server->analysis_tokens, count, server->errors, &error_count);
+    document->undeclared_count = 0;
+    errors_append(&document->undeclared, &document->undeclared_count, &document->undeclared_capacity,
+                  server->errors, error_count, 1);
+}
+
+/* Run the analysis once the document has been quiet for delay_ms */
+static void document_schedule(LspDocument *document, int delay_ms) {
+    document->dirty = 1;
+    document->due_ms = now_ms() + delay_ms;
+}
+
+static void document_remove(LspServer *server, int index) {
+    LspDocument *document = &server->documents[index];
+    lexer_free(document->uri);
+    lexer_free(document->text);
+    lexer_stream_free(&document->tokens);
+    lexer_free(document->diagnostics);
+    lexer_free(document->undeclared);
+    server->documents[index] = server->documents[--server->document_count];
+}
+
+static Language language_for(const char *language_id, const char *uri) {
+    if (language_id) return json_is(language_id, "python") ? LANG_PYTHON : LANG_TYPESCRIPT;
+    const char *ext = strrchr(uri, '.');
+    return ext && strcmp(ext, ".py") == 0 ? LANG_PYTHON : LANG_TYPESCRIPT;
+}
+
+/*===========================================================================
+ * SECTION 5: MESSAGES TO THE CLIENT
+ *===========================================================================*/
+
+static void lsp_send(TextBuffer *body) {
+    printf("Content-Length: %d\r\n\r\n", body->length);
+    fwrite(body->data, 1, body->length, stdout);
+    fflush(stdout);
+    lexer_free(body->data);
+}
+
+static void send_result(const char *id, int id_length, const char *result) {
+    TextBuffer body = {0};
+    text_printf(&body, "{\"jsonrpc\":\"2.0\",\"id\":%.*s,\"result\":%s}", id_length, id, result);
+    lsp_send(&body);
+}
+
+static void send_error(const char *id, int id_length, int code, const char *message) {
+    TextBuffer body = {0};
+    text_printf(&body, "{\"jsonrpc\":\"2.0\",\"id\":%.*s,\"error\":{\"code\":%d,\"message\":", id_length, id, code);
+    text_append_json_string(&body, message);
+    text_append(&body, "}}", 2);
+    lsp_send(&body);
+}
+
+static void send_capabilities(const char *id, int id_length) {
+    TextBuffer result = {0};
+    text_printf(&result, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                         "\"semanticTokensProvider\":{\"legend\":{\"tokenTypes\":[");
+    for (size_t i = 0; i < sizeof(SEMANTIC_TOKEN_TYPES) / sizeof(SEMANTIC_TOKEN_TYPES[0]); i++) {
+        text_printf(&result, "%s\"%s\"", i ? "," : "", SEMANTIC_TOKEN_TYPES[i]);
+    }
+    text_printf(&result, "],\"tokenModifiers\":[]},\"full\":true}},\"serverInfo\":{\"name\":\"lexer\"}}");
+    send_result(id, id_length, result.data);
+    lexer_free(result.data);
+}
+
+/* Append one diagnostic per error to the publishDiagnostics body */
+static void append_diagnostics(TextBuffer *body, const LspDocument *document, const Error *errors, int error_count,
+                               const int *line_starts, int line_count, int *emitted) {
+    for (int i = 0; i < error_count; i++) {
+        const Error *error = &errors[i];
+        int line = error->line_number - 1;
+        if (line < 0) line = 0;
+        if (line >= line_count) line = line_count - 1;
+        int width = 0;
+        for (int j = line_starts[line]; j < line_starts[line + 1] - 1; j++) width += utf16_units(document->text[j]);
+
+        text_printf(body, "%s{\"range\":{\"start\":{\"line\":%d,\"character\":0},\"end\":{\"line\":%d,\"character\":%d}},"
+                          "\"severity\":1,\"source\":\"lexer\",\"code\":\"%s\",\"message\":",
+                    (*emitted)++ ? "," : "", line, line, width, DIAGNOSTIC_CODES[error->type]);
+        text_append_json_string(body, error->message);
+        text_append(body, "}", 1);
+    }
+}
+
+/* Refresh the undeclared identifiers and publish all diagnostics of the document */
+static void publish_diagnostics(LspServer *server, LspDocument *document) {
+    document_check_names(server, document);
+
+    // Line starts, to underline each reported line
+    int line_count = 1;
+    for (int i = 0; i < document->length; i++) {
+        if (document->text[i] == '\n') line_count++;
+    }
+    int *line_starts = lsp_realloc(NULL, sizeof(int) * (line_count + 1));
+    line_starts[0] = 0;
+    for (int i = 0, line = 1; i < document->length; i++) {
+        if (document->text[i] == '\n') line_starts[line++] = i + 1;
+    }
+    line_starts[line_count] = document->length + 1;
+
+    TextBuffer body = {0};
+    text_printf(&body, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    text_append_json_string(&body, document->uri);
+    text_printf(&body, ",\"version\":%d,\"diagnostics\":[", document->version);
+    int emitted = 0;
+    append_diagnostics(&body, document, document->diagnostics, document->diagnostic_count, line_starts, line_count, &emitted);
+    append_diagnostics(&body, document, document->undeclared, document->undeclared_count, line_starts, line_count, &emitted);
+    text_append(&body, "]}}", 3);
+    lsp_send(&body);
+    lexer_free(line_starts);
+}
+
+static void publish_no_diagnostics(const char *uri) {
+    TextBuffer body = {0};
+    text_printf(&body, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    text_append_json_string(&body, uri);
+    text_append(&body, ",\"diagnostics\":[]}}", 19);
+    lsp_send(&body);
+}
+
+/* Semantic tokens straight from the token stream (relative encoding, UTF-16 columns) */
+static void send_semantic_tokens(const char *id, int id_length, const LspDocument *document) {
+    TextBuffer body = {0};
+    text_printf(&body, "{\"jsonrpc\":\"2.0\",\"id\":%.*s,\"result\":{\"data\":[", id_length, id);
+
+    const char *text = document->text;
+    int position = 0, line = 0, column = 0;     // Walk position and its line/column
+    int previous_line = 0, previous_column = 0, emitted = 0;
+    for (int i = 0; i < document->tokens.count; i++) {
+        TokenView token;
+        lexer_stream_get(&document->tokens, i, &token);
+        int type = SEMANTIC_TOKEN_TYPE_OF_KIND[token.kind];
+        if (type < 0) continue;
+
+        for (; position < token.start; position++) {
+            if (text[position] == '\n') {
+                line++;
+                column = 0;
+            } else {
+                column += utf16_units(text[position]);
+            }
+        }
+        // Tokens spanning lines are reported up to the end of their first line
+        int width = 0;
+        for (int j = token.start; j < token.start + token.length && text[j] != '\n'; j++) width += utf16_units(text[j]);
+
+        int delta_line = line - previous_line;
+        int delta_column = delta_line == 0 ? column - previous_column : column;
+        text_printf(&body, "%s%d,%d,%d,%d,0", emitted ? "," : "", delta_line, delta_column, width, type);
+        previous_line = line;
+        previous_column = column;
+        emitted = 1;
+    }
+    text_append(&body, "]}}", 3);
+    lsp_send(&body);
+}
+
+/*===========================================================================
+ * SECTION 6: MESSAGE HANDLING
+ *===========================================================================*/
+
+static void handle_did_open(LspServer *server, const char *params) {
+    const char *item = json_member(params, "textDocument");
+    char *uri = json_string(json_member(item, "uri"), NULL);
+    int length;
+    char *text = json_string(json_member(item, "text"), &length);
+    if (!uri || !text) {
+        lexer_free(uri);
+        lexer_free(text);
+        return;
+    }
+
+    int index = document_find(server, uri);
+    if (index >= 0) document_remove(server, index);
+    if (server->document_count == server->document_capacity) {
+        server->document_capacity = server->document_capacity ? server->document_capacity * 2 : 8;
+        server->documents = lsp_realloc(server->documents, sizeof(LspDocument) * server->document_capacity);
+    }
+    LspDocument *document = &server->documents[server->document_count++];
+    memset(document, 0, sizeof(LspDocument));
+    document->uri = uri;
+    document->lang = language_for(json_member(item, "languageId"), uri);
+    document->version = json_int(json_member(item, "version"), 0);
+    document->text = text;
+    document->length = length;
+    document->capacity = length + 1;
+
+    document_lex(document);
+    document_check_all(server, document);
+    document_schedule(document, 0);
+}
+
+static void handle_did_change(LspServer *server, const char *params) {
+    const char *item = json_member(params, "textDocument");
+    char *uri = json_string(json_member(item, "uri"), NULL);
+    if (!uri) return;
+    int index = document_find(server, uri);
+    lexer_free(uri);
+    if (index < 0) return;
+
+    LspDocument *document = &server->documents[index];
+    document->version = json_int(json_member(item, "version"), document->version);
+    for (const char *change = json_first(json_member(params, "contentChanges")); change; change = json_next(change)) {
+        int text_length;
+        char *text = json_string(json_member(change, "text"), &text_length);
+        if (!text) continue;
+
+        const char *range = json_member(change, "range");
+        if (range) {
+            const char *start = json_member(range, "start");
+            const char *end = json_member(range, "end");
+            int start_offset = position_to_offset(document, json_int(json_member(start, "line"), 0),
+                                                  json_int(json_member(start, "character"), 0));
+            int end_offset = position_to_offset(document, json_int(json_member(end, "line"), 0),
+                                                json_int(json_member(end, "character"), 0));
+            if (end_offset < start_offset) end_offset = start_offset;
+            document_edit(server, document, start_offset, end_offset, text, text_length);
+            lexer_free(text);
+        } else {
+            // Full text replacement
+            lexer_free(document->text);
+            document->text = text;
+            document->length = text_length;
+            document->capacity = text_length + 1;
+            document_lex(document);
+            document_check_all(server, document);
+        }
+    }
+    document_schedule(document, LSP_DEBOUNCE_MS);
+}
+
+static void handle_did_close(LspServer *server, const char *params) {
+    char *uri = json_string(json_member(json_member(params, "textDocument"), "uri"), NULL);
+    if (!uri) return;
+    int index = document_find(server, uri);
+    if (index >= 0) {
+        document_remove(server, index);
+        publish_no_diagnostics(uri);
+    }
+    lexer_free(uri);
+}
+
+/* Handle one message; returns the exit code once the client sends "exit", otherwise -1 */
+static int handle_message(LspServer *server, const char *message) {
+    const char *method = json_member(message, "method");
+    const char *id = json_member(message, "id");
+    const char *params = json_member(message, "params");
+    int id_length = id ? (int)(json_skip_value(id) - id) : 0;
+    if (!method) return -1;     // A response; the server sends no requests
+
+    if (json_is(method, "initialize")) {
+        send_capabilities(id, id_length);
+    } else if (json_is(method, "shutdown")) {
+        server->shutdown_requested = 1;
+        send_result(id, id_length, "null");
+    } else if (json_is(method, "exit")) {
+        return server->shutdown_requested ? 0 : 1;
+    } else if (json_is(method, "textDocument/didOpen")) {
+        handle_did_open(server, params);
+    } else if (json_is(method, "textDocument/didChange")) {
+        handle_did_change(server, params);
+    } else if (json_is(method, "textDocument/didClose")) {
+        handle_did_close(server, params);
+    } else if (json_is(method, "textDocument/semanticTokens/full")) {
+        char *uri = json_string(json_member(json_member(params, "textDocument"), "uri"), NULL);
+        int index = uri ? document_find(server, uri) : -1;
+        lexer_free(uri);
+        if (index >= 0) send_semantic_tokens(id, id_length, &server->documents[index]);
+        else send_result(id, id_length, "null");
+    } else if (id) {
+        // Every request is answered before the next message is read, so $/cancelRequest is ignored
+        send_error(id, id_length, LSP_METHOD_NOT_FOUND, "Method not found");
+    }
+    return -1;
+}
+
+/*===========================================================================
+ * SECTION 7: EVENT LOOP
+ *===========================================================================*/
+
+/* Content-Length of the header that ends at header_end; -1 if it is missing or not a plain
+   decimal number up to LSP_MAX_MESSAGE */
+static long content_length(const char *header, const char *header_end) {
+    const char *field = strstr(header, "Content-Length:");
+    if (!field || field > header_end) return -1;
+    const char *digits = field + 15;
+    while (*digits == ' ' || *digits == '\t') digits++;
+    if (*digits < '0' || *digits > '9') return -1;     // strtol would also take a sign or a line break
+
+    char *end;
+    errno = 0;
+    long length = strtol(digits, &end, 10);
+    while (*end == ' ' || *end == '\t') end++;
+    if (errno == ERANGE || length > LSP_MAX_MESSAGE || end[0] != '\r' || end[1] != '\n') return -1;
+    return length;
+}
+
+/**
+ * Take the next complete message from the input buffer (NUL-terminated copy into *message)
+ * Returns 1 if there was one, 0 if more input is needed and -1 if the header is malformed:
+ * the stream can then no longer be framed and the connection must be dropped.
+ */
+static int take_message(LspServer *server, char **message) {
+    server->input[server->input_length] = '\0';
+    char *header_end = strstr(server->input, "\r\n\r\n");
+    if (!header_end) return server->input_length > LSP_MAX_HEADER ? -1 : 0;
+    int body_start = header_end + 4 - server->input;
+    long body_length = content_length(server->input, header_end);
+    if (body_length < 0) return -1;
+    if (server->input_length < body_start + body_length) return 0;
+
+    char *body = lsp_realloc(NULL, body_length + 1);
+    memcpy(body, server->input + body_start, body_length);
+    body[body_length] = '\0';
+    server->input_length -= body_start + body_length;
+    memmove(server->input, server->input + body_start + body_length, server->input_length);
+    *message = body;
+    return 1;
+}
+
+/* Read more input; returns 0 once stdin is closed */
+static int read_input(LspServer *server) {
+    if (server->input_length + LSP_READ_BLOCK + 1 > server->input_capacity) {
+        server->input_capacity = (server->input_length + LSP_READ_BLOCK + 1) * 2;
+        server->input = lsp_realloc(server->input, server->input_capacity);
+    }
+    for (;;) {
+        ssize_t bytes = read(STDIN_FILENO, server->input + server->input_length, LSP_READ_BLOCK);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) return 0;
+        server->input_length += bytes;
+        return 1;
+    }
+}
+
+static int input_pending(void) {
+    struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&input, 1, 0) > 0;
+}
+
+/* Milliseconds until the next debounced pass is due, or -1 if none is pending */
+static int next_analysis_timeout(LspServer *server) {
+    long long now = now_ms(), timeout = -1;
+    for (int i = 0; i < server->document_count; i++) {
+        if (!server->documents[i].dirty) continue;
+        long long wait = server->documents[i].due_ms > now ? server->documents[i].due_ms - now : 0;
+        if (timeout < 0 || wait < timeout) timeout = wait;
+    }
+    return (int)timeout;
+}
+
+/* Publish documents whose debounce expired, yielding as soon as the client sends more */
+static void analyze_due_documents(LspServer *server) {
+    long long now = now_ms();
+    for (int i = 0; i < server->document_count; i++) {
+        LspDocument *document = &server->documents[i];
+        if (!document->dirty || document->due_ms > now) continue;
+        if (input_pending()) return;
+        publish_diagnostics(server, document);
+        document->dirty = 0;
+    }
+}
+
+int run_lsp(void) {
+    LspServer server = {0};
+    server.errors = lexer_malloc(sizeof(Error) * MAX_ERRORS * CHECK_COUNT);
+    server.input_capacity = LSP_READ_BLOCK + 1;
+    server.input = lexer_malloc(server.input_capacity);
+    if (!server.errors || !server.input) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+
+    int exit_code = 1;      // Stdin closed without "exit"
+    for (;;) {
+        char *message;
+        int taken = take_message(&server, &message);
+        if (taken < 0) {
+            fprintf(stderr, "Error: Malformed message header\n");
+            break;
+        }
+        if (taken) {
+            int status = handle_message(&server, message);
+            lexer_free(message);
+            if (status >= 0) {
+                exit_code = status;
+                break;
+            }
+            continue;
+        }
+
+        struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+        int ready = poll(&input, 1, next_analysis_timeout(&server));
+        if (ready == 0) {
+            analyze_due_documents(&server);
+        } else if (ready < 0 && errno != EINTR) {
+            break;
+        } else if (ready > 0 && !read_input(&server)) {
+            break;
+        }
+    }
+
+    while (server.document_count > 0) document_remove(&server, server.document_count - 1);
+    lexer_free(server.documents);
+    lexer_free(server.analysis_tokens);
+    lexer_free(server.errors);
+    lexer_free(server.input);
+    return exit_code;
+}
@@ -0,0 +1,14 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - LANGUAGE SERVER
+ *
+ * Diagnostics and semantic tokens over the Language Server Protocol
+ * (JSON-RPC on stdin/stdout), used by ./lexer --lsp.
+ */
+
+#ifndef LSP_H
+#define LSP_H
+
+/* Serve until the client sends "exit"; returns the process exit code */
+int run_lsp(void);
+
+#endif
@@ -0,0 +1,834 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - COMMAND LINE TOOL
+ * 
+ * Analyzes one source file with liblexer and displays the results in the terminal.
+ * 
+ * Usage: ./lexer [--pipeline | --tree] <source_file.py|source_file.ts>
+ *        ./lexer --lsp              (language server on stdin/stdout)
+ *        ./lexer --daemon <socket>  (analysis daemon, see lexer-client)
+ *        ./lexer --watch <dir>      (re-analyze files as they change)
+ *        ./lexer [--report | --shard i/N] <files or directories...>  (machine-readable report)
+ *        Add --project to also check imports against all the files, --index <file> to
+ *        keep that index between runs (see project.h)
+ *        Add --stats to a file or report run for phase timings on stderr,
+ *        --perf for hardware counters per phase, --trace <out.json> for a Chrome trace
+ *        ./lexer --merge <reports...>  (combine shard reports)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "lsp.h"
+#include "daemon.h"
+#include "watch.h"
+#include "perf.h"
+#include "report.h"
+#include "stats.h"
+#include "trace.h"
+
+/*===========================================================================
+ * ANSI COLOR CODES FOR TERMINAL OUTPUT
+ *===========================================================================*/
+#define COLOR_RESET       "\033[0m"
+#define COLOR_BOLD        "\033[1m"
+
+// Comment colors
+#define COLOR_SINGLE_LINE_COMMENT   "\033[32m"  // Green
+#define COLOR_MULTI_LINE_COMMENT    "\033[36m"  // Cyan
+
+// Token attribute colors
+#define COLOR_KEYWORD         "\033[35m"  // Magenta
+#define COLOR_IDENTIFIER      "\033[33m"  // Yellow
+#define COLOR_LITERAL         "\033[34m"  // Blue
+#define COLOR_OPERATOR        "\033[31m"  // Red
+#define COLOR_DELIMITER       "\033[37m"  // White
+
+// Error type colors
+#define COLOR_ERROR_MISSPELL  "\033[93m"  // Bright Yellow
+#define COLOR_ERROR_TYPE      "\033[91m"  // Bright Red
+#define COLOR_ERROR_UNDECL    "\033[95m"  // Bright Magenta
+#define COLOR_ERROR_OPERATOR  "\033[96m"  // Bright Cyan
+
+// UI elements
+#define COLOR_HEADER          "\033[1;36m" // Bold Cyan
+#define COLOR_LINE_NUMBER     "\033[90m"   // Gray
+
+/*===========================================================================
+ * SECTION 1: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+/* Number of worker threads: $LEXER_THREADS if set, otherwise the online CPU count */
+int get_thread_count(void) {
+    const char *env = getenv("LEXER_THREADS");
+    long count = env ? strtol(env, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) count = 1;
+    if (count > MAX_THREADS) count = MAX_THREADS;
+    return (int)count;
+}
+
+/* Read entire file into a string */
+char *read_file(const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        printf("Error: Cannot open file '%s'\n", filename);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    char *content = lexer_malloc(size + 1);
+    fread(content, 1, size, file);
+    content[size] = '\0';
+    fclose(file);
+    return content;
+}
+
+/*===========================================================================
+ * SECTION 2: OUTPUT FUNCTIONS
+ *===========================================================================*/
+
+/* Helper function to get color for token attribute type */
+const char* get_token_attribute_color(const char* attribute_type) {
+    if (strcmp(attribute_type, "KEYWORD") == 0) {
+        return COLOR_KEYWORD;
+    } else if (strcmp(attribute_type, "IDENTIFIER") == 0) {
+        return COLOR_IDENTIFIER;
+    } else if (strstr(attribute_type, "LITERAL") != NULL) {
+        return COLOR_LITERAL;
+    } else if (strcmp(attribute_type, "OPERATOR") == 0) {
+        return COLOR_OPERATOR;
+    } else if (strcmp(attribute_type, "DELIMITER") == 0) {
+        return COLOR_DELIMITER;
+    }
+    return COLOR_RESET;
+}
+
+/* Helper function to get color for error type */
+const char* get_error_type_color(ErrorType error_type) {
+    switch(error_type) {
+        case ERROR_TYPE_MISSPELLED_KEYWORD:
+            return COLOR_ERROR_MISSPELL;
+        case ERROR_TYPE_TYPE_MISMATCH:
+            return COLOR_ERROR_TYPE;
+        case ERROR_TYPE_UNDECLARED_IDENTIFIER:
+            return COLOR_ERROR_UNDECL;
+        case ERROR_TYPE_INVALID_OPERATOR:
+            return COLOR_ERROR_OPERATOR;
+        default:
+            return COLOR_RESET;
+    }
+}
+
+/* Helper function to get error type name */
+const char* get_error_type_name(ErrorType error_type) {
+    switch(error_type) {
+        case ERROR_TYPE_MISSPELLED_KEYWORD:
+            return "MISSPELLED KEYWORD";
+        case ERROR_TYPE_TYPE_MISMATCH:
+            return "TYPE MISMATCH";
+        case ERROR_TYPE_UNDECLARED_IDENTIFIER:
+            return "UNDECLARED IDENTIFIER";
+        case ERROR_TYPE_INVALID_OPERATOR:
+            return "INVALID OPERATOR";
+        default:
+            return "UNKNOWN ERROR";
+    }
+}
+
+/* Print the tokenization table heading */
+void print_token_table_header(FILE *out) {
+    fprintf(out, "\n");
+    fprintf(out, "%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s║                         TOKENIZATION TABLE                           ║%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s┌──────────────────────────────────┬───────────────────────────────────┐%s\n", COLOR_BOLD, COLOR_RESET);
+    fprintf(out, "%s│%-34s│%-35s│%s\n", COLOR_BOLD, "            TOKEN", "           ATTRIBUTE", COLOR_RESET);
+    fprintf(out, "%s├──────────────────────────────────┼───────────────────────────────────┤%s\n", COLOR_BOLD, COLOR_RESET);
+}
+
+/* Print rows of the tokenization table */
+void print_token_rows(FILE *out, Token *tokens, int token_count) {
+    for (int i = 0; i < token_count; i++) {
+        const char* attribute_color = get_token_attribute_color(tokens[i].type);
+        fprintf(out, "│ %-32s │ %s%-33s%s │\n", 
+                     tokens[i].value, 
+                     attribute_color, 
+                     tokens[i].type, 
+                     COLOR_RESET);
+    }
+}
+
+/* Close the tokenization table */
+void print_token_table_footer(FILE *out) {
+    fprintf(out, "%s└──────────────────────────────────┴───────────────────────────────────┘%s\n", COLOR_BOLD, COLOR_RESET);
+}
+
+/* Print the comments section */
+void print_comments(FILE *out, Comment *comments, int comment_count) {
+    fprintf(out, "\n");
+    fprintf(out, "%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s║                         COMMENTS DETECTED                            ║%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "\n");
+    
+    if (comment_count == 0) {
+        fprintf(out, "  %s✓ No comments found in the source code.%s\n", COLOR_LINE_NUMBER, COLOR_RESET);
+    } else {
+        for (int i = 0; i < comment_count; i++) {
+            if (comments[i].is_multiline) {
+                fprintf(out, "%s[Lines %d-%d]%s %sMULTI-LINE%s\n%s%s%s\n", 
+                             COLOR_LINE_NUMBER,
+                             comments[i].start_line, 
+                             comments[i].end_line,
+                             COLOR_RESET,
+                             COLOR_BOLD,
+                             COLOR_RESET,
+                             COLOR_MULTI_LINE_COMMENT,
+                             comments[i].content,
+                             COLOR_RESET);
+            } else {
+                fprintf(out, "%s[Line %d]%s %sSINGLE-LINE%s: %s%s%s\n", 
+                             COLOR_LINE_NUMBER,
+                             comments[i].start_line,
+                             COLOR_RESET,
+                             COLOR_BOLD,
+                             COLOR_RESET,
+                             COLOR_SINGLE_LINE_COMMENT,
+                             comments[i].content,
+                             COLOR_RESET);
+            }
+        }
+    }
+}
+
+/* Print the error detection section */
+void print_errors(FILE *out, Error *errors, int error_count) {
+    fprintf(out, "\n");
+    fprintf(out, "%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s║                         ERROR DETECTION                              ║%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "\n");
+    
+    if (error_count == 0) {
+        fprintf(out, "  %s✓ No errors detected! Code is clean.%s\n", COLOR_SINGLE_LINE_COMMENT, COLOR_RESET);
+    } else {
+        for (int i = 0; i < error_count; i++) {
+            const char* error_color = get_error_type_color(errors[i].type);
+            const char* error_type_name = get_error_type_name(errors[i].type);
+            
+            fprintf(out, "  %s[Line %d]%s %s[%s]%s\n", 
+                         COLOR_LINE_NUMBER,
+                         errors[i].line_number,
+                         COLOR_RESET,
+                         error_color,
+                         error_type_name,
+                         COLOR_RESET);
+            fprintf(out, "    %s↳ %s%s\n\n", 
+                         COLOR_LINE_NUMBER,
+                         errors[i].message,
+                         COLOR_RESET);
+        }
+    }
+}
+
+/* Print all results */
+void print_results(FILE *out, Token *tokens, int token_count, Comment *comments, int comment_count, Error *errors, int error_count) {
+    print_token_table_header(out);
+    print_token_rows(out, tokens, token_count);
+    print_token_table_footer(out);
+    print_comments(out, comments, comment_count);
+    print_errors(out, errors, error_count);
+}
+
+/* Print the errors of one file, one line each (for runs over many files) */
+void print_file_errors(FILE *out, const char *filename, const Error *errors, int error_count) {
+    if (error_count == 0) {
+        fprintf(out, "%s✓ %s%s\n", COLOR_SINGLE_LINE_COMMENT, filename, COLOR_RESET);
+        return;
+    }
+    for (int i = 0; i < error_count; i++) {
+        fprintf(out, "%s%s:%d:%s %s[%s]%s %s\n",
+                     COLOR_BOLD, filename, errors[i].line_number, COLOR_RESET,
+                     get_error_type_color(errors[i].type), get_error_type_name(errors[i].type), COLOR_RESET,
+                     errors[i].message);
+    }
+}
+
+/* Print the mode banner and the name of the analyzed file */
+void print_banner(FILE *out, const char *filename, Language lang) {
+    const char* language_name = (lang == LANG_PYTHON) ? "Python" : "TypeScript";
+
+    fprintf(out, "\n%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s              LEXICAL ANALYZER - %s MODE                           %s\n", 
+                 COLOR_HEADER, 
+                 lang == LANG_PYTHON ? "PYTHON    " : "TYPESCRIPT", 
+                 COLOR_RESET);
+    fprintf(out, "%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "\n%sAnalyzing file:%s %s\n", COLOR_BOLD, COLOR_RESET, filename);
+    fprintf(out, "%sLanguage detected:%s %s\n", COLOR_BOLD, COLOR_RESET, language_name);
+}
+
+/* Print the syntax tree, one node per line, indented by depth, with its line and first tokens */
+void print_syntax_tree(FILE *out, const Token *tokens, const SyntaxTree *tree) {
+    fprintf(out, "\n");
+    fprintf(out, "%s╔══════════════════════════════════════════════════════════════════════╗%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s║                         SYNTAX TREE                                  ║%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "%s╚══════════════════════════════════════════════════════════════════════╝%s\n", COLOR_HEADER, COLOR_RESET);
+    fprintf(out, "\n");
+
+    int *depth = lexer_malloc(sizeof(int) * (tree->node_count + 1));
+    if (!depth) return;
+    for (int n = 0; n < tree->node_count; n++) {
+        const CstNode *node = &tree->nodes[n];
+        depth[n] = node->parent >= 0 ? depth[node->parent] + 1 : 0;
+        fprintf(out, "%*s%s%s%s", depth[n] * 2, "", COLOR_BOLD, cst_kind_name(node->kind), COLOR_RESET);
+        if (node->token_count > 0) fprintf(out, " %s[Line %d]%s", COLOR_LINE_NUMBER, tokens[node->first_token].line, COLOR_RESET);
+        for (int t = node->first_token; t < node->first_token + node->token_count && t < node->first_token + 6; t++) {
+            if (tokens[t].value[0]) fprintf(out, " %s", tokens[t].value);
+        }
+        fprintf(out, "%s\n", node->token_count > 6 ? " ..." : "");
+    }
+    lexer_free(depth);
+}
+
+/* Print the banner and the analysis results: the report for one file */
+void print_report(FILE *out, const char *filename, Language lang, const LexerResult *result) {
+    print_banner(out, filename, lang);
+    print_results(out, result->tokens, result->token_count, result->comments, result->comment_count,
+                  result->errors, result->error_count);
+}
+
+/*===========================================================================
+ * SECTION 3: PIPELINED ANALYSIS
+ * Reading, lexing, checking and printing run on separate threads. The reader
+ * publishes how many bytes have arrived; lexer, checker and printer hand each
+ * other batches of tokens through lock-free single-producer/single-consumer
+ * rings. The output is identical to the sequential path in main().
+ *===========================================================================*/
+
+#define PIPELINE_READ_BLOCK    (64 * 1024)
+#define PIPELINE_BATCH_TOKENS  128
+#define PIPELINE_RING_SLOTS    64    // Must be a power of two
+
+/* TokenBatch: a run of tokens already stored in the shared token array */
+typedef struct {
+    int first;
+    int count;
+} TokenBatch;
+
+/* BatchRing: single-producer/single-consumer queue of token batches */
+typedef struct {
+    TokenBatch slots[PIPELINE_RING_SLOTS];
+    atomic_uint head;   // Next slot to pop (written by the consumer only)
+    atomic_uint tail;   // Next slot to fill (written by the producer only)
+    atomic_int closed;  // Set by the producer after its last push
+} BatchRing;
+
+static void batch_ring_push(BatchRing *ring, TokenBatch batch) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == PIPELINE_RING_SLOTS) sched_yield();
+    ring->slots[tail % PIPELINE_RING_SLOTS] = batch;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+static void batch_ring_close(BatchRing *ring) {
+    atomic_store_explicit(&ring->closed, 1, memory_order_release);
+}
+
+/* Pop the next batch, waiting if necessary; returns 0 once the ring is closed and drained */
+static int batch_ring_pop(BatchRing *ring, TokenBatch *batch) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    while (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire) &&
+            atomic_load_explicit(&ring->tail, memory_order_acquire) == head) return 0;
+        sched_yield();
+    }
+    *batch = ring->slots[head % PIPELINE_RING_SLOTS];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+/* Pipeline: state shared by the stages */
+typedef struct {
+    FILE *file;
+    Language lang;
+    long source_size;
+    char *source_code;              // Filled by the reader
+    atomic_long bytes_read;
+    atomic_int read_done;
+    char *code_without_comments;    // Owned by the lexer
+    Token *tokens;                  // Written by the lexer, then read-only
+    Comment *comments;              // Valid once the lexer has finished
+    int comment_count;
+    Error *check_errors[CHECK_COUNT];   // One buffer per check, merged in order
+    int check_error_counts[CHECK_COUNT];
+    Error *errors;                  // Valid once the checker has finished
+    int error_count;
+    BatchRing lexed;                // Lexer -> checker
+    BatchRing checked;              // Checker -> printer
+} Pipeline;
+
+static void *pipeline_read_stage(void *arg) {
+    Pipeline *pipeline = arg;
+    long total = 0;
+    while (total < pipeline->source_size) {
+        long block = pipeline->source_size - total;
+        if (block > PIPELINE_READ_BLOCK) block = PIPELINE_READ_BLOCK;
+        size_t bytes = fread(pipeline->source_code + total, 1, block, pipeline->file);
+        if (bytes == 0) break;
+        total += bytes;
+        atomic_store_explicit(&pipeline->bytes_read, total, memory_order_release);
+    }
+    pipeline->source_code[total] = '\0';
+    atomic_store_explicit(&pipeline->read_done, 1, memory_order_release);
+    return NULL;
+}
+
+static void *pipeline_lex_stage(void *arg) {
+    Pipeline *pipeline = arg;
+    CommentScanner scanner = { 0, 0, 1, 0, 0, MAX_COMMENTS };
+    LexCursor cursor = { pipeline->code_without_comments, 0, 0, 1, 1, 0, { 0 } };
+    int token_count = 0, source_length = 0, is_final = 0;
+
+    while (!is_final) {
+        is_final = atomic_load_explicit(&pipeline->read_done, memory_order_acquire);
+        int available = (int)atomic_load_explicit(&pipeline->bytes_read, memory_order_acquire);
+
+        // The sequential path sees the file as a C string, so stop at a NUL byte too
+        const char *nul = memchr(pipeline->source_code + source_length, '\0', available - source_length);
+        if (nul) {
+            available = (int)(nul - pipeline->source_code);
+            is_final = 1;
+        }
+        if (available == source_length && !is_final) {
+            sched_yield();
+            continue;
+        }
+        source_length = available;
+
+        if (pipeline->lang == LANG_PYTHON) {
+            scan_comments_python(&scanner, pipeline->source_code, source_length, is_final,
+                                 pipeline->comments, pipeline->code_without_comments);
+        } else {
+            scan_comments_typescript(&scanner, pipeline->source_code, source_length, is_final,
+                                     pipeline->comments, pipeline->code_without_comments);
+        }
+
+        cursor.code_length = scanner.clean_index;
+        cursor.more_input = !is_final;
+        while (token_count < MAX_TOKENS) {
+            int batch_size = MAX_TOKENS - token_count < PIPELINE_BATCH_TOKENS ? MAX_TOKENS - token_count : PIPELINE_BATCH_TOKENS;
+            int lexed = tokenize_range(&cursor, cursor.code_length, pipeline->lang, pipeline->tokens + token_count, batch_size);
+            if (lexed == 0) break;
+            batch_ring_push(&pipeline->lexed, (TokenBatch){ token_count, lexed });
+            token_count += lexed;
+        }
+    }
+
+    pipeline->comment_count = scanner.comment_count < MAX_COMMENTS ? scanner.comment_count : MAX_COMMENTS;
+    batch_ring_close(&pipeline->lexed);
+    return NULL;
+}
+
+/**
+ * Checker stage
+ * Per-token checks run on each batch as it arrives. The type-mismatch check follows
+ * types from earlier assignments and the undeclared-identifier check needs every
+ * declaration, so both run once the stream is complete. Each check writes to its own
+ * buffer and the buffers are concatenated in the sequential order at the end.
+ */
+static void *pipeline_check_stage(void *arg) {
+    Pipeline *pipeline = arg;
+    int is_python = pipeline->lang == LANG_PYTHON;
+    int available = 0;
+    Error **errors = pipeline->check_errors;
+    int *counts = pipeline->check_error_counts;
+    TokenBatch batch;
+
+    while (batch_ring_pop(&pipeline->lexed, &batch)) {
+        Token *tokens = pipeline->tokens + batch.first;
+        if (is_python) {
+            check_misspelled_keyword_python(tokens, batch.count, errors[ERROR_TYPE_MISSPELLED_KEYWORD], &counts[ERROR_TYPE_MISSPELLED_KEYWORD]);
+            check_invalid_operator_python(tokens, batch.count, errors[ERROR_TYPE_INVALID_OPERATOR], &counts[ERROR_TYPE_INVALID_OPERATOR]);
+        } else {
+            check_misspelled_keyword_typescript(tokens, batch.count, errors[ERROR_TYPE_MISSPELLED_KEYWORD], &counts[ERROR_TYPE_MISSPELLED_KEYWORD]);
+            check_invalid_operator_typescript(tokens, batch.count, errors[ERROR_TYPE_INVALID_OPERATOR], &counts[ERROR_TYPE_INVALID_OPERATOR]);
+        }
+        available = batch.first + batch.count;
+        batch_ring_push(&pipeline->checked, batch);
+    }
+    batch_ring_close(&pipeline->checked);
+
+    if (is_python) {
+        check_type_mismatch_python(pipeline->tokens, available, errors[ERROR_TYPE_TYPE_MISMATCH], &counts[ERROR_TYPE_TYPE_MISMATCH]);
+        check_undeclared_identifier_python(pipeline->tokens, available, errors[ERROR_TYPE_UNDECLARED_IDENTIFIER], &counts[ERROR_TYPE_UNDECLARED_IDENTIFIER]);
+    } else {
+        check_type_mismatch_typescript(pipeline->tokens, available, errors[ERROR_TYPE_TYPE_MISMATCH], &counts[ERROR_TYPE_TYPE_MISMATCH]);
+        check_undeclared_identifier_typescript(pipeline->tokens, available, errors[ERROR_TYPE_UNDECLARED_IDENTIFIER], &counts[ERROR_TYPE_UNDECLARED_IDENTIFIER]);
+    }
+
+    pipeline->error_count = 0;
+    merge_check_errors(errors, counts, pipeline->errors, &pipeline->error_count, MAX_ERRORS);
+    return NULL;
+}
+
+static void pipeline_free(Pipeline *pipeline) {
+    lexer_free(pipeline->source_code);
+    lexer_free(pipeline->code_without_comments);
+    lexer_free(pipeline->tokens);
+    lexer_free(pipeline->comments);
+    lexer_free(pipeline->errors);
+    for (int c = 0; c < CHECK_COUNT; c++) lexer_free(pipeline->check_errors[c]);
+    lexer_free(pipeline);
+}
+
+/**
+ * Start the stages from the end of the chain, so that if one cannot be started the
+ * ones already running can be drained: a checker sees its input ring closed, a lexer
+ * sees the end of an empty file. Returns 0 if any stage failed to start.
+ */
+static int pipeline_start(Pipeline *pipeline, pthread_t *reader, pthread_t *lexer, pthread_t *checker) {
+    if (pthread_create(checker, NULL, pipeline_check_stage, pipeline) != 0) return 0;
+    if (pthread_create(lexer, NULL, pipeline_lex_stage, pipeline) != 0) {
+        batch_ring_close(&pipeline->lexed);
+        pthread_join(*checker, NULL);
+        return 0;
+    }
+    if (pthread_create(reader, NULL, pipeline_read_stage, pipeline) != 0) {
+        atomic_store_explicit(&pipeline->read_done, 1, memory_order_release);
+        pthread_join(*lexer, NULL);
+        pthread_join(*checker, NULL);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Analyze an open file with the pipelined stages and print the results (printer stage).
+ * Returns -1, having printed nothing and closed the file, if the buffers or threads
+ * could not be had; the caller then analyzes the file sequentially.
+ */
+int run_pipeline(FILE *file, Language lang) {
+    Pipeline *pipeline = lexer_malloc(sizeof(Pipeline));
+    if (!pipeline) {
+        fclose(file);
+        return -1;
+    }
+    memset(pipeline, 0, sizeof(Pipeline));
+    pipeline->file = file;
+    pipeline->lang = lang;
+    fseek(file, 0, SEEK_END);
+    pipeline->source_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    pipeline->source_code = lexer_malloc(pipeline->source_size + 1);
+    pipeline->code_without_comments = lexer_malloc(pipeline->source_size + 1);
+    pipeline->tokens = lexer_malloc(sizeof(Token) * MAX_TOKENS);
+    pipeline->comments = lexer_malloc(sizeof(Comment) * MAX_COMMENTS);
+    pipeline->errors = lexer_malloc(sizeof(Error) * MAX_ERRORS);
+    int allocated = pipeline->source_code && pipeline->code_without_comments && pipeline->tokens &&
+                    pipeline->comments && pipeline->errors;
+    for (int c = 0; c < CHECK_COUNT; c++) {
+        pipeline->check_errors[c] = lexer_malloc(sizeof(Error) * MAX_ERRORS);
+        if (!pipeline->check_errors[c]) allocated = 0;
+    }
+
+    pthread_t reader, lexer, checker;
+    if (!allocated || !pipeline_start(pipeline, &reader, &lexer, &checker)) {
+        pipeline_free(pipeline);
+        fclose(file);
+        return -1;
+    }
+
+    // Print tokens as soon as they have been checked
+    TokenBatch batch;
+    print_token_table_header(stdout);
+    while (batch_ring_pop(&pipeline->checked, &batch)) {
+        print_token_rows(stdout, pipeline->tokens + batch.first, batch.count);
+        fflush(stdout);
+    }
+    print_token_table_footer(stdout);
+
+    pthread_join(lexer, NULL);
+    print_comments(stdout, pipeline->comments, pipeline->comment_count);
+    pthread_join(checker, NULL);
+    print_errors(stdout, pipeline->errors, pipeline->error_count);
+    pthread_join(reader, NULL);
+
+    pipeline_free(pipeline);
+    fclose(file);
+    return 0;
+}
+
+/*===========================================================================
+ * SECTION 4: MAIN FUNCTION
+ *===========================================================================*/
+
+/* Validate and detect language from file extension */
+int validate_and_detect_language(const char *filename, Language *lang) {
+    const char *ext = strrchr(filename, '.');
+    
+    if (!ext || ext == filename) {
+        printf("%sError:%s File has no extension.\n", COLOR_BOLD, COLOR_RESET);
+        printf("Please provide a Python (.py) or TypeScript (.ts, .js) file.\n");
+        return 0;
+    }
+    
+    if (strcmp(ext, ".py") == 0) {
+        *lang = LANG_PYTHON;
+        return 1;
+    } else if (strcmp(ext, ".ts") == 0 || strcmp(ext, ".js") == 0) {
+        *lang = LANG_TYPESCRIPT;
+        return 1;
+    } else {
+        printf("%sError:%s Unsupported file extension '%s'.\n", COLOR_BOLD, COLOR_RESET, ext);
+        printf("Please provide a Python (.py) or TypeScript (.ts, .js) file.\n");
+        return 0;
+    }
+}
+
+/* Print the command line forms */
+void print_usage(const char *program) {
+    printf("%sUsage:%s %s [--stats] [--perf] [--trace out.json] [--pipeline | --tree] <source_file.py|source_file.ts>\n", COLOR_BOLD, COLOR_RESET, program);
+    printf("       %s [--stats] [--perf] [--trace out.json] [--report | --shard i/N] [--project] [--index file]\n", program);
+    printf("              <files or directories...>\n");
+    printf("       %s --merge <reports...>\n", program);
+    printf("       %s --lsp | --daemon <socket> | --watch <dir>\n\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    // Parse options (they come before the source file)
+    int use_pipeline = 0;
+    int show_tree = 0;
+    int use_lsp = 0;
+    const char *daemon_socket = NULL;
+    const char *watch_directory = NULL;
+    int use_report = 0, use_merge = 0;
+    int shard_index = 1, shard_count = 1;
+    int use_project = 0;
+    const char *index_path = NULL;
+    int show_stats = 0, show_perf = 0;
+    const char *trace_path = NULL;
+    int arg_index = 1;
+    while (arg_index < argc && strncmp(argv[arg_index], "--", 2) == 0) {
+        if (strcmp(argv[arg_index], "--pipeline") == 0) {
+            use_pipeline = 1;
+        } else if (strcmp(argv[arg_index], "--tree") == 0) {
+            show_tree = 1;
+        } else if (strcmp(argv[arg_index], "--lsp") == 0) {
+            use_lsp = 1;
+        } else if (strcmp(argv[arg_index], "--daemon") == 0 && arg_index + 1 < argc) {
+            daemon_socket = argv[++arg_index];
+        } else if (strcmp(argv[arg_index], "--watch") == 0 && arg_index + 1 < argc) {
+            watch_directory = argv[++arg_index];
+        } else if (strcmp(argv[arg_index], "--report") == 0) {
+            use_report = 1;
+        } else if (strcmp(argv[arg_index], "--shard") == 0 && arg_index + 1 < argc) {
+            char extra;
+            if (sscanf(argv[++arg_index], "%d/%d%c", &shard_index, &shard_count, &extra) != 2 ||
+                shard_count < 1 || shard_index < 1 || shard_index > shard_count) {
+                printf("\n%sError:%s Invalid shard '%s' (expected i/N with 1 <= i <= N).\n\n", COLOR_BOLD, COLOR_RESET, argv[arg_index]);
+                return 1;
+            }
+            use_report = 1;
+        } else if (strcmp(argv[arg_index], "--project") == 0) {
+            use_project = use_report = 1;
+        } else if (strcmp(argv[arg_index], "--index") == 0 && arg_index + 1 < argc) {
+            index_path = argv[++arg_index];
+            use_project = use_report = 1;
+        } else if (strcmp(argv[arg_index], "--merge") == 0) {
+            use_merge = 1;
+        } else if (strcmp(argv[arg_index], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[arg_index], "--perf") == 0) {
+            show_perf = 1;
+        } else if (strcmp(argv[arg_index], "--trace") == 0 && arg_index + 1 < argc) {
+            trace_path = argv[++arg_index];
+        } else {
+            printf("\n%sError:%s Unknown option '%s'.\n", COLOR_BOLD, COLOR_RESET, argv[arg_index]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        arg_index++;
+    }
+
+    if ((show_stats || show_perf || trace_path) && (use_pipeline || use_lsp || daemon_socket || watch_directory || use_merge)) {
+        printf("\n%sError:%s --stats, --perf and --trace work with single files and --report/--shard runs.\n\n",
+               COLOR_BOLD, COLOR_RESET);
+        return 1;
+    }
+
+    if (show_tree && (use_pipeline || use_lsp || daemon_socket || watch_directory || use_report || use_merge)) {
+        printf("\n%sError:%s --tree works with single files only (not with --pipeline).\n\n", COLOR_BOLD, COLOR_RESET);
+        return 1;
+    }
+
+    if (show_perf) perf_init();
+    if (trace_path) {
+        if (!trace_open(trace_path)) {
+            printf("\n%sError:%s Cannot write trace '%s'.\n\n", COLOR_BOLD, COLOR_RESET, trace_path);
+            return 1;
+        }
+        trace_thread_name("main");
+    }
+
+    // Server modes: inputs come from clients, not the command line
+    if (use_lsp) {
+        return run_lsp();
+    }
+    if (daemon_socket) {
+        return run_daemon(daemon_socket, get_thread_count(), print_report);
+    }
+    if (watch_directory) {
+        return run_watch(watch_directory, get_thread_count(), print_file_errors);
+    }
+
+    // Multi-file modes for CI
+    if ((use_report || use_merge) && argc - arg_index < 1) {
+        printf("\n%sError:%s No input files provided.\n\n", COLOR_BOLD, COLOR_RESET);
+        return 1;
+    }
+    if (use_merge) {
+        return run_merge(argv + arg_index, argc - arg_index);
+    }
+    if (use_report) {
+        return run_report(argv + arg_index, argc - arg_index, shard_index, shard_count, get_thread_count(), show_stats,
+                          show_perf, use_project, index_path);
+    }
+
+    // Validate command line arguments
+    if (argc - arg_index < 1) {
+        printf("\n%sError:%s No input file provided.\n", COLOR_BOLD, COLOR_RESET);
+        print_usage(argv[0]);
+        printf("Examples:\n");
+        printf("  %s script.py    %s# Analyze Python file\n", argv[0], COLOR_LINE_NUMBER);
+        printf("  %s script.ts    %s# Analyze TypeScript file\n", argv[0], COLOR_LINE_NUMBER);
+        printf("  %s script.js    %s# Analyze JavaScript file\n", argv[0], COLOR_LINE_NUMBER);
+        printf("%s\n", COLOR_RESET);
+        return 1;
+    }
+
+    if (argc - arg_index > 1) {
+        printf("\n%sError:%s Too many arguments provided.\n", COLOR_BOLD, COLOR_RESET);
+        printf("Please provide only one source file at a time.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    const char *filename = argv[arg_index];
+
+    // Validate file extension and detect language
+    Language detected_language;
+    if (!validate_and_detect_language(filename, &detected_language)) {
+        return 1;
+    }
+
+    // Read source file (in pipeline mode it is read while the analysis runs)
+    PhaseStats stats = { .files = 1 };
+    double run_start = stats_now();
+    if (show_stats) lexer_memory_begin();
+    char *source_code = NULL;
+    FILE *pipeline_file = NULL;
+    if (use_pipeline) {
+        pipeline_file = fopen(filename, "r");
+        if (!pipeline_file) {
+            printf("Error: Cannot open file '%s'\n", filename);
+            return 1;
+        }
+    } else {
+        trace_begin_file(filename);
+        trace_begin("read");
+        source_code = read_file(filename);
+        trace_end();
+        if (!source_code) return 1;
+        stats.seconds[PHASE_READ] = stats_now() - run_start;
+        stats.phase_bytes[PHASE_READ] = strlen(source_code);
+    }
+
+    print_banner(stdout, filename, detected_language);
+
+    if (use_pipeline) {
+        fflush(stdout);
+        int status = run_pipeline(pipeline_file, detected_language);
+        if (status >= 0) return status;
+        source_code = read_file(filename);     // The pipeline could not start
+        if (!source_code) return 1;
+    }
+
+    // Allocate memory for analysis (the token buffer is sized from the source by lexer_analyze_all)
+    Comment *comment_array = lexer_malloc(sizeof(Comment) * MAX_COMMENTS);
+    Error *error_array = lexer_malloc(sizeof(Error) * MAX_ERRORS);
+    LexerResult result = { NULL, 0, 0, comment_array, MAX_COMMENTS, 0, error_array, MAX_ERRORS, 0 };
+    LexerContext *context = lexer_create();
+    if (!context || !comment_array || !error_array) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+    lexer_set_threads(context, get_thread_count());
+    PerfCounters perf;
+    if (show_perf) perf_attach(&perf, context);
+    TraceHook trace;
+    trace_attach(&trace, context);
+
+    // Extract comments, tokenize and detect errors
+    int source_length = strlen(source_code);
+    lexer_set_source_name(context, filename);
+    if (!lexer_analyze_all(context, detected_language, source_code, source_length, &result)) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+    stats_add_analysis(&stats, context, source_length, &result);
+    stats.bytes = source_length;
+    stats.tokens = result.token_count;
+
+    // Display formatted results
+    double print_start = stats_now();
+    trace_begin("print");
+    print_results(stdout, result.tokens, result.token_count, result.comments, result.comment_count, result.errors, result.error_count);
+    if (show_tree) {
+        SyntaxTree tree = { 0 };
+        if (!lexer_parse(detected_language, result.tokens, result.token_count, &tree)) {
+            printf("Error: Out of memory\n");
+            return 1;
+        }
+        print_syntax_tree(stdout, result.tokens, &tree);
+        lexer_tree_free(&tree);
+    }
+    fflush(stdout);
+    trace_end();
+    trace_end_file();
+    if (show_stats) {
+        stats.seconds[PHASE_PRINT] = stats_now() - print_start;
+        stats.phase_bytes[PHASE_PRINT] = source_length;
+        stats.phase_tokens[PHASE_PRINT] = result.token_count;
+        print_stats(stderr, &stats, stats_now() - run_start, NULL, 0, NULL, 1);
+
+        LexerMemory file_memory, run_memory;
+        lexer_memory_end(&file_memory);
+        lexer_memory_process(&run_memory);
+        print_memory_stats(stderr, &run_memory, &file_memory, 1);
+    }
+    if (show_perf) {
+        perf.bytes = source_length;
+        perf.tokens = result.token_count;
+        print_perf(stderr, &perf);
+    }
+
+    // Cleanup memory
+    lexer_destroy(context);
+    lexer_free(source_code);
+    lexer_free(result.tokens);
+    lexer_free(comment_array);
+    lexer_free(error_array);
+
+    return 0;
+}
+
+
+
@@ -0,0 +1,163 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - HARDWARE COUNTERS
+ */
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "perf.h"
+
+/*===========================================================================
+ * SECTION 1: EVENTS
+ *===========================================================================*/
+
+#define CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} EVENTS[PERF_EVENT_COUNT] = {
+    [PERF_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    [PERF_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instr" },
+    [PERF_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "br-miss" },
+    [PERF_L1D_MISSES] = { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D), "L1D-miss" },
+    [PERF_LLC_MISSES] = { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL), "LLC-miss" },
+};
+
+// Set once by perf_init, before any analysis thread starts
+static int event_available[PERF_EVENT_COUNT];
+static int available_count;
+static int open_errno;
+
+/* Count event on the calling thread, user space only, starting now; returns the fd or -1 */
+static int open_event(PerfEvent event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = EVENTS[event].type;
+    attr.config = EVENTS[event].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+/* Read and close a counter; the count is scaled up if the event was multiplexed */
+static double close_event(int fd) {
+    uint64_t values[3];   // value, time enabled, time running
+    double count = 0;
+    if (read(fd, values, sizeof(values)) == sizeof(values) && values[2] > 0) {
+        count = values[2] < values[1] ? (double)values[0] * values[1] / values[2] : values[0];
+    }
+    close(fd);
+    return count;
+}
+
+int perf_init(void) {
+    available_count = 0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        int fd = open_event(e);
+        event_available[e] = fd >= 0;
+        if (fd >= 0) {
+            close(fd);
+            available_count++;
+        } else if (!open_errno) {
+            open_errno = errno;
+        }
+    }
+    return available_count;
+}
+
+/*===========================================================================
+ * SECTION 2: COUNTING
+ *===========================================================================*/
+
+/* The checks phase spans several threads, so its counts are the sum of the checks' */
+static void perf_phase_hook(void *data, LexerPhase phase, int is_end) {
+    PerfCounters *counters = data;
+    if (phase == LEXER_PHASE_CHECKS) return;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (!event_available[e]) continue;
+        if (!is_end) {
+            counters->fds[phase][e] = open_event(e);
+        } else if (counters->fds[phase][e] >= 0) {
+            counters->counts[phase][e] += close_event(counters->fds[phase][e]);
+            counters->fds[phase][e] = -1;
+        }
+    }
+}
+
+void perf_attach(PerfCounters *counters, LexerContext *context) {
+    memset(counters, 0, sizeof(PerfCounters));
+    for (int p = 0; p < LEXER_PHASE_COUNT; p++) {
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) counters->fds[p][e] = -1;
+    }
+    if (available_count > 0) lexer_set_phase_hook(context, perf_phase_hook, counters);
+}
+
+void perf_merge(PerfCounters *total, const PerfCounters *part) {
+    for (int p = 0; p < LEXER_PHASE_COUNT; p++) {
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) total->counts[p][e] += part->counts[p][e];
+    }
+    total->bytes += part->bytes;
+    total->tokens += part->tokens;
+}
+
+/*===========================================================================
+ * SECTION 3: OUTPUT
+ *===========================================================================*/
+
+static void print_perf_table(FILE *out, const double counts[LEXER_PHASE_COUNT][PERF_EVENT_COUNT], long long units,
+                             const char *unit) {
+    char heading[32];
+    fprintf(out, "  %-24s", "Phase");
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        snprintf(heading, sizeof(heading), "%s/%s", EVENTS[e].name, unit);
+        fprintf(out, " %14s", heading);
+    }
+    fprintf(out, " %6s\n", "IPC");
+
+    for (int p = 0; p < LEXER_PHASE_COUNT; p++) {
+        fprintf(out, "  %s%-*s", p >= LEXER_PHASE_CHECK_FIRST ? "  " : "", p >= LEXER_PHASE_CHECK_FIRST ? 22 : 24,
+                lexer_phase_name(p));
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            if (event_available[e] && units > 0) fprintf(out, " %14.4f", counts[p][e] / units);
+            else fprintf(out, " %14s", "-");
+        }
+        if (event_available[PERF_CYCLES] && event_available[PERF_INSTRUCTIONS] && counts[p][PERF_CYCLES] > 0) {
+            fprintf(out, " %6.2f\n", counts[p][PERF_INSTRUCTIONS] / counts[p][PERF_CYCLES]);
+        } else {
+            fprintf(out, " %6s\n", "-");
+        }
+    }
+}
+
+void print_perf(FILE *out, const PerfCounters *counters) {
+    if (available_count == 0) {
+        fprintf(out, "\nHardware counters unavailable (perf_event_open: %s)%s\n", strerror(open_errno),
+                open_errno == EACCES || open_errno == EPERM ? "; check /proc/sys/kernel/perf_event_paranoid" : "");
+        return;
+    }
+
+    double counts[LEXER_PHASE_COUNT][PERF_EVENT_COUNT];
+    memcpy(counts, counters->counts, sizeof(counts));
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        counts[LEXER_PHASE_CHECKS][e] = 0;
+        for (int c = 0; c < CHECK_COUNT; c++) counts[LEXER_PHASE_CHECKS][e] += counts[LEXER_PHASE_CHECK_FIRST + c][e];
+    }
+
+    fprintf(out, "\nHardware counters (user space, %lld bytes, %lld tokens)\n", counters->bytes, counters->tokens);
+    print_perf_table(out, counts, counters->bytes, "B");
+    fprintf(out, "\n");
+    print_perf_table(out, counts, counters->tokens, "tok");
+    if (available_count < PERF_EVENT_COUNT) {
+        fprintf(out, "  Events marked - are not supported here (perf_event_open: %s)\n", strerror(open_errno));
+    }
+}
@@ -0,0 +1,46 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - HARDWARE COUNTERS
+ *
+ * --perf: cycles, instructions, branch misses and L1D/LLC misses of each
+ * lexer_analyze phase and each check, counted with perf_event_open on the
+ * thread that runs the phase (user space only) and normalized per input byte
+ * and per token. Counters the kernel or CPU does not provide are reported as
+ * unavailable; the analysis itself is unaffected.
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdio.h>
+
+#include "lexer.h"
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_EVENT_COUNT
+} PerfEvent;
+
+/* PerfCounters: counts of one context (one thread); merged at the end of a run */
+typedef struct {
+    double counts[LEXER_PHASE_COUNT][PERF_EVENT_COUNT];   // Scaled for multiplexing
+    int fds[LEXER_PHASE_COUNT][PERF_EVENT_COUNT];         // Open while a phase runs
+    long long bytes;
+    long long tokens;
+} PerfCounters;
+
+/* Find out which events can be counted; returns how many (0: print_perf explains why) */
+int perf_init(void);
+
+/* Start counting on context: every phase of its analyses adds to counters */
+void perf_attach(PerfCounters *counters, LexerContext *context);
+
+void perf_merge(PerfCounters *total, const PerfCounters *part);
+
+/* Print the counters per byte and per token */
+void print_perf(FILE *out, const PerfCounters *counters);
+
+#endif
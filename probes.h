@@ -0,0 +1,33 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - USDT PROBES
+ *
+ * Built with -DLEXER_USDT (make USDT=1, needs <sys/sdt.h> from systemtap),
+ * probe sites become USDT probes of provider "lexer" that bpftrace, perf or
+ * SystemTap can attach to in a running process. Otherwise they compile to
+ * nothing and their arguments are not evaluated (only type-checked).
+ *
+ *   file_start   (name, bytes)                        lexer_analyze begins
+ *   file_end     (name, bytes, tokens, errors)        lexer_analyze ends
+ *   phase_start  (name, phase, bytes)                 a phase or check begins
+ *   phase_end    (name, phase, bytes, tokens)         a phase or check ends
+ *   diagnostic   (name, line, type, message)          one error reported (type: ErrorType)
+ *   cache_hit    (path, bytes)                        daemon served a cached report
+ *   cache_miss   (path, bytes)                        daemon had to analyze the file
+ *
+ * name is the source name given to lexer_set_source_name ("" if none); phase
+ * is a lexer_phase_name string. Example:
+ *   bpftrace -e 'usdt:./lexer:lexer:file_end { @bytes = hist(arg1); }'
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#ifdef LEXER_USDT
+#include <sys/sdt.h>
+#define LEXER_PROBE(name, ...) STAP_PROBEV(lexer, name, __VA_ARGS__)
+#else
+static inline void lexer_probe_args(int unused, ...) { (void)unused; }
+#define LEXER_PROBE(name, ...) do { if (0) lexer_probe_args(0, __VA_ARGS__); } while (0)
+#endif
+
+#endif
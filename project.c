@@ -0,0 +1,601 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - PROJECT INDEX
+ *
+ * The first phase of a project run: files are lexed in parallel for their
+ * module interfaces (files unchanged since the saved index are not lexed),
+ * which are then hashed by module path and by (file, name). In the second
+ * phase the report's workers resolve imports against the index without
+ * locking; nothing is written to it after it is built. See project.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "lexer.h"
+#include "project.h"
+
+#define MAX_CANDIDATES 16   // Modules an import is checked against (Python paths may match several files)
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+/* IndexedFile: one file of the project and its interface */
+typedef struct {
+    char *path;
+    char *key;              // Module the file is: normalized path without the extension
+    char *package;          // For __init__.py and index.ts/.js, the key of their directory, else NULL
+    Language lang;
+    long long size;
+    long long mtime;        // Nanoseconds
+    ModuleInterface module;
+    int indexed;            // 0 if the file could not be read
+    int cached;             // Interface taken from the saved index
+    int opaque;             // Any name may resolve: exports_all, or TypeScript without exports
+} IndexedFile;
+
+/* ModuleSlot: a path suffix of a module key ("pkg/utils" of "src/pkg/utils"); files may share one */
+typedef struct {
+    const char *suffix;     // Points into the key, NULL if the slot is empty
+    int file;
+    int whole;              // The suffix is the whole key
+} ModuleSlot;
+
+/* NameSlot: a name declared by a file */
+typedef struct {
+    const char *name;       // Points into the file's interface text, NULL if the slot is empty
+    int file;
+} NameSlot;
+
+struct ProjectIndex {
+    IndexedFile *files;     // Sorted by path
+    int file_count;
+    int cached_count;
+    ModuleSlot *module_slots;
+    int module_mask;
+    NameSlot *name_slots;
+    int name_mask;
+};
+
+typedef struct {
+    ProjectIndex *index;
+    IndexedFile *saved;     // Loaded from the saved index, sorted by path
+    int saved_count;
+    atomic_int next_file;   // Next file for a worker to take
+} IndexJobs;
+
+/*===========================================================================
+ * SECTION 2: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+static unsigned int hash_text(const char *text) {
+    unsigned int hash = 2166136261u;    // FNV-1a
+    for (; *text; text++) hash = (hash ^ (unsigned char)*text) * 16777619u;
+    return hash;
+}
+
+static int detect_language(const char *path, Language *lang) {
+    const char *ext = strrchr(path, '.');
+    if (!ext || ext == path) return 0;
+    if (strcmp(ext, ".py") == 0) {
+        *lang = LANG_PYTHON;
+        return 1;
+    }
+    if (strcmp(ext, ".ts") == 0 || strcmp(ext, ".js") == 0) {
+        *lang = LANG_TYPESCRIPT;
+        return 1;
+    }
+    return 0;
+}
+
+static char *read_source(const char *path, long long *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *content = size >= 0 ? lexer_malloc(size + 1) : NULL;
+    if (content) {
+        *length = fread(content, 1, size, file);
+        content[*length] = '\0';
+    }
+    fclose(file);
+    return content;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(((const IndexedFile *)a)->path, ((const IndexedFile *)b)->path);
+}
+
+static IndexedFile *find_file(IndexedFile *files, int count, const char *path) {
+    IndexedFile key = { .path = (char *)path };
+    return count > 0 ? bsearch(&key, files, count, sizeof(IndexedFile), compare_paths) : NULL;
+}
+
+/**
+ * path with empty and '.' segments and 'dir/..' pairs removed (a '..' that
+ * leaves the start is kept), and a .py/.ts/.js extension if strip_extension
+ * is set: src/./pkg/../utils.py is src/utils. Returns a malloc'd string.
+ */
+static char *normalize_path(const char *path, int strip_extension) {
+    char *result = malloc(strlen(path) + 1);
+    if (!result) return NULL;
+    int root = path[0] == '/', out = root;
+    if (root) result[0] = '/';
+
+    for (const char *segment = path; *segment;) {
+        const char *end = strchr(segment, '/');
+        if (!end) end = segment + strlen(segment);
+        int length = end - segment;
+        int last = out;         // Start of the last segment kept
+        while (last > root && result[last - 1] != '/') last--;
+        int last_is_up = out - last == 2 && result[last] == '.' && result[last + 1] == '.';
+
+        if (length == 2 && segment[0] == '.' && segment[1] == '.' && out > root && !last_is_up) {
+            out = last > root ? last - 1 : root;
+        } else if (length > 0 && !(length == 1 && segment[0] == '.')) {
+            if (out > root) result[out++] = '/';
+            memcpy(result + out, segment, length);
+            out += length;
+        }
+        segment = *end ? end + 1 : end;
+    }
+    result[out] = '\0';
+
+    char *ext = strrchr(result, '.');
+    if (strip_extension && ext && ext > result && ext[-1] != '/' && !strchr(ext, '/') &&
+        (strcmp(ext, ".py") == 0 || strcmp(ext, ".ts") == 0 || strcmp(ext, ".js") == 0)) {
+        *ext = '\0';
+    }
+    return result;
+}
+
+/* Length of the directory part of key ("src/pkg" of "src/pkg/utils"), 0 if none */
+static int directory_length(const char *key) {
+    const char *slash = strrchr(key, '/');
+    return slash ? (slash == key ? 1 : slash - key) : 0;
+}
+
+/* Write a tab and the field, escaped as in report.h */
+static void write_field(FILE *out, const char *text) {
+    fputc('\t', out);
+    for (; *text; text++) {
+        if (*text == '\t') fputs("\\t", out);
+        else if (*text == '\n') fputs("\\n", out);
+        else if (*text == '\\') fputs("\\\\", out);
+        else fputc(*text, out);
+    }
+}
+
+/* Split line at its tabs into at most max fields, unescaping each in place; returns the field count */
+static int split_fields(char *line, char **fields, int max) {
+    int count = 0;
+    char *field = line;
+    while (count < max) {
+        char *tab = strchr(field, '\t');
+        if (tab) *tab = '\0';
+        char *out = field;
+        for (char *in = field; *in; in++) {
+            if (*in == '\\' && in[1]) {
+                in++;
+                *out++ = *in == 't' ? '\t' : *in == 'n' ? '\n' : *in;
+            } else {
+                *out++ = *in;
+            }
+        }
+        *out = '\0';
+        fields[count++] = field;
+        if (!tab) break;
+        field = tab + 1;
+    }
+    return count;
+}
+
+/*===========================================================================
+ * SECTION 3: SAVED INDEX
+ *===========================================================================*/
+
+static void free_files(IndexedFile *files, int count) {
+    for (int i = 0; i < count; i++) {
+        free(files[i].path);
+        free(files[i].key);
+        free(files[i].package);
+        lexer_module_free(&files[i].module);
+    }
+    free(files);
+}
+
+/* The files of the index saved at path, sorted by path; none if it is missing or of another version */
+static IndexedFile *load_index(const char *path, int *count) {
+    *count = 0;
+    FILE *file = fopen(path, "r");
+    if (!file) return NULL;
+    IndexedFile *files = NULL;
+    int capacity = 0, ok = 1;
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+
+    while (ok && (length = getline(&line, &line_capacity, file)) > 0) {
+        if (line[length - 1] == '\n') line[--length] = '\0';
+        char *fields[6];
+        int field_count = split_fields(line, fields, 6);
+        IndexedFile *current = *count > 0 ? &files[*count - 1] : NULL;
+
+        if (strcmp(fields[0], "L") == 0) {
+            ok = field_count == 3 && strcmp(fields[1], "lexer-index") == 0 && atoi(fields[2]) == INDEX_VERSION;
+        } else if (strcmp(fields[0], "M") == 0 && field_count == 5) {
+            if (*count == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                IndexedFile *grown = realloc(files, sizeof(IndexedFile) * capacity);
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                files = grown;
+            }
+            files[*count] = (IndexedFile){ .path = strdup(fields[1]), .size = atoll(fields[2]), .mtime = atoll(fields[3]) };
+            files[*count].module.exports_all = atoi(fields[4]);
+            ok = files[(*count)++].path != NULL;
+        } else if (strcmp(fields[0], "D") == 0 && field_count == 3 && current) {
+            ok = lexer_module_add(&current->module, fields[1], NULL, atoi(fields[2]));
+        } else if (strcmp(fields[0], "I") == 0 && field_count == 4 && current) {
+            ok = lexer_module_add(&current->module, fields[2], fields[1], atoi(fields[3]));
+        }
+    }
+    free(line);
+    fclose(file);
+
+    if (!ok) {
+        free_files(files, *count);
+        *count = 0;
+        return NULL;
+    }
+    qsort(files, *count, sizeof(IndexedFile), compare_paths);
+    return files;
+}
+
+/* Save the indexed files to path (written beside it, then renamed); returns 1, or 0 on failure */
+static int save_index(const ProjectIndex *index, const char *path) {
+    char temporary[4096];
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int)sizeof(temporary)) return 0;
+    FILE *out = fopen(temporary, "w");
+    if (!out) return 0;
+
+    fprintf(out, "L\tlexer-index\t%d\n", INDEX_VERSION);
+    for (int i = 0; i < index->file_count; i++) {
+        const IndexedFile *file = &index->files[i];
+        if (!file->indexed) continue;
+        const ModuleInterface *module = &file->module;
+        fputc('M', out);
+        write_field(out, file->path);
+        fprintf(out, "\t%lld\t%lld\t%d\n", file->size, file->mtime, module->exports_all);
+        for (int d = 0; d < module->declaration_count; d++) {
+            fputc('D', out);
+            write_field(out, module->text + module->declarations[d].name);
+            fprintf(out, "\t%d\n", module->declarations[d].line);
+        }
+        for (int m = 0; m < module->import_count; m++) {
+            fputc('I', out);
+            write_field(out, module->text + module->imports[m].module);
+            write_field(out, module->text + module->imports[m].name);
+            fprintf(out, "\t%d\n", module->imports[m].line);
+        }
+    }
+    int ok = !ferror(out);
+    if (fclose(out) != 0) ok = 0;
+    if (ok && rename(temporary, path) != 0) ok = 0;
+    if (!ok) remove(temporary);
+    return ok;
+}
+
+/*===========================================================================
+ * SECTION 4: PARALLEL INDEXING
+ *===========================================================================*/
+
+/**
+ * Lex source into *tokens, growing it as needed (unlike lexer_analyze, whose
+ * token array has a fixed capacity: a name declared late in a large file must
+ * still be found). Returns the token count, or -1 if out of memory.
+ */
+static int lex_file(Language lang, const char *source, int length, char **code, int *code_capacity,
+                    Token **tokens, int *token_capacity) {
+    if (*code_capacity < length + 1) {
+        char *grown = lexer_realloc(*code, length + 1);
+        if (!grown) return -1;
+        *code = grown;
+        *code_capacity = length + 1;
+    }
+    CommentScanner scanner = { 0, 0, 1, 0, 0, 0 };
+    if (lang == LANG_PYTHON) scan_comments_python(&scanner, source, length, 1, NULL, *code);
+    else scan_comments_typescript(&scanner, source, length, 1, NULL, *code);
+
+    LexCursor cursor = { *code, scanner.clean_index, 0, 1, 0, 0, { 0 } };
+    int count = 0;
+    for (;;) {
+        if (count == *token_capacity) {
+            int capacity = *token_capacity ? *token_capacity * 2 : 4096;
+            Token *grown = lexer_realloc(*tokens, sizeof(Token) * capacity);
+            if (!grown) return -1;
+            *tokens = grown;
+            *token_capacity = capacity;
+        }
+        count += tokenize_range(&cursor, scanner.clean_index, lang, *tokens + count, *token_capacity - count);
+        if (count < *token_capacity) return count;
+    }
+}
+
+static void *index_worker(void *arg) {
+    IndexJobs *jobs = arg;
+    ProjectIndex *index = jobs->index;
+    char *code = NULL;
+    Token *tokens = NULL;
+    int code_capacity = 0, token_capacity = 0;
+
+    for (int i = atomic_fetch_add(&jobs->next_file, 1); i < index->file_count; i = atomic_fetch_add(&jobs->next_file, 1)) {
+        IndexedFile *file = &index->files[i];
+        struct stat info;
+        if (!detect_language(file->path, &file->lang) || stat(file->path, &info) != 0 || !S_ISREG(info.st_mode)) continue;
+        file->size = info.st_size;
+        file->mtime = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+
+        // Each path is taken by one worker, so its saved interface can be moved without a lock
+        IndexedFile *saved = find_file(jobs->saved, jobs->saved_count, file->path);
+        if (saved && saved->size == file->size && saved->mtime == file->mtime) {
+            file->module = saved->module;
+            memset(&saved->module, 0, sizeof(ModuleInterface));
+            file->indexed = file->cached = 1;
+            continue;
+        }
+
+        long long length = 0;
+        char *source = read_source(file->path, &length);
+        if (!source) continue;
+        int count = length <= 0x7fffffff ? lex_file(file->lang, source, (int)length, &code, &code_capacity, &tokens, &token_capacity) : -1;
+        file->indexed = count >= 0 && lexer_module_interface(file->lang, tokens, count, &file->module);
+        lexer_free(source);
+    }
+
+    lexer_free(code);
+    lexer_free(tokens);
+    return NULL;
+}
+
+/*===========================================================================
+ * SECTION 5: HASH INDEX
+ *===========================================================================*/
+
+static int table_size(int entries) {
+    int size = 16;
+    while (size < 2 * entries) size *= 2;
+    return size;
+}
+
+/* Add every path suffix of key (the whole key, then after each '/') for file */
+static void add_module(ProjectIndex *index, const char *key, int file) {
+    for (const char *suffix = key; suffix; suffix = strchr(suffix, '/') ? strchr(suffix, '/') + 1 : NULL) {
+        if (!*suffix) break;
+        int slot = hash_text(suffix) & index->module_mask;
+        while (index->module_slots[slot].suffix) slot = (slot + 1) & index->module_mask;
+        index->module_slots[slot] = (ModuleSlot){ suffix, file, suffix == key };
+    }
+}
+
+static int count_suffixes(const char *key) {
+    int count = 1;
+    for (; *key; key++) count += *key == '/';
+    return count;
+}
+
+/* Name keys and hash tables for the indexed files; returns 0 if out of memory */
+static int build_tables(ProjectIndex *index) {
+    int suffix_count = 0, name_count = 0;
+    for (int f = 0; f < index->file_count; f++) {
+        IndexedFile *file = &index->files[f];
+        if (!file->indexed) continue;
+        if (!(file->key = normalize_path(file->path, 1))) return 0;
+        const char *base = strrchr(file->key, '/') ? strrchr(file->key, '/') + 1 : file->key;
+        if (strcmp(base, file->lang == LANG_PYTHON ? "__init__" : "index") == 0 && base > file->key) {
+            if (!(file->package = strndup(file->key, directory_length(file->key)))) return 0;
+            suffix_count += count_suffixes(file->package);
+        }
+        file->opaque = file->module.exports_all || (file->lang == LANG_TYPESCRIPT && file->module.declaration_count == 0);
+        suffix_count += count_suffixes(file->key);
+        name_count += file->module.declaration_count;
+    }
+
+    int module_size = table_size(suffix_count), name_size = table_size(name_count);
+    index->module_slots = calloc(module_size, sizeof(ModuleSlot));
+    index->name_slots = calloc(name_size, sizeof(NameSlot));
+    if (!index->module_slots || !index->name_slots) return 0;
+    index->module_mask = module_size - 1;
+    index->name_mask = name_size - 1;
+
+    for (int f = 0; f < index->file_count; f++) {
+        const IndexedFile *file = &index->files[f];
+        if (!file->indexed) continue;
+        add_module(index, file->key, f);
+        if (file->package) add_module(index, file->package, f);
+        for (int d = 0; d < file->module.declaration_count; d++) {
+            const char *name = file->module.text + file->module.declarations[d].name;
+            int slot = (hash_text(name) ^ (unsigned int)f * 2654435761u) & index->name_mask;
+            while (index->name_slots[slot].name) slot = (slot + 1) & index->name_mask;
+            index->name_slots[slot] = (NameSlot){ name, f };
+        }
+    }
+    return 1;
+}
+
+/* Files that are module key (whole: as a whole key, else as any path suffix); returns how many, at most max */
+static int find_modules(const ProjectIndex *index, const char *key, int whole, int *found, int max) {
+    int count = 0;
+    for (int slot = hash_text(key) & index->module_mask; index->module_slots[slot].suffix && count < max;
+         slot = (slot + 1) & index->module_mask) {
+        const ModuleSlot *entry = &index->module_slots[slot];
+        if ((entry->whole || !whole) && strcmp(entry->suffix, key) == 0) found[count++] = entry->file;
+    }
+    return count;
+}
+
+static int declares(const ProjectIndex *index, int file, const char *name) {
+    for (int slot = (hash_text(name) ^ (unsigned int)file * 2654435761u) & index->name_mask; index->name_slots[slot].name;
+         slot = (slot + 1) & index->name_mask) {
+        const NameSlot *entry = &index->name_slots[slot];
+        if (entry->file == file && strcmp(entry->name, name) == 0) return 1;
+    }
+    return 0;
+}
+
+ProjectIndex *project_index_build(char *const *paths, int path_count, const char *cache_path, int thread_count) {
+    ProjectIndex *index = calloc(1, sizeof(ProjectIndex));
+    if (!index) return NULL;
+    index->files = calloc(path_count > 0 ? path_count : 1, sizeof(IndexedFile));
+    if (!index->files) {
+        free(index);
+        return NULL;
+    }
+    for (int i = 0; i < path_count; i++) {
+        index->files[index->file_count].path = strdup(paths[i]);
+        if (!index->files[index->file_count++].path) {
+            project_index_free(index);
+            return NULL;
+        }
+    }
+    qsort(index->files, index->file_count, sizeof(IndexedFile), compare_paths);
+
+    IndexJobs jobs = { index, NULL, 0, 0 };
+    if (cache_path) jobs.saved = load_index(cache_path, &jobs.saved_count);
+    int worker_count = thread_count < index->file_count ? thread_count : index->file_count;
+    if (worker_count > MAX_THREADS) worker_count = MAX_THREADS;
+    if (worker_count < 1) worker_count = 1;
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+    atomic_init(&jobs.next_file, 0);
+    for (int i = 1; i < worker_count; i++) started[i] = pthread_create(&threads[i], NULL, index_worker, &jobs) == 0;
+    index_worker(&jobs);
+    for (int i = 1; i < worker_count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    int indexed_count = 0;
+    for (int i = 0; i < index->file_count; i++) {
+        indexed_count += index->files[i].indexed;
+        index->cached_count += index->files[i].cached;
+    }
+    int changed = index->cached_count != indexed_count || index->cached_count != jobs.saved_count;
+    free_files(jobs.saved, jobs.saved_count);
+
+    if (!build_tables(index)) {
+        project_index_free(index);
+        return NULL;
+    }
+    if (cache_path && changed && !save_index(index, cache_path)) {
+        fprintf(stderr, "Warning: Cannot write index '%s'\n", cache_path);
+    }
+    return index;
+}
+
+/*===========================================================================
+ * SECTION 6: IMPORT RESOLUTION
+ *===========================================================================*/
+
+/**
+ * Module key of an import of from_module in file, and whether it must match a
+ * whole key (relative imports) or may match any path suffix (Python absolute
+ * imports). Returns a malloc'd key, or NULL for a module outside the project.
+ */
+static char *import_key(const IndexedFile *file, const char *from_module, int *whole) {
+    int directory = directory_length(file->key);
+    char *joined;
+    if (file->lang == LANG_PYTHON) {
+        // ..pkg.utils: one '..' per leading dot after the first, then the dotted path
+        int dots = 0;
+        while (from_module[dots] == '.') dots++;
+        size_t length = directory + 3 * (dots > 0 ? dots : 0) + strlen(from_module) + 2;
+        if (!(joined = malloc(length))) return NULL;
+        int out = 0;
+        if (dots > 0) {
+            memcpy(joined, file->key, directory);
+            out = directory;
+            for (int d = 1; d < dots; d++) out += sprintf(joined + out, "%s..", out > 0 ? "/" : "");
+        }
+        if (from_module[dots] && out > 0) joined[out++] = '/';
+        for (const char *c = from_module + dots; *c; c++) joined[out++] = *c == '.' ? '/' : *c;
+        joined[out] = '\0';
+        *whole = dots > 0;
+    } else {
+        if (strncmp(from_module, "./", 2) != 0 && strncmp(from_module, "../", 3) != 0 &&
+            strcmp(from_module, ".") != 0 && strcmp(from_module, "..") != 0) {
+            return NULL;                                // A package
+        }
+        if (!(joined = malloc(directory + strlen(from_module) + 2))) return NULL;
+        sprintf(joined, "%.*s%s%s", directory, file->key, directory > 0 ? "/" : "", from_module);
+        *whole = 1;
+    }
+    char *key = normalize_path(joined, file->lang == LANG_TYPESCRIPT);
+    free(joined);
+    return key;
+}
+
+/* Whether name may come from module key: declared by a file that is the module, or (Python) a submodule */
+static int import_resolves(const ProjectIndex *index, const char *key, int whole, const char *name, Language lang,
+                           int *module_found) {
+    int found[MAX_CANDIDATES];
+    int count = find_modules(index, key, whole, found, MAX_CANDIDATES);
+    *module_found = count > 0;
+    for (int m = 0; m < count; m++) {
+        if (index->files[found[m]].opaque || declares(index, found[m], name)) return 1;
+    }
+    if (lang != LANG_PYTHON) return 0;
+
+    char *submodule = malloc(strlen(key) + strlen(name) + 2);
+    if (!submodule) return 1;
+    sprintf(submodule, "%s%s%s", key, *key ? "/" : "", name);
+    int is_submodule = find_modules(index, submodule, whole, found, 1) > 0;
+    free(submodule);
+    if (is_submodule) *module_found = 1;
+    return is_submodule;
+}
+
+int project_check_imports(const ProjectIndex *index, const char *path, Error *errors, int max_errors) {
+    const IndexedFile *file = find_file(index->files, index->file_count, path);
+    if (!file || !file->indexed) return 0;
+    const ModuleInterface *module = &file->module;
+    int written = 0;
+
+    for (int i = 0; i < module->import_count && written < max_errors; i++) {
+        const char *name = module->text + module->imports[i].name;
+        const char *from_module = module->text + module->imports[i].module;
+        int whole, module_found;
+        char *key = import_key(file, from_module, &whole);
+        if (!key) continue;
+        int resolves = import_resolves(index, key, whole, name, file->lang, &module_found);
+        free(key);
+        if (resolves || !module_found) continue;       // Modules outside the project are not checked
+
+        snprintf(errors[written].message, MAX_LENGTH,
+            "Undeclared identifier - '%s' is not declared in module '%s'", name, from_module);
+        errors[written].line_number = module->imports[i].line;
+        errors[written].type = ERROR_TYPE_UNDECLARED_IDENTIFIER;
+        written++;
+    }
+    return written;
+}
+
+void project_index_counts(const ProjectIndex *index, int *file_count, int *cached_count) {
+    *file_count = 0;
+    for (int i = 0; i < index->file_count; i++) *file_count += index->files[i].indexed;
+    *cached_count = index->cached_count;
+}
+
+void project_index_free(ProjectIndex *index) {
+    if (!index) return;
+    free_files(index->files, index->file_count);
+    free(index->module_slots);
+    free(index->name_slots);
+    free(index);
+}
@@ -0,0 +1,50 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - PROJECT INDEX
+ *
+ * Cross-file checks for ./lexer --report --project: every file of the project
+ * is lexed, in parallel, for its module interface (see lexer.h), and the
+ * interfaces go into one hash index that the analysis threads then only read.
+ * A name imported from a project module that does not declare it is reported
+ * as an undeclared identifier; modules outside the project are not checked.
+ *
+ * Python modules are matched by dotted path against the end of file paths
+ * (pkg.utils is any .../pkg/utils.py or .../pkg/utils/__init__.py), relative
+ * imports from the importing file's package. TypeScript imports are resolved
+ * for relative specifiers only ('./y' is y.ts, y.js, y/index.ts or y/index.js);
+ * a file without export statements is taken as CommonJS and not checked.
+ *
+ * With --index FILE the interfaces are saved to FILE and, on later runs,
+ * reused for every file whose size and modification time have not changed:
+ *
+ *   L  lexer-index  1
+ *   M  <path>  <size>  <mtime ns>  <exports_all>     one indexed file
+ *   D  <name>  <line>                                a declaration of that file
+ *   I  <module>  <name>  <line>                      a name it imports
+ *
+ * Fields are separated and escaped as in report.h.
+ */
+
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include "lexer.h"
+
+#define INDEX_VERSION 1
+
+/* ProjectIndex: module interfaces of a set of files (opaque) */
+typedef struct ProjectIndex ProjectIndex;
+
+/* Index paths[0 .. path_count) using thread_count threads, reusing the interfaces saved at cache_path
+   (if not NULL) and saving them there afterwards; returns NULL if out of memory */
+ProjectIndex *project_index_build(char *const *paths, int path_count, const char *cache_path, int thread_count);
+
+/* Write an error to errors (at most max_errors) for each name that path imports from a project module
+   that does not declare it; returns the number written. Safe to call from several threads. */
+int project_check_imports(const ProjectIndex *index, const char *path, Error *errors, int max_errors);
+
+/* Number of files indexed, and how many of them came from the cache */
+void project_index_counts(const ProjectIndex *index, int *file_count, int *cached_count);
+
+void project_index_free(ProjectIndex *index);
+
+#endif
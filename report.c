@@ -0,0 +1,502 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - MACHINE-READABLE REPORTS
+ *
+ * Multi-file analysis for CI: files are analyzed in parallel (one warm
+ * LexerContext per worker thread) and reported in path order, optionally only
+ * the files of one shard. --merge joins shard reports. See report.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "lexer.h"
+#include "perf.h"
+#include "project.h"
+#include "report.h"
+#include "stats.h"
+#include "trace.h"
+
+/* Error codes, indexed by ErrorType */
+static const char *const REPORT_ERROR_CODES[] = {
+    "misspelled-keyword", "type-mismatch", "undeclared-identifier", "invalid-operator"
+};
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+/* FileReport: the analysis of one file */
+typedef struct {
+    char *path;
+    int token_count;
+    int comment_count;
+    Error *errors;
+    int error_count;
+    const char *failure;    // Why the file could not be analyzed, or NULL
+    double seconds;         // Reading and analysis
+    LexerMemory memory;     // Allocated for this file (beyond the worker's warm buffers)
+} FileReport;
+
+typedef struct {
+    FileReport *files;
+    int file_count;
+    int file_capacity;
+    atomic_int next_file;   // Next file for a worker to take
+    const ProjectIndex *project;    // Imports are checked against it, or NULL
+} ReportJobs;
+
+/* ReportWorker: one analysis thread and its counters */
+typedef struct {
+    ReportJobs *jobs;
+    int index;
+    PhaseStats stats;
+    int count_perf;         // Hardware counters wanted
+    PerfCounters perf;
+    TraceHook trace;
+} ReportWorker;
+
+/* MergeRecord: one F/E/X line of a shard report */
+typedef struct {
+    char *line;
+    char *path;             // Escaped, as in the line
+    int rank;               // F before E before X for the same path
+    int sequence;           // Input order, keeps the errors of a file in order
+} MergeRecord;
+
+/*===========================================================================
+ * SECTION 2: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+int shard_of_path(const char *path, int shard_count) {
+    uint64_t hash = 14695981039346656037ULL;    // FNV-1a, 64 bit
+    for (; *path; path++) hash = (hash ^ (unsigned char)*path) * 1099511628211ULL;
+    return (int)(hash % (uint64_t)shard_count);
+}
+
+static int detect_language(const char *path, Language *lang) {
+    const char *ext = strrchr(path, '.');
+    if (!ext || ext == path) return 0;
+    if (strcmp(ext, ".py") == 0) {
+        *lang = LANG_PYTHON;
+        return 1;
+    }
+    if (strcmp(ext, ".ts") == 0 || strcmp(ext, ".js") == 0) {
+        *lang = LANG_TYPESCRIPT;
+        return 1;
+    }
+    return 0;
+}
+
+static char *read_source(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *content = size >= 0 ? lexer_malloc(size + 1) : NULL;
+    if (content) {
+        size_t length = fread(content, 1, size, file);
+        content[length] = '\0';
+    }
+    fclose(file);
+    return content;
+}
+
+/* Print a tab and the field, escaped */
+static void print_field(const char *text) {
+    putchar('\t');
+    for (; *text; text++) {
+        if (*text == '\t') fputs("\\t", stdout);
+        else if (*text == '\n') fputs("\\n", stdout);
+        else if (*text == '\\') fputs("\\\\", stdout);
+        else putchar(*text);
+    }
+}
+
+static int compare_files(const void *a, const void *b) {
+    return strcmp(((const FileReport *)a)->path, ((const FileReport *)b)->path);
+}
+
+/*===========================================================================
+ * SECTION 3: FILE COLLECTION
+ *===========================================================================*/
+
+static void add_file(ReportJobs *jobs, const char *path) {
+    if (jobs->file_count == jobs->file_capacity) {
+        jobs->file_capacity = jobs->file_capacity ? jobs->file_capacity * 2 : 256;
+        jobs->files = realloc(jobs->files, sizeof(FileReport) * jobs->file_capacity);
+        if (!jobs->files) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(1);
+        }
+    }
+    jobs->files[jobs->file_count++] = (FileReport){ .path = strdup(path) };
+}
+
+/* Add path, or the source files below it if it is a directory (hidden entries skipped) */
+static void collect_files(ReportJobs *jobs, const char *path, int explicit) {
+    struct stat info;
+    Language lang;
+    if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        // Named files are always reported, even if they cannot be analyzed
+        if (explicit || detect_language(path, &lang)) add_file(jobs, path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char child[PATH_MAX];
+        snprintf(child, sizeof(child), "%s%s%s", path, path[strlen(path) - 1] == '/' ? "" : "/", entry->d_name);
+        collect_files(jobs, child, 0);
+    }
+    closedir(dir);
+}
+
+/*===========================================================================
+ * SECTION 4: PARALLEL ANALYSIS
+ *===========================================================================*/
+
+static void *report_worker(void *arg) {
+    ReportWorker *worker = arg;
+    ReportJobs *jobs = worker->jobs;
+    PhaseStats *stats = &worker->stats;
+    LexerContext *context = lexer_create();
+    if (context && worker->count_perf) perf_attach(&worker->perf, context);
+    if (context) trace_attach(&worker->trace, context);
+    if (worker->index > 0) {
+        char name[32];
+        snprintf(name, sizeof(name), "worker %d", worker->index);
+        trace_thread_name(name);
+    }
+    Token *tokens = NULL;           // Grown to the largest file by lexer_analyze_all
+    int token_capacity = 0;
+    Comment *comments = lexer_malloc(sizeof(Comment) * MAX_COMMENTS);
+    Error *errors = lexer_malloc(sizeof(Error) * MAX_ERRORS);
+
+    for (int index = atomic_fetch_add(&jobs->next_file, 1); index < jobs->file_count;
+         index = atomic_fetch_add(&jobs->next_file, 1)) {
+        FileReport *file = &jobs->files[index];
+        Language lang;
+        if (!detect_language(file->path, &lang)) {
+            file->failure = "Unsupported file extension";
+            continue;
+        }
+        trace_begin_file(file->path);
+        double start = stats_now();
+        lexer_memory_begin();
+        trace_begin("read");
+        char *source_code = read_source(file->path);
+        trace_end();
+        double read_end = stats_now();
+        stats->seconds[PHASE_READ] += read_end - start;
+        if (!source_code) {
+            file->failure = "Cannot open file";
+            lexer_memory_end(&file->memory);
+            trace_end_file();
+            continue;
+        }
+
+        LexerResult result = { tokens, token_capacity, 0, comments, MAX_COMMENTS, 0, errors, MAX_ERRORS, 0 };
+        int source_length = strlen(source_code);
+        if (context) lexer_set_source_name(context, file->path);
+        int analyzed = context && comments && errors &&
+                       lexer_analyze_all(context, lang, source_code, source_length, &result);
+        tokens = result.tokens;
+        token_capacity = result.token_capacity;
+        if (analyzed && jobs->project) {
+            result.error_count += project_check_imports(jobs->project, file->path, errors + result.error_count,
+                                                        MAX_ERRORS - result.error_count);
+        }
+        if (!analyzed || !(file->errors = lexer_malloc(sizeof(Error) * (result.error_count ? result.error_count : 1)))) {
+            file->failure = "Out of memory";
+            lexer_free(source_code);
+            lexer_memory_end(&file->memory);
+            trace_end_file();
+            continue;
+        }
+        lexer_free(source_code);
+        lexer_memory_end(&file->memory);
+        trace_end_file();
+        file->seconds = stats_now() - start;
+        stats_add_analysis(stats, context, source_length, &result);
+        stats->phase_bytes[PHASE_READ] += source_length;
+        stats->files++;
+        stats->bytes += source_length;
+        stats->tokens += result.token_count;
+        worker->perf.bytes += source_length;
+        worker->perf.tokens += result.token_count;
+
+        file->token_count = result.token_count;
+        file->comment_count = result.comment_count;
+        memcpy(file->errors, result.errors, sizeof(Error) * result.error_count);
+        file->error_count = result.error_count;
+    }
+
+    lexer_destroy(context);
+    lexer_free(tokens);
+    lexer_free(comments);
+    lexer_free(errors);
+    return NULL;
+}
+
+int run_report(char **paths, int path_count, int shard_index, int shard_count, int thread_count, int show_stats,
+               int show_perf, int use_project, const char *index_path) {
+    double run_start = stats_now();
+    ReportJobs jobs = {0};
+    trace_begin("collect files");
+    for (int i = 0; i < path_count; i++) collect_files(&jobs, paths[i], 1);
+
+    // Path order, without duplicates
+    qsort(jobs.files, jobs.file_count, sizeof(FileReport), compare_files);
+    int unique = 0;
+    for (int i = 0; i < jobs.file_count; i++) {
+        if (unique > 0 && strcmp(jobs.files[unique - 1].path, jobs.files[i].path) == 0) free(jobs.files[i].path);
+        else jobs.files[unique++] = jobs.files[i];
+    }
+    trace_end();
+
+    // The project index covers every file, not only this shard's
+    ProjectIndex *project = NULL;
+    if (use_project) {
+        trace_begin("index project");
+        char **all_paths = malloc(sizeof(char *) * (unique ? unique : 1));
+        for (int i = 0; all_paths && i < unique; i++) all_paths[i] = jobs.files[i].path;
+        project = all_paths ? project_index_build(all_paths, unique, index_path, thread_count) : NULL;
+        free(all_paths);
+        trace_end();
+        if (!project) {
+            fprintf(stderr, "Error: Out of memory\n");
+            return 1;
+        }
+        jobs.project = project;
+    }
+
+    // Keep this shard's files
+    int kept = 0;
+    for (int i = 0; i < unique; i++) {
+        if (shard_of_path(jobs.files[i].path, shard_count) == shard_index - 1) jobs.files[kept++] = jobs.files[i];
+        else free(jobs.files[i].path);
+    }
+    jobs.file_count = kept;
+
+    int worker_count = thread_count < jobs.file_count ? thread_count : jobs.file_count;
+    if (worker_count < 1) worker_count = 1;
+    pthread_t threads[MAX_THREADS];
+    ReportWorker workers[MAX_THREADS];
+    atomic_init(&jobs.next_file, 0);
+    for (int i = 0; i < worker_count; i++) workers[i] = (ReportWorker){ .jobs = &jobs, .index = i, .count_perf = show_perf };
+    // Workers take files from a shared queue, so fewer threads than planned still cover every file
+    for (int i = 1; i < worker_count; i++) {
+        if (pthread_create(&threads[i], NULL, report_worker, &workers[i]) != 0) {
+            worker_count = i;
+            break;
+        }
+    }
+    report_worker(&workers[0]);
+    for (int i = 1; i < worker_count; i++) pthread_join(threads[i], NULL);
+
+    // Merge the per-thread counters; keep per-file times for percentiles
+    PhaseStats total = { .files = 0 };
+    PhaseStats thread_stats[MAX_THREADS];
+    for (int i = 0; i < worker_count; i++) {
+        thread_stats[i] = workers[i].stats;
+        stats_merge(&total, &thread_stats[i]);
+    }
+    double *file_seconds = show_stats ? malloc(sizeof(double) * (jobs.file_count ? jobs.file_count : 1)) : NULL;
+    LexerMemory *file_memory = show_stats ? malloc(sizeof(LexerMemory) * (jobs.file_count ? jobs.file_count : 1)) : NULL;
+    int timed_files = 0;
+    double print_start = stats_now();
+    trace_begin("print report");
+
+    long total_tokens = 0, total_comments = 0, total_errors = 0;
+    int analyzed = 0, failed = 0;
+    printf("L\tlexer-report\t%d\n", REPORT_VERSION);
+    if (shard_count > 1) printf("S\t%d\t%d\n", shard_index, shard_count);
+    for (int i = 0; i < jobs.file_count; i++) {
+        FileReport *file = &jobs.files[i];
+        if (file->failure) {
+            printf("X");
+            print_field(file->path);
+            print_field(file->failure);
+            printf("\n");
+            failed++;
+        } else {
+            printf("F");
+            print_field(file->path);
+            printf("\t%d\t%d\t%d\n", file->token_count, file->comment_count, file->error_count);
+            for (int e = 0; e < file->error_count; e++) {
+                printf("E");
+                print_field(file->path);
+                printf("\t%d\t%s", file->errors[e].line_number, REPORT_ERROR_CODES[file->errors[e].type]);
+                print_field(file->errors[e].message);
+                printf("\n");
+            }
+            analyzed++;
+            if (file_seconds && file_memory) {
+                file_seconds[timed_files] = file->seconds;
+                file_memory[timed_files++] = file->memory;
+            }
+            total_tokens += file->token_count;
+            total_comments += file->comment_count;
+            total_errors += file->error_count;
+        }
+        free(file->path);
+        lexer_free(file->errors);
+    }
+    printf("T\t%d\t%ld\t%ld\t%ld\t%d\n", analyzed, total_tokens, total_comments, total_errors, failed);
+    free(jobs.files);
+    trace_end();
+
+    if (project && show_stats) {
+        int indexed, cached;
+        project_index_counts(project, &indexed, &cached);
+        fprintf(stderr, "Project index: %d files (%d unchanged since the saved index)\n", indexed, cached);
+    }
+    project_index_free(project);
+
+    if (show_stats) {
+        fflush(stdout);
+        total.seconds[PHASE_PRINT] = stats_now() - print_start;
+        print_stats(stderr, &total, stats_now() - run_start, file_seconds, timed_files, thread_stats, worker_count);
+        LexerMemory run_memory;
+        lexer_memory_process(&run_memory);
+        print_memory_stats(stderr, &run_memory, file_memory, timed_files);
+        free(file_seconds);
+        free(file_memory);
+    }
+    if (show_perf) {
+        PerfCounters perf_total = {0};
+        for (int i = 0; i < worker_count; i++) perf_merge(&perf_total, &workers[i].perf);
+        print_perf(stderr, &perf_total);
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+/*===========================================================================
+ * SECTION 5: MERGING
+ *===========================================================================*/
+
+static int compare_records(const void *a, const void *b) {
+    const MergeRecord *left = a, *right = b;
+    int order = strcmp(left->path, right->path);
+    if (order != 0) return order;
+    if (left->rank != right->rank) return left->rank - right->rank;
+    return left->sequence - right->sequence;
+}
+
+int run_merge(char **report_paths, int report_count) {
+    MergeRecord *records = NULL;
+    int record_count = 0, record_capacity = 0;
+    long total_tokens = 0, total_comments = 0, total_errors = 0;
+    int analyzed = 0, failed = 0, status = 0;
+    int shard_count = 0;
+    char *shard_seen = NULL;
+
+    for (int r = 0; r < report_count; r++) {
+        FILE *file = fopen(report_paths[r], "r");
+        if (!file) {
+            fprintf(stderr, "Error: Cannot open report '%s'\n", report_paths[r]);
+            status = 1;
+            continue;
+        }
+
+        char *line = NULL;
+        size_t line_capacity = 0;
+        ssize_t length;
+        while ((length = getline(&line, &line_capacity, file)) > 0) {
+            if (line[length - 1] == '\n') line[--length] = '\0';
+            if (length < 2 || line[1] != '\t') continue;
+            char kind = line[0];
+
+            if (kind == 'L') {
+                int version = 0;
+                if (sscanf(line, "L\tlexer-report\t%d", &version) != 1 || version > REPORT_VERSION) {
+                    fprintf(stderr, "Error: '%s' is not a lexer report this version can read\n", report_paths[r]);
+                    status = 1;
+                    break;
+                }
+            } else if (kind == 'S') {
+                int index, count;
+                if (sscanf(line, "S\t%d\t%d", &index, &count) != 2 || count < 1 || index < 1 || index > count ||
+                    (shard_count && count != shard_count)) {
+                    fprintf(stderr, "Error: '%s' belongs to a different sharding\n", report_paths[r]);
+                    status = 1;
+                    continue;
+                }
+                if (!shard_count) {
+                    shard_count = count;
+                    shard_seen = calloc(count + 1, 1);
+                }
+                if (shard_seen[index]++) {
+                    fprintf(stderr, "Error: Shard %d of %d appears more than once\n", index, count);
+                    status = 1;
+                }
+            } else if (kind == 'F' || kind == 'E' || kind == 'X') {
+                char *path_end = strchr(line + 2, '\t');
+                if (!path_end) continue;
+                if (record_count == record_capacity) {
+                    record_capacity = record_capacity ? record_capacity * 2 : 1024;
+                    records = realloc(records, sizeof(MergeRecord) * record_capacity);
+                    if (!records) {
+                        fprintf(stderr, "Error: Out of memory\n");
+                        return 1;
+                    }
+                }
+                MergeRecord *record = &records[record_count];
+                *record = (MergeRecord){ strdup(line), strndup(line + 2, path_end - (line + 2)),
+                                         kind == 'F' ? 0 : kind == 'E' ? 1 : 2, record_count };
+                record_count++;
+
+                if (kind == 'F') {
+                    int tokens = 0, comments = 0, errors = 0;
+                    sscanf(path_end, "\t%d\t%d\t%d", &tokens, &comments, &errors);
+                    total_tokens += tokens;
+                    total_comments += comments;
+                    total_errors += errors;
+                    analyzed++;
+                } else if (kind == 'X') {
+                    failed++;
+                }
+            }
+        }
+        free(line);
+        fclose(file);
+    }
+
+    for (int i = 1; i <= shard_count; i++) {
+        if (!shard_seen[i]) {
+            fprintf(stderr, "Error: Shard %d of %d is missing\n", i, shard_count);
+            status = 1;
+        }
+    }
+
+    qsort(records, record_count, sizeof(MergeRecord), compare_records);
+    printf("L\tlexer-report\t%d\n", REPORT_VERSION);
+    for (int i = 0; i < record_count; i++) {
+        if (records[i].rank == 0 && i > 0 && records[i - 1].rank == 0 && strcmp(records[i].path, records[i - 1].path) == 0) {
+            fprintf(stderr, "Error: '%s' was analyzed by more than one shard\n", records[i].path);
+            status = 1;
+        }
+        printf("%s\n", records[i].line);
+    }
+    printf("T\t%d\t%ld\t%ld\t%ld\t%d\n", analyzed, total_tokens, total_comments, total_errors, failed);
+    if (failed > 0) status = 1;
+
+    for (int i = 0; i < record_count; i++) {
+        free(records[i].line);
+        free(records[i].path);
+    }
+    free(records);
+    free(shard_seen);
+    return status;
+}
@@ -0,0 +1,38 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - MACHINE-READABLE REPORTS
+ *
+ * Multi-file runs (./lexer --report, ./lexer --shard i/N) print one record per
+ * line, fields separated by tabs, so several CI machines can each lint a shard
+ * of a repository and ./lexer --merge can combine their outputs:
+ *
+ *   L  lexer-report  1                               header (format version)
+ *   S  <i>  <N>                                      shard i of N (1-based)
+ *   F  <path>  <tokens>  <comments>  <errors>        one analyzed file
+ *   E  <path>  <line>  <code>  <message>             one error (code as in --lsp)
+ *   X  <path>  <message>                             a file that could not be analyzed
+ *   T  <files>  <tokens>  <comments>  <errors>  <failed>   totals
+ *
+ * Tabs, newlines and backslashes inside fields are written as \t, \n and \\.
+ * Records are ordered by path, so reports can be compared with diff.
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#define REPORT_VERSION 1
+
+/* Shard (0-based) that owns path: a stable hash of the path, so adding files never moves others */
+int shard_of_path(const char *path, int shard_count);
+
+/* Analyze the files of shard shard_index (1-based) of shard_count among paths (directories are
+   searched for .py/.ts/.js files) and print the report, then statistics if show_stats is set and
+   hardware counters if show_perf is set (perf_init must have been called). With use_project, imports
+   are also checked against an index of all the files, saved at index_path if not NULL (see
+   project.h). Returns the exit code */
+int run_report(char **paths, int path_count, int shard_index, int shard_count, int thread_count, int show_stats,
+               int show_perf, int use_project, const char *index_path);
+
+/* Combine shard reports into one ordered report with recomputed totals; returns the exit code */
+int run_merge(char **report_paths, int report_count);
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - RUN STATISTICS
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "lexer.h"
+#include "stats.h"
+
+static const char *const PHASE_NAMES[PHASE_COUNT] = {
+    [PHASE_READ] = "read",
+    [PHASE_COMMENTS] = "extract comments",
+    [PHASE_TOKENIZE] = "tokenize",
+    [PHASE_CHECKS] = "checks",
+    [PHASE_CHECK_FIRST + ERROR_TYPE_MISSPELLED_KEYWORD] = "  misspelled keyword",
+    [PHASE_CHECK_FIRST + ERROR_TYPE_TYPE_MISMATCH] = "  type mismatch",
+    [PHASE_CHECK_FIRST + ERROR_TYPE_UNDECLARED_IDENTIFIER] = "  undeclared identifier",
+    [PHASE_CHECK_FIRST + ERROR_TYPE_INVALID_OPERATOR] = "  invalid operator",
+    [PHASE_PRINT] = "print",
+};
+
+double stats_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void stats_add_analysis(PhaseStats *stats, const LexerContext *context, int source_length, const LexerResult *result) {
+    const LexerTimes *times = lexer_last_times(context);
+    stats->seconds[PHASE_COMMENTS] += times->comments;
+    stats->seconds[PHASE_TOKENIZE] += times->tokenize;
+    stats->seconds[PHASE_CHECKS] += times->checks;
+    for (int c = 0; c < CHECK_COUNT; c++) stats->seconds[PHASE_CHECK_FIRST + c] += times->check[c];
+
+    int complete = result->token_count < result->token_capacity;
+    stats->phase_bytes[PHASE_COMMENTS] += source_length;
+    for (int p = PHASE_TOKENIZE; p < PHASE_PRINT; p++) {
+        if (complete) stats->phase_bytes[p] += source_length;
+        stats->phase_tokens[p] += result->token_count;
+    }
+}
+
+void stats_merge(PhaseStats *total, const PhaseStats *part) {
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        total->seconds[p] += part->seconds[p];
+        total->phase_bytes[p] += part->phase_bytes[p];
+        total->phase_tokens[p] += part->phase_tokens[p];
+    }
+    total->files += part->files;
+    total->bytes += part->bytes;
+    total->tokens += part->tokens;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double left = *(const double *)a, right = *(const double *)b;
+    return (left > right) - (left < right);
+}
+
+/* Nearest-rank percentile of sorted values */
+static double percentile(const double *sorted, int count, int percent) {
+    int rank = (percent * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/* Time spent outside the per-check breakdown (the phases that add up to the total) */
+static double busy_seconds(const PhaseStats *stats) {
+    return stats->seconds[PHASE_READ] + stats->seconds[PHASE_COMMENTS] + stats->seconds[PHASE_TOKENIZE] +
+           stats->seconds[PHASE_CHECKS] + stats->seconds[PHASE_PRINT];
+}
+
+void print_stats(FILE *out, const PhaseStats *total, double wall_seconds, double *file_seconds, int file_count,
+                 const PhaseStats *thread_stats, int thread_count) {
+    double busy = busy_seconds(total);
+    double megabytes = total->bytes / 1e6;
+
+    // Each phase's rates come from what that phase went through; '-' where it handles no bytes or tokens
+    fprintf(out, "\nStatistics%s\n", thread_count > 1 ? " (phase times summed over threads)" : "");
+    fprintf(out, "  %-26s %12s %8s %12s %12s\n", "Phase", "Time (ms)", "Share", "MB/s", "M tokens/s");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        double seconds = total->seconds[p];
+        fprintf(out, "  %-26s %12.3f %7.1f%% ", PHASE_NAMES[p], seconds * 1e3, busy > 0 ? 100 * seconds / busy : 0);
+        if (seconds > 0 && total->phase_bytes[p] > 0) fprintf(out, "%12.1f ", total->phase_bytes[p] / 1e6 / seconds);
+        else fprintf(out, "%12s ", "-");
+        if (seconds > 0 && total->phase_tokens[p] > 0) fprintf(out, "%12.2f\n", total->phase_tokens[p] / 1e6 / seconds);
+        else fprintf(out, "%12s\n", "-");
+    }
+    fprintf(out, "  %-26s %12.3f\n", "total (wall clock)", wall_seconds * 1e3);
+
+    if (wall_seconds > 0) {
+        fprintf(out, "  Throughput: %.1f MB/s, %.2f M tokens/s (%lld bytes, %lld tokens, %ld file%s)\n",
+                megabytes / wall_seconds, total->tokens / wall_seconds / 1e6, total->bytes, total->tokens,
+                total->files, total->files == 1 ? "" : "s");
+    }
+
+    if (file_seconds && file_count > 1) {
+        qsort(file_seconds, file_count, sizeof(double), compare_doubles);
+        fprintf(out, "  Per-file time (ms): p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+                percentile(file_seconds, file_count, 50) * 1e3, percentile(file_seconds, file_count, 90) * 1e3,
+                percentile(file_seconds, file_count, 99) * 1e3, file_seconds[file_count - 1] * 1e3);
+    }
+
+    if (thread_stats && thread_count > 1) {
+        fprintf(out, "  %-8s %8s %14s %12s %12s\n", "Thread", "Files", "Bytes", "Tokens", "Busy (ms)");
+        for (int t = 0; t < thread_count; t++) {
+            fprintf(out, "  %-8d %8ld %14lld %12lld %12.3f\n", t, thread_stats[t].files, thread_stats[t].bytes,
+                    thread_stats[t].tokens, busy_seconds(&thread_stats[t]) * 1e3);
+        }
+    }
+}
+
+void print_memory_stats(FILE *out, const LexerMemory *run, const LexerMemory *files, int file_count) {
+    struct rusage usage;
+    long max_rss_kb = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+
+    fprintf(out, "\nMemory\n");
+    fprintf(out, "  Run: %lld allocations, %.3f MB requested, peak %.3f MB live, max RSS %.3f MB\n",
+            run->allocation_count, run->allocated_bytes / 1e6, run->peak_bytes / 1e6, max_rss_kb / 1e3);
+    if (file_count == 1) {
+        fprintf(out, "  File: %lld allocations, %.3f MB requested, peak %.3f MB live\n",
+                files[0].allocation_count, files[0].allocated_bytes / 1e6, files[0].peak_bytes / 1e6);
+    } else if (file_count > 1) {
+        double *peaks = malloc(sizeof(double) * file_count);
+        double *counts = malloc(sizeof(double) * file_count);
+        if (!peaks || !counts) {
+            free(peaks);
+            free(counts);
+            return;
+        }
+        for (int i = 0; i < file_count; i++) {
+            peaks[i] = files[i].peak_bytes / 1e3;
+            counts[i] = files[i].allocation_count;
+        }
+        qsort(peaks, file_count, sizeof(double), compare_doubles);
+        qsort(counts, file_count, sizeof(double), compare_doubles);
+        fprintf(out, "  Per-file peak (KB): p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", percentile(peaks, file_count, 50),
+                percentile(peaks, file_count, 90), percentile(peaks, file_count, 99), peaks[file_count - 1]);
+        fprintf(out, "  Per-file allocations: p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n", percentile(counts, file_count, 50),
+                percentile(counts, file_count, 90), percentile(counts, file_count, 99), counts[file_count - 1]);
+        free(peaks);
+        free(counts);
+    }
+}
@@ -0,0 +1,61 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - RUN STATISTICS
+ *
+ * --stats: time per phase (monotonic clock), bytes/s and tokens/s, per-check
+ * time and, for multi-file runs, per-file percentiles and per-thread counters.
+ * Memory comes from the counting allocator (lexer_malloc) and getrusage.
+ * The front ends (report, daemon, watch, LSP) allocate source text, analysis
+ * buffers and responses with lexer_malloc, so those are counted; file lists,
+ * path indexes and other bookkeeping use plain malloc and only show in RSS.
+ * Statistics go to stderr so they never mix with the report on stdout.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+#include "lexer.h"
+
+typedef enum {
+    PHASE_READ,
+    PHASE_COMMENTS,
+    PHASE_TOKENIZE,
+    PHASE_CHECKS,                                   // All checks, wall clock
+    PHASE_CHECK_FIRST,                              // Then one phase per check, in ErrorType order
+    PHASE_PRINT = PHASE_CHECK_FIRST + CHECK_COUNT,
+    PHASE_COUNT
+} Phase;
+
+/* PhaseStats: counters of one thread; threads merge theirs at the end of a run */
+typedef struct {
+    double seconds[PHASE_COUNT];
+    long files;
+    long long bytes;
+    long long tokens;
+    long long phase_bytes[PHASE_COUNT];     // Input each phase went through, for its MB/s
+    long long phase_tokens[PHASE_COUNT];    // Tokens it produced or went through, for its tokens/s
+} PhaseStats;
+
+double stats_now(void);
+
+/* Add the phase times of the last lexer_analyze call on context, which analyzed source_length
+   bytes into result. A token stream cut short by its buffer covers an unknown part of the
+   input, so then tokenize and the checks count only their tokens. */
+void stats_add_analysis(PhaseStats *stats, const LexerContext *context, int source_length, const LexerResult *result);
+
+void stats_merge(PhaseStats *total, const PhaseStats *part);
+
+/**
+ * Print the statistics of a run. file_seconds (per-file times, may be NULL)
+ * adds percentiles; thread_stats (may be NULL) adds the per-thread counters.
+ * file_seconds is sorted in place.
+ */
+void print_stats(FILE *out, const PhaseStats *total, double wall_seconds, double *file_seconds, int file_count,
+                 const PhaseStats *thread_stats, int thread_count);
+
+/* Print the allocations of the run and of each file (from lexer_memory_end; percentiles if
+   there are several) with the maximum resident set size */
+void print_memory_stats(FILE *out, const LexerMemory *run, const LexerMemory *files, int file_count);
+
+#endif
@@ -0,0 +1,285 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - LINEAR COMPLEXITY TEST
+ *
+ * Generates adversarial inputs at doubling sizes and checks that the time of
+ * lexer_analyze, plus lexer_parse of its tokens, grows roughly linearly. The
+ * check is on the growth exponent: the slope of log(time) over log(bytes),
+ * fitted over all sizes, which is about 1 for a linear path and 2 for a
+ * quadratic one. A single noisy size moves the fit much less than it moves
+ * one doubling. Each size takes the fastest of several runs. The per-doubling
+ * ratios are printed too, scaled to an exact doubling of the bytes
+ * (generators stop at whole lines or blocks).
+ *
+ * Cases, for Python and TypeScript: huge identifiers, thousands of unique
+ * names, unterminated multi-line comments, one-line minified code, deep
+ * nesting and thousands of nested functions.
+ *
+ * Usage: linear [--base-size 65536] [--doublings 3] [case...]
+ * Exits with status 1 if a case is superlinear.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+
+/*===========================================================================
+ * SECTION 1: CONSTANTS AND DATA STRUCTURES
+ *===========================================================================*/
+
+#define MAX_EXPONENT        1.35
+#define RUNS                5
+#define MAX_DOUBLINGS       6
+#define MIN_TIMED_SECONDS   0.0005  // Sizes faster than this are mostly noise and left out of the fit
+
+/* Text: a growable buffer that a generator appends to */
+typedef struct {
+    char *data;
+    int length;
+    int capacity;
+} Text;
+
+/* Generator: writes at least size bytes of one adversarial shape */
+typedef void (*Generator)(Text *text, Language lang, int size);
+
+/*===========================================================================
+ * SECTION 2: GENERATORS
+ *===========================================================================*/
+
+static void append(Text *text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(Text *text, const char *format, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, format);
+        int written = vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+        va_end(args);
+        if (written < text->capacity - text->length) {
+            text->length += written;
+            return;
+        }
+        text->capacity = text->capacity * 2 + written + 1;
+        text->data = realloc(text->data, text->capacity);
+        if (!text->data) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(1);
+        }
+    }
+}
+
+/* Identifiers of 4 KB each */
+static void huge_identifiers(Text *text, Language lang, int size) {
+    char name[4097];
+    memset(name, 'a', 4096);
+    name[4096] = '\0';
+    for (int n = 0; text->length < size; n++) {
+        name[n % 4096] = 'a' + n % 26;
+        append(text, lang == LANG_PYTHON ? "%s = %d\n" : "let %s = %d;\n", name, n);
+    }
+}
+
+/* Every line declares a new name and uses the previous one */
+static void unique_names(Text *text, Language lang, int size) {
+    append(text, lang == LANG_PYTHON ? "name_0 = 0\n" : "let name_0 = 0;\n");
+    for (int n = 1; text->length < size; n++) {
+        append(text, lang == LANG_PYTHON ? "name_%d = name_%d + 1\n" : "let name_%d = name_%d + 1;\n", n, n - 1);
+    }
+}
+
+/* Multi-line comment openers that are never closed, one per line */
+static void unterminated_comments(Text *text, Language lang, int size) {
+    for (int n = 0; text->length < size; n++) {
+        if (lang == LANG_PYTHON) append(text, "value_%d = %d  %s never closed\n", n, n, n % 2 ? "\"\"\"" : "'''");
+        else append(text, "let value_%d = %d; /* never closed\n", n, n);
+    }
+}
+
+/* All code on one line */
+static void minified(Text *text, Language lang, int size) {
+    append(text, lang == LANG_PYTHON ? "a=0;" : "let a=0;");
+    for (int n = 0; text->length < size; n++) {
+        append(text, lang == LANG_PYTHON ? "a=a+%d*(a-%d);" : "a=a+%d*(a-%d);", n % 97, n % 13);
+    }
+    append(text, "\n");
+}
+
+/* Blocks and parentheses nested 100 deep, over and over */
+static void deep_nesting(Text *text, Language lang, int size) {
+    append(text, lang == LANG_PYTHON ? "depth = 0\n" : "let depth = 0;\n");
+    while (text->length < size) {
+        for (int d = 0; d < 100; d++) {
+            if (lang == LANG_PYTHON) append(text, "%*sif depth < %d:\n", d * 4, "", d);
+            else append(text, "%*sif (depth < %d) {\n", d * 2, "", d);
+        }
+        append(text, "%*sdepth = ", lang == LANG_PYTHON ? 400 : 200, "");
+        for (int d = 0; d < 100; d++) append(text, "(");
+        append(text, "depth");
+        for (int d = 0; d < 100; d++) append(text, " + 1)");
+        append(text, lang == LANG_PYTHON ? "\n" : ";\n");
+        if (lang == LANG_TYPESCRIPT) {
+            for (int d = 99; d >= 0; d--) append(text, "%*s}\n", d * 2, "");
+        }
+    }
+}
+
+/* Functions nested 200 deep, each using its own, the outermost and a later module-level name */
+static void nested_functions(Text *text, Language lang, int size) {
+    for (int block = 0; text->length < size; block++) {
+        for (int d = 0; d < 200; d++) {
+            if (lang == LANG_PYTHON) append(text, "%*sdef fn_%d(arg_%d):\n%*slocal_%d = arg_%d + 1\n", d, "", d, d, d + 1, "", d, d);
+            else append(text, "function fn_%d(arg_%d) {\nlet local_%d = arg_%d + 1;\n", d, d, d, d);
+        }
+        append(text, lang == LANG_PYTHON ? "%*sreturn arg_0 + local_199 + late_%d\n" : "%*sreturn arg_0 + local_199 + late_%d;\n",
+               lang == LANG_PYTHON ? 200 : 0, "", block);
+        if (lang == LANG_TYPESCRIPT) {
+            for (int d = 0; d < 200; d++) append(text, "}\n");
+        }
+        append(text, lang == LANG_PYTHON ? "late_%d = %d\n" : "let late_%d = %d;\n", block, block);
+    }
+}
+
+static const struct {
+    const char *name;
+    Generator generate;
+} CASES[] = {
+    { "huge-identifiers", huge_identifiers },
+    { "unique-names", unique_names },
+    { "unterminated-comments", unterminated_comments },
+    { "minified", minified },
+    { "deep-nesting", deep_nesting },
+    { "nested-functions", nested_functions },
+};
+#define CASE_COUNT (int)(sizeof(CASES) / sizeof(CASES[0]))
+
+/*===========================================================================
+ * SECTION 3: MEASUREMENT
+ *===========================================================================*/
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Fastest of RUNS analyses and parses of text; the token buffer holds every token */
+static double time_analysis(const Text *text, Language lang) {
+    LexerIterator iter;
+    TokenView view;
+    int token_capacity = 1024;
+    lexer_iter_init(&iter, lang, text->data, text->length);
+    while (lexer_iter_next(&iter, &view)) token_capacity++;
+
+    LexerResult result = { malloc(sizeof(Token) * token_capacity), token_capacity, 0,
+                           malloc(sizeof(Comment) * MAX_COMMENTS), MAX_COMMENTS, 0,
+                           malloc(sizeof(Error) * MAX_ERRORS), MAX_ERRORS, 0 };
+    LexerContext *context = lexer_create();
+    SyntaxTree tree = { 0 };
+    if (!result.tokens || !result.comments || !result.errors || !context) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    double best = 0;
+    for (int r = 0; r < RUNS; r++) {
+        double start = now_seconds();
+        lexer_analyze(context, lang, text->data, text->length, &result);
+        if (!lexer_parse(lang, result.tokens, result.token_count, &tree)) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(1);
+        }
+        double seconds = now_seconds() - start;
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    lexer_destroy(context);
+    lexer_tree_free(&tree);
+    free(result.tokens);
+    free(result.comments);
+    free(result.errors);
+    return best;
+}
+
+/* Least-squares slope of log(seconds) over log(lengths), for the sizes timed long enough */
+static double growth_exponent(const double *seconds, const int *lengths, int count) {
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    int points = 0;
+    for (int k = 0; k < count; k++) {
+        if (seconds[k] < MIN_TIMED_SECONDS) continue;
+        double x = log(lengths[k]), y = log(seconds[k]);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+        points++;
+    }
+    double spread = points * sum_xx - sum_x * sum_x;
+    if (points < 2 || spread < 1e-9) return 1;  // Too fast, or sizes too alike, to tell
+    return (points * sum_xy - sum_x * sum_y) / spread;
+}
+
+/* Time one case at base_size * 2^k; prints a row and returns 1 if it scales linearly */
+static int run_case(int index, Language lang, int base_size, int doublings) {
+    double seconds[MAX_DOUBLINGS + 1];
+    int lengths[MAX_DOUBLINGS + 1];
+    printf("  %-22s %-3s", CASES[index].name, lang == LANG_PYTHON ? "py" : "ts");
+    for (int k = 0; k <= doublings; k++) {
+        Text text = { malloc(4096), 0, 4096 };
+        if (!text.data) return 0;
+        CASES[index].generate(&text, lang, base_size << k);
+        seconds[k] = time_analysis(&text, lang);
+        lengths[k] = text.length;
+        free(text.data);
+
+        if (k == 0) {
+            printf(" %9.2f ms", seconds[k] * 1000);
+            continue;
+        }
+        printf(" %6.2fx", seconds[k] / seconds[k - 1] * (2.0 * lengths[k - 1] / lengths[k]));
+    }
+    double exponent = growth_exponent(seconds, lengths, doublings + 1);
+    printf(" %9.2f ms %9.2f  %s\n", seconds[doublings] * 1000, exponent, exponent <= MAX_EXPONENT ? "ok" : "SUPERLINEAR");
+    return exponent <= MAX_EXPONENT;
+}
+
+/*===========================================================================
+ * SECTION 4: MAIN
+ *===========================================================================*/
+
+int main(int argc, char *argv[]) {
+    int base_size = 64 * 1024, doublings = 3;
+    int selected[CASE_COUNT] = { 0 }, any_selected = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--base-size") == 0 && i + 1 < argc) {
+            base_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--doublings") == 0 && i + 1 < argc) {
+            doublings = atoi(argv[++i]);
+        } else {
+            int found = 0;
+            for (int c = 0; c < CASE_COUNT; c++) {
+                if (strcmp(argv[i], CASES[c].name) == 0) selected[c] = found = any_selected = 1;
+            }
+            if (!found) {
+                fprintf(stderr, "Usage: %s [--base-size 65536] [--doublings 3] [case...]\n", argv[0]);
+                return 1;
+            }
+        }
+    }
+    if (base_size < 1024 || doublings < 1 || doublings > MAX_DOUBLINGS) {
+        fprintf(stderr, "Error: --base-size must be at least 1024 and --doublings 1..%d\n", MAX_DOUBLINGS);
+        return 1;
+    }
+
+    printf("Time per doubling of the input, %d to %d bytes; growth exponent limit %.2f\n", base_size,
+           base_size << doublings, MAX_EXPONENT);
+    int failures = 0;
+    for (int c = 0; c < CASE_COUNT; c++) {
+        if (any_selected && !selected[c]) continue;
+        failures += !run_case(c, LANG_PYTHON, base_size, doublings);
+        failures += !run_case(c, LANG_TYPESCRIPT, base_size, doublings);
+    }
+    printf("%s: %d superlinear case%s\n", failures ? "FAILED" : "PASSED", failures, failures == 1 ? "" : "s");
+    return failures ? 1 : 0;
+}
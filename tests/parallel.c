@@ -0,0 +1,140 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - PARALLEL TOKENIZER TEST
+ *
+ * Lexes random inputs with tokenize_parallel and checks that every token
+ * (value, type, line and column) is what the sequential tokenizer gives. The
+ * test is built with small PARALLEL_LEX_MIN_BYTES and PARALLEL_LEX_MIN_CHUNK,
+ * so a few kilobytes are already cut into many chunks. The Python inputs are
+ * heavy on layout: indentation that comes and goes, blank and whitespace-only
+ * lines, lines holding only a character that is no token ('@', '$'),
+ * brackets and line joins across lines, and strings that span lines. Some
+ * cases also give less room than the input needs, so the stream is cut short.
+ *
+ * Usage: parallel [--seed 1] [--cases 500]
+ * Exits with status 1 if a parallel stream differs from the sequential one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+
+/*===========================================================================
+ * SECTION 1: CONSTANTS
+ *===========================================================================*/
+
+#define MIN_INPUT_BYTES     2048
+#define MAX_INPUT_BYTES     16384
+#define MAX_TEST_THREADS    8
+#define MAX_INDENT          5       // Indentation levels of the random Python lines
+
+/* Line bodies; indentation is added separately */
+static const char *const PYTHON_LINES[] = {
+    "x = 1", "def f(a, b):", "class C:", "if y:", "else:", "pass", "return x", "@", "$", "?", "@decorator",
+    "", "   ", "\t", "f(a,", "  b)", "[1,", "2]", "x = \\", "y", "s = '''doc", "more'''", "t = \"\"\"a", "b\"\"\"",
+    "u = 'open", "v = 3.5 + w", "for i in range(3):", "while z:"
+};
+static const char *const TYPESCRIPT_LINES[] = {
+    "let x = 1;", "function f(a) {", "}", "if (y) {", "} else {", "return x;", "@", "$", "", "  ", "f(a,", "b);",
+    "const s = `tpl", "end`;", "let t = 'open", "x = 3.5 + w;", "class C {", "z => {"
+};
+
+/*===========================================================================
+ * SECTION 2: INPUTS
+ *===========================================================================*/
+
+static void out_of_memory(void) {
+    fprintf(stderr, "Error: Out of memory\n");
+    exit(1);
+}
+
+/* Random source of about size bytes (NUL-terminated); returns its length */
+static int generate(Language lang, char *buffer, int size) {
+    const char *const *lines = lang == LANG_PYTHON ? PYTHON_LINES : TYPESCRIPT_LINES;
+    int line_count = lang == LANG_PYTHON ? (int)(sizeof(PYTHON_LINES) / sizeof(PYTHON_LINES[0]))
+                                         : (int)(sizeof(TYPESCRIPT_LINES) / sizeof(TYPESCRIPT_LINES[0]));
+    int length = 0, level = 0;
+    while (length < size) {
+        // A walk over indentation levels, often back to column 1 where chunks are cut
+        int step = rand() % 6;
+        if (step == 0 && level < MAX_INDENT) level++;
+        else if (step == 1 && level > 0) level--;
+        else if (step == 2) level = 0;
+        int indent = rand() % 8 == 0 ? rand() % 7 : level * 4;
+        const char *body = lines[rand() % line_count];
+        length += sprintf(buffer + length, "%*s%s\n", indent, "", body);
+    }
+    return length;
+}
+
+/*===========================================================================
+ * SECTION 3: COMPARISON
+ *===========================================================================*/
+
+/* Lex one random input both ways; returns 1 if the streams are identical */
+static int run_case(Language lang, int case_index, char *source, Token *serial, Token *parallel) {
+    int length = generate(lang, source, MIN_INPUT_BYTES + rand() % (MAX_INPUT_BYTES - MIN_INPUT_BYTES));
+    int capacity = 2 * length + 16;                             // More than any input can produce
+    if (rand() % 4 == 0) capacity = 1 + rand() % (length / 4);  // Cut short
+    int threads = 2 + rand() % (MAX_TEST_THREADS - 1);
+
+    int serial_count = 0, parallel_count = 0;
+    tokenize_parallel(source, length, lang, serial, capacity, &serial_count, 1);
+    tokenize_parallel(source, length, lang, parallel, capacity, &parallel_count, threads);
+
+    int count = serial_count < parallel_count ? serial_count : parallel_count;
+    for (int t = 0; t < count; t++) {
+        const Token *expected = &serial[t], *actual = &parallel[t];
+        if (strcmp(expected->value, actual->value) == 0 && strcmp(expected->type, actual->type) == 0 &&
+            expected->line == actual->line && expected->column == actual->column) {
+            continue;
+        }
+        printf("  case %d (%s, %d threads): token %d is %s '%s' at %d:%d, sequentially %s '%s' at %d:%d\n",
+               case_index, lang == LANG_PYTHON ? "py" : "ts", threads, t, actual->type, actual->value,
+               actual->line, actual->column, expected->type, expected->value, expected->line, expected->column);
+        return 0;
+    }
+    if (serial_count != parallel_count) {
+        printf("  case %d (%s, %d threads): %d tokens, sequentially %d\n", case_index,
+               lang == LANG_PYTHON ? "py" : "ts", threads, parallel_count, serial_count);
+        return 0;
+    }
+    return 1;
+}
+
+/* case_count random inputs; returns the number of mismatches */
+static int run_cases(Language lang, int case_count) {
+    char *source = malloc(MAX_INPUT_BYTES + 256);
+    Token *serial = malloc(sizeof(Token) * (2 * (MAX_INPUT_BYTES + 256) + 16));
+    Token *parallel = malloc(sizeof(Token) * (2 * (MAX_INPUT_BYTES + 256) + 16));
+    if (!source || !serial || !parallel) out_of_memory();
+
+    int mismatches = 0;
+    for (int c = 0; c < case_count; c++) mismatches += !run_case(lang, c, source, serial, parallel);
+    printf("  %-28s %-3s %s\n", "random-layout", lang == LANG_PYTHON ? "py" : "ts", mismatches ? "MISMATCH" : "ok");
+    free(source);
+    free(serial);
+    free(parallel);
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    int seed = 1, case_count = 500;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) {
+            case_count = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--seed 1] [--cases 500]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("Parallel against sequential token streams (%d random inputs per language, seed %d)\n", case_count, seed);
+    srand(seed);
+    int failures = (run_cases(LANG_PYTHON, case_count) > 0) + (run_cases(LANG_TYPESCRIPT, case_count) > 0);
+    printf("%s: %d mismatched case%s\n", failures ? "FAILED" : "PASSED", failures, failures == 1 ? "" : "s");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,322 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - INCREMENTAL RE-LEXING TEST
+ *
+ * Applies edits to a document, patches its TokenStream with lexer_relex after
+ * each one, and checks that the stream is exactly what lexing the edited text
+ * from scratch gives. First come fixed cases, such as closing a multi-line
+ * comment that had been left open earlier in the file. Then come random
+ * edits built from fragments that form comment openers and closers, strings,
+ * line joins and indentation. Last, lexer_check_range is run on each line of
+ * a few samples on its own and must report what a full lexer_analyze reports
+ * for that line, apart from undeclared identifiers, which it does not cover.
+ *
+ * Usage: relex [--seed 1] [--edits 2000]
+ * Exits with status 1 if a patched stream differs from a full lex.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+
+/*===========================================================================
+ * SECTION 1: CONSTANTS AND DATA STRUCTURES
+ *===========================================================================*/
+
+#define DOCUMENT_FRAGMENTS  200     // Fragments in a random document before the edits start
+#define MAX_EDIT_REMOVED    8
+
+/* Document: a source buffer and the stream lexer_relex keeps for it */
+typedef struct {
+    Language lang;
+    char *text;
+    int length;
+    int capacity;
+    TokenStream stream;
+} Document;
+
+/* FixedCase: text, then one edit to it */
+typedef struct {
+    const char *name;
+    Language lang;
+    const char *text;
+    int start;          // -1: at the end of the text
+    int removed;
+    const char *inserted;
+} FixedCase;
+
+static const FixedCase FIXED_CASES[] = {
+    { "close-comment-after-open", LANG_TYPESCRIPT, "a /* b\nc d\ne\n", -1, 0, "*/ f" },
+    { "close-docstring-after-open", LANG_PYTHON, "x = 1\n'''\ny = 2\nz = 3\n", -1, 0, "'''\nw = 4\n" },
+    { "close-comment-by-joining", LANG_TYPESCRIPT, "a /* b\nc *x/\ne\n", 10, 1, "" },
+    { "reopen-by-removing-closer", LANG_TYPESCRIPT, "a /* b */ c\nd /* e */\n", 7, 2, "" },
+    { "close-docstring-by-quote", LANG_PYTHON, "s = '''\nx = 1\n''\ny = 2\n", 16, 0, "'" },
+    { "edit-inside-string", LANG_PYTHON, "a = 'b c'\nd = 1\n", 6, 1, "x' + '" },
+};
+#define FIXED_CASE_COUNT (int)(sizeof(FIXED_CASES) / sizeof(FIXED_CASES[0]))
+
+/* Random edits insert these; together they open and close comments and strings */
+static const char *const PYTHON_FRAGMENTS[] = {
+    "x", " = ", "1", "\n", "    ", "def f(a):", "'''", "\"\"\"", "'", "\"", "#c", "'s'", "(", ")", "y2", "3.5",
+    "\\\n", ":", "pass"
+};
+static const char *const TYPESCRIPT_FRAGMENTS[] = {
+    "x", " = ", "1", "\n", "  ", "function f(a) {", "}", "/*", "*/", "*", "/", "//c", "'s'", "`t`", "`", "(", ")",
+    "y2", "3.5", ";"
+};
+
+/* RangeSample: a document whose lines are checked one at a time */
+typedef struct {
+    const char *name;
+    Language lang;
+    const char *text;
+} RangeSample;
+
+static const RangeSample RANGE_SAMPLES[] = {
+    { "types-across-lines", LANG_PYTHON,
+      "count: int = 0\n"
+      "name = \"x\"\n"
+      "total = count + 1\n"
+      "if total > 1:\n"
+      "    print(total)\n"
+      "    count = \"many\"\n"
+      "ratio: float = 1.5\n"
+      "ratio = name\n"
+      "def helper(a):\n"
+      "    local: str = \"s\"\n"
+      "    local = 3\n"
+      "    retrn local\n"
+      "value: int = 3.14\n"
+      "x === 1\n" },
+    { "types-across-lines", LANG_TYPESCRIPT,
+      "let count: number = 0;\n"
+      "let label = \"x\";\n"
+      "let total = count + 1;\n"
+      "if (total > 1) {\n"
+      "  console.log(total);\n"
+      "  count = label;\n"
+      "}\n"
+      "function helper(a) {\n"
+      "  let local: string = \"s\";\n"
+      "  local = 3;\n"
+      "  retrun local;\n"
+      "}\n"
+      "let flag: boolean = 1;\n"
+      "let text: number = \"s\";\n"
+      "if (count =< 1) { count = \"many\"; }\n" },
+    { "regions-in-brackets", LANG_PYTHON,
+      "items = sorted(data, key=lambda v: v,\n"
+      "               reverse=True)\n"
+      "limit: int = 2\n"
+      "limit = \"s\"\n" },
+    { "regions-in-brackets", LANG_TYPESCRIPT,
+      "items.forEach((item) => {\n"
+      "  let seen: number = 0;\n"
+      "  seen = \"s\";\n"
+      "});\n"
+      "run(function () {\n"
+      "  let done: boolean = true;\n"
+      "  done = 1;\n"
+      "});\n" },
+};
+#define RANGE_SAMPLE_COUNT (int)(sizeof(RANGE_SAMPLES) / sizeof(RANGE_SAMPLES[0]))
+
+/*===========================================================================
+ * SECTION 2: DOCUMENTS
+ *===========================================================================*/
+
+static void out_of_memory(void) {
+    fprintf(stderr, "Error: Out of memory\n");
+    exit(1);
+}
+
+static void document_init(Document *document, Language lang, const char *text) {
+    document->lang = lang;
+    document->length = (int)strlen(text);
+    document->capacity = document->length + 1;
+    document->text = malloc(document->capacity);
+    if (!document->text) out_of_memory();
+    memcpy(document->text, text, document->length + 1);
+    if (!lexer_stream_init(&document->stream, lang, document->text, document->length)) out_of_memory();
+}
+
+static void document_free(Document *document) {
+    lexer_stream_free(&document->stream);
+    free(document->text);
+}
+
+/* Replace text[start .. start + removed) with inserted and patch the stream */
+static void document_edit(Document *document, int start, int removed, const char *inserted) {
+    int inserted_length = (int)strlen(inserted);
+    int length = document->length - removed + inserted_length;
+    if (length + 1 > document->capacity) {
+        document->capacity = (length + 1) * 2;
+        document->text = realloc(document->text, document->capacity);
+        if (!document->text) out_of_memory();
+    }
+    memmove(document->text + start + inserted_length, document->text + start + removed, document->length - start - removed + 1);
+    memcpy(document->text + start, inserted, inserted_length);
+    document->length = length;
+
+    TextEdit edit = { start, removed, inserted_length };
+    RelexResult change;
+    if (!lexer_relex(document->lang, document->text, document->length, &edit, &document->stream, &change)) out_of_memory();
+}
+
+/* Whether the stream matches a full lex of the text; prints the first difference if not */
+static int document_matches(const Document *document, const char *label) {
+    TokenStream full;
+    if (!lexer_stream_init(&full, document->lang, document->text, document->length)) out_of_memory();
+    int matches = full.count == document->stream.count;
+    for (int i = 0; matches && i < full.count; i++) {
+        TokenView expected, actual;
+        lexer_stream_get(&full, i, &expected);
+        lexer_stream_get(&document->stream, i, &actual);
+        matches = expected.kind == actual.kind && expected.start == actual.start &&
+                  expected.length == actual.length && expected.line == actual.line;
+        if (!matches) {
+            printf("  %s: token %d is %s at %d (line %d), a full lex has %s at %d (line %d)\n", label, i,
+                   token_kind_name(actual.kind), actual.start, actual.line,
+                   token_kind_name(expected.kind), expected.start, expected.line);
+        }
+    }
+    if (full.count != document->stream.count) {
+        printf("  %s: %d tokens after relexing, %d from a full lex\n", label, document->stream.count, full.count);
+    }
+    lexer_stream_free(&full);
+    return matches;
+}
+
+/*===========================================================================
+ * SECTION 3: CASES
+ *===========================================================================*/
+
+static int run_fixed_case(const FixedCase *fixed) {
+    Document document;
+    document_init(&document, fixed->lang, fixed->text);
+    document_edit(&document, fixed->start < 0 ? document.length : fixed->start, fixed->removed, fixed->inserted);
+    int matches = document_matches(&document, fixed->name);
+    printf("  %-28s %-3s %s\n", fixed->name, fixed->lang == LANG_PYTHON ? "py" : "ts", matches ? "ok" : "MISMATCH");
+    document_free(&document);
+    return matches;
+}
+
+/* edit_count random edits to a random document; returns the number of mismatches */
+static int run_random_edits(Language lang, int edit_count) {
+    const char *const *fragments = lang == LANG_PYTHON ? PYTHON_FRAGMENTS : TYPESCRIPT_FRAGMENTS;
+    int fragment_count = lang == LANG_PYTHON ? (int)(sizeof(PYTHON_FRAGMENTS) / sizeof(PYTHON_FRAGMENTS[0]))
+                                             : (int)(sizeof(TYPESCRIPT_FRAGMENTS) / sizeof(TYPESCRIPT_FRAGMENTS[0]));
+    Document document;
+    document_init(&document, lang, "");
+    for (int i = 0; i < DOCUMENT_FRAGMENTS; i++) {
+        document_edit(&document, document.length, 0, fragments[rand() % fragment_count]);
+    }
+
+    int mismatches = 0;
+    for (int e = 0; e < edit_count; e++) {
+        int start = rand() % (document.length + 1);
+        int removed = rand() % 4 == 0 ? rand() % (MAX_EDIT_REMOVED + 1) : 0;
+        if (start + removed > document.length) removed = document.length - start;
+        document_edit(&document, start, removed, rand() % 3 ? fragments[rand() % fragment_count] : "");
+
+        char label[64];
+        snprintf(label, sizeof(label), "edit %d", e);
+        if (!document_matches(&document, label)) {
+            mismatches++;
+            lexer_stream_free(&document.stream);    // Start over from a correct stream
+            if (!lexer_stream_init(&document.stream, lang, document.text, document.length)) out_of_memory();
+        }
+    }
+    printf("  %-28s %-3s %s\n", "random-edits", lang == LANG_PYTHON ? "py" : "ts", mismatches ? "MISMATCH" : "ok");
+    document_free(&document);
+    return mismatches;
+}
+
+/* Errors of errors[0 .. count) on line, other than undeclared identifiers, moved to the front */
+static int errors_on_line(Error *errors, int count, int line) {
+    int kept = 0;
+    for (int e = 0; e < count; e++) {
+        if (errors[e].line_number == line && errors[e].type != ERROR_TYPE_UNDECLARED_IDENTIFIER) errors[kept++] = errors[e];
+    }
+    return kept;
+}
+
+/* Check each line of the sample on its own; returns 1 if every line matches a full analysis */
+static int run_range_sample(const RangeSample *sample) {
+    Document document;
+    document_init(&document, sample->lang, sample->text);
+    LexerContext *context = lexer_create();
+    LexerResult result = { malloc(sizeof(Token) * MAX_TOKENS), MAX_TOKENS, 0, malloc(sizeof(Comment) * MAX_COMMENTS),
+                           MAX_COMMENTS, 0, malloc(sizeof(Error) * MAX_ERRORS * CHECK_COUNT), MAX_ERRORS * CHECK_COUNT, 0 };
+    Error *ranged = malloc(sizeof(Error) * MAX_ERRORS * CHECK_COUNT);
+    Error *expected = malloc(sizeof(Error) * MAX_ERRORS * CHECK_COUNT);
+    if (!context || !result.tokens || !result.comments || !result.errors || !ranged || !expected) out_of_memory();
+    if (!lexer_analyze(context, sample->lang, document.text, document.length, &result)) out_of_memory();
+
+    int matches = 1, first = 0;
+    while (first < document.stream.count) {
+        TokenView token;
+        lexer_stream_get(&document.stream, first, &token);
+        int line = token.line, count = 1;
+        for (; first + count < document.stream.count; count++) {
+            lexer_stream_get(&document.stream, first + count, &token);
+            if (token.line != line) break;
+        }
+
+        int ranged_count = lexer_check_range(sample->lang, document.text, &document.stream, first, count,
+                                             ranged, MAX_ERRORS * CHECK_COUNT);
+        ranged_count = errors_on_line(ranged, ranged_count, line);
+        memcpy(expected, result.errors, sizeof(Error) * result.error_count);
+        int expected_count = errors_on_line(expected, result.error_count, line);
+        int same = ranged_count == expected_count;
+        for (int e = 0; same && e < expected_count; e++) {
+            same = ranged[e].type == expected[e].type && strcmp(ranged[e].message, expected[e].message) == 0;
+        }
+        if (!same) {
+            printf("  %s: line %d has %d errors checked on its own, %d in a full analysis\n", sample->name, line,
+                   ranged_count, expected_count);
+            matches = 0;
+        }
+        first += count;
+    }
+    printf("  %-28s %-3s %s\n", sample->name, sample->lang == LANG_PYTHON ? "py" : "ts", matches ? "ok" : "MISMATCH");
+
+    lexer_destroy(context);
+    free(result.tokens);
+    free(result.comments);
+    free(result.errors);
+    free(ranged);
+    free(expected);
+    document_free(&document);
+    return matches;
+}
+
+/*===========================================================================
+ * SECTION 4: MAIN
+ *===========================================================================*/
+
+int main(int argc, char *argv[]) {
+    int seed = 1, edit_count = 2000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--edits") == 0 && i + 1 < argc) {
+            edit_count = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--seed 1] [--edits 2000]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("Relexed streams against full lexes (%d random edits per language, seed %d), ranged checks against full analyses\n",
+           edit_count, seed);
+    int failures = 0;
+    for (int c = 0; c < FIXED_CASE_COUNT; c++) failures += !run_fixed_case(&FIXED_CASES[c]);
+    srand(seed);
+    failures += run_random_edits(LANG_PYTHON, edit_count) > 0;
+    failures += run_random_edits(LANG_TYPESCRIPT, edit_count) > 0;
+    for (int c = 0; c < RANGE_SAMPLE_COUNT; c++) failures += !run_range_sample(&RANGE_SAMPLES[c]);
+    printf("%s: %d mismatched case%s\n", failures ? "FAILED" : "PASSED", failures, failures == 1 ? "" : "s");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - EVENT TRACING
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "trace.h"
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+/* TraceEvent: one begin or end */
+typedef struct {
+    long long nanoseconds;      // Since trace_open
+    const char *name;           // Begin events only
+    char *owned_name;           // name, if it is a copy to free
+    char phase;                 // 'B' or 'E'
+    char is_file;               // File (1) or phase (0)
+} TraceEvent;
+
+/* TraceBuffer: the ring of one thread; kept after the thread exits */
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    int tid;
+    char name[32];
+    TraceEvent *events;
+    int capacity;               // Grows up to TRACE_RING_EVENTS, then the oldest events are overwritten
+    long long written;
+} TraceBuffer;
+
+static FILE *trace_file;
+static struct timespec trace_start;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;   // Taken once per thread
+static TraceBuffer *buffers;
+static _Thread_local TraceBuffer *thread_buffer;
+
+/*===========================================================================
+ * SECTION 2: RECORDING
+ *===========================================================================*/
+
+static TraceBuffer *current_buffer(void) {
+    if (thread_buffer) return thread_buffer;
+    TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+    if (!buffer) return NULL;
+    buffer->tid = syscall(SYS_gettid);
+    snprintf(buffer->name, sizeof(buffer->name), "analysis %d", buffer->tid);
+    pthread_mutex_lock(&buffers_lock);
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&buffers_lock);
+    thread_buffer = buffer;
+    return buffer;
+}
+
+static void record(char phase, int is_file, const char *name, char *owned_name) {
+    TraceBuffer *buffer = trace_file ? current_buffer() : NULL;
+    if (!buffer) {
+        free(owned_name);
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (buffer->written == buffer->capacity && buffer->capacity < TRACE_RING_EVENTS) {
+        int capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        if (capacity > TRACE_RING_EVENTS) capacity = TRACE_RING_EVENTS;
+        TraceEvent *grown = realloc(buffer->events, sizeof(TraceEvent) * capacity);
+        if (grown) {
+            buffer->events = grown;
+            buffer->capacity = capacity;
+        }
+    }
+    if (buffer->capacity == 0) {
+        free(owned_name);
+        return;
+    }
+    TraceEvent *event = &buffer->events[buffer->written % buffer->capacity];
+    if (buffer->written >= buffer->capacity) free(event->owned_name);
+    event->nanoseconds = (now.tv_sec - trace_start.tv_sec) * 1000000000LL + (now.tv_nsec - trace_start.tv_nsec);
+    event->name = name;
+    event->owned_name = owned_name;
+    event->phase = phase;
+    event->is_file = is_file;
+    buffer->written++;
+}
+
+void trace_thread_name(const char *name) {
+    TraceBuffer *buffer = trace_file ? current_buffer() : NULL;
+    if (buffer) snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+}
+
+void trace_begin_file(const char *path) {
+    if (!trace_file) return;
+    char *copy = strdup(path);
+    record('B', 1, copy ? copy : "file", copy);
+}
+
+void trace_end_file(void) {
+    record('E', 1, NULL, NULL);
+}
+
+void trace_begin(const char *name) {
+    record('B', 0, name, NULL);
+}
+
+void trace_end(void) {
+    record('E', 0, NULL, NULL);
+}
+
+static void trace_phase_hook(void *data, LexerPhase phase, int is_end) {
+    TraceHook *hook = data;
+    if (is_end) {
+        if (hook->next) hook->next(hook->next_data, phase, is_end);
+        trace_end();
+    } else {
+        trace_begin(lexer_phase_name(phase));
+        if (hook->next) hook->next(hook->next_data, phase, is_end);
+    }
+}
+
+void trace_attach(TraceHook *hook, LexerContext *context) {
+    if (!trace_file) return;
+    lexer_get_phase_hook(context, &hook->next, &hook->next_data);
+    lexer_set_phase_hook(context, trace_phase_hook, hook);
+}
+
+/*===========================================================================
+ * SECTION 3: OUTPUT
+ *===========================================================================*/
+
+static void write_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {
+        if (*c == '"' || *c == '\\') fprintf(out, "\\%c", *c);
+        else if (*c < 0x20) fprintf(out, "\\u%04x", *c);
+        else fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+/* Write every buffer, oldest event first, and release them */
+static void trace_write(void) {
+    FILE *out = trace_file;
+    int pid = getpid();
+    long long dropped = 0;
+    trace_file = NULL;
+
+    pthread_mutex_lock(&buffers_lock);
+    fprintf(out, "{\"traceEvents\":[");
+    int first = 1;
+    for (TraceBuffer *buffer = buffers; buffer; buffer = buffer->next) {
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",",
+                pid, buffer->tid);
+        write_json_string(out, buffer->name);
+        fprintf(out, "}}");
+        first = 0;
+
+        long long oldest = buffer->written > buffer->capacity ? buffer->written - buffer->capacity : 0;
+        dropped += oldest;
+        for (long long i = oldest; i < buffer->written; i++) {
+            TraceEvent *event = &buffer->events[i % buffer->capacity];
+            fprintf(out, ",\n{");
+            if (event->name) {
+                fprintf(out, "\"name\":");
+                write_json_string(out, event->name);
+                fprintf(out, ",");
+            }
+            fprintf(out, "\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d}", event->is_file ? "file" : "phase",
+                    event->phase, event->nanoseconds / 1000, event->nanoseconds % 1000, pid, buffer->tid);
+            free(event->owned_name);
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%lld}}\n", dropped);
+    fclose(out);
+
+    while (buffers) {
+        TraceBuffer *next = buffers->next;
+        free(buffers->events);
+        free(buffers);
+        buffers = next;
+    }
+    pthread_mutex_unlock(&buffers_lock);
+}
+
+int trace_open(const char *path) {
+    trace_file = fopen(path, "w");
+    if (!trace_file) return 0;
+    clock_gettime(CLOCK_MONOTONIC, &trace_start);
+    atexit(trace_write);
+    return 1;
+}
@@ -0,0 +1,41 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - EVENT TRACING
+ *
+ * --trace <out.json>: begin/end events per file and per phase on every thread,
+ * written at exit in the Chrome trace-event JSON format (load it in Perfetto
+ * or chrome://tracing). Each thread records into its own ring buffer, so
+ * recording takes no lock; a buffer that fills up keeps the newest events.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "lexer.h"
+
+#ifndef TRACE_RING_EVENTS
+#define TRACE_RING_EVENTS 65536     // Per thread
+#endif
+
+/* Start tracing; the trace is written to path when the process exits. Returns 0 if
+   path cannot be written. */
+int trace_open(const char *path);
+
+/* Name the calling thread in the trace */
+void trace_thread_name(const char *name);
+
+/* Begin/end a file (the path is copied) and a phase (name must stay valid until exit);
+   these do nothing unless tracing was started */
+void trace_begin_file(const char *path);
+void trace_end_file(void);
+void trace_begin(const char *name);
+void trace_end(void);
+
+/* TraceHook: records lexer_analyze phases, then calls the hook that was installed before */
+typedef struct {
+    LexerPhaseHook next;
+    void *next_data;
+} TraceHook;
+
+void trace_attach(TraceHook *hook, LexerContext *context);
+
+#endif
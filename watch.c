@@ -0,0 +1,461 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - WATCH MODE
+ *
+ * Every directory under the root gets an inotify watch. Events are collected
+ * until the tree has been quiet for WATCH_DEBOUNCE_MS (an editor save is often
+ * several events), then each touched file is analyzed once. The errors of all
+ * other files stay in memory, so the totals stay correct without a rescan.
+ * Files and pending paths are found through hash indexes, so even the rescan
+ * after an event queue overflow costs time linear in the number of files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "lexer.h"
+#include "watch.h"
+
+/*===========================================================================
+ * CONSTANTS
+ *===========================================================================*/
+#define WATCH_DEBOUNCE_MS   100     // Quiet time before changed files are analyzed
+#define WATCH_DIR_EVENTS    (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR)
+#define WATCH_INDEX_MIN     64      // Initial slots of a path index
+#define WATCH_EVENT_BUFFER  65536
+
+/*===========================================================================
+ * SECTION 1: DATA STRUCTURES
+ *===========================================================================*/
+
+/* WatchedFile: the last analysis of one source file */
+typedef struct {
+    char *path;
+    Error *errors;
+    int error_count;
+} WatchedFile;
+
+/* PathList: growable array of owned strings */
+typedef struct {
+    char **items;
+    int count;
+    int capacity;
+} PathList;
+
+/* PathIndex: path -> position in a list (FNV-1a hash, linear probing, never more than half full) */
+typedef struct {
+    const char **keys;          // Borrowed from the list; NULL: empty slot
+    int *values;
+    int capacity;               // Power of two
+    int count;
+} PathIndex;
+
+typedef struct {
+    int inotify_fd;
+    const char *root;
+    PathList directories;       // Indexed by watch descriptor
+    WatchedFile *files;
+    int file_count;
+    int file_capacity;
+    PathIndex file_index;       // Path -> index in files
+    PathList pending;           // Files touched since the last analysis
+    PathIndex pending_index;
+    long long due_ms;
+    LexerContext *context;
+    Token *tokens;              // Grown to the largest file so far by lexer_analyze_all
+    int token_capacity;
+    Comment *comments;
+    Error *errors;
+    FileErrorPrinter print_file_errors;
+} Watcher;
+
+/*===========================================================================
+ * SECTION 2: UTILITY FUNCTIONS
+ *===========================================================================*/
+
+static void out_of_memory(void) {
+    fprintf(stderr, "Error: Out of memory\n");
+    exit(1);
+}
+
+static long long now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int is_source_file(const char *name, Language *lang) {
+    const char *ext = strrchr(name, '.');
+    if (!ext || ext == name) return 0;
+    if (strcmp(ext, ".py") == 0) {
+        *lang = LANG_PYTHON;
+        return 1;
+    }
+    if (strcmp(ext, ".ts") == 0 || strcmp(ext, ".js") == 0) {
+        *lang = LANG_TYPESCRIPT;
+        return 1;
+    }
+    return 0;
+}
+
+/* Add a copy of path at index (growing the list as needed) */
+static void path_list_set(PathList *list, int index, const char *path) {
+    if (index >= list->capacity) {
+        int capacity = list->capacity ? list->capacity : 64;
+        while (capacity <= index) capacity *= 2;
+        char **grown = realloc(list->items, sizeof(char *) * capacity);
+        if (!grown) out_of_memory();
+        memset(grown + list->capacity, 0, sizeof(char *) * (capacity - list->capacity));
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    free(list->items[index]);
+    list->items[index] = strdup(path);
+    if (!list->items[index]) out_of_memory();
+    if (index >= list->count) list->count = index + 1;
+}
+
+static unsigned int hash_path(const char *path) {
+    unsigned int hash = 2166136261u;    // FNV-1a
+    for (; *path; path++) hash = (hash ^ (unsigned char)*path) * 16777619u;
+    return hash;
+}
+
+/* Slot holding path, or the empty slot where it would go */
+static int path_index_slot(const PathIndex *index, const char *path) {
+    int mask = index->capacity - 1;
+    int slot = hash_path(path) & mask;
+    while (index->keys[slot] && strcmp(index->keys[slot], path) != 0) slot = (slot + 1) & mask;
+    return slot;
+}
+
+/* Position of path in the list, or -1 */
+static int path_index_find(const PathIndex *index, const char *path) {
+    if (index->count == 0) return -1;
+    int slot = path_index_slot(index, path);
+    return index->keys[slot] ? index->values[slot] : -1;
+}
+
+/* Map path (borrowed, must outlive the entry) to value */
+static void path_index_put(PathIndex *index, const char *path, int value) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        PathIndex grown = { NULL, NULL, index->capacity ? index->capacity * 2 : WATCH_INDEX_MIN, 0 };
+        grown.keys = calloc(grown.capacity, sizeof(char *));
+        grown.values = malloc(sizeof(int) * grown.capacity);
+        if (!grown.keys || !grown.values) out_of_memory();
+        for (int i = 0; i < index->capacity; i++) {
+            if (index->keys[i]) path_index_put(&grown, index->keys[i], index->values[i]);
+        }
+        free(index->keys);
+        free(index->values);
+        *index = grown;
+    }
+    int slot = path_index_slot(index, path);
+    if (!index->keys[slot]) index->count++;
+    index->keys[slot] = path;
+    index->values[slot] = value;
+}
+
+/* Remove path, moving later entries of its probe run back so lookups never stop early */
+static void path_index_remove(PathIndex *index, const char *path) {
+    if (index->count == 0) return;
+    int mask = index->capacity - 1;
+    int hole = path_index_slot(index, path);
+    if (!index->keys[hole]) return;
+    index->keys[hole] = NULL;
+    index->count--;
+    for (int slot = (hole + 1) & mask; index->keys[slot]; slot = (slot + 1) & mask) {
+        int home = hash_path(index->keys[slot]) & mask;
+        // The entry may move into the hole unless its home lies cyclically in (hole, slot]
+        if ((slot > hole && (home <= hole || home > slot)) || (slot < hole && home <= hole && home > slot)) {
+            index->keys[hole] = index->keys[slot];
+            index->values[hole] = index->values[slot];
+            index->keys[slot] = NULL;
+            hole = slot;
+        }
+    }
+}
+
+static void path_index_clear(PathIndex *index) {
+    if (index->keys) memset(index->keys, 0, sizeof(char *) * index->capacity);
+    index->count = 0;
+}
+
+/* Mark path as touched since the last analysis */
+static void add_pending(Watcher *watcher, const char *path) {
+    if (path_index_find(&watcher->pending_index, path) >= 0) return;
+    path_list_set(&watcher->pending, watcher->pending.count, path);
+    path_index_put(&watcher->pending_index, watcher->pending.items[watcher->pending.count - 1], watcher->pending.count - 1);
+}
+
+static void clear_pending(Watcher *watcher) {
+    path_index_clear(&watcher->pending_index);
+    for (int i = 0; i < watcher->pending.count; i++) {
+        free(watcher->pending.items[i]);
+        watcher->pending.items[i] = NULL;
+    }
+    watcher->pending.count = 0;
+}
+
+/* Whether path is directory or lies below it */
+static int is_under(const char *path, const char *directory) {
+    size_t length = strlen(directory);
+    return strncmp(path, directory, length) == 0 && (path[length] == '\0' || path[length] == '/');
+}
+
+/* Read a whole file; NULL if it cannot be opened (e.g. it was just deleted) */
+static char *read_source(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *content = lexer_malloc(size + 1);
+    if (content) {
+        size_t length = fread(content, 1, size, file);
+        content[length] = '\0';
+    }
+    fclose(file);
+    return content;
+}
+
+/*===========================================================================
+ * SECTION 3: ANALYSIS
+ *===========================================================================*/
+
+static int find_file(Watcher *watcher, const char *path) {
+    return path_index_find(&watcher->file_index, path);
+}
+
+/* Forget files[index]; the last file takes its place */
+static void remove_file(Watcher *watcher, int index) {
+    WatchedFile *file = &watcher->files[index];
+    path_index_remove(&watcher->file_index, file->path);
+    free(file->path);
+    lexer_free(file->errors);
+    *file = watcher->files[--watcher->file_count];
+    if (index < watcher->file_count) path_index_put(&watcher->file_index, file->path, index);
+}
+
+static int total_errors(Watcher *watcher) {
+    int total = 0;
+    for (int i = 0; i < watcher->file_count; i++) total += watcher->files[i].error_count;
+    return total;
+}
+
+/* Analyze path and keep its errors; a file that is gone is forgotten. Returns 1 if the file exists */
+static int analyze_file(Watcher *watcher, const char *path) {
+    Language lang;
+    int index = find_file(watcher, path);
+    char *source_code = is_source_file(path, &lang) ? read_source(path) : NULL;
+    if (!source_code) {
+        if (index >= 0) remove_file(watcher, index);
+        return 0;
+    }
+
+    LexerResult result = { watcher->tokens, watcher->token_capacity, 0, watcher->comments, MAX_COMMENTS, 0,
+                           watcher->errors, MAX_ERRORS, 0 };
+    lexer_set_source_name(watcher->context, path);
+    int analyzed = lexer_analyze_all(watcher->context, lang, source_code, strlen(source_code), &result);
+    watcher->tokens = result.tokens;
+    watcher->token_capacity = result.token_capacity;
+    lexer_free(source_code);
+    if (!analyzed) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+
+    if (index < 0) {
+        if (watcher->file_count == watcher->file_capacity) {
+            watcher->file_capacity = watcher->file_capacity ? watcher->file_capacity * 2 : 64;
+            watcher->files = realloc(watcher->files, sizeof(WatchedFile) * watcher->file_capacity);
+            if (!watcher->files) out_of_memory();
+        }
+        char *copy = strdup(path);
+        if (!copy) out_of_memory();
+        index = watcher->file_count++;
+        watcher->files[index] = (WatchedFile){ copy, NULL, 0 };
+        path_index_put(&watcher->file_index, copy, index);
+    }
+    WatchedFile *file = &watcher->files[index];
+    lexer_free(file->errors);
+    file->errors = lexer_malloc(sizeof(Error) * (result.error_count ? result.error_count : 1));
+    if (!file->errors) out_of_memory();
+    memcpy(file->errors, result.errors, sizeof(Error) * result.error_count);
+    file->error_count = result.error_count;
+    return 1;
+}
+
+/*===========================================================================
+ * SECTION 4: DIRECTORY WATCHES
+ *===========================================================================*/
+
+/* Watch directory and everything below it; with analyze set, analyze the files found */
+static void watch_tree(Watcher *watcher, const char *directory, int analyze) {
+    int wd = inotify_add_watch(watcher->inotify_fd, directory, WATCH_DIR_EVENTS);
+    if (wd < 0) {
+        fprintf(stderr, "Warning: Cannot watch '%s': %s\n", directory, strerror(errno));
+        return;
+    }
+    path_list_set(&watcher->directories, wd, directory);
+
+    DIR *dir = opendir(directory);
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;     // ".", ".." and hidden directories such as .git
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+
+        struct stat info;
+        if (stat(path, &info) != 0) continue;
+        Language lang;
+        if (S_ISDIR(info.st_mode)) {
+            watch_tree(watcher, path, analyze);
+        } else if (S_ISREG(info.st_mode) && is_source_file(entry->d_name, &lang)) {
+            if (analyze) analyze_file(watcher, path);
+            else add_pending(watcher, path);
+        }
+    }
+    closedir(dir);
+}
+
+/* A directory was deleted or moved away: unwatch its subtree; its files count as changed (and are gone) */
+static void unwatch_tree(Watcher *watcher, const char *directory) {
+    for (int wd = 0; wd < watcher->directories.count; wd++) {
+        if (!watcher->directories.items[wd] || !is_under(watcher->directories.items[wd], directory)) continue;
+        inotify_rm_watch(watcher->inotify_fd, wd);     // Fails harmlessly if the kernel already dropped it
+        free(watcher->directories.items[wd]);
+        watcher->directories.items[wd] = NULL;
+    }
+    for (int i = 0; i < watcher->file_count; i++) {
+        if (is_under(watcher->files[i].path, directory)) add_pending(watcher, watcher->files[i].path);
+    }
+}
+
+/* Collect the files touched by the events in buffer */
+static void handle_events(Watcher *watcher, const char *buffer, ssize_t length) {
+    for (const char *p = buffer; p < buffer + length;) {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            // Events were lost: re-check every known file and rescan the tree
+            for (int i = 0; i < watcher->file_count; i++) add_pending(watcher, watcher->files[i].path);
+            watch_tree(watcher, watcher->root, 0);
+            continue;
+        }
+        if ((event->mask & IN_IGNORED) && event->wd < watcher->directories.count) {
+            // The watch is gone (its directory was deleted or unwatched)
+            free(watcher->directories.items[event->wd]);
+            watcher->directories.items[event->wd] = NULL;
+            continue;
+        }
+        if (event->len == 0 || event->wd >= watcher->directories.count || !watcher->directories.items[event->wd]) continue;
+        if (event->name[0] == '.') continue;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", watcher->directories.items[event->wd], event->name);
+        Language lang;
+        if (event->mask & IN_ISDIR) {
+            // A new or moved-in directory: watch it; its files count as changed
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) watch_tree(watcher, path, 0);
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) unwatch_tree(watcher, path);
+        } else if (is_source_file(event->name, &lang)) {
+            add_pending(watcher, path);
+        }
+    }
+}
+
+/* Analyze the pending files and print their errors and the new totals */
+static void analyze_pending(Watcher *watcher) {
+    for (int i = 0; i < watcher->pending.count; i++) {
+        const char *path = watcher->pending.items[i];
+        int had_file = find_file(watcher, path) >= 0;
+        if (analyze_file(watcher, path)) {
+            WatchedFile *file = &watcher->files[find_file(watcher, path)];
+            watcher->print_file_errors(stdout, file->path, file->errors, file->error_count);
+        } else if (had_file) {
+            printf("%s: removed\n", path);
+        }
+    }
+    clear_pending(watcher);
+    printf("Watching %d files: %d errors\n", watcher->file_count, total_errors(watcher));
+    fflush(stdout);
+}
+
+/*===========================================================================
+ * SECTION 5: EVENT LOOP
+ *===========================================================================*/
+
+int run_watch(const char *directory, int thread_count, FileErrorPrinter print_file_errors) {
+    struct stat info;
+    if (stat(directory, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        printf("Error: '%s' is not a directory\n", directory);
+        return 1;
+    }
+
+    Watcher watcher = {0};
+    watcher.root = directory;
+    watcher.print_file_errors = print_file_errors;
+    watcher.inotify_fd = inotify_init1(IN_CLOEXEC);
+    watcher.context = lexer_create();
+    watcher.comments = lexer_malloc(sizeof(Comment) * MAX_COMMENTS);
+    watcher.errors = lexer_malloc(sizeof(Error) * MAX_ERRORS);
+    if (watcher.inotify_fd < 0) {
+        printf("Error: Cannot start watching: %s\n", strerror(errno));
+        return 1;
+    }
+    if (!watcher.context || !watcher.comments || !watcher.errors) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+    lexer_set_threads(watcher.context, thread_count);
+
+    // Initial full analysis; afterwards only changed files are analyzed
+    watch_tree(&watcher, directory, 1);
+    for (int i = 0; i < watcher.file_count; i++) {
+        WatchedFile *file = &watcher.files[i];
+        if (file->error_count > 0) print_file_errors(stdout, file->path, file->errors, file->error_count);
+    }
+    printf("Watching %d files: %d errors\n", watcher.file_count, total_errors(&watcher));
+    fflush(stdout);
+
+    static char buffer[WATCH_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        int timeout = -1;
+        if (watcher.pending.count > 0) {
+            long long wait = watcher.due_ms - now_ms();
+            timeout = wait > 0 ? (int)wait : 0;
+        }
+
+        struct pollfd events = { watcher.inotify_fd, POLLIN, 0 };
+        int ready = poll(&events, 1, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready == 0) {
+            analyze_pending(&watcher);
+            continue;
+        }
+
+        ssize_t length = read(watcher.inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && errno == EINTR) continue;
+            break;
+        }
+        handle_events(&watcher, buffer, length);
+        if (watcher.pending.count > 0) watcher.due_ms = now_ms() + WATCH_DEBOUNCE_MS;
+    }
+    printf("Error: Watching stopped: %s\n", strerror(errno));
+    return 1;
+}
@@ -0,0 +1,21 @@
+/**
+ * LEXICAL ANALYZER FOR PYTHON AND TYPESCRIPT - WATCH MODE
+ *
+ * ./lexer --watch <dir> analyzes every .py/.ts/.js file under dir, then
+ * re-analyzes only the files that change (inotify), printing their errors.
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdio.h>
+
+#include "lexer.h"
+
+/* Prints the errors of one file (compact, one line per error) */
+typedef void (*FileErrorPrinter)(FILE *out, const char *filename, const Error *errors, int error_count);
+
+/* Watch directory until killed; returns the exit code if watching cannot start */
+int run_watch(const char *directory, int thread_count, FileErrorPrinter print_file_errors);
+
+#endif